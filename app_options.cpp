@@ -0,0 +1,420 @@
+#include "app_options.h"
+
+#include <cstdio>
+#include <sstream>
+#include <stdexcept>
+#include <string_view>
+
+namespace
+{
+
+// Six comma-separated voxel indices, X0,X1,Y0,Y1,Z0,Z1
+std::vector<int> ParseExtent(const std::string &text)
+{
+    std::vector<int> extent;
+    std::istringstream stream(text);
+    std::string item;
+    while (std::getline(stream, item, ','))
+    {
+        extent.push_back(std::stoi(item));
+    }
+    if (extent.size() != 6 || extent[0] > extent[1] || extent[2] > extent[3] ||
+        extent[4] > extent[5])
+    {
+        throw std::invalid_argument("--extent needs X0,X1,Y0,Y1,Z0,Z1 with X0 <= X1 and so on");
+    }
+    return extent;
+}
+
+// Two comma-separated values, LOWER,UPPER, of option
+std::vector<double> ParseRange(const std::string &option, const std::string &text)
+{
+    std::vector<double> bounds;
+    std::istringstream stream(text);
+    std::string item;
+    while (std::getline(stream, item, ','))
+    {
+        bounds.push_back(std::stod(item));
+    }
+    if (bounds.size() != 2 || bounds[0] > bounds[1])
+    {
+        throw std::invalid_argument(option + " needs LOWER,UPPER with LOWER <= UPPER");
+    }
+    return bounds;
+}
+
+} // namespace
+
+AppOptions ParseOptions(int argc, char *argv[])
+{
+    AppOptions options;
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string_view arg = argv[i];
+        auto value = [&]() -> std::string {
+            if (i + 1 >= argc)
+            {
+                throw std::invalid_argument(std::string(arg) + " needs a value");
+            }
+            return argv[++i];
+        };
+
+        if (arg == "-h" || arg == "--help")
+        {
+            options.showHelp = true;
+        }
+        else if (arg == "--mesh")
+        {
+            options.meshPath = value();
+        }
+        else if (arg == "--octree")
+        {
+            options.octreePath = value();
+        }
+        else if (arg == "--point-budget")
+        {
+            options.pointBudget = std::stoull(value());
+        }
+        else if (arg == "--build-octree")
+        {
+            options.octreeInput = value();
+            options.octreeOutput = value();
+        }
+        else if (arg == "--sdf")
+        {
+            options.sdfResolution = std::stoi(value());
+        }
+        else if (arg == "--components")
+        {
+            options.keepComponents = std::stoi(value());
+        }
+        else if (arg == "--min-area")
+        {
+            options.minimumArea = std::stod(value());
+        }
+        else if (arg == "--smooth")
+        {
+            options.smoothIterations = std::stoi(value());
+        }
+        else if (arg == "--measure")
+        {
+            options.measure = true;
+        }
+        else if (arg == "--save")
+        {
+            options.savePath = value();
+        }
+        else if (arg == "--save-bits")
+        {
+            options.saveBits = std::stoi(value());
+        }
+        else if (arg == "--export-glb")
+        {
+            options.glbPath = value();
+        }
+        else if (arg == "--glb-lods")
+        {
+            options.glbLevels = std::stoi(value());
+        }
+        else if (arg == "--snapshot")
+        {
+            options.snapshotPath = value();
+        }
+        else if (arg == "--clip")
+        {
+            options.clip = true;
+        }
+        else if (arg == "--crop")
+        {
+            options.crop = true;
+        }
+        else if (arg == "--volume")
+        {
+            options.volumePath = value();
+        }
+        else if (arg == "--extent")
+        {
+            options.volumeExtent = ParseExtent(value());
+        }
+        else if (arg == "--save-volume")
+        {
+            options.saveVolumePath = value();
+        }
+        else if (arg == "--hdf-chunk")
+        {
+            options.hdfChunk = std::stoi(value());
+        }
+        else if (arg == "--labels")
+        {
+            options.labels = true;
+        }
+        else if (arg == "--dicom")
+        {
+            options.dicomPath = value();
+        }
+        else if (arg == "--play")
+        {
+            options.play = true;
+        }
+        else if (arg == "--incremental")
+        {
+            options.incremental = true;
+        }
+        else if (arg == "--iso")
+        {
+            options.isoValue = std::stod(value());
+        }
+        else if (arg == "--threshold")
+        {
+            options.threshold = ParseRange("--threshold", value());
+        }
+        else if (arg == "--volume-smooth")
+        {
+            options.volumeSigma = std::stod(value());
+        }
+        else if (arg == "--grow")
+        {
+            options.growRange = ParseRange("--grow", value());
+        }
+        else if (arg == "--fps")
+        {
+            options.framesPerSecond = std::stod(value());
+        }
+        else if (arg == "--ring-size")
+        {
+            options.ringSize = std::stoi(value());
+        }
+        else if (arg == "--io-depth")
+        {
+            options.ioDepth = std::stoi(value());
+        }
+        else if (arg == "--volume-cache")
+        {
+            options.volumeCache = value();
+        }
+        else if (arg == "--watch")
+        {
+            options.watchPath = value();
+        }
+        else if (arg == "--settle")
+        {
+            options.settleSeconds = std::stod(value());
+        }
+        else if (arg == "--startup-profile")
+        {
+            options.startupProfile = true;
+        }
+        else if (arg == "--bench")
+        {
+            options.benchmark = value();
+            options.benchmarkArgs.assign(argv + i + 1, argv + argc);
+            break;
+        }
+        else
+        {
+            throw std::invalid_argument("unknown option " + std::string(arg));
+        }
+    }
+    for (int i = 1; i < argc; ++i)
+    {
+        if (std::string_view(argv[i]) == "--snapshot")
+        {
+            ++i;
+            continue;
+        }
+        options.sceneArguments += argv[i];
+        options.sceneArguments += '\n';
+    }
+    if (options.play && options.dicomPath.empty())
+    {
+        throw std::invalid_argument("--play needs --dicom");
+    }
+    const bool volume = !options.dicomPath.empty() || !options.volumePath.empty();
+    if (options.crop && !volume)
+    {
+        throw std::invalid_argument("--crop needs --dicom or --volume");
+    }
+    if (options.incremental && !options.play)
+    {
+        throw std::invalid_argument("--incremental needs --play");
+    }
+    if (!options.saveVolumePath.empty() && !volume)
+    {
+        throw std::invalid_argument("--save-volume needs --dicom or --volume");
+    }
+    if (options.labels &&
+        (!volume || options.play || options.incremental || !std::isnan(options.isoValue) ||
+         !options.threshold.empty() || options.volumeSigma != 0.0 || options.sdfResolution > 0 ||
+         options.keepComponents > 0 || options.minimumArea > 0.0 || options.measure ||
+         options.clip || options.crop))
+    {
+        throw std::invalid_argument("--labels needs --dicom or --volume, without --play, "
+                                    "--incremental, --iso, --threshold, --volume-smooth, --sdf, "
+                                    "--components, --min-area, --measure, --clip or --crop");
+    }
+    if (!options.growRange.empty() &&
+        (!volume || options.play || options.labels || options.crop ||
+         !options.snapshotPath.empty()))
+    {
+        throw std::invalid_argument(
+            "--grow needs --dicom or --volume, without --play, --labels, --crop or --snapshot");
+    }
+    if (!options.volumeExtent.empty() && options.volumePath.empty())
+    {
+        throw std::invalid_argument("--extent needs --volume");
+    }
+    if (!options.dicomPath.empty() && !options.volumePath.empty())
+    {
+        throw std::invalid_argument("--dicom and --volume are exclusive");
+    }
+    if (!options.volumeCache.empty() && (options.dicomPath.empty() || options.play))
+    {
+        throw std::invalid_argument("--volume-cache needs --dicom without --play");
+    }
+    if ((!options.threshold.empty() || options.volumeSigma != 0.0) &&
+        ((!volume && options.watchPath.empty()) || options.incremental))
+    {
+        throw std::invalid_argument("--threshold and --volume-smooth need --dicom, --volume or "
+                                    "--watch, without --incremental");
+    }
+    if (options.volumeSigma < 0.0)
+    {
+        throw std::invalid_argument("--volume-smooth must not be negative");
+    }
+    if (options.ioDepth < 0)
+    {
+        throw std::invalid_argument("--io-depth must not be negative");
+    }
+    if (options.hdfChunk < 1)
+    {
+        throw std::invalid_argument("--hdf-chunk must be positive");
+    }
+    if (options.saveBits < 4 || options.saveBits > 24)
+    {
+        throw std::invalid_argument("--save-bits must be 4 to 24");
+    }
+    if (!options.watchPath.empty() &&
+        (!options.dicomPath.empty() || !options.volumePath.empty() ||
+         !options.meshPath.empty() || !options.octreePath.empty()))
+    {
+        throw std::invalid_argument("--watch replaces --dicom, --volume, --mesh and --octree");
+    }
+    const bool moving = options.play || !options.watchPath.empty();
+    if (!options.glbPath.empty() && (moving || !options.octreePath.empty()))
+    {
+        throw std::invalid_argument(
+            "--export-glb needs a surface, not --play, --watch or --octree");
+    }
+    if ((options.clip || options.crop || options.measure || !options.savePath.empty() ||
+         !options.saveVolumePath.empty()) &&
+        moving)
+    {
+        throw std::invalid_argument("--clip, --crop, --measure, --save and --save-volume need a "
+                                    "still surface, not --play or --watch");
+    }
+    if (!options.snapshotPath.empty() &&
+        (moving || !options.octreePath.empty() || options.clip || options.crop ||
+         options.measure || !options.savePath.empty() || !options.saveVolumePath.empty()))
+    {
+        throw std::invalid_argument("--snapshot needs a still surface without --clip, --crop, "
+                                    "--measure, --save or --save-volume");
+    }
+    return options;
+}
+
+void PrintUsage(const char *program)
+{
+    std::printf("Usage: %s [options]\n"
+                "  --mesh FILE              render an STL, PLY, OBJ, .qmesh or .vtkhdf mesh\n"
+                "                           instead of the cube\n"
+                "  --octree FILE            stream a point-cloud octree instead of the cube\n"
+                "  --point-budget N         points drawn per frame from the octree (5000000)\n"
+                "  --build-octree IN OUT    build an octree from a binary PLY or raw float32\n"
+                "                           xyz file and exit\n"
+                "  --sdf N                  show the surface rebuilt from its sparse distance\n"
+                "                           field with N points along the longest side\n"
+                "  --components N           keep the N largest connected components of the\n"
+                "                           surface\n"
+                "  --min-area A             drop surface components with less area than A\n"
+                "  --smooth N               smooth the surface with N windowed-sinc iterations\n"
+                "  --measure                log the area, volume, curvature and wall thickness\n"
+                "                           of the surface\n"
+                "  --save FILE              write the surface to an STL, PLY, OBJ, .qmesh or\n"
+                "                           .vtkhdf file\n"
+                "  --save-bits N            bits per coordinate of .qmesh positions (16)\n"
+                "  --export-glb FILE        write the scene as binary glTF with levels of detail\n"
+                "  --glb-lods N             levels of detail per surface in glTF exports (3)\n"
+                "  --snapshot FILE          start from the scene saved in FILE by an earlier run\n"
+                "                           with the same arguments, or save it there on exit\n"
+                "  --clip                   clip the surface with a plane widget\n"
+                "  --crop                   crop the volume with a box widget\n"
+                "  --volume FILE            isosurface a VTKHDF, NRRD (.nrrd, .nhdr) or NIfTI\n"
+                "                           (.nii, .nii.gz) volume instead of the cube\n"
+                "  --extent X0,X1,Y0,Y1,Z0,Z1\n"
+                "                           read only these voxels of a VTKHDF --volume file\n"
+                "  --save-volume FILE       write the volume to a VTKHDF file\n"
+                "  --hdf-chunk N            chunk edge in voxels of saved volumes (64)\n"
+                "  --labels                 show the volume as a segmentation, one surface\n"
+                "                           per label, all extracted in one pass\n"
+                "  --dicom DIR              isosurface the first DICOM series under DIR\n"
+                "  --play                   play the time phases of the DICOM series\n"
+                "  --incremental            re-extract only blocks that changed between phases\n"
+                "  --iso VALUE              isovalue (middle of the scalar range)\n"
+                "  --threshold LOWER,UPPER  set voxels outside LOWER to UPPER to LOWER before\n"
+                "                           the isosurface\n"
+                "  --volume-smooth SIGMA    Gaussian of SIGMA voxels before the isosurface\n"
+                "  --grow LOWER,UPPER       grow regions of voxels within LOWER to UPPER from\n"
+                "                           the surface point under the mouse when g is pressed\n"
+                "  --fps N                  target playback rate (20)\n"
+                "  --ring-size N            phases prefetched ahead of playback (8)\n"
+                "  --io-depth N             read DICOM slices N files at a time with io_uring\n"
+                "                           and GDCM instead of vtkDICOMReader (0)\n"
+                "  --volume-cache NAME      share the DICOM volume with other viewers using the\n"
+                "                           same cache NAME\n"
+                "  --watch DIR              show DICOM series pushed into DIR as they complete\n"
+                "  --settle SECONDS         quiet time that completes a series without slice\n"
+                "                           counts (2)\n"
+                "  --startup-profile        log where the time to the first frame went and exit\n"
+                "  --bench NAME ARGS...     run a benchmark and exit:\n"
+                "      readers FILE...      parallel readers vs vtkSTL/PLY/OBJReader\n"
+                "      incremental DIR [ISO [BLOCK]]\n"
+                "                           full vs incremental isosurface over the phases\n"
+                "      voxelize [FILE [N]]  voxelize a mesh (the cube) onto an N^3 grid (1024)\n"
+                "      sdf [FILE [N [BAND]]]\n"
+                "                           sparse distance field of a mesh (the cube), N points\n"
+                "                           on the longest side (512), BAND voxels wide (3)\n"
+                "      smooth FILE [N]      parallel vs vtkWindowedSincPolyDataFilter, N\n"
+                "                           iterations (20)\n"
+                "      components FILE [N]  parallel vs vtkPolyDataConnectivityFilter, keeping\n"
+                "                           the N largest components (1)\n"
+                "      clip FILE [STEPS]    parallel vs vtkClipPolyData for a plane swept over\n"
+                "                           the mesh in STEPS positions (20)\n"
+                "      topology FILE [STAGES]\n"
+                "                           cached CSR topology vs BuildLinks in every one of\n"
+                "                           STAGES mesh stages (4)\n"
+                "      compress FILE [BITS] .qmesh size and decode speed with BITS per\n"
+                "                           coordinate (16)\n"
+                "      hdf [N [CHUNK [FILE]]]\n"
+                "                           VTKHDF vs XML round trip of an N^3 volume (512) in\n"
+                "                           CHUNK^3 chunks (64) and of a mesh, if given\n"
+                "      uring DIR [DEPTH...] sequential vs batched reads of the files under DIR\n"
+                "                           at each queue depth (1 8 32 128), and of its first\n"
+                "                           DICOM series decoded with GDCM\n"
+                "      fused [N [SIGMA [DEPTH]]]\n"
+                "                           fused threshold, Gaussian and isosurface kernel vs\n"
+                "                           the VTK filters on an N^3 volume (384), SIGMA\n"
+                "                           voxels (2), slabs of DEPTH layers (16)\n"
+                "      expr [N]             expression template and formula vs chained\n"
+                "                           vtkImageMathematics on N^3 volumes (384)\n"
+                "      dispatch [N]         per-value cost of virtual vtkDataArray access vs\n"
+                "                           array_dispatch kernels on N^3 values (256)\n"
+                "      labels [N [LABELS]]  one-pass label surfaces vs vtkDiscreteFlyingEdges3D\n"
+                "                           per label on an N^3 segmentation (256) of LABELS\n"
+                "                           labels (100)\n"
+                "      grow [N [LOWER [UPPER]]]\n"
+                "                           parallel region growing vs a serial flood fill on\n"
+                "                           an N^3 volume (384) within LOWER to UPPER (-300 to\n"
+                "                           1000)\n"
+                "  -h, --help               show this help\n",
+                program);
+}
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Command line of simple_vtk_example. Without arguments the example renders a
+// cube, as it always did.
+struct AppOptions
+{
+    // --mesh FILE: render an STL/PLY/OBJ/.qmesh/.vtkhdf mesh instead of the cube
+    std::string meshPath;
+
+    // --octree FILE: stream a point-cloud octree instead of the cube
+    std::string octreePath;
+    // --point-budget N: points drawn per frame from the octree
+    std::uint64_t pointBudget = 5000000;
+    // --build-octree INPUT OUTPUT: build an octree file and exit
+    std::string octreeInput;
+    std::string octreeOutput;
+
+    // --sdf N: show the zero level set of the surface's narrow-band distance
+    // field sampled with N points along the longest side, 0 for the surface
+    int sdfResolution = 0;
+
+    // --components N: keep the N largest connected components of the surface,
+    // 0 for all of them
+    int keepComponents = 0;
+    // --min-area A: drop components with less area than A
+    double minimumArea = 0.0;
+
+    // --smooth N: windowed-sinc smoothing of the surface with N iterations
+    int smoothIterations = 0;
+
+    // --measure: log the area, volume, curvature and wall thickness of the
+    // surface
+    bool measure = false;
+
+    // --save FILE: write the surface to an STL/PLY/OBJ/.qmesh/.vtkhdf file
+    std::string savePath;
+    // --save-bits N: bits per position coordinate in .qmesh files
+    int saveBits = 16;
+
+    // --export-glb FILE: write the scene as binary glTF with levels of detail
+    std::string glbPath;
+    // --glb-lods N: levels of detail per actor, the full surface included
+    int glbLevels = 3;
+
+    // --snapshot FILE: restore the scene from FILE if it was written with the
+    // same arguments and inputs; otherwise build it and write FILE on exit
+    std::string snapshotPath;
+    // Every argument but --snapshot FILE, one per line; they decide the scene
+    std::string sceneArguments;
+
+    // --clip: clip the surface with a plane widget
+    bool clip = false;
+    // --crop: crop the DICOM or --volume volume with a box widget
+    bool crop = false;
+
+    // --volume FILE: isosurface a VTKHDF, NRRD or NIfTI volume instead of the
+    // cube
+    std::string volumePath;
+    // --extent X0,X1,Y0,Y1,Z0,Z1: read only these voxels of a VTKHDF --volume
+    std::vector<int> volumeExtent;
+    // --save-volume FILE: write the DICOM or --volume volume to a VTKHDF file
+    std::string saveVolumePath;
+    // --hdf-chunk N: edge in voxels of the chunks of saved volumes
+    int hdfChunk = 64;
+
+    // --labels: show the --dicom or --volume volume as a segmentation, one
+    // surface per label
+    bool labels = false;
+
+    // --dicom DIR: isosurface a DICOM series instead of the cube
+    std::string dicomPath;
+    // --play: loop over the time phases of the series
+    bool play = false;
+    // --incremental: re-extract only the blocks that changed between phases
+    bool incremental = false;
+    // --iso VALUE: isovalue, NaN for the middle of the scalar range
+    double isoValue = std::nan("");
+    // --threshold LOWER,UPPER: set the voxels outside [LOWER, UPPER] to LOWER
+    // before the isosurface
+    std::vector<double> threshold;
+    // --volume-smooth SIGMA: Gaussian of SIGMA voxels before the isosurface,
+    // after the threshold
+    double volumeSigma = 0.0;
+    // --grow LOWER,UPPER: grow regions of the voxels within [LOWER, UPPER]
+    // from seeds picked on the surface
+    std::vector<double> growRange;
+    // --fps N: target playback rate
+    double framesPerSecond = 20.0;
+    // --ring-size N: phases prefetched ahead of playback
+    int ringSize = 8;
+    // --io-depth N: read the DICOM slices N files at a time with the batched
+    // reader and GDCM instead of vtkDICOMReader, 0 for vtkDICOMReader
+    int ioDepth = 0;
+    // --volume-cache NAME: share the --dicom volume with other viewers using
+    // the cache NAME
+    std::string volumeCache;
+
+    // --watch DIR: show every DICOM series pushed into a spool folder once it
+    // is complete
+    std::string watchPath;
+    // --settle SECONDS: quiet time after which a series without slice counts
+    // is complete
+    double settleSeconds = 2.0;
+
+    // --startup-profile: log where the time to the first frame went, then exit
+    bool startupProfile = false;
+
+    // --bench NAME ARGS...: run a benchmark instead of opening a window; every
+    // argument after NAME belongs to the benchmark
+    std::string benchmark;
+    std::vector<std::string> benchmarkArgs;
+
+    bool showHelp = false;
+};
+
+// Throws std::invalid_argument on unknown options or missing values.
+AppOptions ParseOptions(int argc, char *argv[]);
+
+void PrintUsage(const char *program);
@@ -0,0 +1,15 @@
+#include "array_dispatch.h"
+
+array_dispatch::FloatReader array_dispatch::MakeFloatReader(vtkDataArray *array)
+{
+    FloatReader reader;
+    Dispatch(array, [&reader](auto values) {
+        reader = [values](vtkIdType begin, int count, float *out) {
+            for (int i = 0; i < count; ++i)
+            {
+                out[i] = static_cast<float>(values.GetValue(begin + i));
+            }
+        };
+    });
+    return reader;
+}
@@ -0,0 +1,263 @@
+#pragma once
+
+#include <vtkAOSDataArrayTemplate.h>
+#include <vtkDataArray.h>
+#include <vtkSOADataArrayTemplate.h>
+#include <vtkType.h>
+
+#include <array>
+#include <functional>
+#include <type_traits>
+#include <vector>
+
+// Typed access to the values of a vtkDataArray.
+//
+// vtkDataArray::GetTuple, GetComponent and vtkPoints::GetPoint are virtual and
+// convert every value to double; in a loop over voxels or points the calls
+// cost more than the work. Dispatch resolves the value type, the number of
+// components and the memory layout of an array once and calls a generic
+// lambda with an accessor whose methods are inline loads from the array's
+// memory. The lambda is compiled for every combination, so keep the kernel in
+// it and the work per call large:
+//
+//     array_dispatch::Dispatch(scalars, [&](auto values) {
+//         for (vtkIdType i = 0; i < values.GetNumberOfTuples(); ++i)
+//             sum += values.Get(i, 0);
+//     });
+//
+// Accessors are a few pointers; pass them by value, so that the compiler
+// keeps them in registers. Arrays of other classes, such as implicit arrays,
+// get GenericValues, which goes through the virtual methods.
+namespace array_dispatch
+{
+
+// Number of components known only at run time
+constexpr int kDynamic = 0;
+
+// Array of structures: the components of a tuple next to each other
+template <typename T, int N>
+class AOSValues
+{
+public:
+    using ValueType = T;
+    static constexpr int kComponents = N;
+
+    explicit AOSValues(vtkAOSDataArrayTemplate<T> *array)
+        : values_(array->GetPointer(0)), tuples_(array->GetNumberOfTuples()),
+          components_(array->GetNumberOfComponents())
+    {
+    }
+
+    vtkIdType GetNumberOfTuples() const { return tuples_; }
+    int GetNumberOfComponents() const { return N == kDynamic ? components_ : N; }
+
+    T Get(vtkIdType tuple, int component) const
+    {
+        return values_[tuple * GetNumberOfComponents() + component];
+    }
+    void Set(vtkIdType tuple, int component, T value) const
+    {
+        values_[tuple * GetNumberOfComponents() + component] = value;
+    }
+
+    // Value index of tuple * components + component
+    T GetValue(vtkIdType index) const { return values_[index]; }
+
+    template <typename U>
+    void GetTuple(vtkIdType tuple, U *out) const
+    {
+        const T *in = values_ + tuple * GetNumberOfComponents();
+        for (int c = 0; c < GetNumberOfComponents(); ++c)
+        {
+            out[c] = static_cast<U>(in[c]);
+        }
+    }
+
+private:
+    T *values_;
+    vtkIdType tuples_;
+    int components_;
+};
+
+// Structure of arrays: one array per component
+template <typename T, int N>
+class SOAValues
+{
+public:
+    using ValueType = T;
+    static constexpr int kComponents = N;
+
+    explicit SOAValues(vtkSOADataArrayTemplate<T> *array)
+        : tuples_(array->GetNumberOfTuples()), components_(array->GetNumberOfComponents())
+    {
+        if constexpr (N == kDynamic)
+        {
+            arrays_.resize(components_);
+        }
+        for (int c = 0; c < components_; ++c)
+        {
+            arrays_[c] = array->GetComponentArrayPointer(c);
+        }
+    }
+
+    vtkIdType GetNumberOfTuples() const { return tuples_; }
+    int GetNumberOfComponents() const { return N == kDynamic ? components_ : N; }
+
+    T Get(vtkIdType tuple, int component) const { return arrays_[component][tuple]; }
+    void Set(vtkIdType tuple, int component, T value) const
+    {
+        arrays_[component][tuple] = value;
+    }
+
+    T GetValue(vtkIdType index) const
+    {
+        return Get(index / GetNumberOfComponents(),
+                   static_cast<int>(index % GetNumberOfComponents()));
+    }
+
+    template <typename U>
+    void GetTuple(vtkIdType tuple, U *out) const
+    {
+        for (int c = 0; c < GetNumberOfComponents(); ++c)
+        {
+            out[c] = static_cast<U>(arrays_[c][tuple]);
+        }
+    }
+
+private:
+    std::conditional_t<N == kDynamic, std::vector<T *>, std::array<T *, N>> arrays_;
+    vtkIdType tuples_;
+    int components_;
+};
+
+// Any other array, through the virtual methods of vtkDataArray
+class GenericValues
+{
+public:
+    using ValueType = double;
+    static constexpr int kComponents = kDynamic;
+
+    explicit GenericValues(vtkDataArray *array)
+        : array_(array), tuples_(array->GetNumberOfTuples()),
+          components_(array->GetNumberOfComponents())
+    {
+    }
+
+    vtkIdType GetNumberOfTuples() const { return tuples_; }
+    int GetNumberOfComponents() const { return components_; }
+
+    double Get(vtkIdType tuple, int component) const
+    {
+        return array_->GetComponent(tuple, component);
+    }
+    void Set(vtkIdType tuple, int component, double value) const
+    {
+        array_->SetComponent(tuple, component, value);
+    }
+
+    double GetValue(vtkIdType index) const
+    {
+        return Get(index / components_, static_cast<int>(index % components_));
+    }
+
+    template <typename U>
+    void GetTuple(vtkIdType tuple, U *out) const
+    {
+        for (int c = 0; c < components_; ++c)
+        {
+            out[c] = static_cast<U>(array_->GetComponent(tuple, c));
+        }
+    }
+
+private:
+    vtkDataArray *array_;
+    vtkIdType tuples_;
+    int components_;
+};
+
+// Calls fn with the accessor of array if it is an AOS or SOA array of T.
+// Arrays of 1 and 3 components get the count as a constant.
+template <typename T, typename Fn>
+bool DispatchAs(vtkDataArray *array, Fn &fn)
+{
+    const int components = array->GetNumberOfComponents();
+    if (auto *aos = vtkAOSDataArrayTemplate<T>::FastDownCast(array))
+    {
+        switch (components)
+        {
+        case 1:
+            fn(AOSValues<T, 1>(aos));
+            break;
+        case 3:
+            fn(AOSValues<T, 3>(aos));
+            break;
+        default:
+            fn(AOSValues<T, kDynamic>(aos));
+            break;
+        }
+        return true;
+    }
+    if (auto *soa = vtkSOADataArrayTemplate<T>::FastDownCast(array))
+    {
+        // An SOA array may hold its values in one AOS buffer, which has no
+        // component arrays
+        for (int c = 0; c < components; ++c)
+        {
+            if (!soa->GetComponentArrayPointer(c))
+            {
+                return false;
+            }
+        }
+        switch (components)
+        {
+        case 1:
+            fn(SOAValues<T, 1>(soa));
+            break;
+        case 3:
+            fn(SOAValues<T, 3>(soa));
+            break;
+        default:
+            fn(SOAValues<T, kDynamic>(soa));
+            break;
+        }
+        return true;
+    }
+    return false;
+}
+
+// Calls fn once with the accessor of array, for every scalar type
+template <typename Fn>
+void Dispatch(vtkDataArray *array, Fn &&fn)
+{
+    bool done = false;
+    switch (array->GetDataType())
+    {
+        vtkTemplateMacro(done = DispatchAs<VTK_TT>(array, fn));
+    }
+    if (!done)
+    {
+        fn(GenericValues(array));
+    }
+}
+
+// Dispatch for arrays that are float or double in practice, such as points
+// and normals; other types get GenericValues. Compiles 13 kernels instead of
+// over 80.
+template <typename Fn>
+void DispatchReal(vtkDataArray *array, Fn &&fn)
+{
+    if (!DispatchAs<float>(array, fn) && !DispatchAs<double>(array, fn))
+    {
+        fn(GenericValues(array));
+    }
+}
+
+// Values begin to begin + count of an array, in order of value index, as
+// float
+using FloatReader = std::function<void(vtkIdType begin, int count, float *out)>;
+
+// Reader of array with the loop compiled for its type and layout. The array
+// must outlive the reader.
+FloatReader MakeFloatReader(vtkDataArray *array);
+
+} // namespace array_dispatch
@@ -0,0 +1,537 @@
+#include "batched_file_reader.h"
+
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+#ifdef _WIN32
+#include <fstream>
+#else
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef HAVE_LIBURING
+#include <liburing.h>
+#include <sys/uio.h>
+#endif
+
+// Hands files that are in memory to worker threads, and their buffer slots
+// back to the reader once consumed
+class BatchedFileReader::ConsumerPool
+{
+public:
+    ConsumerPool(const std::vector<std::string> &paths, const Consumer &consume, int slots,
+                 int workers)
+        : paths_(paths)
+        , consume_(consume)
+    {
+        for (int slot = 0; slot < slots; ++slot)
+        {
+            free_.push_back(slot);
+        }
+        for (int i = 0; i < workers; ++i)
+        {
+            workers_.emplace_back(&ConsumerPool::WorkerLoop, this);
+        }
+    }
+
+    ~ConsumerPool() { Join(); }
+
+    ConsumerPool(const ConsumerPool &) = delete;
+    ConsumerPool &operator=(const ConsumerPool &) = delete;
+
+    // Takes a free slot, if there is one
+    bool TryAcquire(int &slot)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (free_.empty())
+        {
+            return false;
+        }
+        slot = free_.front();
+        free_.pop_front();
+        return true;
+    }
+
+    // Waits for a slot to be free and takes it
+    int Acquire()
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        slotFreed_.wait(lock, [this] { return !free_.empty(); });
+        const int slot = free_.front();
+        free_.pop_front();
+        return slot;
+    }
+
+    // Waits for a slot to be free without taking it
+    void WaitForFreeSlot()
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        slotFreed_.wait(lock, [this] { return !free_.empty(); });
+    }
+
+    void Release(int slot)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            free_.push_back(slot);
+        }
+        slotFreed_.notify_all();
+    }
+
+    // Queues the contents of paths[index], held in slot, for a worker
+    void Submit(int slot, std::size_t index, const char *data, std::size_t size)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            queue_.push_back({slot, index, data, size});
+        }
+        fileReady_.notify_one();
+    }
+
+    // Records the first failure; the reader stops starting new files
+    void Fail(const std::string &message)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (error_.empty())
+        {
+            error_ = message;
+        }
+    }
+
+    bool Failed()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return !error_.empty();
+    }
+
+    // Waits for the workers to consume every queued file, then throws the
+    // first failure if there was one
+    void Finish()
+    {
+        Join();
+        if (!error_.empty())
+        {
+            throw std::runtime_error(error_);
+        }
+    }
+
+private:
+    struct File
+    {
+        int slot;
+        std::size_t index;
+        const char *data;
+        std::size_t size;
+    };
+
+    void WorkerLoop()
+    {
+        for (;;)
+        {
+            File file;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                fileReady_.wait(lock, [this] { return done_ || !queue_.empty(); });
+                if (queue_.empty())
+                {
+                    return;
+                }
+                file = queue_.front();
+                queue_.pop_front();
+            }
+            try
+            {
+                consume_(file.index, file.data, file.size);
+            }
+            catch (const std::exception &e)
+            {
+                Fail(paths_[file.index] + ": " + e.what());
+            }
+            Release(file.slot);
+        }
+    }
+
+    void Join()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            done_ = true;
+        }
+        fileReady_.notify_all();
+        for (std::thread &worker : workers_)
+        {
+            if (worker.joinable())
+            {
+                worker.join();
+            }
+        }
+    }
+
+    const std::vector<std::string> &paths_;
+    const Consumer &consume_;
+    std::mutex mutex_;
+    std::condition_variable fileReady_;
+    std::condition_variable slotFreed_;
+    std::deque<File> queue_;
+    std::deque<int> free_;
+    std::string error_;
+    bool done_ = false;
+    std::vector<std::thread> workers_;
+};
+
+namespace
+{
+
+#ifdef HAVE_LIBURING
+// What a completion finished, in the low bits of its user data
+enum Operation : std::uint64_t
+{
+    kOpen,
+    kStat,
+    kRead,
+    kClose,
+};
+
+std::uint64_t Tag(int slot, Operation operation)
+{
+    return std::uint64_t(slot) << 2 | operation;
+}
+#endif
+
+} // namespace
+
+BatchedFileReader::BatchedFileReader(const BatchedFileReaderOptions &options)
+    : queueDepth_(std::max(options.queueDepth, 1))
+    , bufferSize_(std::max<std::size_t>(options.bufferSize, 4096))
+    , workers_(options.workers > 0
+                   ? options.workers
+                   : std::max(1, static_cast<int>(std::thread::hardware_concurrency()) - 1))
+    , buffers_(std::size_t(queueDepth_) * bufferSize_)
+{
+#ifdef HAVE_LIBURING
+    if (options.forceFallback)
+    {
+        return;
+    }
+    // Room for the open and size query of every slot and the close of the
+    // file it held before
+    ring_ = new io_uring;
+    const int status = io_uring_queue_init(static_cast<unsigned>(queueDepth_) * 4, ring_, 0);
+    if (status < 0)
+    {
+        spdlog::warn("io_uring unavailable ({}), reading with pread", std::strerror(-status));
+        delete ring_;
+        ring_ = nullptr;
+        return;
+    }
+    std::vector<iovec> iovecs(static_cast<std::size_t>(queueDepth_));
+    for (int slot = 0; slot < queueDepth_; ++slot)
+    {
+        iovecs[slot] = {SlotBuffer(slot), bufferSize_};
+    }
+    const int registered = io_uring_register_buffers(ring_, iovecs.data(), iovecs.size());
+    registered_ = registered == 0;
+    if (!registered_)
+    {
+        // Usually RLIMIT_MEMLOCK; plain reads into the same buffers still work
+        spdlog::warn("cannot register io_uring buffers ({}), reading without them",
+                     std::strerror(-registered));
+    }
+#else
+    (void)options.forceFallback;
+#endif
+}
+
+BatchedFileReader::~BatchedFileReader()
+{
+#ifdef HAVE_LIBURING
+    if (ring_)
+    {
+        io_uring_queue_exit(ring_);
+        delete ring_;
+    }
+#endif
+}
+
+void BatchedFileReader::ReadAll(const std::vector<std::string> &paths, const Consumer &consume)
+{
+    ConsumerPool pool(paths, consume, queueDepth_, workers_);
+    if (ring_)
+    {
+        ReadWithRing(paths, pool);
+    }
+    else
+    {
+        ReadWithPread(paths, pool);
+    }
+    pool.Finish();
+}
+
+void BatchedFileReader::ReadWithPread(const std::vector<std::string> &paths, ConsumerPool &pool)
+{
+    // Files too large for a slot buffer, by slot
+    std::vector<std::vector<char>> large(static_cast<std::size_t>(queueDepth_));
+    for (std::size_t index = 0; index < paths.size() && !pool.Failed(); ++index)
+    {
+        const int slot = pool.Acquire();
+        const std::string &path = paths[index];
+#ifdef _WIN32
+        std::ifstream file(path, std::ios::binary | std::ios::ate);
+        if (!file)
+        {
+            pool.Fail("cannot open " + path);
+            pool.Release(slot);
+            break;
+        }
+        const auto size = static_cast<std::size_t>(file.tellg());
+        char *data = SlotBuffer(slot);
+        if (size > bufferSize_)
+        {
+            large[slot].resize(size);
+            data = large[slot].data();
+        }
+        file.seekg(0);
+        if (!file.read(data, static_cast<std::streamsize>(size)))
+        {
+            pool.Fail("cannot read " + path);
+            pool.Release(slot);
+            break;
+        }
+#else
+        const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        struct stat st;
+        if (fd < 0 || ::fstat(fd, &st) != 0)
+        {
+            pool.Fail(path + ": " + std::strerror(errno));
+            if (fd >= 0)
+            {
+                ::close(fd);
+            }
+            pool.Release(slot);
+            break;
+        }
+        const auto size = static_cast<std::size_t>(st.st_size);
+        char *data = SlotBuffer(slot);
+        if (size > bufferSize_)
+        {
+            large[slot].resize(size);
+            data = large[slot].data();
+        }
+        std::size_t done = 0;
+        while (done < size)
+        {
+            const ssize_t n = ::pread(fd, data + done, size - done, static_cast<off_t>(done));
+            if (n <= 0)
+            {
+                break;
+            }
+            done += static_cast<std::size_t>(n);
+        }
+        ::close(fd);
+        if (done < size)
+        {
+            pool.Fail(path + ": short read");
+            pool.Release(slot);
+            break;
+        }
+#endif
+        pool.Submit(slot, index, data, size);
+    }
+}
+
+#ifdef HAVE_LIBURING
+
+void BatchedFileReader::ReadWithRing(const std::vector<std::string> &paths, ConsumerPool &pool)
+{
+    // Progress of the file in each slot
+    struct Slot
+    {
+        std::size_t index = 0;
+        int fd = -1;
+        int pending = 0; // open and size query not completed yet
+        bool failed = false;
+        struct statx stx;
+        std::size_t size = 0;
+        std::size_t done = 0;
+        char *data = nullptr;
+        std::vector<char> large;
+    };
+    std::vector<Slot> slots(static_cast<std::size_t>(queueDepth_));
+    std::size_t next = 0;
+    std::size_t inFlight = 0;
+
+    const auto newEntry = [&](std::uint64_t tag) {
+        io_uring_sqe *sqe = io_uring_get_sqe(ring_);
+        if (!sqe)
+        {
+            io_uring_submit(ring_);
+            sqe = io_uring_get_sqe(ring_);
+        }
+        io_uring_sqe_set_data64(sqe, tag);
+        ++inFlight;
+        return sqe;
+    };
+    const auto read = [&](int s) {
+        Slot &slot = slots[s];
+        // Reads are capped so that a huge file is read in several steps
+        const auto length =
+            static_cast<unsigned>(std::min<std::size_t>(slot.size - slot.done, 1u << 30));
+        io_uring_sqe *sqe = newEntry(Tag(s, kRead));
+        if (registered_ && slot.data == SlotBuffer(s))
+        {
+            io_uring_prep_read_fixed(sqe, slot.fd, slot.data + slot.done, length, slot.done, s);
+        }
+        else
+        {
+            io_uring_prep_read(sqe, slot.fd, slot.data + slot.done, length, slot.done);
+        }
+    };
+    // Closes the file of a slot without waiting; the slot goes to the workers
+    // or, if it failed, straight back to the pool
+    const auto finish = [&](int s) {
+        Slot &slot = slots[s];
+        if (slot.fd >= 0)
+        {
+            io_uring_prep_close(newEntry(Tag(s, kClose)), slot.fd);
+            slot.fd = -1;
+        }
+        if (slot.failed)
+        {
+            pool.Release(s);
+        }
+        else
+        {
+            pool.Submit(s, slot.index, slot.data, slot.size);
+        }
+    };
+    const auto fail = [&](int s, int error) {
+        Slot &slot = slots[s];
+        if (!slot.failed)
+        {
+            pool.Fail(paths[slot.index] + ": " + std::strerror(error));
+            slot.failed = true;
+        }
+    };
+
+    for (;;)
+    {
+        // Start a file on every free slot
+        int s;
+        while (next < paths.size() && !pool.Failed() && pool.TryAcquire(s))
+        {
+            Slot &slot = slots[s];
+            slot.index = next++;
+            slot.fd = -1;
+            slot.pending = 2;
+            slot.failed = false;
+            slot.size = slot.done = 0;
+            const char *path = paths[slot.index].c_str();
+            io_uring_prep_openat(newEntry(Tag(s, kOpen)), AT_FDCWD, path, O_RDONLY | O_CLOEXEC,
+                                 0);
+            io_uring_prep_statx(newEntry(Tag(s, kStat)), AT_FDCWD, path, 0, STATX_SIZE,
+                                &slot.stx);
+        }
+        if (inFlight == 0)
+        {
+            if (next >= paths.size() || pool.Failed())
+            {
+                break;
+            }
+            // Every buffer is with the workers
+            pool.WaitForFreeSlot();
+            continue;
+        }
+
+        const int submitted = io_uring_submit_and_wait(ring_, 1);
+        if (submitted < 0 && submitted != -EINTR)
+        {
+            throw std::runtime_error(std::string("io_uring: ") + std::strerror(-submitted));
+        }
+        io_uring_cqe *cqe;
+        while (io_uring_peek_cqe(ring_, &cqe) == 0)
+        {
+            const std::uint64_t tag = io_uring_cqe_get_data64(cqe);
+            const int result = cqe->res;
+            io_uring_cqe_seen(ring_, cqe);
+            --inFlight;
+
+            const int s = static_cast<int>(tag >> 2);
+            Slot &slot = slots[s];
+            switch (static_cast<Operation>(tag & 3))
+            {
+            case kOpen:
+            case kStat:
+                if (result < 0)
+                {
+                    fail(s, -result);
+                }
+                else if ((tag & 3) == kOpen)
+                {
+                    slot.fd = result;
+                }
+                else
+                {
+                    slot.size = static_cast<std::size_t>(slot.stx.stx_size);
+                }
+                if (--slot.pending > 0)
+                {
+                    break;
+                }
+                if (slot.failed || slot.size == 0)
+                {
+                    slot.data = SlotBuffer(s);
+                    finish(s);
+                    break;
+                }
+                if (slot.size > bufferSize_)
+                {
+                    slot.large.resize(slot.size);
+                    slot.data = slot.large.data();
+                }
+                else
+                {
+                    slot.data = SlotBuffer(s);
+                }
+                read(s);
+                break;
+            case kRead:
+                if (result <= 0)
+                {
+                    // A file that shrank since its size was queried ends early
+                    fail(s, result < 0 ? -result : EIO);
+                    finish(s);
+                }
+                else if ((slot.done += static_cast<std::size_t>(result)) < slot.size)
+                {
+                    read(s); // short read
+                }
+                else
+                {
+                    finish(s);
+                }
+                break;
+            case kClose:
+                break;
+            }
+        }
+    }
+}
+
+#else
+
+void BatchedFileReader::ReadWithRing(const std::vector<std::string> &paths, ConsumerPool &pool)
+{
+    ReadWithPread(paths, pool);
+}
+
+#endif
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <vector>
+
+struct io_uring;
+
+struct BatchedFileReaderOptions
+{
+    // Files read at once; every one holds a buffer until it is consumed
+    int queueDepth = 64;
+    // Bytes per registered buffer; larger files get a buffer of their own
+    std::size_t bufferSize = std::size_t(1) << 20;
+    // Threads that consume the buffers read
+    int workers = 0; // 0 for one per core, less the reading thread
+    // Read with blocking open/pread/close even where io_uring is available
+    bool forceFallback = false;
+};
+
+// Reads many small files, such as slice-per-file DICOM series, and hands
+// each whole file to worker threads as soon as it is in memory.
+//
+// With io_uring (Linux, built with liburing), opens, size queries, reads and
+// closes of up to queueDepth files are submitted in batches with a single
+// system call each, and files that fit are read into buffers registered with
+// the kernel once. Without it, or if the ring cannot be created, the calling
+// thread opens and preads one file after the other into the same buffers.
+// Either way the workers consume files while later ones are being read.
+class BatchedFileReader
+{
+public:
+    // Called on a worker thread with the contents of paths[index]; data is
+    // valid until the call returns.
+    using Consumer = std::function<void(std::size_t index, const char *data, std::size_t size)>;
+
+    explicit BatchedFileReader(const BatchedFileReaderOptions &options = {});
+    ~BatchedFileReader();
+
+    BatchedFileReader(const BatchedFileReader &) = delete;
+    BatchedFileReader &operator=(const BatchedFileReader &) = delete;
+
+    // Reads every file and returns once all of them have been consumed, in
+    // no particular order. Throws std::runtime_error for the first file that
+    // cannot be read or whose consumer threw, after the others are done.
+    void ReadAll(const std::vector<std::string> &paths, const Consumer &consume);
+
+    // Whether reads go through io_uring rather than the pread fallback
+    bool UsesIoUring() const { return ring_ != nullptr; }
+
+private:
+    // Worker threads and the buffers they hold
+    class ConsumerPool;
+
+    void ReadWithRing(const std::vector<std::string> &paths, ConsumerPool &pool);
+    void ReadWithPread(const std::vector<std::string> &paths, ConsumerPool &pool);
+
+    char *SlotBuffer(int slot) { return buffers_.data() + std::size_t(slot) * bufferSize_; }
+
+    int queueDepth_;
+    std::size_t bufferSize_;
+    int workers_;
+    std::vector<char> buffers_;
+    io_uring *ring_ = nullptr; // null when reading with pread
+    bool registered_ = false;  // buffers_ are registered with ring_
+};
@@ -0,0 +1,1276 @@
+#include "array_dispatch.h"
+#include "batched_file_reader.h"
+#include "benchmarks.h"
+#include "clipping.h"
+#include "compressed_mesh.h"
+#include "connected_components_filter.h"
+#include "dicom_catalog.h"
+#include "fused_volume_pipeline.h"
+#include "incremental_isosurface.h"
+#include "isosurface.h"
+#include "label_surfaces.h"
+#include "mapped_file.h"
+#include "mesh_topology.h"
+#include "mesh_readers.h"
+#include "process_stats.h"
+#include "region_growing.h"
+#include "sinc_smooth_filter.h"
+#include "sparse_distance_field.h"
+#include "triangle_bvh.h"
+#include "voxelizer.h"
+#include "volume_expression.h"
+#include "vtkhdf_io.h"
+
+#include <vtkAbstractCellLinks.h>
+#include <vtkCellArray.h>
+#include <vtkClipPolyData.h>
+#include <vtkCubeSource.h>
+#include <vtkDiscreteFlyingEdges3D.h>
+#include <vtkFloatArray.h>
+#include <vtkImageMathematics.h>
+#include <vtkMath.h>
+#include <vtkMultiBlockDataSet.h>
+#include <vtkOBJReader.h>
+#include <vtkPLYReader.h>
+#include <vtkPlane.h>
+#include <vtkPointData.h>
+#include <vtkPolyDataConnectivityFilter.h>
+#include <vtkSOADataArrayTemplate.h>
+#include <vtkSMPTools.h>
+#include <vtkPoints.h>
+#include <vtkSTLReader.h>
+#include <vtkSmartPointer.h>
+#include <vtkWindowedSincPolyDataFilter.h>
+#include <vtkXMLImageDataReader.h>
+#include <vtkXMLImageDataWriter.h>
+#include <vtkXMLPolyDataReader.h>
+#include <vtkXMLPolyDataWriter.h>
+
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <limits>
+#include <map>
+#include <memory>
+#include <random>
+#include <stdexcept>
+
+namespace
+{
+
+template <typename Fn>
+double SecondsFor(Fn &&fn)
+{
+    const auto start = std::chrono::steady_clock::now();
+    fn();
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+double GigabytesPerSecond(std::size_t bytes, double seconds)
+{
+    return seconds > 0.0 ? double(bytes) / 1e9 / seconds : 0.0;
+}
+
+// Touches every page so both readers start from a warm page cache
+void WarmPageCache(const MappedFile &file)
+{
+    volatile char sink = 0;
+    for (std::size_t offset = 0; offset < file.size(); offset += 4096)
+    {
+        sink = sink + file.data()[offset];
+    }
+}
+
+vtkSmartPointer<vtkPolyData> ReadWithVTK(const std::string &path)
+{
+    std::string extension = path.substr(std::min(path.size(), path.find_last_of('.')));
+    std::transform(extension.begin(), extension.end(), extension.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+
+    vtkSmartPointer<vtkAbstractPolyDataReader> reader;
+    if (extension == ".stl")
+    {
+        reader = vtkSmartPointer<vtkSTLReader>::New();
+    }
+    else if (extension == ".ply")
+    {
+        reader = vtkSmartPointer<vtkPLYReader>::New();
+    }
+    else if (extension == ".obj")
+    {
+        reader = vtkSmartPointer<vtkOBJReader>::New();
+    }
+    else
+    {
+        throw std::runtime_error("unsupported mesh format: " + path);
+    }
+    reader->SetFileName(path.c_str());
+    reader->Update();
+    return reader->GetOutput();
+}
+
+// readers FILE...: parallel mesh readers against the VTK readers
+void BenchmarkMeshReaders(const std::vector<std::string> &args)
+{
+    if (args.empty())
+    {
+        throw std::invalid_argument("readers: expected at least one mesh file");
+    }
+    for (const std::string &path : args)
+    {
+        std::size_t bytes = 0;
+        {
+            MappedFile file(path);
+            bytes = file.size();
+            WarmPageCache(file);
+        }
+
+        vtkIdType vtkCells = 0;
+        const double vtkSeconds = SecondsFor([&] { vtkCells = ReadWithVTK(path)->GetNumberOfCells(); });
+        vtkIdType parallelCells = 0;
+        const double parallelSeconds =
+            SecondsFor([&] { parallelCells = ReadMeshFile(path)->GetNumberOfCells(); });
+
+        spdlog::info("{}: {:.2f} GB", path, bytes / 1e9);
+        spdlog::info("  VTK reader:      {:8.3f} s  {:6.2f} GB/s  {} cells", vtkSeconds,
+                     GigabytesPerSecond(bytes, vtkSeconds), vtkCells);
+        spdlog::info("  parallel reader: {:8.3f} s  {:6.2f} GB/s  {} cells  ({:.1f}x)",
+                     parallelSeconds, GigabytesPerSecond(bytes, parallelSeconds), parallelCells,
+                     parallelSeconds > 0.0 ? vtkSeconds / parallelSeconds : 0.0);
+    }
+}
+
+// incremental DIR [ISO [BLOCK]]: full against incremental isosurface over the
+// phases of the first DICOM series under DIR
+void BenchmarkIncrementalIsosurface(const std::vector<std::string> &args)
+{
+    if (args.empty())
+    {
+        throw std::invalid_argument("incremental: expected a DICOM directory");
+    }
+    DicomCatalog catalog;
+    catalog.AddDirectory(args[0]);
+    if (catalog.GetSeries().empty())
+    {
+        throw std::runtime_error("incremental: no DICOM series under " + args[0]);
+    }
+    std::vector<vtkSmartPointer<vtkImageData>> volumes;
+    for (const auto &files : SplitIntoPhases(catalog.GetSeries().front()))
+    {
+        volumes.push_back(ReadDicomVolume(files));
+    }
+    const double isoValue = args.size() > 1 ? std::stod(args[1]) : DefaultIsoValue(volumes[0]);
+    const int blockSize = args.size() > 2 ? std::stoi(args[2]) : 32;
+
+    // Start from the last phase, as when playback loops
+    IncrementalIsosurface extractor(blockSize);
+    extractor.Update(volumes.back(), isoValue);
+
+    double fullTotal = 0.0;
+    double incrementalTotal = 0.0;
+    for (std::size_t phase = 0; phase < volumes.size(); ++phase)
+    {
+        const double fullSeconds =
+            SecondsFor([&] { ExtractIsosurface(volumes[phase], isoValue); });
+        extractor.Update(volumes[phase], isoValue);
+        const IncrementalIsosurfaceStats stats = extractor.GetLastStats();
+        fullTotal += fullSeconds;
+        incrementalTotal += stats.seconds;
+        spdlog::info("phase {:3}: full {:7.1f} ms  incremental {:7.1f} ms  {:5}/{} blocks changed",
+                     phase, fullSeconds * 1e3, stats.seconds * 1e3, stats.changedBlocks,
+                     stats.blocks);
+    }
+    const double frames = double(volumes.size());
+    spdlog::info("{} phases, isovalue {}, {}^3 blocks: full {:.1f} ms/frame, incremental "
+                 "{:.1f} ms/frame, {:.1f} ms/frame saved ({:.1f}x)",
+                 volumes.size(), isoValue, blockSize, fullTotal * 1e3 / frames,
+                 incrementalTotal * 1e3 / frames, (fullTotal - incrementalTotal) * 1e3 / frames,
+                 incrementalTotal > 0.0 ? fullTotal / incrementalTotal : 0.0);
+}
+
+// The mesh named by the first argument, or the example's cube
+vtkSmartPointer<vtkPolyData> MeshOrCube(const std::vector<std::string> &args)
+{
+    if (!args.empty() && args[0] != "cube")
+    {
+        return ReadMeshFile(args[0]);
+    }
+    auto cubeSource = vtkSmartPointer<vtkCubeSource>::New();
+    cubeSource->SetXLength(10.0);
+    cubeSource->SetYLength(10.0);
+    cubeSource->SetZLength(10.0);
+    cubeSource->Update();
+    return cubeSource->GetOutput();
+}
+
+// voxelize [FILE [N]]: voxelizes a mesh (the 10x10x10 cube by default) onto an
+// N^3 grid (1024^3 by default) with both rules
+void BenchmarkVoxelizer(const std::vector<std::string> &args)
+{
+    vtkSmartPointer<vtkPolyData> mesh = MeshOrCube(args);
+    const int size = args.size() > 1 ? std::stoi(args[1]) : 1024;
+
+    // Pad the bounds so the surface never touches the grid border
+    double bounds[6];
+    mesh->GetBounds(bounds);
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        const double pad = 0.02 * (bounds[2 * axis + 1] - bounds[2 * axis]);
+        bounds[2 * axis] -= pad;
+        bounds[2 * axis + 1] += pad;
+    }
+    const int dimensions[3] = {size, size, size};
+    auto grid = CreateVoxelGrid(bounds, dimensions);
+    double spacing[3];
+    grid->GetSpacing(spacing);
+    const double voxels = double(size) * size * size;
+
+    for (VoxelizeRule rule : {VoxelizeRule::Parity, VoxelizeRule::Winding})
+    {
+        vtkSmartPointer<vtkImageData> volume;
+        const double seconds = SecondsFor([&] { volume = VoxelizeMesh(mesh, grid, rule); });
+        const char *values = static_cast<const char *>(volume->GetScalarPointer());
+        const std::size_t inside = static_cast<std::size_t>(
+            std::count_if(values, values + std::size_t(voxels), [](char v) { return v != 0; }));
+        spdlog::info("{} {}^3: {:.3f} s, {:.0f} Mvoxels/s, {} voxels inside ({:.4g} volume)",
+                     rule == VoxelizeRule::Parity ? "parity " : "winding", size, seconds,
+                     seconds > 0.0 ? voxels / seconds / 1e6 : 0.0, inside,
+                     inside * spacing[0] * spacing[1] * spacing[2]);
+    }
+}
+
+// sdf [FILE [N [BAND]]]: narrow-band distance field of a mesh (the cube by
+// default) against the size of the dense field
+void BenchmarkDistanceField(const std::vector<std::string> &args)
+{
+    vtkSmartPointer<vtkPolyData> mesh = MeshOrCube(args);
+    const int resolution = args.size() > 1 ? std::stoi(args[1]) : 512;
+    const double bandVoxels = args.size() > 2 ? std::stod(args[2]) : 3.0;
+
+    std::unique_ptr<TriangleBVH> bvh;
+    const double bvhSeconds = SecondsFor([&] { bvh = std::make_unique<TriangleBVH>(mesh); });
+    double bounds[6];
+    bvh->GetBounds(bounds);
+    auto grid = CreateDistanceFieldGrid(bounds, resolution);
+    std::unique_ptr<SparseDistanceField> field;
+    const double fieldSeconds = SecondsFor([&] {
+        field = std::make_unique<SparseDistanceField>(*bvh, grid, bandVoxels * grid->GetSpacing()[0]);
+    });
+
+    const int *dimensions = grid->GetDimensions();
+    const double storedPoints =
+        double(field->GetNumberOfStoredBlocks()) * SparseDistanceField::kBlockPoints;
+    spdlog::info("BVH over {} triangles: {:.3f} s, {:.1f} MB", bvh->GetNumberOfTriangles(),
+                 bvhSeconds, bvh->GetMemorySize() / 1e6);
+    spdlog::info("{}x{}x{} grid, band {} voxels: {:.3f} s, {:.1f} Mpoints/s exact", dimensions[0],
+                 dimensions[1], dimensions[2], bandVoxels, fieldSeconds,
+                 fieldSeconds > 0.0 ? storedPoints / fieldSeconds / 1e6 : 0.0);
+    spdlog::info("{} of {} blocks stored: {:.1f} MB sparse, {:.1f} MB dense ({:.1f}%)",
+                 field->GetNumberOfStoredBlocks(), field->GetNumberOfBlocks(),
+                 field->GetMemorySize() / 1e6, field->GetDenseMemorySize() / 1e6,
+                 100.0 * field->GetMemorySize() / double(field->GetDenseMemorySize()));
+}
+
+// smooth FILE [N]: parallel windowed-sinc smoothing against
+// vtkWindowedSincPolyDataFilter with the same settings
+void BenchmarkSmoothing(const std::vector<std::string> &args)
+{
+    if (args.empty())
+    {
+        throw std::invalid_argument("smooth: expected a mesh file");
+    }
+    vtkSmartPointer<vtkPolyData> mesh = ReadMeshFile(args[0]);
+    const int iterations = args.size() > 1 ? std::stoi(args[1]) : 20;
+
+    auto reference = vtkSmartPointer<vtkWindowedSincPolyDataFilter>::New();
+    reference->SetInputData(mesh);
+    reference->SetNumberOfIterations(iterations);
+    reference->SetPassBand(0.1);
+    reference->BoundarySmoothingOn();
+    reference->FeatureEdgeSmoothingOff();
+    reference->NonManifoldSmoothingOn();
+    const double vtkSeconds = SecondsFor([&] { reference->Update(); });
+
+    auto smoother = vtkSmartPointer<SincSmoothPolyDataFilter>::New();
+    smoother->SetInputData(mesh);
+    smoother->SetNumberOfIterations(iterations);
+    smoother->SetPassBand(0.1);
+    const double parallelSeconds = SecondsFor([&] { smoother->Update(); });
+
+    // How far apart the two results are, relative to the mesh size
+    vtkPoints *expected = reference->GetOutput()->GetPoints();
+    vtkPoints *actual = smoother->GetOutput()->GetPoints();
+    double squares = 0.0;
+    for (vtkIdType id = 0; id < expected->GetNumberOfPoints(); ++id)
+    {
+        double p[3], q[3];
+        expected->GetPoint(id, p);
+        actual->GetPoint(id, q);
+        squares += vtkMath::Distance2BetweenPoints(p, q);
+    }
+    const double rms = std::sqrt(squares / std::max<vtkIdType>(expected->GetNumberOfPoints(), 1));
+
+    spdlog::info("{}: {} points, {} polygons, {} iterations", args[0], mesh->GetNumberOfPoints(),
+                 mesh->GetNumberOfPolys(), iterations);
+    spdlog::info("  vtkWindowedSincPolyDataFilter: {:8.3f} s", vtkSeconds);
+    spdlog::info("  parallel sinc smoothing:       {:8.3f} s  ({:.1f}x), RMS difference {:.3g} "
+                 "(diagonal {:.3g})",
+                 parallelSeconds, parallelSeconds > 0.0 ? vtkSeconds / parallelSeconds : 0.0, rms,
+                 mesh->GetLength());
+}
+
+// components FILE [N]: parallel connected components against
+// vtkPolyDataConnectivityFilter, keeping the N largest
+void BenchmarkComponents(const std::vector<std::string> &args)
+{
+    if (args.empty())
+    {
+        throw std::invalid_argument("components: expected a mesh file");
+    }
+    vtkSmartPointer<vtkPolyData> mesh = ReadMeshFile(args[0]);
+    const int largest = args.size() > 1 ? std::max(std::stoi(args[1]), 1) : 1;
+
+    // It keeps only the largest region by itself; for more, label them all
+    auto reference = vtkSmartPointer<vtkPolyDataConnectivityFilter>::New();
+    reference->SetInputData(mesh);
+    if (largest == 1)
+    {
+        reference->SetExtractionModeToLargestRegion();
+    }
+    else
+    {
+        reference->SetExtractionModeToAllRegions();
+        reference->ColorRegionsOn();
+    }
+    const double vtkSeconds = SecondsFor([&] { reference->Update(); });
+
+    auto filter = vtkSmartPointer<ConnectedComponentsFilter>::New();
+    filter->SetInputData(mesh);
+    filter->SetLargestComponents(largest);
+    const double topologySeconds = SecondsFor([&] { MeshTopology::Get(mesh); });
+    const double parallelSeconds = SecondsFor([&] { filter->Update(); });
+
+    spdlog::info("{}: {} points, {} polygons, keeping {} of {} components", args[0],
+                 mesh->GetNumberOfPoints(), mesh->GetNumberOfPolys(),
+                 filter->GetNumberOfKeptComponents(), filter->GetNumberOfComponents());
+    spdlog::info("  vtkPolyDataConnectivityFilter: {:8.3f} s, {} regions", vtkSeconds,
+                 reference->GetNumberOfExtractedRegions());
+    spdlog::info("  parallel components:           {:8.3f} s  ({:.1f}x) + {:.3f} s topology, {} "
+                 "polygons kept",
+                 parallelSeconds, parallelSeconds > 0.0 ? vtkSeconds / parallelSeconds : 0.0,
+                 topologySeconds, filter->GetOutput()->GetNumberOfPolys());
+}
+
+// clip FILE [STEPS]: a plane swept across the mesh in STEPS positions, as
+// when dragged, clipped in parallel and by vtkClipPolyData
+void BenchmarkClipping(const std::vector<std::string> &args)
+{
+    if (args.empty())
+    {
+        throw std::invalid_argument("clip: expected a mesh file");
+    }
+    vtkSmartPointer<vtkPolyData> mesh = ReadMeshFile(args[0]);
+    const int steps = args.size() > 1 ? std::max(std::stoi(args[1]), 1) : 20;
+    double bounds[6];
+    mesh->GetBounds(bounds);
+    const double normal[3] = {1.0, 0.0, 0.0};
+    auto originAt = [&](int step, double origin[3]) {
+        origin[0] = bounds[0] + (step + 0.5) * (bounds[1] - bounds[0]) / steps;
+        origin[1] = 0.5 * (bounds[2] + bounds[3]);
+        origin[2] = 0.5 * (bounds[4] + bounds[5]);
+    };
+
+    auto plane = vtkSmartPointer<vtkPlane>::New();
+    plane->SetNormal(normal[0], normal[1], normal[2]);
+    auto reference = vtkSmartPointer<vtkClipPolyData>::New();
+    reference->SetInputData(mesh);
+    reference->SetClipFunction(plane);
+    double vtkTotal = 0.0;
+    double vtkWorst = 0.0;
+    for (int step = 0; step < steps; ++step)
+    {
+        double origin[3];
+        originAt(step, origin);
+        plane->SetOrigin(origin);
+        const double seconds = SecondsFor([&] { reference->Update(); });
+        vtkTotal += seconds;
+        vtkWorst = std::max(vtkWorst, seconds);
+    }
+
+    auto clipper = vtkSmartPointer<ClipPolyDataFilter>::New();
+    clipper->SetInputData(mesh);
+    const double topologySeconds = SecondsFor([&] { MeshTopology::Get(mesh); });
+    double total = 0.0;
+    double worst = 0.0;
+    vtkIdType clipped = 0;
+    for (int step = 0; step < steps; ++step)
+    {
+        double origin[3];
+        originAt(step, origin);
+        clipper->SetPlane(origin, normal);
+        const double seconds = SecondsFor([&] { clipper->Update(); });
+        total += seconds;
+        worst = std::max(worst, seconds);
+        clipped += clipper->GetNumberOfClippedPolygons();
+    }
+
+    spdlog::info("{}: {} points, {} polygons, {} plane positions", args[0],
+                 mesh->GetNumberOfPoints(), mesh->GetNumberOfPolys(), steps);
+    spdlog::info("  vtkClipPolyData:  {:8.1f} ms mean, {:8.1f} ms worst", 1000.0 * vtkTotal / steps,
+                 1000.0 * vtkWorst);
+    spdlog::info("  parallel clip:    {:8.1f} ms mean, {:8.1f} ms worst ({:.1f}x), {} polygons "
+                 "cut per position, {:.3f} s topology once",
+                 1000.0 * total / steps, 1000.0 * worst, total > 0.0 ? vtkTotal / total : 0.0,
+                 clipped / steps, topologySeconds);
+}
+
+// topology FILE [STAGES]: the cached CSR topology against STAGES mesh stages
+// that each build their own vtkPolyData links
+void BenchmarkTopology(const std::vector<std::string> &args)
+{
+    if (args.empty())
+    {
+        throw std::invalid_argument("topology: expected a mesh file");
+    }
+    vtkSmartPointer<vtkPolyData> mesh = ReadMeshFile(args[0]);
+    const int stages = args.size() > 1 ? std::max(std::stoi(args[1]), 1) : 4;
+
+    // Every stage works on its own output, so none finds the links built
+    unsigned long linksKiB = 0;
+    const double linksSeconds = SecondsFor([&] {
+        for (int stage = 0; stage < stages; ++stage)
+        {
+            mesh->DeleteCells();
+            mesh->DeleteLinks();
+            mesh->BuildLinks();
+        }
+        linksKiB = mesh->GetLinks()->GetActualMemorySize();
+    });
+    mesh->DeleteCells();
+    mesh->DeleteLinks();
+
+    MeshTopology *topology = nullptr;
+    const double buildSeconds = SecondsFor([&] { topology = MeshTopology::Get(mesh); });
+    const double cachedSeconds = SecondsFor([&] {
+        for (int stage = 1; stage < stages; ++stage)
+        {
+            MeshTopology::Get(mesh);
+        }
+    });
+    // Editing the polygons drops the cache
+    mesh->GetPolys()->Modified();
+    const bool rebuilt = MeshTopology::Get(mesh) != topology;
+
+    spdlog::info("{}: {} points, {} polygons, {} stages", args[0], mesh->GetNumberOfPoints(),
+                 mesh->GetNumberOfPolys(), stages);
+    spdlog::info("  BuildLinks per stage: {:8.3f} s, {:8.1f} MB", linksSeconds,
+                 stages * linksKiB * 1024.0 / 1e6);
+    spdlog::info("  cached topology:      {:8.3f} s  ({:.1f}x), {:8.1f} MB ({} edges, cache hits "
+                 "{:.2g} s, rebuilt after Modified: {})",
+                 buildSeconds + cachedSeconds,
+                 linksSeconds / std::max(buildSeconds + cachedSeconds, 1e-9),
+                 MeshTopology::Get(mesh)->GetMemorySize() / 1e6, topology->edges.size(),
+                 cachedSeconds, rebuilt);
+}
+
+// compress FILE [BITS]: size of the .qmesh encoding with BITS per coordinate
+// and its encode and decode throughput
+void BenchmarkCompression(const std::vector<std::string> &args)
+{
+    if (args.empty())
+    {
+        throw std::invalid_argument("compress: expected a mesh file");
+    }
+    vtkSmartPointer<vtkPolyData> mesh = ReadMeshFile(args[0]);
+    CompressedMeshOptions options;
+    if (args.size() > 1)
+    {
+        options.positionBits = std::stoi(args[1]);
+    }
+
+    std::vector<char> encoded;
+    const double encodeSeconds = SecondsFor([&] { encoded = EncodeCompressedMesh(mesh, options); });
+    // Best of a few runs, as a cached surface would be decoded warm
+    vtkSmartPointer<vtkPolyData> decoded;
+    double decodeSeconds = std::numeric_limits<double>::max();
+    for (int run = 0; run < 5; ++run)
+    {
+        decodeSeconds = std::min(decodeSeconds, SecondsFor([&] {
+            decoded = DecodeCompressedMesh(encoded.data(), encoded.size());
+        }));
+    }
+
+    // Against float32 positions and normals and 32-bit indices with a size
+    // per polygon, as the cache held them before
+    const std::size_t points = static_cast<std::size_t>(mesh->GetNumberOfPoints());
+    const bool normals = decoded->GetPointData()->GetNormals() != nullptr;
+    const std::size_t polys = static_cast<std::size_t>(mesh->GetNumberOfPolys());
+    const std::size_t ids =
+        polys > 0 ? static_cast<std::size_t>(mesh->GetPolys()->GetNumberOfConnectivityIds()) : 0;
+    const std::size_t rawBytes = points * (normals ? 24 : 12) + (polys + ids) * 4;
+    // What the decoder writes: float32 points and normals, 64-bit cell arrays
+    const std::size_t decodedBytes = points * (normals ? 24 : 12) + (polys + 1 + ids) * 8;
+
+    double bounds[6];
+    mesh->GetBounds(bounds);
+    const double diagonal = std::sqrt((bounds[1] - bounds[0]) * (bounds[1] - bounds[0]) +
+                                      (bounds[3] - bounds[2]) * (bounds[3] - bounds[2]) +
+                                      (bounds[5] - bounds[4]) * (bounds[5] - bounds[4]));
+    double maxError = 0.0;
+    for (vtkIdType i = 0; i < mesh->GetNumberOfPoints(); ++i)
+    {
+        double p[3], q[3];
+        mesh->GetPoint(i, p);
+        decoded->GetPoint(i, q);
+        maxError = std::max(maxError, std::sqrt(vtkMath::Distance2BetweenPoints(p, q)));
+    }
+
+    spdlog::info("{}: {} points{}, {} polygons, {} bits per coordinate", args[0], points,
+                 normals ? " with normals" : "", polys, options.positionBits);
+    spdlog::info("  size:   {:8.1f} MB -> {:8.1f} MB ({:.2f}x), max position error {:.3g} of "
+                 "the diagonal",
+                 rawBytes / 1e6, encoded.size() / 1e6,
+                 encoded.empty() ? 0.0 : double(rawBytes) / double(encoded.size()),
+                 diagonal > 0.0 ? maxError / diagonal : 0.0);
+    spdlog::info("  encode: {:8.3f} s  {:6.2f} GB/s of raw mesh", encodeSeconds,
+                 GigabytesPerSecond(rawBytes, encodeSeconds));
+    spdlog::info("  decode: {:8.3f} s  {:6.2f} GB/s written, {:6.2f} GB/s read", decodeSeconds,
+                 GigabytesPerSecond(decodedBytes, decodeSeconds),
+                 GigabytesPerSecond(encoded.size(), decodeSeconds));
+}
+
+// Logs one write/read round trip of bytes of array data through a file
+void LogRoundTrip(const char *label, const std::string &path, std::size_t bytes,
+                  double writeSeconds, double readSeconds)
+{
+    const double fileBytes = static_cast<double>(std::filesystem::file_size(path));
+    spdlog::info("  {:8} write {:8.3f} s {:6.2f} GB/s, read {:8.3f} s {:6.2f} GB/s, "
+                 "{:8.1f} MB on disk ({:.2f}x)",
+                 label, writeSeconds, GigabytesPerSecond(bytes, writeSeconds), readSeconds,
+                 GigabytesPerSecond(bytes, readSeconds), fileBytes / 1e6,
+                 fileBytes > 0.0 ? double(bytes) / fileBytes : 0.0);
+}
+
+// N^3 shorts of smooth blobs, -1000 to 1000, with a little noise; roughly as
+// compressible as CT. Other phases shift the blobs.
+vtkSmartPointer<vtkImageData> SyntheticVolume(int n, double phase = 0.0)
+{
+    auto volume = vtkSmartPointer<vtkImageData>::New();
+    volume->SetDimensions(n, n, n);
+    volume->AllocateScalars(VTK_SHORT, 1);
+    auto *voxels = static_cast<short *>(volume->GetScalarPointer());
+    const std::size_t slice = std::size_t(n) * std::size_t(n);
+    vtkSMPTools::For(0, n, [&](vtkIdType zBegin, vtkIdType zEnd) {
+        for (vtkIdType z = zBegin; z < zEnd; ++z)
+        {
+            for (std::size_t i = 0; i < slice; ++i)
+            {
+                const double x = double(i % n) / n, y = double(i / n) / n, w = double(z) / n;
+                const double value =
+                    1000.0 * std::sin(9.0 * x + phase) * std::cos(7.0 * y + 5.0 * w);
+                voxels[z * slice + i] = static_cast<short>(value) + static_cast<short>(i % 7);
+            }
+        }
+    });
+    return volume;
+}
+
+// hdf [N [CHUNK [FILE]]]: VTKHDF against the XML writers and readers for a
+// synthetic N^3 volume of shorts (N = 1710 is about 10 GB) stored in CHUNK^3
+// chunks, a partial read of its central octant, and the mesh in FILE if given
+void BenchmarkVTKHDF(const std::vector<std::string> &args)
+{
+    const int n = args.size() > 0 ? std::stoi(args[0]) : 512;
+    VTKHDFOptions options;
+    if (args.size() > 1)
+    {
+        std::fill_n(options.chunkSize, 3, std::stoi(args[1]));
+    }
+    if (n < 2 || options.chunkSize[0] < 1)
+    {
+        throw std::invalid_argument("hdf: expected N >= 2 and CHUNK >= 1");
+    }
+    const std::filesystem::path directory = std::filesystem::temp_directory_path();
+    const std::string hdfPath = (directory / "bench_volume.vtkhdf").string();
+    const std::string xmlPath = (directory / "bench_volume.vti").string();
+
+    auto volume = SyntheticVolume(n);
+    const auto *voxels = static_cast<const short *>(volume->GetScalarPointer());
+    const std::size_t bytes = std::size_t(volume->GetNumberOfPoints()) * sizeof(short);
+    spdlog::info("{}^3 shorts ({:.2f} GB), {}^3 chunks, zlib level {}", n, bytes / 1e9,
+                 options.chunkSize[0], options.compressionLevel);
+
+    vtkSmartPointer<vtkImageData> loaded;
+    const double hdfWrite = SecondsFor([&] { WriteVTKHDF(volume, hdfPath, options); });
+    const double hdfRead = SecondsFor([&] { loaded = ReadVTKHDFImage(hdfPath); });
+    if (std::memcmp(loaded->GetScalarPointer(), voxels, bytes) != 0)
+    {
+        throw std::runtime_error("hdf: the VTKHDF round trip changed the volume");
+    }
+    LogRoundTrip("VTKHDF", hdfPath, bytes, hdfWrite, hdfRead);
+    loaded = nullptr;
+
+    const int quarter = n / 4;
+    const int octant[6] = {quarter, quarter + n / 2 - 1, quarter, quarter + n / 2 - 1,
+                           quarter, quarter + n / 2 - 1};
+    const double partialRead = SecondsFor([&] { loaded = ReadVTKHDFImage(hdfPath, octant); });
+    const std::size_t partialBytes = std::size_t(loaded->GetNumberOfPoints()) * sizeof(short);
+    spdlog::info("  {:8} read {:8.3f} s {:6.2f} GB/s of the central octant", "VTKHDF",
+                 partialRead, GigabytesPerSecond(partialBytes, partialRead));
+    loaded = nullptr;
+    std::filesystem::remove(hdfPath);
+
+    // zlib-compressed appended raw data, the XML writer's densest setting
+    const double xmlWrite = SecondsFor([&] {
+        auto writer = vtkSmartPointer<vtkXMLImageDataWriter>::New();
+        writer->SetInputData(volume);
+        writer->SetFileName(xmlPath.c_str());
+        writer->SetDataModeToAppended();
+        writer->EncodeAppendedDataOff();
+        writer->SetCompressorTypeToZLib();
+        writer->SetCompressionLevel(options.compressionLevel);
+        writer->Write();
+    });
+    const double xmlRead = SecondsFor([&] {
+        auto reader = vtkSmartPointer<vtkXMLImageDataReader>::New();
+        reader->SetFileName(xmlPath.c_str());
+        reader->Update();
+    });
+    LogRoundTrip("XML", xmlPath, bytes, xmlWrite, xmlRead);
+    std::filesystem::remove(xmlPath);
+    volume = nullptr;
+
+    if (args.size() < 3)
+    {
+        return;
+    }
+    vtkSmartPointer<vtkPolyData> mesh = ReadMeshFile(args[2]);
+    const std::string meshHdfPath = (directory / "bench_mesh.vtkhdf").string();
+    const std::string meshXmlPath = (directory / "bench_mesh.vtp").string();
+    std::size_t meshBytes = 0;
+    for (vtkDataArray *array : {mesh->GetPoints()->GetData(),
+                                mesh->GetPolys()->GetOffsetsArray(),
+                                mesh->GetPolys()->GetConnectivityArray()})
+    {
+        meshBytes += std::size_t(array->GetNumberOfValues()) * array->GetDataTypeSize();
+    }
+    spdlog::info("{}: {} points, {} cells ({:.2f} GB)", args[2], mesh->GetNumberOfPoints(),
+                 mesh->GetNumberOfCells(), meshBytes / 1e9);
+
+    const double meshHdfWrite = SecondsFor([&] { WriteVTKHDF(mesh, meshHdfPath, options); });
+    const double meshHdfRead = SecondsFor([&] { ReadVTKHDFPolyData(meshHdfPath); });
+    LogRoundTrip("VTKHDF", meshHdfPath, meshBytes, meshHdfWrite, meshHdfRead);
+    std::filesystem::remove(meshHdfPath);
+
+    const double meshXmlWrite = SecondsFor([&] {
+        auto writer = vtkSmartPointer<vtkXMLPolyDataWriter>::New();
+        writer->SetInputData(mesh);
+        writer->SetFileName(meshXmlPath.c_str());
+        writer->SetDataModeToAppended();
+        writer->EncodeAppendedDataOff();
+        writer->SetCompressorTypeToZLib();
+        writer->SetCompressionLevel(options.compressionLevel);
+        writer->Write();
+    });
+    const double meshXmlRead = SecondsFor([&] {
+        auto reader = vtkSmartPointer<vtkXMLPolyDataReader>::New();
+        reader->SetFileName(meshXmlPath.c_str());
+        reader->Update();
+    });
+    LogRoundTrip("XML", meshXmlPath, meshBytes, meshXmlWrite, meshXmlRead);
+    std::filesystem::remove(meshXmlPath);
+}
+
+void LogFileReads(const std::string &label, std::size_t files, std::size_t bytes, double seconds)
+{
+    spdlog::info("  {:24} {:8.3f} s {:9.0f} files/s {:6.2f} GB/s", label, seconds,
+                 seconds > 0.0 ? double(files) / seconds : 0.0, GigabytesPerSecond(bytes, seconds));
+}
+
+// uring DIR [DEPTH...]: reads every file under DIR one after the other, then
+// with the batched reader at each queue depth (1, 8, 32 and 128) and with its
+// pread fallback, and reads the first DICOM series under DIR with
+// vtkDICOMReader and with batched reads decoded by GDCM
+void BenchmarkBatchedReads(const std::vector<std::string> &args)
+{
+    if (args.empty())
+    {
+        throw std::invalid_argument("uring: expected a directory");
+    }
+    std::vector<int> depths;
+    for (std::size_t i = 1; i < args.size(); ++i)
+    {
+        depths.push_back(std::stoi(args[i]));
+    }
+    if (depths.empty())
+    {
+        depths = {1, 8, 32, 128};
+    }
+    if (*std::min_element(depths.begin(), depths.end()) < 1)
+    {
+        throw std::invalid_argument("uring: queue depths must be positive");
+    }
+
+    std::vector<std::string> paths;
+    for (const auto &entry : std::filesystem::recursive_directory_iterator(args[0]))
+    {
+        if (entry.is_regular_file())
+        {
+            paths.push_back(entry.path().string());
+        }
+    }
+    std::sort(paths.begin(), paths.end());
+    if (paths.empty())
+    {
+        throw std::runtime_error("uring: no files under " + args[0]);
+    }
+
+    auto readSequentially = [&] {
+        std::size_t bytes = 0;
+        std::vector<char> buffer;
+        for (const std::string &path : paths)
+        {
+            std::ifstream file(path, std::ios::binary | std::ios::ate);
+            buffer.resize(static_cast<std::size_t>(file.tellg()));
+            file.seekg(0);
+            file.read(buffer.data(), std::streamsize(buffer.size()));
+            bytes += std::size_t(file.gcount());
+        }
+        return bytes;
+    };
+    // The first pass fills the page cache, so every reader below is timed warm;
+    // drop the cache and run with a single depth for cold reads
+    const std::size_t bytes = readSequentially();
+    spdlog::info("{} files ({:.2f} GB) under {}, warm page cache", paths.size(), bytes / 1e9,
+                 args[0]);
+    const double sequentialSeconds = SecondsFor(readSequentially);
+    LogFileReads("sequential", paths.size(), bytes, sequentialSeconds);
+
+    auto readBatched = [&](const BatchedFileReaderOptions &options, const std::string &label) {
+        BatchedFileReader reader(options);
+        std::atomic<std::size_t> read{0};
+        const double seconds = SecondsFor([&] {
+            reader.ReadAll(paths, [&](std::size_t, const char *, std::size_t size) {
+                read.fetch_add(size, std::memory_order_relaxed);
+            });
+        });
+        if (read != bytes)
+        {
+            throw std::runtime_error("uring: " + label + " read a different number of bytes");
+        }
+        LogFileReads(label + (reader.UsesIoUring() ? " io_uring" : " pread"), paths.size(),
+                     bytes, seconds);
+    };
+    for (int depth : depths)
+    {
+        BatchedFileReaderOptions options;
+        options.queueDepth = depth;
+        readBatched(options, "depth " + std::to_string(depth));
+    }
+    BatchedFileReaderOptions fallback;
+    fallback.queueDepth = *std::max_element(depths.begin(), depths.end());
+    fallback.forceFallback = true;
+    readBatched(fallback, "depth " + std::to_string(fallback.queueDepth));
+
+    DicomCatalog catalog;
+    catalog.AddDirectory(args[0]);
+    if (catalog.GetSeries().empty())
+    {
+        return;
+    }
+    const std::vector<std::string> files = SplitIntoPhases(catalog.GetSeries().front()).front();
+    std::size_t seriesBytes = 0;
+    for (const std::string &file : files)
+    {
+        seriesBytes += std::filesystem::file_size(file);
+    }
+    spdlog::info("first DICOM series, first phase: {} files ({:.2f} GB)", files.size(),
+                 seriesBytes / 1e9);
+    vtkSmartPointer<vtkImageData> expected;
+    vtkSmartPointer<vtkImageData> batched;
+    const double vtkSeconds = SecondsFor([&] { expected = ReadDicomVolume(files); });
+    LogFileReads("vtkDICOMReader", files.size(), seriesBytes, vtkSeconds);
+    BatchedFileReaderOptions options;
+    options.queueDepth = fallback.queueDepth;
+    const double batchedSeconds =
+        SecondsFor([&] { batched = ReadDicomVolumeBatched(files, options); });
+    LogFileReads("batched + GDCM", files.size(), seriesBytes, batchedSeconds);
+    const std::size_t volumeBytes =
+        std::size_t(expected->GetNumberOfPoints()) * expected->GetScalarSize();
+    if (batched->GetNumberOfPoints() != expected->GetNumberOfPoints() ||
+        batched->GetScalarType() != expected->GetScalarType() ||
+        std::memcmp(batched->GetScalarPointer(), expected->GetScalarPointer(), volumeBytes) != 0)
+    {
+        spdlog::warn("uring: the batched volume differs from vtkDICOMReader's");
+    }
+}
+
+// Runs fn, returning its result, and logs its wall time and peak memory,
+// beyond what the process held before, after label and the details of the
+// result that describe returns
+template <typename Fn, typename Describe>
+auto LogRun(const char *label, Fn &&fn, Describe &&describe)
+{
+    ResetPeakResidentBytes();
+    const std::size_t before = CurrentResidentBytes();
+    decltype(fn()) result;
+    const double seconds = SecondsFor([&] { result = fn(); });
+    const std::size_t peak = PeakResidentBytes();
+    spdlog::info("  {:8} {:8.3f} s, peak {:8.1f} MB above the input, {}", label, seconds,
+                 peak > before ? (peak - before) / 1e6 : 0.0, describe(result, seconds));
+    return result;
+}
+
+void LogPipelineRun(const char *label, const std::function<vtkSmartPointer<vtkPolyData>()> &fn)
+{
+    LogRun(label, fn, [](vtkPolyData *surface, double) {
+        return std::to_string(surface->GetNumberOfPoints()) + " points, " +
+               std::to_string(surface->GetNumberOfPolys()) + " triangles";
+    });
+}
+
+// fused [N [SIGMA [DEPTH]]]: threshold, Gaussian of SIGMA voxels and
+// isosurface of a synthetic N^3 volume of shorts, as the fused kernel over
+// slabs of DEPTH layers and as the chain of VTK filters
+void BenchmarkFusedVolumePipeline(const std::vector<std::string> &args)
+{
+    const int n = args.size() > 0 ? std::stoi(args[0]) : 384;
+    const double sigma = args.size() > 1 ? std::stod(args[1]) : 2.0;
+    const int depth = args.size() > 2 ? std::stoi(args[2]) : 16;
+    if (n < 2 || !(sigma > 0.0) || depth < 1)
+    {
+        throw std::invalid_argument("fused: expected N >= 2, SIGMA > 0 and DEPTH >= 1");
+    }
+    auto volume = SyntheticVolume(n);
+    const VolumePipeline pipeline({VolumeStage::Threshold(-500.0, 800.0, -500.0),
+                                   VolumeStage::GaussianSmooth(sigma)},
+                                  depth);
+    spdlog::info("{}^3 shorts ({:.2f} GB), threshold -500 to 800, Gaussian of {} voxels, "
+                 "slabs of {} layers",
+                 n, double(volume->GetNumberOfPoints()) * sizeof(short) / 1e9, sigma, depth);
+    LogPipelineRun("fused", [&] { return pipeline.Extract(volume, 0.0); });
+    LogPipelineRun("VTK", [&] { return pipeline.ExtractUnfused(volume, 0.0); });
+}
+
+// expr [N]: abs((a - b) * mask + 100) over N^3 volumes of shorts as an
+// expression template, as a formula compiled at run time and as a chain of
+// vtkImageMathematics filters
+void BenchmarkVolumeExpressions(const std::vector<std::string> &args)
+{
+    const int n = args.size() > 0 ? std::stoi(args[0]) : 384;
+    if (n < 1)
+    {
+        throw std::invalid_argument("expr: expected N >= 1");
+    }
+    auto a = SyntheticVolume(n);
+    auto b = SyntheticVolume(n, 1.0);
+    auto mask = vtkSmartPointer<vtkImageData>::New();
+    mask->SetDimensions(n, n, n);
+    mask->AllocateScalars(VTK_SHORT, 1);
+    const auto *aValues = static_cast<const short *>(a->GetScalarPointer());
+    auto *maskValues = static_cast<short *>(mask->GetScalarPointer());
+    const vtkIdType numValues = a->GetNumberOfPoints();
+    vtkSMPTools::For(0, numValues, [&](vtkIdType begin, vtkIdType end) {
+        for (vtkIdType i = begin; i < end; ++i)
+        {
+            maskValues[i] = aValues[i] > 0 ? 1 : 0;
+        }
+    });
+    // Three volumes read, one written
+    const std::size_t bytes = 4 * std::size_t(numValues) * sizeof(short);
+    spdlog::info("abs((a - b) * mask + 100) over {}^3 shorts ({:.2f} GB read and written)", n,
+                 bytes / 1e9);
+    auto throughput = [bytes](vtkImageData *, double seconds) {
+        return fmt::format("{:.2f} GB/s", GigabytesPerSecond(bytes, seconds));
+    };
+
+    auto fromTemplate = LogRun(
+        "template",
+        [&] {
+            const VolumeOperand va(a), vb(b), vm(mask);
+            return Evaluate(Abs((va - vb) * vm + 100), VTK_SHORT);
+        },
+        throughput);
+    const VolumeFormula formula("abs((a - b) * mask + 100)", {"a", "b", "mask"});
+    auto fromFormula = LogRun(
+        "formula", [&] { return formula.Evaluate({a, b, mask}, VTK_SHORT); }, throughput);
+    auto fromVTK = LogRun(
+        "VTK",
+        [&] {
+            auto subtract = vtkSmartPointer<vtkImageMathematics>::New();
+            subtract->SetOperationToSubtract();
+            subtract->SetInput1Data(a);
+            subtract->SetInput2Data(b);
+            auto multiply = vtkSmartPointer<vtkImageMathematics>::New();
+            multiply->SetOperationToMultiply();
+            multiply->SetInputConnection(0, subtract->GetOutputPort());
+            multiply->SetInput2Data(mask);
+            auto add = vtkSmartPointer<vtkImageMathematics>::New();
+            add->SetOperationToAddConstant();
+            add->SetConstantC(100.0);
+            add->SetInputConnection(multiply->GetOutputPort());
+            auto abs = vtkSmartPointer<vtkImageMathematics>::New();
+            abs->SetOperationToAbsoluteValue();
+            abs->SetInputConnection(add->GetOutputPort());
+            abs->Update();
+            return vtkSmartPointer<vtkImageData>(abs->GetOutput());
+        },
+        throughput);
+    for (vtkImageData *result : {fromTemplate.Get(), fromFormula.Get()})
+    {
+        if (std::memcmp(result->GetScalarPointer(), fromVTK->GetScalarPointer(),
+                        std::size_t(numValues) * sizeof(short)) != 0)
+        {
+            throw std::runtime_error("expr: the result differs from vtkImageMathematics");
+        }
+    }
+}
+
+// Logs the time per value of each way of summing values, against the first,
+// and checks that they agree
+void LogSums(const std::string &label, vtkIdType numValues,
+             const std::vector<std::pair<std::string, std::function<double()>>> &sums)
+{
+    double baseline = 0.0;
+    double expected = 0.0;
+    for (std::size_t i = 0; i < sums.size(); ++i)
+    {
+        double sum = 0.0;
+        const double seconds = SecondsFor([&] { sum = sums[i].second(); });
+        const double nanoseconds = seconds * 1e9 / double(numValues);
+        if (i == 0)
+        {
+            baseline = nanoseconds;
+            expected = sum;
+        }
+        else if (sum != expected)
+        {
+            throw std::runtime_error("dispatch: the " + label + " sums differ");
+        }
+        spdlog::info("{} {}: {:.2f} ns per value ({:.1f}x)", label, sums[i].first, nanoseconds,
+                     nanoseconds > 0.0 ? baseline / nanoseconds : 0.0);
+    }
+}
+
+// dispatch [N]: cost per value of reading N^3 shorts, and N^3 float points
+// stored as AOS and as SOA, through the virtual methods of vtkDataArray and
+// through array_dispatch, on one thread
+void BenchmarkArrayDispatch(const std::vector<std::string> &args)
+{
+    const int n = args.size() > 0 ? std::stoi(args[0]) : 256;
+    if (n < 1)
+    {
+        throw std::invalid_argument("dispatch: expected N >= 1");
+    }
+    auto volume = SyntheticVolume(n);
+    vtkDataArray *scalars = volume->GetPointData()->GetScalars();
+    const vtkIdType count = scalars->GetNumberOfTuples();
+    LogSums("shorts", count,
+            {{"GetComponent",
+              [&] {
+                  double sum = 0.0;
+                  for (vtkIdType i = 0; i < count; ++i)
+                  {
+                      sum += scalars->GetComponent(i, 0);
+                  }
+                  return sum;
+              }},
+             {"GetTuple1",
+              [&] {
+                  double sum = 0.0;
+                  for (vtkIdType i = 0; i < count; ++i)
+                  {
+                      sum += scalars->GetTuple1(i);
+                  }
+                  return sum;
+              }},
+             {"dispatched", [&] {
+                  double sum = 0.0;
+                  array_dispatch::Dispatch(scalars, [&](auto values) {
+                      for (vtkIdType i = 0; i < count; ++i)
+                      {
+                          sum += values.Get(i, 0);
+                      }
+                  });
+                  return sum;
+              }}});
+
+    // The voxel centers, moved by the scalars, in both layouts
+    const auto *voxels = static_cast<const short *>(volume->GetScalarPointer());
+    auto aos = vtkSmartPointer<vtkFloatArray>::New();
+    aos->SetNumberOfComponents(3);
+    aos->SetNumberOfTuples(count);
+    auto soa = vtkSmartPointer<vtkSOADataArrayTemplate<float>>::New();
+    soa->SetNumberOfComponents(3);
+    soa->SetNumberOfTuples(count);
+    float *xyz = aos->GetPointer(0);
+    float *axes[3] = {soa->GetComponentArrayPointer(0), soa->GetComponentArrayPointer(1),
+                      soa->GetComponentArrayPointer(2)};
+    vtkSMPTools::For(0, count, [&](vtkIdType begin, vtkIdType end) {
+        for (vtkIdType i = begin; i < end; ++i)
+        {
+            const vtkIdType index[3] = {i % n, (i / n) % n, i / (vtkIdType(n) * n)};
+            for (int a = 0; a < 3; ++a)
+            {
+                const float value = float(index[a]) + 1e-3f * voxels[i];
+                xyz[3 * i + a] = value;
+                axes[a][i] = value;
+            }
+        }
+    });
+    vtkDataArray *layouts[] = {aos, soa};
+    for (vtkDataArray *points : layouts)
+    {
+        LogSums(points == aos ? "AOS points" : "SOA points", 3 * count,
+                {{"GetTuple",
+                  [&] {
+                      double sum = 0.0;
+                      for (vtkIdType i = 0; i < count; ++i)
+                      {
+                          double p[3];
+                          points->GetTuple(i, p);
+                          sum += p[0] + p[1] + p[2];
+                      }
+                      return sum;
+                  }},
+                 {"dispatched", [&] {
+                      double sum = 0.0;
+                      array_dispatch::DispatchReal(points, [&](auto values) {
+                          for (vtkIdType i = 0; i < count; ++i)
+                          {
+                              double p[3];
+                              values.GetTuple(i, p);
+                              sum += p[0] + p[1] + p[2];
+                          }
+                      });
+                      return sum;
+                  }}});
+    }
+}
+
+// labels [N [LABELS]]: a synthetic N^3 segmentation of LABELS Voronoi cells
+// inside a sphere, every label boundary extracted in one pass and split into
+// per-label surfaces, against one vtkDiscreteFlyingEdges3D pass per label
+void BenchmarkLabelSurfaces(const std::vector<std::string> &args)
+{
+    const int n = args.size() > 0 ? std::stoi(args[0]) : 256;
+    const int numLabels = args.size() > 1 ? std::stoi(args[1]) : 100;
+    if (n < 2 || numLabels < 1 || numLabels > 32767)
+    {
+        throw std::invalid_argument("labels: expected N >= 2 and LABELS from 1 to 32767");
+    }
+    std::mt19937 random(42);
+    std::uniform_real_distribution<double> coordinate(0.05 * n, 0.95 * n);
+    std::vector<std::array<double, 3>> seeds(numLabels);
+    for (auto &seed : seeds)
+    {
+        seed = {coordinate(random), coordinate(random), coordinate(random)};
+    }
+    auto volume = vtkSmartPointer<vtkImageData>::New();
+    volume->SetDimensions(n, n, n);
+    volume->AllocateScalars(VTK_SHORT, 1);
+    auto *voxels = static_cast<short *>(volume->GetScalarPointer());
+    const double center = 0.5 * (n - 1);
+    const double radius = 0.45 * n;
+    vtkSMPTools::For(0, n, [&](vtkIdType zBegin, vtkIdType zEnd) {
+        for (vtkIdType z = zBegin; z < zEnd; ++z)
+        {
+            for (int y = 0; y < n; ++y)
+            {
+                short *row = voxels + (z * n + y) * n;
+                for (int x = 0; x < n; ++x)
+                {
+                    const double p[3] = {double(x), double(y), double(z)};
+                    const double c[3] = {center, center, center};
+                    row[x] = 0;
+                    if (vtkMath::Distance2BetweenPoints(p, c) > radius * radius)
+                    {
+                        continue;
+                    }
+                    double nearest = std::numeric_limits<double>::max();
+                    for (int l = 0; l < numLabels; ++l)
+                    {
+                        const double d = vtkMath::Distance2BetweenPoints(p, seeds[l].data());
+                        if (d < nearest)
+                        {
+                            nearest = d;
+                            row[x] = static_cast<short>(l + 1);
+                        }
+                    }
+                }
+            }
+        }
+    });
+    spdlog::info("{}^3 shorts with {} labels", n, numLabels);
+
+    LogRun(
+        "one pass",
+        [&] { return SplitLabelBoundaries(ExtractLabelBoundaries(volume)); },
+        [](const std::vector<LabelSurface> &surfaces, double) {
+            vtkIdType quads = 0;
+            for (const LabelSurface &label : surfaces)
+            {
+                quads += label.surface->GetNumberOfPolys();
+            }
+            return fmt::format("{} surfaces, {} quads", surfaces.size(), quads);
+        });
+    LogRun(
+        "VTK",
+        [&] {
+            std::vector<vtkSmartPointer<vtkPolyData>> surfaces;
+            for (int l = 1; l <= numLabels; ++l)
+            {
+                auto flyingEdges = vtkSmartPointer<vtkDiscreteFlyingEdges3D>::New();
+                flyingEdges->SetInputData(volume);
+                flyingEdges->SetValue(0, l);
+                flyingEdges->ComputeScalarsOff();
+                flyingEdges->Update();
+                surfaces.emplace_back(flyingEdges->GetOutput());
+            }
+            return surfaces;
+        },
+        [](const std::vector<vtkSmartPointer<vtkPolyData>> &surfaces, double) {
+            vtkIdType triangles = 0;
+            for (vtkPolyData *surface : surfaces)
+            {
+                triangles += surface->GetNumberOfPolys();
+            }
+            return fmt::format("{} surfaces, {} triangles", surfaces.size(), triangles);
+        });
+}
+
+// grow [N [LOWER [UPPER]]]: region growing over a synthetic N^3 volume of
+// shorts from its center, within LOWER to UPPER, as the parallel level by
+// level growth and as a single-threaded flood fill with a queue, which must
+// find the same voxels
+void BenchmarkRegionGrowing(const std::vector<std::string> &args)
+{
+    const int n = args.size() > 0 ? std::stoi(args[0]) : 384;
+    const double lower = args.size() > 1 ? std::stod(args[1]) : -300.0;
+    const double upper = args.size() > 2 ? std::stod(args[2]) : 1000.0;
+    if (n < 1 || lower > upper)
+    {
+        throw std::invalid_argument("grow: expected N >= 1 and LOWER <= UPPER");
+    }
+    auto volume = SyntheticVolume(n);
+    const auto *voxels = static_cast<const short *>(volume->GetScalarPointer());
+    double center[3];
+    volume->GetCenter(center);
+    int seed[3];
+    if (!RegionGrowing(volume, lower, upper).FindSeed(center, n / 8, seed))
+    {
+        throw std::invalid_argument("grow: no voxel within the range near the center");
+    }
+    spdlog::info("{}^3 shorts, values {} to {}, seed ({}, {}, {})", n, lower, upper, seed[0],
+                 seed[1], seed[2]);
+    auto rate = [](vtkIdType voxels, double seconds) {
+        return fmt::format("{} voxels, {:.1f} M voxels/s", voxels, voxels / seconds / 1e6);
+    };
+
+    // Both regions outlive their runs to be compared voxel by voxel
+    std::unique_ptr<RegionGrowing> region;
+    const vtkIdType slice = vtkIdType(n) * n;
+    std::vector<std::uint8_t> visited;
+    int steps = 0;
+    const vtkIdType parallel = LogRun(
+        "parallel",
+        [&] {
+            region = std::make_unique<RegionGrowing>(volume, lower, upper);
+            region->AddSeed(seed);
+            while (!region->IsDone())
+            {
+                region->Step();
+            }
+            steps = region->GetNumberOfSteps();
+            return region->GetNumberOfVoxels();
+        },
+        [&](vtkIdType voxels, double seconds) {
+            return rate(voxels, seconds) + fmt::format(", {} steps", steps);
+        });
+    const vtkIdType serial = LogRun(
+        "serial",
+        [&] {
+            visited.assign(std::size_t(slice) * n, 0);
+            std::vector<vtkIdType> queue;
+            const vtkIdType first = seed[0] + n * (seed[1] + vtkIdType(n) * seed[2]);
+            visited[first] = 1;
+            queue.push_back(first);
+            for (std::size_t head = 0; head < queue.size(); ++head)
+            {
+                const vtkIdType voxel = queue[head];
+                const int i = static_cast<int>(voxel % n);
+                const int j = static_cast<int>((voxel / n) % n);
+                const int k = static_cast<int>(voxel / slice);
+                const vtkIdType neighbors[6] = {i > 0 ? voxel - 1 : -1,
+                                                i + 1 < n ? voxel + 1 : -1,
+                                                j > 0 ? voxel - n : -1,
+                                                j + 1 < n ? voxel + n : -1,
+                                                k > 0 ? voxel - slice : -1,
+                                                k + 1 < n ? voxel + slice : -1};
+                for (const vtkIdType neighbor : neighbors)
+                {
+                    if (neighbor >= 0 && !visited[neighbor] && voxels[neighbor] >= lower &&
+                        voxels[neighbor] <= upper)
+                    {
+                        visited[neighbor] = 1;
+                        queue.push_back(neighbor);
+                    }
+                }
+            }
+            return static_cast<vtkIdType>(queue.size());
+        },
+        rate);
+    vtkIdType differing = 0;
+    for (vtkIdType voxel = 0; voxel < slice * n; ++voxel)
+    {
+        differing += region->Contains(voxel) != (visited[voxel] != 0);
+    }
+    if (parallel != serial || differing > 0)
+    {
+        throw std::runtime_error("grow: the parallel region differs from the flood fill in " +
+                                 std::to_string(differing) + " voxels");
+    }
+}
+
+} // namespace
+
+bool RunBenchmark(const std::string &name, const std::vector<std::string> &args)
+{
+    static const std::map<std::string, std::function<void(const std::vector<std::string> &)>>
+        kBenchmarks = {
+            {"readers", BenchmarkMeshReaders},
+            {"incremental", BenchmarkIncrementalIsosurface},
+            {"voxelize", BenchmarkVoxelizer},
+            {"sdf", BenchmarkDistanceField},
+            {"smooth", BenchmarkSmoothing},
+            {"components", BenchmarkComponents},
+            {"clip", BenchmarkClipping},
+            {"topology", BenchmarkTopology},
+            {"compress", BenchmarkCompression},
+            {"hdf", BenchmarkVTKHDF},
+            {"uring", BenchmarkBatchedReads},
+            {"fused", BenchmarkFusedVolumePipeline},
+            {"expr", BenchmarkVolumeExpressions},
+            {"dispatch", BenchmarkArrayDispatch},
+            {"labels", BenchmarkLabelSurfaces},
+            {"grow", BenchmarkRegionGrowing},
+        };
+
+    const auto it = kBenchmarks.find(name);
+    if (it == kBenchmarks.end())
+    {
+        return false;
+    }
+    it->second(args);
+    return true;
+}
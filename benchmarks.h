@@ -0,0 +1,8 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// Runs the benchmark called name with its arguments and logs the results via
+// spdlog. Returns false if there is no benchmark of that name.
+bool RunBenchmark(const std::string &name, const std::vector<std::string> &args);
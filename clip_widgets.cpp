@@ -0,0 +1,134 @@
+#include "clip_widgets.h"
+
+#include <vtkBoxRepresentation.h>
+#include <vtkBoxWidget2.h>
+#include <vtkCommand.h>
+#include <vtkImplicitPlaneRepresentation.h>
+#include <vtkImplicitPlaneWidget2.h>
+#include <vtkRenderWindowInteractor.h>
+#include <vtkRenderer.h>
+
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <chrono>
+#include <utility>
+
+PlaneClipWidget::PlaneClipWidget(ClipPolyDataFilter *filter, const double bounds[6])
+    : filter_(filter),
+      representation_(vtkSmartPointer<vtkImplicitPlaneRepresentation>::New()),
+      widget_(vtkSmartPointer<vtkImplicitPlaneWidget2>::New())
+{
+    double place[6];
+    std::copy_n(bounds, 6, place);
+    const double origin[3] = {0.5 * (bounds[0] + bounds[1]), 0.5 * (bounds[2] + bounds[3]),
+                              0.5 * (bounds[4] + bounds[5])};
+    const double normal[3] = {1.0, 0.0, 0.0};
+    representation_->SetPlaceFactor(1.0);
+    representation_->PlaceWidget(place);
+    representation_->SetOrigin(origin[0], origin[1], origin[2]);
+    representation_->SetNormal(normal[0], normal[1], normal[2]);
+    // The clipped surface shows where the plane is
+    representation_->DrawPlaneOff();
+    widget_->SetRepresentation(representation_);
+    filter_->SetPlane(origin, normal);
+}
+
+PlaneClipWidget::~PlaneClipWidget()
+{
+    // Detached, since the widget calls this back
+    widget_->Off();
+    widget_->RemoveAllObservers();
+    widget_->SetInteractor(nullptr);
+}
+
+void PlaneClipWidget::Attach(vtkRenderer *renderer, vtkRenderWindowInteractor *interactor)
+{
+    widget_->SetInteractor(interactor);
+    widget_->SetCurrentRenderer(renderer);
+    widget_->AddObserver(vtkCommand::InteractionEvent, this, &PlaneClipWidget::OnInteraction);
+    widget_->On();
+}
+
+void PlaneClipWidget::OnInteraction()
+{
+    double origin[3], normal[3];
+    representation_->GetOrigin(origin);
+    representation_->GetNormal(normal);
+    filter_->SetPlane(origin, normal);
+
+    const auto start = std::chrono::steady_clock::now();
+    filter_->Update();
+    const double seconds =
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    ++updates_;
+    totalSeconds_ += seconds;
+    maxSeconds_ = std::max(maxSeconds_, seconds);
+    spdlog::debug("Clipped {} polygons in {:.1f} ms", filter_->GetNumberOfClippedPolygons(),
+                  1000.0 * seconds);
+}
+
+void PlaneClipWidget::LogStats() const
+{
+    if (updates_ == 0)
+    {
+        return;
+    }
+    spdlog::info("Plane clipping: {} updates while dragging, {:.1f} ms mean, {:.1f} ms worst",
+                 updates_, 1000.0 * totalSeconds_ / updates_, 1000.0 * maxSeconds_);
+}
+
+BoxCropWidget::BoxCropWidget(vtkImageData *volume, vtkPolyData *surface, Extractor extract)
+    : volume_(volume),
+      surface_(surface),
+      extract_(std::move(extract)),
+      representation_(vtkSmartPointer<vtkBoxRepresentation>::New()),
+      widget_(vtkSmartPointer<vtkBoxWidget2>::New())
+{
+    double bounds[6];
+    volume_->GetBounds(bounds);
+    representation_->SetPlaceFactor(1.0);
+    representation_->PlaceWidget(bounds);
+    widget_->SetRepresentation(representation_);
+    // Crops are axis-aligned
+    widget_->RotationEnabledOff();
+}
+
+BoxCropWidget::~BoxCropWidget()
+{
+    // Detached, since the widget calls this back
+    widget_->Off();
+    widget_->RemoveAllObservers();
+    widget_->SetInteractor(nullptr);
+}
+
+void BoxCropWidget::Attach(vtkRenderer *renderer, vtkRenderWindowInteractor *interactor)
+{
+    widget_->SetInteractor(interactor);
+    widget_->SetCurrentRenderer(renderer);
+    widget_->AddObserver(vtkCommand::EndInteractionEvent, this, &BoxCropWidget::OnEndInteraction);
+    widget_->On();
+}
+
+void BoxCropWidget::OnEndInteraction()
+{
+    const auto start = std::chrono::steady_clock::now();
+    double bounds[6];
+    std::copy_n(representation_->GetBounds(), 6, bounds);
+    vtkSmartPointer<vtkImageData> cropped = CropImage(volume_, bounds);
+    const double cropSeconds =
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    // A box off the volume leaves nothing to extract from
+    vtkSmartPointer<vtkPolyData> surface = cropped->GetNumberOfPoints() > 0
+                                               ? extract_(cropped)
+                                               : vtkSmartPointer<vtkPolyData>::New();
+    // Same object, new contents: everything downstream re-executes
+    surface_->ShallowCopy(surface);
+    int dimensions[3];
+    cropped->GetDimensions(dimensions);
+    spdlog::info("Cropped the volume to {}x{}x{} in {:.3f} s, surface of {} cells in {:.3f} s",
+                 dimensions[0], dimensions[1], dimensions[2], cropSeconds,
+                 surface->GetNumberOfCells(),
+                 std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() -
+                     cropSeconds);
+}
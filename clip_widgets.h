@@ -0,0 +1,79 @@
+#pragma once
+
+#include "clipping.h"
+
+#include <vtkImageData.h>
+#include <vtkPolyData.h>
+#include <vtkSmartPointer.h>
+
+#include <cstdint>
+#include <functional>
+
+class vtkBoxRepresentation;
+class vtkBoxWidget2;
+class vtkImplicitPlaneRepresentation;
+class vtkImplicitPlaneWidget2;
+class vtkRenderer;
+class vtkRenderWindowInteractor;
+
+// vtkImplicitPlaneWidget2 that moves the plane of a ClipPolyDataFilter while
+// it is dragged; the filter is updated on every interaction event, before
+// the render, and the update times are kept to check that dragging stays
+// interactive.
+class PlaneClipWidget
+{
+public:
+    // The plane starts through the middle of bounds, facing +x
+    PlaneClipWidget(ClipPolyDataFilter *filter, const double bounds[6]);
+    ~PlaneClipWidget();
+
+    PlaneClipWidget(const PlaneClipWidget &) = delete;
+    PlaneClipWidget &operator=(const PlaneClipWidget &) = delete;
+
+    // The interactor must outlive the widget, which turns itself off in it
+    // when destroyed
+    void Attach(vtkRenderer *renderer, vtkRenderWindowInteractor *interactor);
+
+    // Logs the number of clips while dragging and their mean and worst time
+    void LogStats() const;
+
+private:
+    void OnInteraction();
+
+    vtkSmartPointer<ClipPolyDataFilter> filter_;
+    vtkSmartPointer<vtkImplicitPlaneRepresentation> representation_;
+    vtkSmartPointer<vtkImplicitPlaneWidget2> widget_;
+
+    std::uint64_t updates_ = 0;
+    double totalSeconds_ = 0.0;
+    double maxSeconds_ = 0.0;
+};
+
+// vtkBoxWidget2 that crops a volume: when the box is released, the volume is
+// cropped to it and the surface extracted from the crop replaces the
+// contents of surface, which stays the input of the rest of the pipeline.
+class BoxCropWidget
+{
+public:
+    using Extractor = std::function<vtkSmartPointer<vtkPolyData>(vtkImageData *)>;
+
+    // The box starts around the whole volume
+    BoxCropWidget(vtkImageData *volume, vtkPolyData *surface, Extractor extract);
+    ~BoxCropWidget();
+
+    BoxCropWidget(const BoxCropWidget &) = delete;
+    BoxCropWidget &operator=(const BoxCropWidget &) = delete;
+
+    // The interactor must outlive the widget, which turns itself off in it
+    // when destroyed
+    void Attach(vtkRenderer *renderer, vtkRenderWindowInteractor *interactor);
+
+private:
+    void OnEndInteraction();
+
+    vtkSmartPointer<vtkImageData> volume_;
+    vtkSmartPointer<vtkPolyData> surface_;
+    Extractor extract_;
+    vtkSmartPointer<vtkBoxRepresentation> representation_;
+    vtkSmartPointer<vtkBoxWidget2> widget_;
+};
@@ -0,0 +1,492 @@
+#include "clipping.h"
+
+#include "array_dispatch.h"
+#include "mesh_topology.h"
+
+#include <vtkCellArray.h>
+#include <vtkCellData.h>
+#include <vtkIdList.h>
+#include <vtkIdTypeArray.h>
+#include <vtkInformation.h>
+#include <vtkInformationVector.h>
+#include <vtkMath.h>
+#include <vtkObjectFactory.h>
+#include <vtkPointData.h>
+#include <vtkPoints.h>
+#include <vtkPolyData.h>
+#include <vtkSMPTools.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+
+vtkStandardNewMacro(ClipPolyDataFilter);
+
+namespace
+{
+
+using Planes = std::vector<std::array<double, 4>>;
+
+// Polygons per task of the counting and filling passes
+constexpr vtkIdType kChunkSize = 16384;
+
+double Distance(const std::array<double, 4> &plane, const double *p)
+{
+    return plane[0] * p[0] + plane[1] * p[1] + plane[2] * p[2] + plane[3];
+}
+
+// Sets bit p of the masks of points begin to end that are outside plane p;
+// one plane at a time so that the loop vectorizes
+template <typename Points>
+void Classify(Points xyz, vtkIdType begin, vtkIdType end, const Planes &planes,
+              std::uint8_t *masks)
+{
+    std::fill(masks + begin, masks + end, std::uint8_t(0));
+    for (std::size_t p = 0; p < planes.size(); ++p)
+    {
+        const double a = planes[p][0], b = planes[p][1], c = planes[p][2], d = planes[p][3];
+        const std::uint8_t bit = std::uint8_t(1u << p);
+        for (vtkIdType i = begin; i < end; ++i)
+        {
+            const double distance = a * xyz.Get(i, 0) + b * xyz.Get(i, 1) + c * xyz.Get(i, 2) + d;
+            masks[i] |= distance < 0.0 ? bit : std::uint8_t(0);
+        }
+    }
+}
+
+// A polygon being clipped: its vertices with their weights over the corners
+// of the input polygon, and the input point of the vertices that are one
+struct ClipPolygon
+{
+    vtkIdType corners = 0;
+    std::vector<double> points;
+    std::vector<double> weights;
+    std::vector<vtkIdType> ids;
+
+    vtkIdType Size() const { return static_cast<vtkIdType>(ids.size()); }
+
+    void Load(vtkPoints *source, const vtkIdType *pts, vtkIdType npts)
+    {
+        corners = npts;
+        points.resize(3 * npts);
+        weights.assign(npts * npts, 0.0);
+        ids.assign(pts, pts + npts);
+        for (vtkIdType i = 0; i < npts; ++i)
+        {
+            source->GetPoint(pts[i], &points[3 * i]);
+            weights[i * npts + i] = 1.0;
+        }
+    }
+
+    void Clear(vtkIdType cornerCount)
+    {
+        corners = cornerCount;
+        points.clear();
+        weights.clear();
+        ids.clear();
+    }
+
+    // Vertex i of from, or the point at t between it and vertex j
+    void Append(const ClipPolygon &from, vtkIdType i, vtkIdType j = -1, double t = 0.0)
+    {
+        for (int a = 0; a < 3; ++a)
+        {
+            const double x = from.points[3 * i + a];
+            points.push_back(j < 0 ? x : x + t * (from.points[3 * j + a] - x));
+        }
+        for (vtkIdType c = 0; c < corners; ++c)
+        {
+            const double w = from.weights[i * corners + c];
+            weights.push_back(j < 0 ? w : w + t * (from.weights[j * corners + c] - w));
+        }
+        ids.push_back(j < 0 ? from.ids[i] : -1);
+    }
+};
+
+// Sutherland-Hodgman clipping of polygon by the planes whose bits are set in
+// mask; a polygon that vanishes ends up with no vertices
+void Clip(ClipPolygon &polygon, ClipPolygon &scratch, const Planes &planes, std::uint8_t mask)
+{
+    for (std::size_t p = 0; p < planes.size() && polygon.Size() > 0; ++p)
+    {
+        if (!(mask >> p & 1u))
+        {
+            continue;
+        }
+        scratch.Clear(polygon.corners);
+        const vtkIdType size = polygon.Size();
+        for (vtkIdType i = 0; i < size; ++i)
+        {
+            const vtkIdType j = (i + 1) % size;
+            const double di = Distance(planes[p], &polygon.points[3 * i]);
+            const double dj = Distance(planes[p], &polygon.points[3 * j]);
+            if (di >= 0.0)
+            {
+                scratch.Append(polygon, i);
+            }
+            if ((di >= 0.0) != (dj >= 0.0))
+            {
+                scratch.Append(polygon, i, j, di / (di - dj));
+            }
+        }
+        std::swap(polygon, scratch);
+    }
+}
+
+// Copies the first count tuples of from into to, in parallel when both are
+// plain arrays of the same type
+void CopyTuples(vtkAbstractArray *from, vtkAbstractArray *to, vtkIdType count)
+{
+    if (!from->HasStandardMemoryLayout() || !to->HasStandardMemoryLayout() ||
+        from->GetDataType() != to->GetDataType())
+    {
+        to->InsertTuples(0, count, 0, from);
+        return;
+    }
+    const std::size_t tupleSize =
+        std::size_t(from->GetDataTypeSize()) * from->GetNumberOfComponents();
+    const auto *source = static_cast<const char *>(from->GetVoidPointer(0));
+    auto *target = static_cast<char *>(to->GetVoidPointer(0));
+    vtkSMPTools::For(0, count, [&](vtkIdType begin, vtkIdType end) {
+        std::memcpy(target + begin * tupleSize, source + begin * tupleSize,
+                    (end - begin) * tupleSize);
+    });
+}
+
+vtkSmartPointer<vtkIdList> NewIdList(const std::vector<vtkIdType> &ids)
+{
+    auto list = vtkSmartPointer<vtkIdList>::New();
+    list->SetNumberOfIds(static_cast<vtkIdType>(ids.size()));
+    std::copy(ids.begin(), ids.end(), list->GetPointer(0));
+    return list;
+}
+
+} // namespace
+
+void ClipPolyDataFilter::SetPlane(const double origin[3], const double normal[3])
+{
+    double n[3] = {normal[0], normal[1], normal[2]};
+    if (vtkMath::Normalize(n) == 0.0)
+    {
+        throw std::invalid_argument("clipping plane without a normal");
+    }
+    planes_ = {{n[0], n[1], n[2], -vtkMath::Dot(n, origin)}};
+    this->Modified();
+}
+
+void ClipPolyDataFilter::SetBox(const double bounds[6])
+{
+    planes_.clear();
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        std::array<double, 4> low = {0.0, 0.0, 0.0, -bounds[2 * axis]};
+        std::array<double, 4> high = {0.0, 0.0, 0.0, bounds[2 * axis + 1]};
+        low[axis] = 1.0;
+        high[axis] = -1.0;
+        planes_.push_back(low);
+        planes_.push_back(high);
+    }
+    this->Modified();
+}
+
+int ClipPolyDataFilter::RequestData(vtkInformation *, vtkInformationVector **inputVector,
+                                    vtkInformationVector *outputVector)
+{
+    vtkPolyData *input = vtkPolyData::GetData(inputVector[0]);
+    vtkPolyData *output = vtkPolyData::GetData(outputVector);
+    clippedPolygons_ = 0;
+
+    const vtkIdType numPoints = input->GetNumberOfPoints();
+    const vtkIdType numPolys = input->GetNumberOfPolys();
+    if (planes_.empty() || numPoints == 0 || numPolys == 0)
+    {
+        output->ShallowCopy(input);
+        return 1;
+    }
+
+    // Which planes every point is outside of
+    vtkPoints *inPoints = input->GetPoints();
+    vtkDataArray *coords = inPoints->GetData();
+    std::vector<std::uint8_t> masks(numPoints);
+    array_dispatch::DispatchReal(coords, [&](auto xyz) {
+        vtkSMPTools::For(0, numPoints, [&](vtkIdType begin, vtkIdType end) {
+            Classify(xyz, begin, end, planes_, masks.data());
+        });
+    });
+
+    // The polygons stay the same while the plane moves, so this is a cache hit
+    const MeshTopology &topology = *MeshTopology::Get(input);
+
+    // Walks the polygons of a chunk: kept, dropped, or clipped into polygon
+    struct Counts
+    {
+        vtkIdType cells = 0;
+        vtkIdType corners = 0;
+        vtkIdType newPoints = 0;
+        vtkIdType clipped = 0;
+    };
+    auto forEachPolygon = [&](vtkIdType chunk, ClipPolygon &polygon, ClipPolygon &scratch,
+                              auto &&emit) {
+        const vtkIdType last = std::min(numPolys, (chunk + 1) * kChunkSize);
+        for (vtkIdType cell = chunk * kChunkSize; cell < last; ++cell)
+        {
+            const vtkIdType c0 = topology.cornerOffsets[cell];
+            const vtkIdType c1 = topology.cornerOffsets[cell + 1];
+            std::uint8_t outside = 0;
+            std::uint8_t common = 0xff;
+            for (vtkIdType c = c0; c < c1; ++c)
+            {
+                outside |= masks[topology.corners[c]];
+                common &= masks[topology.corners[c]];
+            }
+            if (c0 == c1 || common != 0)
+            {
+                continue;
+            }
+            if (outside == 0)
+            {
+                emit(cell, nullptr);
+                continue;
+            }
+            polygon.Load(inPoints, &topology.corners[c0], c1 - c0);
+            Clip(polygon, scratch, planes_, outside);
+            emit(cell, &polygon);
+        }
+    };
+
+    // Counts per chunk, then their prefix sums
+    const vtkIdType numChunks = (numPolys + kChunkSize - 1) / kChunkSize;
+    std::vector<Counts> chunkStarts(numChunks + 1);
+    vtkSMPTools::For(0, numChunks, [&](vtkIdType begin, vtkIdType end) {
+        ClipPolygon polygon, scratch;
+        for (vtkIdType chunk = begin; chunk < end; ++chunk)
+        {
+            Counts &counts = chunkStarts[chunk + 1];
+            forEachPolygon(chunk, polygon, scratch, [&](vtkIdType cell, const ClipPolygon *clip) {
+                const vtkIdType size = clip ? clip->Size()
+                                            : topology.cornerOffsets[cell + 1] -
+                                                  topology.cornerOffsets[cell];
+                if (clip)
+                {
+                    ++counts.clipped;
+                }
+                if (size < 3)
+                {
+                    return;
+                }
+                ++counts.cells;
+                counts.corners += size;
+                if (clip)
+                {
+                    counts.newPoints += std::count(clip->ids.begin(), clip->ids.end(), -1);
+                }
+            });
+        }
+    });
+    for (vtkIdType chunk = 0; chunk < numChunks; ++chunk)
+    {
+        Counts &next = chunkStarts[chunk + 1];
+        const Counts &start = chunkStarts[chunk];
+        next.cells += start.cells;
+        next.corners += start.corners;
+        next.newPoints += start.newPoints;
+        next.clipped += start.clipped;
+    }
+    const Counts total = chunkStarts[numChunks];
+    clippedPolygons_ = total.clipped;
+    if (total.clipped == 0 && total.cells == numPolys)
+    {
+        // Nothing cut: the input passes through
+        output->ShallowCopy(input);
+        return 1;
+    }
+
+    // Every chunk fills its share of the output from its prefix sums
+    const vtkIdType numOutPoints = numPoints + total.newPoints;
+    auto points = vtkSmartPointer<vtkPoints>::New();
+    points->SetDataType(inPoints->GetDataType());
+    points->SetNumberOfPoints(numOutPoints);
+    CopyTuples(coords, points->GetData(), numPoints);
+    auto offsets = vtkSmartPointer<vtkIdTypeArray>::New();
+    offsets->SetNumberOfValues(total.cells + 1);
+    auto connectivity = vtkSmartPointer<vtkIdTypeArray>::New();
+    connectivity->SetNumberOfValues(total.corners);
+    vtkIdType *off = offsets->GetPointer(0);
+    vtkIdType *conn = connectivity->GetPointer(0);
+    off[total.cells] = total.corners;
+    std::vector<vtkIdType> cellIds(total.cells);
+    std::vector<vtkIdType> newPointCells(total.newPoints);
+    vtkSMPTools::For(0, numChunks, [&](vtkIdType begin, vtkIdType end) {
+        ClipPolygon polygon, scratch;
+        for (vtkIdType chunk = begin; chunk < end; ++chunk)
+        {
+            Counts at = chunkStarts[chunk];
+            forEachPolygon(chunk, polygon, scratch, [&](vtkIdType cell, const ClipPolygon *clip) {
+                const vtkIdType c0 = topology.cornerOffsets[cell];
+                const vtkIdType size = clip ? clip->Size() : topology.cornerOffsets[cell + 1] - c0;
+                if (size < 3)
+                {
+                    return;
+                }
+                cellIds[at.cells] = cell;
+                off[at.cells++] = at.corners;
+                for (vtkIdType v = 0; v < size; ++v)
+                {
+                    if (!clip)
+                    {
+                        conn[at.corners++] = topology.corners[c0 + v];
+                    }
+                    else if (clip->ids[v] >= 0)
+                    {
+                        conn[at.corners++] = clip->ids[v];
+                    }
+                    else
+                    {
+                        newPointCells[at.newPoints] = cell;
+                        points->SetPoint(numPoints + at.newPoints, &clip->points[3 * v]);
+                        conn[at.corners++] = numPoints + at.newPoints++;
+                    }
+                }
+            });
+        }
+    });
+    auto polys = vtkSmartPointer<vtkCellArray>::New();
+    polys->SetData(offsets, connectivity);
+    output->SetPoints(points);
+    output->SetPolys(polys);
+
+    // Point data: the input's, then interpolated for the points on cut edges
+    vtkPointData *inPD = input->GetPointData();
+    vtkPointData *outPD = output->GetPointData();
+    outPD->InterpolateAllocate(inPD, numOutPoints);
+    for (int a = 0; a < outPD->GetNumberOfArrays(); ++a)
+    {
+        vtkAbstractArray *to = outPD->GetAbstractArray(a);
+        to->SetNumberOfTuples(numOutPoints);
+        if (vtkAbstractArray *from = inPD->GetAbstractArray(to->GetName()))
+        {
+            CopyTuples(from, to, numPoints);
+        }
+    }
+    if (outPD->GetNumberOfArrays() > 0)
+    {
+        ClipPolygon polygon, scratch;
+        auto cornerIds = vtkSmartPointer<vtkIdList>::New();
+        for (vtkIdType n = 0; n < total.newPoints;)
+        {
+            // The new points of a polygon are numbered together, in order
+            const vtkIdType cell = newPointCells[n];
+            const vtkIdType c0 = topology.cornerOffsets[cell];
+            const vtkIdType c1 = topology.cornerOffsets[cell + 1];
+            std::uint8_t outside = 0;
+            for (vtkIdType c = c0; c < c1; ++c)
+            {
+                outside |= masks[topology.corners[c]];
+            }
+            polygon.Load(inPoints, &topology.corners[c0], c1 - c0);
+            Clip(polygon, scratch, planes_, outside);
+            cornerIds->SetNumberOfIds(c1 - c0);
+            std::copy(&topology.corners[c0], &topology.corners[c0] + (c1 - c0),
+                      cornerIds->GetPointer(0));
+            for (vtkIdType v = 0; v < polygon.Size(); ++v)
+            {
+                if (polygon.ids[v] < 0)
+                {
+                    outPD->InterpolatePoint(inPD, numPoints + n++, cornerIds,
+                                            &polygon.weights[v * polygon.corners]);
+                }
+            }
+        }
+    }
+
+    // Cell data of the polygons the output cells came from, whose ids in the
+    // input come after the verts and lines
+    vtkCellData *inCD = input->GetCellData();
+    if (inCD->GetNumberOfArrays() > 0)
+    {
+        const vtkIdType firstPoly = input->GetNumberOfVerts() + input->GetNumberOfLines();
+        std::vector<vtkIdType> outIds(total.cells);
+        for (vtkIdType cell = 0; cell < total.cells; ++cell)
+        {
+            cellIds[cell] += firstPoly;
+            outIds[cell] = cell;
+        }
+        output->GetCellData()->CopyAllocate(inCD, total.cells);
+        output->GetCellData()->CopyData(inCD, NewIdList(cellIds), NewIdList(outIds));
+    }
+    return 1;
+}
+
+void ClipPolyDataFilter::PrintSelf(ostream &os, vtkIndent indent)
+{
+    this->Superclass::PrintSelf(os, indent);
+    os << indent << "Planes: " << planes_.size() << "\n";
+    os << indent << "Clipped polygons: " << clippedPolygons_ << "\n";
+}
+
+vtkSmartPointer<vtkImageData> CropImage(vtkImageData *image, const double bounds[6])
+{
+    int extent[6];
+    double origin[3], spacing[3];
+    image->GetExtent(extent);
+    image->GetOrigin(origin);
+    image->GetSpacing(spacing);
+    // Index box around the corners of bounds, which is the box itself unless
+    // the image is oblique
+    double low[3], high[3];
+    std::fill_n(low, 3, std::numeric_limits<double>::max());
+    std::fill_n(high, 3, std::numeric_limits<double>::lowest());
+    for (int corner = 0; corner < 8; ++corner)
+    {
+        double index[3];
+        image->TransformPhysicalPointToContinuousIndex(
+            bounds[corner & 1], bounds[2 + ((corner >> 1) & 1)], bounds[4 + ((corner >> 2) & 1)],
+            index);
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            low[axis] = std::min(low[axis], index[axis]);
+            high[axis] = std::max(high[axis], index[axis]);
+        }
+    }
+    int crop[6];
+    bool empty = false;
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        crop[2 * axis] = std::max(extent[2 * axis], static_cast<int>(std::ceil(low[axis])));
+        crop[2 * axis + 1] =
+            std::min(extent[2 * axis + 1], static_cast<int>(std::floor(high[axis])));
+        empty = empty || crop[2 * axis] > crop[2 * axis + 1];
+    }
+
+    auto cropped = vtkSmartPointer<vtkImageData>::New();
+    cropped->SetOrigin(origin);
+    cropped->SetSpacing(spacing);
+    cropped->SetDirectionMatrix(image->GetDirectionMatrix());
+    vtkDataArray *scalars = image->GetPointData()->GetScalars();
+    if (empty || !scalars)
+    {
+        return cropped;
+    }
+    cropped->SetExtent(crop);
+    cropped->AllocateScalars(scalars->GetDataType(), scalars->GetNumberOfComponents());
+    cropped->GetPointData()->GetScalars()->SetName(scalars->GetName());
+
+    const std::size_t rowBytes = std::size_t(crop[1] - crop[0] + 1) *
+                                 scalars->GetDataTypeSize() * scalars->GetNumberOfComponents();
+    const int rows = crop[3] - crop[2] + 1;
+    const vtkIdType count = vtkIdType(rows) * (crop[5] - crop[4] + 1);
+    vtkSMPTools::For(0, count, [&](vtkIdType begin, vtkIdType end) {
+        for (vtkIdType row = begin; row < end; ++row)
+        {
+            const int j = crop[2] + int(row % rows);
+            const int k = crop[4] + int(row / rows);
+            std::memcpy(cropped->GetScalarPointer(crop[0], j, k),
+                        image->GetScalarPointer(crop[0], j, k), rowBytes);
+        }
+    });
+    return cropped;
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <vtkImageData.h>
+#include <vtkPolyDataAlgorithm.h>
+#include <vtkSmartPointer.h>
+
+#include <array>
+#include <vector>
+
+// Clips the polygons of a mesh by a plane or a box, in parallel, fast enough
+// to follow a plane widget being dragged over tens of millions of triangles.
+//
+// Every point is classified against the planes in one vectorizable pass.
+// Polygons with all corners inside are kept as they are and those with all
+// corners outside one plane are dropped; only the polygons in between are
+// clipped (Sutherland-Hodgman), into one convex polygon each. Output cells
+// are compacted with prefix sums. The input points and point data are copied
+// unchanged and the points on cut edges appended, so points that were clipped
+// away stay in the output unused, and cut edges shared by two polygons get a
+// point each. Verts, lines and strips are dropped.
+class ClipPolyDataFilter : public vtkPolyDataAlgorithm
+{
+public:
+    static ClipPolyDataFilter *New();
+    vtkTypeMacro(ClipPolyDataFilter, vtkPolyDataAlgorithm);
+    void PrintSelf(ostream &os, vtkIndent indent) override;
+
+    // Keeps the half space the normal points into
+    void SetPlane(const double origin[3], const double normal[3]);
+    // Keeps the inside of an axis-aligned box
+    void SetBox(const double bounds[6]);
+
+    // Polygons clipped by the last update
+    vtkIdType GetNumberOfClippedPolygons() const { return clippedPolygons_; }
+
+protected:
+    ClipPolyDataFilter() = default;
+    ~ClipPolyDataFilter() override = default;
+
+    int RequestData(vtkInformation *request, vtkInformationVector **inputVector,
+                    vtkInformationVector *outputVector) override;
+
+private:
+    ClipPolyDataFilter(const ClipPolyDataFilter &) = delete;
+    void operator=(const ClipPolyDataFilter &) = delete;
+
+    // a x + b y + c z + d >= 0 inside every plane
+    std::vector<std::array<double, 4>> planes_;
+    vtkIdType clippedPolygons_ = 0;
+};
+
+// Points of image inside bounds, with their scalars, copied row by row in
+// parallel. The extent keeps its indices, so the crop stays in place; it is
+// empty when bounds miss the image. For an image with a direction matrix the
+// crop is the index box around bounds, so it may hold points outside them.
+vtkSmartPointer<vtkImageData> CropImage(vtkImageData *image, const double bounds[6]);
@@ -0,0 +1,490 @@
+#include "compressed_mesh.h"
+#include "array_dispatch.h"
+#include "mapped_file.h"
+
+#include <vtkCellArray.h>
+#include <vtkDataArray.h>
+#include <vtkFloatArray.h>
+#include <vtkIdList.h>
+#include <vtkIdTypeArray.h>
+#include <vtkPointData.h>
+#include <vtkPoints.h>
+#include <vtkSMPTools.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+namespace
+{
+
+// Points packed per task; a multiple of 64, so that every task starts on a
+// whole 64-bit word whatever the field width
+constexpr vtkIdType kPackChunk = 4096;
+
+std::uint64_t AlignUp(std::uint64_t bytes)
+{
+    return (bytes + 7) & ~std::uint64_t(7);
+}
+
+// Bytes of a bit-packed region of count fields, padded so that any field can
+// be read with one unaligned 64-bit load
+std::uint64_t PackedBytes(std::uint64_t count, int bits)
+{
+    return (count * bits + 63) / 64 * 8 + 8;
+}
+
+// Appends fields of up to 32 bits, least significant bit first, to whole
+// little-endian 64-bit words
+class BitWriter
+{
+public:
+    explicit BitWriter(char *out)
+        : out_(out)
+    {
+    }
+
+    void Put(std::uint32_t value, int bits)
+    {
+        buffer_ |= std::uint64_t(value) << fill_;
+        fill_ += bits;
+        if (fill_ >= 64)
+        {
+            std::memcpy(out_, &buffer_, 8);
+            out_ += 8;
+            fill_ -= 64;
+            buffer_ = fill_ > 0 ? std::uint64_t(value) >> (bits - fill_) : 0;
+        }
+    }
+
+    void Flush()
+    {
+        if (fill_ > 0)
+        {
+            std::memcpy(out_, &buffer_, 8);
+        }
+    }
+
+private:
+    char *out_;
+    std::uint64_t buffer_ = 0;
+    int fill_ = 0;
+};
+
+std::uint32_t ReadField(const char *packed, std::uint64_t bitOffset, std::uint32_t mask)
+{
+    std::uint64_t word;
+    std::memcpy(&word, packed + (bitOffset >> 3), 8);
+    return static_cast<std::uint32_t>(word >> (bitOffset & 7)) & mask;
+}
+
+// Packs fieldsPerItem fields of bits each for every item, in parallel
+template <typename Fields>
+void PackFields(vtkIdType count, int fieldsPerItem, int bits, char *out, Fields &&fields)
+{
+    const vtkIdType chunks = (count + kPackChunk - 1) / kPackChunk;
+    vtkSMPTools::For(0, chunks, [&](vtkIdType begin, vtkIdType end) {
+        std::uint32_t values[3];
+        for (vtkIdType chunk = begin; chunk < end; ++chunk)
+        {
+            const vtkIdType first = chunk * kPackChunk;
+            const vtkIdType last = std::min(count, first + kPackChunk);
+            BitWriter writer(out + first * fieldsPerItem * bits / 8);
+            for (vtkIdType i = first; i < last; ++i)
+            {
+                fields(i, values);
+                for (int k = 0; k < fieldsPerItem; ++k)
+                {
+                    writer.Put(values[k], bits);
+                }
+            }
+            writer.Flush();
+        }
+    });
+}
+
+// Octahedral encoding of a normal into [0, maximum]^2
+void EncodeOctahedral(const double n[3], std::uint32_t maximum, std::uint32_t out[2])
+{
+    const double sum = std::abs(n[0]) + std::abs(n[1]) + std::abs(n[2]);
+    double u = sum > 0.0 ? n[0] / sum : 0.0;
+    double v = sum > 0.0 ? n[1] / sum : 0.0;
+    if (sum > 0.0 && n[2] < 0.0)
+    {
+        const double folded = std::copysign(1.0 - std::abs(v), u);
+        v = std::copysign(1.0 - std::abs(u), v);
+        u = folded;
+    }
+    out[0] = static_cast<std::uint32_t>(std::lround((0.5 * u + 0.5) * maximum));
+    out[1] = static_cast<std::uint32_t>(std::lround((0.5 * v + 0.5) * maximum));
+}
+
+void PutVarint(std::vector<char> &out, std::uint64_t value)
+{
+    while (value >= 0x80)
+    {
+        out.push_back(static_cast<char>((value & 0x7f) | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<char>(value));
+}
+
+// Returns false if the varint runs past end
+bool GetVarint(const char *&p, const char *end, std::uint64_t &value)
+{
+    value = 0;
+    for (int shift = 0; p < end && shift < 64; shift += 7)
+    {
+        const auto byte = static_cast<unsigned char>(*p++);
+        value |= std::uint64_t(byte & 0x7f) << shift;
+        if (byte < 0x80)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+std::uint64_t ZigZag(std::int64_t value)
+{
+    return (static_cast<std::uint64_t>(value) << 1) ^ static_cast<std::uint64_t>(value >> 63);
+}
+
+std::int64_t UnZigZag(std::uint64_t value)
+{
+    return static_cast<std::int64_t>(value >> 1) ^ -static_cast<std::int64_t>(value & 1);
+}
+
+void CheckBits(int bits, int min, int max, const char *what)
+{
+    if (bits < min || bits > max)
+    {
+        throw std::invalid_argument(std::string("compressed mesh: ") + what + " must be " +
+                                    std::to_string(min) + " to " + std::to_string(max));
+    }
+}
+
+} // namespace
+
+std::vector<char> EncodeCompressedMesh(vtkPolyData *mesh, const CompressedMeshOptions &options)
+{
+    CheckBits(options.positionBits, 4, 24, "position bits");
+    vtkDataArray *normals = mesh->GetPointData()->GetNormals();
+    const int normalBits = normals ? options.normalBits : 0;
+    if (normalBits != 0)
+    {
+        CheckBits(normalBits, 4, 16, "normal bits");
+    }
+
+    const vtkIdType numPoints = mesh->GetNumberOfPoints();
+    vtkCellArray *polys = mesh->GetPolys();
+    const vtkIdType numPolys = polys ? polys->GetNumberOfCells() : 0;
+
+    CompressedMeshHeader header{};
+    std::memcpy(header.magic, kCompressedMeshMagic, sizeof(kCompressedMeshMagic));
+    header.version = kCompressedMeshVersion;
+    header.positionBits = static_cast<std::uint32_t>(options.positionBits);
+    header.normalBits = static_cast<std::uint32_t>(normalBits);
+    header.blockCount = static_cast<std::uint32_t>(
+        (static_cast<std::uint64_t>(numPolys) + kCompressedMeshBlockPolygons - 1) /
+        kCompressedMeshBlockPolygons);
+    header.pointCount = static_cast<std::uint64_t>(numPoints);
+    header.polygonCount = static_cast<std::uint64_t>(numPolys);
+    header.connectivitySize =
+        numPolys > 0 ? static_cast<std::uint64_t>(polys->GetNumberOfConnectivityIds()) : 0;
+
+    const std::uint32_t positionMax = (1u << options.positionBits) - 1;
+    if (numPoints > 0)
+    {
+        double bounds[6];
+        mesh->GetPoints()->GetBounds(bounds);
+        for (int k = 0; k < 3; ++k)
+        {
+            header.origin[k] = bounds[2 * k];
+            header.scale[k] = (bounds[2 * k + 1] - bounds[2 * k]) / positionMax;
+        }
+    }
+
+    // Polygon blocks are encoded first, as their size is not known up front
+    std::vector<std::vector<char>> blocks(header.blockCount);
+    std::vector<CompressedMeshBlock> table(header.blockCount);
+    vtkSMPTools::For(0, static_cast<vtkIdType>(blocks.size()), [&](vtkIdType begin,
+                                                                   vtkIdType end) {
+        auto idList = vtkSmartPointer<vtkIdList>::New();
+        for (vtkIdType block = begin; block < end; ++block)
+        {
+            const auto first = static_cast<vtkIdType>(block * kCompressedMeshBlockPolygons);
+            const vtkIdType last =
+                std::min(numPolys, first + static_cast<vtkIdType>(kCompressedMeshBlockPolygons));
+            std::vector<char> &out = blocks[block];
+            out.reserve(static_cast<std::size_t>(last - first) * 8);
+            table[block].connectivityOffset = static_cast<std::uint64_t>(polys->GetOffset(first));
+            vtkIdType previous = 0;
+            for (vtkIdType cell = first; cell < last; ++cell)
+            {
+                vtkIdType npts = 0;
+                const vtkIdType *pts = nullptr;
+                polys->GetCellAtId(cell, npts, pts, idList);
+                PutVarint(out, static_cast<std::uint64_t>(npts));
+                for (vtkIdType i = 0; i < npts; ++i)
+                {
+                    PutVarint(out, ZigZag(static_cast<std::int64_t>(pts[i] - previous)));
+                    previous = pts[i];
+                }
+            }
+        }
+    });
+    std::uint64_t polygonBytes = 0;
+    for (std::size_t block = 0; block < blocks.size(); ++block)
+    {
+        table[block].byteOffset = polygonBytes;
+        polygonBytes += blocks[block].size();
+    }
+
+    const std::uint64_t positionsOffset = sizeof(CompressedMeshHeader);
+    header.normalsOffset =
+        positionsOffset + PackedBytes(header.pointCount * 3, options.positionBits);
+    header.blocksOffset =
+        header.normalsOffset + (normalBits ? PackedBytes(header.pointCount * 2, normalBits) : 0);
+    header.polygonsOffset = header.blocksOffset + table.size() * sizeof(CompressedMeshBlock);
+    header.size = AlignUp(header.polygonsOffset + polygonBytes);
+
+    std::vector<char> data(header.size, 0);
+    std::memcpy(data.data(), &header, sizeof(header));
+    if (!table.empty())
+    {
+        std::memcpy(data.data() + header.blocksOffset, table.data(),
+                    table.size() * sizeof(CompressedMeshBlock));
+    }
+
+    if (numPoints > 0)
+    {
+        array_dispatch::DispatchReal(mesh->GetPoints()->GetData(), [&](auto xyz) {
+            PackFields(numPoints, 3, options.positionBits, data.data() + positionsOffset,
+                       [&](vtkIdType i, std::uint32_t *values) {
+                           for (int k = 0; k < 3; ++k)
+                           {
+                               const double q =
+                                   header.scale[k] > 0.0
+                                       ? (xyz.Get(i, k) - header.origin[k]) / header.scale[k]
+                                       : 0.0;
+                               values[k] = static_cast<std::uint32_t>(std::clamp<long>(
+                                   std::lround(q), 0, static_cast<long>(positionMax)));
+                           }
+                       });
+        });
+    }
+    if (normalBits)
+    {
+        const std::uint32_t normalMax = (1u << normalBits) - 1;
+        array_dispatch::DispatchReal(normals, [&](auto directions) {
+            PackFields(numPoints, 2, normalBits, data.data() + header.normalsOffset,
+                       [&](vtkIdType i, std::uint32_t *values) {
+                           double n[3];
+                           directions.GetTuple(i, n);
+                           EncodeOctahedral(n, normalMax, values);
+                       });
+        });
+    }
+    vtkSMPTools::For(0, static_cast<vtkIdType>(blocks.size()), [&](vtkIdType begin,
+                                                                   vtkIdType end) {
+        for (vtkIdType block = begin; block < end; ++block)
+        {
+            std::copy(blocks[block].begin(), blocks[block].end(),
+                      data.begin() + header.polygonsOffset + table[block].byteOffset);
+        }
+    });
+    return data;
+}
+
+vtkSmartPointer<vtkPolyData> DecodeCompressedMesh(const char *data, std::size_t size)
+{
+    CompressedMeshHeader header;
+    if (size < sizeof(header))
+    {
+        throw std::runtime_error("compressed mesh: truncated header");
+    }
+    std::memcpy(&header, data, sizeof(header));
+    if (std::memcmp(header.magic, kCompressedMeshMagic, sizeof(kCompressedMeshMagic)) != 0 ||
+        header.version != kCompressedMeshVersion)
+    {
+        throw std::runtime_error("compressed mesh: not a version 1 .qmesh file");
+    }
+    const int positionBits = static_cast<int>(header.positionBits);
+    const int normalBits = static_cast<int>(header.normalBits);
+    const bool validBits = positionBits >= 4 && positionBits <= 24 &&
+                           (normalBits == 0 || (normalBits >= 4 && normalBits <= 16));
+    const std::uint64_t positionsOffset = sizeof(CompressedMeshHeader);
+    const std::uint64_t positionBytes = PackedBytes(header.pointCount * 3, positionBits);
+    const std::uint64_t normalBytes =
+        normalBits ? PackedBytes(header.pointCount * 2, normalBits) : 0;
+    const std::uint64_t tableBytes = std::uint64_t(header.blockCount) * sizeof(CompressedMeshBlock);
+    if (!validBits || header.size != size ||
+        header.blockCount != (header.polygonCount + kCompressedMeshBlockPolygons - 1) /
+                                 kCompressedMeshBlockPolygons ||
+        header.normalsOffset < positionsOffset + positionBytes ||
+        header.blocksOffset < header.normalsOffset + normalBytes ||
+        header.polygonsOffset < header.blocksOffset + tableBytes || header.polygonsOffset > size)
+    {
+        throw std::runtime_error("compressed mesh: corrupt header");
+    }
+    std::vector<CompressedMeshBlock> table(header.blockCount);
+    if (!table.empty())
+    {
+        std::memcpy(table.data(), data + header.blocksOffset,
+                    table.size() * sizeof(CompressedMeshBlock));
+    }
+
+    const auto numPoints = static_cast<vtkIdType>(header.pointCount);
+    const auto numPolys = static_cast<vtkIdType>(header.polygonCount);
+    const auto numIds = static_cast<vtkIdType>(header.connectivitySize);
+
+    // Positions: one unaligned load, shift and mask per coordinate
+    auto coords = vtkSmartPointer<vtkFloatArray>::New();
+    coords->SetNumberOfComponents(3);
+    coords->SetNumberOfTuples(numPoints);
+    float *xyz = coords->GetPointer(0);
+    const char *packedPositions = data + positionsOffset;
+    const std::uint32_t positionMask = (1u << positionBits) - 1;
+    const double origin[3] = {header.origin[0], header.origin[1], header.origin[2]};
+    const double scale[3] = {header.scale[0], header.scale[1], header.scale[2]};
+    vtkSMPTools::For(0, numPoints, [&](vtkIdType begin, vtkIdType end) {
+        for (vtkIdType i = begin; i < end; ++i)
+        {
+            const std::uint64_t bit = static_cast<std::uint64_t>(i) * 3 * positionBits;
+            for (int k = 0; k < 3; ++k)
+            {
+                const std::uint32_t q = ReadField(packedPositions, bit + k * positionBits,
+                                                  positionMask);
+                xyz[3 * i + k] = static_cast<float>(origin[k] + scale[k] * q);
+            }
+        }
+    });
+    auto points = vtkSmartPointer<vtkPoints>::New();
+    points->SetData(coords);
+    auto poly = vtkSmartPointer<vtkPolyData>::New();
+    poly->SetPoints(points);
+
+    if (normalBits)
+    {
+        auto normals = vtkSmartPointer<vtkFloatArray>::New();
+        normals->SetName("Normals");
+        normals->SetNumberOfComponents(3);
+        normals->SetNumberOfTuples(numPoints);
+        float *n = normals->GetPointer(0);
+        const char *packedNormals = data + header.normalsOffset;
+        const std::uint32_t normalMask = (1u << normalBits) - 1;
+        const double step = 2.0 / normalMask;
+        vtkSMPTools::For(0, numPoints, [&](vtkIdType begin, vtkIdType end) {
+            for (vtkIdType i = begin; i < end; ++i)
+            {
+                const std::uint64_t bit = static_cast<std::uint64_t>(i) * 2 * normalBits;
+                double u = ReadField(packedNormals, bit, normalMask) * step - 1.0;
+                double v = ReadField(packedNormals, bit + normalBits, normalMask) * step - 1.0;
+                const double w = 1.0 - std::abs(u) - std::abs(v);
+                // Unfold the lower hemisphere without branching
+                const double t = std::max(-w, 0.0);
+                u -= std::copysign(t, u);
+                v -= std::copysign(t, v);
+                const double length = std::sqrt(u * u + v * v + w * w);
+                n[3 * i] = static_cast<float>(u / length);
+                n[3 * i + 1] = static_cast<float>(v / length);
+                n[3 * i + 2] = static_cast<float>(w / length);
+            }
+        });
+        poly->GetPointData()->SetNormals(normals);
+    }
+
+    if (numPolys == 0)
+    {
+        return poly;
+    }
+    auto offsets = vtkSmartPointer<vtkIdTypeArray>::New();
+    offsets->SetNumberOfValues(numPolys + 1);
+    auto connectivity = vtkSmartPointer<vtkIdTypeArray>::New();
+    connectivity->SetNumberOfValues(numIds);
+    vtkIdType *off = offsets->GetPointer(0);
+    vtkIdType *conn = connectivity->GetPointer(0);
+    off[numPolys] = numIds;
+    const char *polygons = data + header.polygonsOffset;
+    const std::uint64_t polygonBytes = size - header.polygonsOffset;
+    // Blocks are contiguous from the start, each ending where the next one
+    // begins, so that every id is written
+    std::atomic<bool> corrupt(table.empty() || table[0].byteOffset != 0 ||
+                              table[0].connectivityOffset != 0);
+    vtkSMPTools::For(0, static_cast<vtkIdType>(table.size()), [&](vtkIdType begin,
+                                                                  vtkIdType end) {
+        for (vtkIdType block = begin; block < end && !corrupt; ++block)
+        {
+            const auto first = static_cast<vtkIdType>(block * kCompressedMeshBlockPolygons);
+            const vtkIdType last =
+                std::min(numPolys, first + static_cast<vtkIdType>(kCompressedMeshBlockPolygons));
+            const std::uint64_t idsEnd = static_cast<std::size_t>(block) + 1 < table.size()
+                                             ? table[block + 1].connectivityOffset
+                                             : header.connectivitySize;
+            const std::uint64_t bytesEnd = static_cast<std::size_t>(block) + 1 < table.size()
+                                               ? table[block + 1].byteOffset
+                                               : polygonBytes;
+            if (table[block].byteOffset > bytesEnd || bytesEnd > polygonBytes ||
+                table[block].connectivityOffset > idsEnd || idsEnd > header.connectivitySize)
+            {
+                corrupt = true;
+                break;
+            }
+            const char *p = polygons + table[block].byteOffset;
+            const char *pEnd = polygons + bytesEnd;
+            auto id = static_cast<vtkIdType>(table[block].connectivityOffset);
+            const auto idEnd = static_cast<vtkIdType>(idsEnd);
+            std::int64_t previous = 0;
+            bool ok = true;
+            for (vtkIdType cell = first; ok && cell < last; ++cell)
+            {
+                off[cell] = id;
+                std::uint64_t npts = 0;
+                ok = GetVarint(p, pEnd, npts) && npts <= static_cast<std::uint64_t>(idEnd - id);
+                for (std::uint64_t i = 0; ok && i < npts; ++i)
+                {
+                    std::uint64_t delta = 0;
+                    ok = GetVarint(p, pEnd, delta);
+                    previous += UnZigZag(delta);
+                    ok = ok && previous >= 0 && previous < numPoints;
+                    conn[id++] = previous;
+                }
+            }
+            if (!ok || id != idEnd)
+            {
+                corrupt = true;
+            }
+        }
+    });
+    if (corrupt)
+    {
+        throw std::runtime_error("compressed mesh: corrupt polygon data");
+    }
+    auto polys = vtkSmartPointer<vtkCellArray>::New();
+    polys->SetData(offsets, connectivity);
+    poly->SetPolys(polys);
+    return poly;
+}
+
+void WriteCompressedMesh(vtkPolyData *mesh, const std::string &path,
+                         const CompressedMeshOptions &options)
+{
+    const std::vector<char> data = EncodeCompressedMesh(mesh, options);
+    std::ofstream out(path, std::ios::binary);
+    out.write(data.data(), static_cast<std::streamsize>(data.size()));
+    if (!out)
+    {
+        throw std::runtime_error("cannot write " + path);
+    }
+}
+
+vtkSmartPointer<vtkPolyData> ReadCompressedMesh(const std::string &path)
+{
+    MappedFile file(path);
+    file.AdviseSequential();
+    return DecodeCompressedMesh(file.data(), file.size());
+}
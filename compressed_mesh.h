@@ -0,0 +1,75 @@
+#pragma once
+
+#include <vtkPolyData.h>
+#include <vtkSmartPointer.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Quantized, compressed mesh file (.qmesh) for surfaces that are cached and
+// loaded back for the mapper.
+//
+// Layout: a CompressedMeshHeader, then the positions quantized over their
+// bounding box to header.positionBits per coordinate and bit-packed, then the
+// point normals (if any) octahedral-encoded to header.normalBits per
+// component and bit-packed, then header.blockCount CompressedMeshBlock
+// entries, then the polygon blocks. A block holds up to
+// kCompressedMeshBlockPolygons polygons as varints: the size of each polygon
+// followed by its point ids, each as the zigzag-encoded difference to the
+// previous id in the block. Fixed-width fields and independent blocks let
+// every part decode in parallel. Only polygons are stored.
+
+constexpr char kCompressedMeshMagic[8] = {'S', 'V', 'E', 'Q', 'M', 'S', 'H', '\0'};
+constexpr std::uint32_t kCompressedMeshVersion = 1;
+constexpr std::uint64_t kCompressedMeshBlockPolygons = 16384;
+
+struct CompressedMeshHeader
+{
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t positionBits;
+    std::uint32_t normalBits; // 0 if there are no normals
+    std::uint32_t blockCount;
+    std::uint64_t pointCount;
+    std::uint64_t polygonCount;
+    std::uint64_t connectivitySize; // point ids over all polygons
+    double origin[3];               // position = origin + scale * quantized
+    double scale[3];
+    std::uint64_t normalsOffset;  // byte offsets from the start of the file
+    std::uint64_t blocksOffset;
+    std::uint64_t polygonsOffset;
+    std::uint64_t size;           // of the whole file
+};
+
+struct CompressedMeshBlock
+{
+    std::uint64_t byteOffset;         // of the block, from header.polygonsOffset
+    std::uint64_t connectivityOffset; // of the block's first point id
+};
+
+struct CompressedMeshOptions
+{
+    // Bits per position coordinate, 4 to 24; the error is at most half a
+    // step of the bounding box divided into 2^positionBits - 1 steps
+    int positionBits = 16;
+    // Bits per octahedral normal component, 4 to 16, or 0 to drop normals
+    int normalBits = 12;
+};
+
+// Encodes the points, point normals and polygons of mesh. Throws
+// std::invalid_argument if the options are out of range.
+std::vector<char> EncodeCompressedMesh(vtkPolyData *mesh,
+                                      const CompressedMeshOptions &options = {});
+
+// Decodes an encoded mesh into float32 points and normals. Throws
+// std::runtime_error if the data is not a valid encoding.
+vtkSmartPointer<vtkPolyData> DecodeCompressedMesh(const char *data, std::size_t size);
+
+// Encodes mesh into a .qmesh file. Throws std::runtime_error on I/O errors.
+void WriteCompressedMesh(vtkPolyData *mesh, const std::string &path,
+                         const CompressedMeshOptions &options = {});
+
+// Maps a .qmesh file and decodes it.
+vtkSmartPointer<vtkPolyData> ReadCompressedMesh(const std::string &path);
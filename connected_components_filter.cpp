@@ -0,0 +1,345 @@
+#include "connected_components_filter.h"
+
+#include "array_dispatch.h"
+#include "mesh_topology.h"
+
+#include <vtkCellArray.h>
+#include <vtkCellData.h>
+#include <vtkIdList.h>
+#include <vtkIdTypeArray.h>
+#include <vtkInformation.h>
+#include <vtkInformationVector.h>
+#include <vtkObjectFactory.h>
+#include <vtkPointData.h>
+#include <vtkPoints.h>
+#include <vtkPolyData.h>
+#include <vtkSMPTools.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <numeric>
+#include <utility>
+#include <vector>
+
+vtkStandardNewMacro(ConnectedComponentsFilter);
+
+namespace
+{
+
+using Parents = std::vector<std::atomic<vtkIdType>>;
+
+// Root of the set of id, halving the path on the way
+vtkIdType Find(Parents &parents, vtkIdType id)
+{
+    while (true)
+    {
+        vtkIdType parent = parents[id].load(std::memory_order_relaxed);
+        if (parent == id)
+        {
+            return id;
+        }
+        const vtkIdType grandparent = parents[parent].load(std::memory_order_relaxed);
+        if (grandparent != parent)
+        {
+            parents[id].compare_exchange_weak(parent, grandparent, std::memory_order_relaxed);
+        }
+        id = grandparent;
+    }
+}
+
+// Links the larger root below the smaller one; a root that another thread
+// linked first is looked up again
+void Unite(Parents &parents, vtkIdType a, vtkIdType b)
+{
+    while (true)
+    {
+        a = Find(parents, a);
+        b = Find(parents, b);
+        if (a == b)
+        {
+            return;
+        }
+        if (a < b)
+        {
+            std::swap(a, b);
+        }
+        vtkIdType expected = a;
+        if (parents[a].compare_exchange_strong(expected, b, std::memory_order_relaxed))
+        {
+            return;
+        }
+    }
+}
+
+vtkSmartPointer<vtkIdList> NewIdList(const std::vector<vtkIdType> &ids)
+{
+    auto list = vtkSmartPointer<vtkIdList>::New();
+    list->SetNumberOfIds(static_cast<vtkIdType>(ids.size()));
+    std::copy(ids.begin(), ids.end(), list->GetPointer(0));
+    return list;
+}
+
+// Id lists 0, 1, 2, ... of count ids
+vtkSmartPointer<vtkIdList> NewSequentialIdList(vtkIdType count)
+{
+    auto list = vtkSmartPointer<vtkIdList>::New();
+    list->SetNumberOfIds(count);
+    std::iota(list->GetPointer(0), list->GetPointer(0) + count, vtkIdType(0));
+    return list;
+}
+
+} // namespace
+
+void ConnectedComponentsFilter::SetLargestComponents(int count)
+{
+    count = std::max(count, 0);
+    if (largestComponents_ != count)
+    {
+        largestComponents_ = count;
+        this->Modified();
+    }
+}
+
+void ConnectedComponentsFilter::SetMinimumArea(double area)
+{
+    area = std::max(area, 0.0);
+    if (minimumArea_ != area)
+    {
+        minimumArea_ = area;
+        this->Modified();
+    }
+}
+
+int ConnectedComponentsFilter::RequestData(vtkInformation *, vtkInformationVector **inputVector,
+                                           vtkInformationVector *outputVector)
+{
+    vtkPolyData *input = vtkPolyData::GetData(inputVector[0]);
+    vtkPolyData *output = vtkPolyData::GetData(outputVector);
+    numberOfComponents_ = numberOfKeptComponents_ = 0;
+
+    const vtkIdType numPoints = input->GetNumberOfPoints();
+    const vtkIdType numPolys = input->GetNumberOfPolys();
+    if (numPoints == 0 || numPolys == 0)
+    {
+        return 1;
+    }
+    const MeshTopology &topology = *MeshTopology::Get(input);
+
+    Parents parents(numPoints);
+    vtkSMPTools::For(0, numPoints, [&](vtkIdType begin, vtkIdType end) {
+        for (vtkIdType id = begin; id < end; ++id)
+        {
+            parents[id].store(id, std::memory_order_relaxed);
+        }
+    });
+    vtkSMPTools::For(0, static_cast<vtkIdType>(topology.edges.size()),
+                     [&](vtkIdType begin, vtkIdType end) {
+                         for (vtkIdType e = begin; e < end; ++e)
+                         {
+                             Unite(parents, topology.edges[e].first, topology.edges[e].second);
+                         }
+                     });
+
+    // Number the components in the order of their smallest point, which is
+    // their root
+    std::vector<vtkIdType> roots(numPoints);
+    vtkSMPTools::For(0, numPoints, [&](vtkIdType begin, vtkIdType end) {
+        for (vtkIdType id = begin; id < end; ++id)
+        {
+            roots[id] = Find(parents, id);
+        }
+    });
+    parents = Parents();
+    std::vector<vtkIdType> componentOf(numPoints + 1, 0);
+    for (vtkIdType id = 0; id < numPoints; ++id)
+    {
+        const bool used = topology.faceOffsets[id] < topology.faceOffsets[id + 1];
+        componentOf[id + 1] = componentOf[id] + (roots[id] == id && used ? 1 : 0);
+    }
+    const vtkIdType numComponents = componentOf[numPoints];
+
+    // Polygon areas (Newell's method), grouped by component
+    vtkPoints *inPoints = input->GetPoints();
+    std::vector<std::pair<vtkIdType, double>> polygonAreas(numPolys);
+    array_dispatch::DispatchReal(inPoints->GetData(), [&](auto xyz) {
+        vtkSMPTools::For(0, numPolys, [&](vtkIdType begin, vtkIdType end) {
+            for (vtkIdType cell = begin; cell < end; ++cell)
+            {
+                const vtkIdType c0 = topology.cornerOffsets[cell];
+                const vtkIdType c1 = topology.cornerOffsets[cell + 1];
+                if (c0 == c1)
+                {
+                    // Empty polygons belong to no component
+                    polygonAreas[cell] = {numComponents, 0.0};
+                    continue;
+                }
+                double normal[3] = {0.0, 0.0, 0.0};
+                double p[3], q[3];
+                xyz.GetTuple(topology.corners[c1 - 1], p);
+                for (vtkIdType c = c0; c < c1; ++c)
+                {
+                    xyz.GetTuple(topology.corners[c], q);
+                    normal[0] += (p[1] - q[1]) * (p[2] + q[2]);
+                    normal[1] += (p[2] - q[2]) * (p[0] + q[0]);
+                    normal[2] += (p[0] - q[0]) * (p[1] + q[1]);
+                    std::copy(q, q + 3, p);
+                }
+                const vtkIdType root = roots[topology.corners[c0]];
+                polygonAreas[cell] = {componentOf[root],
+                                      0.5 * std::sqrt(normal[0] * normal[0] +
+                                                      normal[1] * normal[1] +
+                                                      normal[2] * normal[2])};
+            }
+        });
+    });
+    vtkSMPTools::Sort(polygonAreas.begin(), polygonAreas.end());
+
+    // Sorted positions start the components between the one before and their own
+    std::vector<vtkIdType> areaOffsets(numComponents + 1);
+    vtkSMPTools::For(0, numPolys + 1, [&](vtkIdType begin, vtkIdType end) {
+        for (vtkIdType i = begin; i < end; ++i)
+        {
+            const vtkIdType low = i == 0 ? 0 : polygonAreas[i - 1].first + 1;
+            const vtkIdType high =
+                i == numPolys ? numComponents : std::min(polygonAreas[i].first, numComponents);
+            for (vtkIdType component = low; component <= high; ++component)
+            {
+                areaOffsets[component] = i;
+            }
+        }
+    });
+    std::vector<double> componentAreas(numComponents);
+    vtkSMPTools::For(0, numComponents, [&](vtkIdType begin, vtkIdType end) {
+        for (vtkIdType component = begin; component < end; ++component)
+        {
+            double area = 0.0;
+            for (vtkIdType i = areaOffsets[component]; i < areaOffsets[component + 1]; ++i)
+            {
+                area += polygonAreas[i].second;
+            }
+            componentAreas[component] = area;
+        }
+    });
+    polygonAreas = {};
+
+    // The largest components with enough area, ties to the first
+    std::vector<vtkIdType> ranked;
+    for (vtkIdType component = 0; component < numComponents; ++component)
+    {
+        if (componentAreas[component] >= minimumArea_)
+        {
+            ranked.push_back(component);
+        }
+    }
+    const std::size_t kept = largestComponents_ == 0
+                                 ? ranked.size()
+                                 : std::min<std::size_t>(ranked.size(), largestComponents_);
+    std::partial_sort(ranked.begin(), ranked.begin() + kept, ranked.end(),
+                      [&](vtkIdType a, vtkIdType b) {
+                          return componentAreas[a] > componentAreas[b] ||
+                                 (componentAreas[a] == componentAreas[b] && a < b);
+                      });
+    std::vector<std::uint8_t> keep(numComponents + 1, 0);
+    for (std::size_t i = 0; i < kept; ++i)
+    {
+        keep[ranked[i]] = 1;
+    }
+    numberOfComponents_ = numComponents;
+    numberOfKeptComponents_ = static_cast<vtkIdType>(kept);
+
+    // Kept points and polygons with their new ids
+    std::vector<vtkIdType> pointIds;
+    std::vector<vtkIdType> newPointIds(numPoints, -1);
+    for (vtkIdType id = 0; id < numPoints; ++id)
+    {
+        if (topology.faceOffsets[id] < topology.faceOffsets[id + 1] &&
+            keep[componentOf[roots[id]]])
+        {
+            newPointIds[id] = static_cast<vtkIdType>(pointIds.size());
+            pointIds.push_back(id);
+        }
+    }
+    std::vector<vtkIdType> cellIds;
+    std::vector<vtkIdType> newOffsets(1, 0);
+    for (vtkIdType cell = 0; cell < numPolys; ++cell)
+    {
+        const vtkIdType c0 = topology.cornerOffsets[cell];
+        const vtkIdType c1 = topology.cornerOffsets[cell + 1];
+        if (c0 < c1 && keep[componentOf[roots[topology.corners[c0]]]])
+        {
+            cellIds.push_back(cell);
+            newOffsets.push_back(newOffsets.back() + c1 - c0);
+        }
+    }
+
+    const vtkIdType numOutPoints = static_cast<vtkIdType>(pointIds.size());
+    const vtkIdType numOutPolys = static_cast<vtkIdType>(cellIds.size());
+    auto points = vtkSmartPointer<vtkPoints>::New();
+    points->SetDataType(inPoints->GetDataType());
+    points->SetNumberOfPoints(numOutPoints);
+    array_dispatch::DispatchReal(inPoints->GetData(), [&](auto from) {
+        // The output has the type of the input and the default layout
+        using Value = typename decltype(from)::ValueType;
+        auto *to = vtkAOSDataArrayTemplate<Value>::FastDownCast(points->GetData());
+        Value *out = to ? to->GetPointer(0) : nullptr;
+        vtkSMPTools::For(0, numOutPoints, [&](vtkIdType begin, vtkIdType end) {
+            for (vtkIdType id = begin; id < end; ++id)
+            {
+                if (out)
+                {
+                    from.GetTuple(pointIds[id], out + 3 * id);
+                    continue;
+                }
+                double p[3];
+                from.GetTuple(pointIds[id], p);
+                points->SetPoint(id, p);
+            }
+        });
+    });
+
+    auto offsets = vtkSmartPointer<vtkIdTypeArray>::New();
+    offsets->SetNumberOfValues(numOutPolys + 1);
+    std::copy(newOffsets.begin(), newOffsets.end(), offsets->GetPointer(0));
+    auto connectivity = vtkSmartPointer<vtkIdTypeArray>::New();
+    connectivity->SetNumberOfValues(newOffsets.back());
+    vtkIdType *conn = connectivity->GetPointer(0);
+    vtkSMPTools::For(0, numOutPolys, [&](vtkIdType begin, vtkIdType end) {
+        for (vtkIdType cell = begin; cell < end; ++cell)
+        {
+            const vtkIdType c0 = topology.cornerOffsets[cellIds[cell]];
+            const vtkIdType c1 = topology.cornerOffsets[cellIds[cell] + 1];
+            for (vtkIdType c = c0; c < c1; ++c)
+            {
+                conn[newOffsets[cell] + c - c0] = newPointIds[topology.corners[c]];
+            }
+        }
+    });
+    auto polys = vtkSmartPointer<vtkCellArray>::New();
+    polys->SetData(offsets, connectivity);
+    output->SetPoints(points);
+    output->SetPolys(polys);
+
+    // Attributes of the kept points and polygons; polygon ids in the input
+    // come after the verts and lines
+    const vtkIdType firstPoly = input->GetNumberOfVerts() + input->GetNumberOfLines();
+    std::transform(cellIds.begin(), cellIds.end(), cellIds.begin(),
+                   [&](vtkIdType cell) { return cell + firstPoly; });
+    output->GetPointData()->CopyAllocate(input->GetPointData(), numOutPoints);
+    output->GetPointData()->CopyData(input->GetPointData(), NewIdList(pointIds),
+                                     NewSequentialIdList(numOutPoints));
+    output->GetCellData()->CopyAllocate(input->GetCellData(), numOutPolys);
+    output->GetCellData()->CopyData(input->GetCellData(), NewIdList(cellIds),
+                                    NewSequentialIdList(numOutPolys));
+    return 1;
+}
+
+void ConnectedComponentsFilter::PrintSelf(ostream &os, vtkIndent indent)
+{
+    this->Superclass::PrintSelf(os, indent);
+    os << indent << "Largest components: " << largestComponents_ << "\n";
+    os << indent << "Minimum area: " << minimumArea_ << "\n";
+    os << indent << "Components: " << numberOfComponents_ << " (" << numberOfKeptComponents_
+       << " kept)\n";
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <vtkPolyDataAlgorithm.h>
+#include <vtkType.h>
+
+// Keeps the largest connected components of the polygons of a mesh, the
+// extraction vtkPolyDataConnectivityFilter does for its largest region, run
+// in parallel to drop the small islands of noisy isosurfaces.
+//
+// Components are labelled by a lock-free union-find over the edges of the
+// MeshTopology cache, so polygons sharing a point are connected. They are
+// ranked by area; the output keeps the polygons of the LargestComponents
+// largest ones with at least MinimumArea, in input order, and only the points
+// they use. Verts, lines and strips are dropped.
+class ConnectedComponentsFilter : public vtkPolyDataAlgorithm
+{
+public:
+    static ConnectedComponentsFilter *New();
+    vtkTypeMacro(ConnectedComponentsFilter, vtkPolyDataAlgorithm);
+    void PrintSelf(ostream &os, vtkIndent indent) override;
+
+    // Number of components kept, 0 for all that pass MinimumArea (1)
+    void SetLargestComponents(int count);
+    int GetLargestComponents() const { return largestComponents_; }
+
+    // Smallest area of a kept component (0)
+    void SetMinimumArea(double area);
+    double GetMinimumArea() const { return minimumArea_; }
+
+    // Components in the input and in the output of the last update
+    vtkIdType GetNumberOfComponents() const { return numberOfComponents_; }
+    vtkIdType GetNumberOfKeptComponents() const { return numberOfKeptComponents_; }
+
+protected:
+    ConnectedComponentsFilter() = default;
+    ~ConnectedComponentsFilter() override = default;
+
+    int RequestData(vtkInformation *request, vtkInformationVector **inputVector,
+                    vtkInformationVector *outputVector) override;
+
+private:
+    ConnectedComponentsFilter(const ConnectedComponentsFilter &) = delete;
+    void operator=(const ConnectedComponentsFilter &) = delete;
+
+    int largestComponents_ = 1;
+    double minimumArea_ = 0.0;
+    vtkIdType numberOfComponents_ = 0;
+    vtkIdType numberOfKeptComponents_ = 0;
+};
@@ -0,0 +1,409 @@
+#include "dicom_catalog.h"
+
+#include <vtkDICOMMetaData.h>
+#include <vtkDICOMParser.h>
+#include <vtkDICOMReader.h>
+#include <vtkDICOMUtilities.h>
+#include <vtkMath.h>
+#include <vtkSMPTools.h>
+#include <vtkStringArray.h>
+#include <vtkType.h>
+
+#include <gdcmImage.h>
+#include <gdcmImageReader.h>
+#include <gdcmPixelFormat.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <istream>
+#include <map>
+#include <set>
+#include <stdexcept>
+#include <streambuf>
+#include <tuple>
+#include <utility>
+
+namespace
+{
+
+// Read-only, seekable stream over a file that is already in memory, so that
+// GDCM can decode it without touching the file again
+class MemoryStreamBuffer : public std::streambuf
+{
+public:
+    MemoryStreamBuffer(const char *data, std::size_t size)
+    {
+        char *begin = const_cast<char *>(data);
+        setg(begin, begin, begin + size);
+    }
+
+protected:
+    pos_type seekoff(off_type offset, std::ios_base::seekdir direction,
+                     std::ios_base::openmode which) override
+    {
+        if (!(which & std::ios_base::in))
+        {
+            return pos_type(off_type(-1));
+        }
+        char *base = direction == std::ios_base::beg   ? eback()
+                     : direction == std::ios_base::cur ? gptr()
+                                                       : egptr();
+        if (offset < eback() - base || offset > egptr() - base)
+        {
+            return pos_type(off_type(-1));
+        }
+        setg(eback(), base + offset, egptr());
+        return pos_type(gptr() - eback());
+    }
+
+    pos_type seekpos(pos_type position, std::ios_base::openmode which) override
+    {
+        return seekoff(off_type(position), std::ios_base::beg, which);
+    }
+};
+
+// Pixels and geometry of one decoded file
+struct DecodedSlice
+{
+    int columns = 0;
+    int rows = 0;
+    int scalarType = VTK_VOID;
+    std::size_t pixelSize = 0;
+    double spacing[3] = {1.0, 1.0, 1.0};
+    double position[3] = {0.0, 0.0, 0.0};
+    double orientation[6] = {1.0, 0.0, 0.0, 0.0, 1.0, 0.0};
+    double slope = 1.0;       // RescaleSlope
+    double intercept = 0.0;   // RescaleIntercept
+    std::vector<char> pixels; // rows top-down, as stored
+};
+
+// VTK type of the stored values, VTK_VOID for types VTK has no array for
+int ScalarType(const gdcm::PixelFormat &format)
+{
+    switch (format.GetScalarType())
+    {
+    case gdcm::PixelFormat::UINT8:
+        return VTK_UNSIGNED_CHAR;
+    case gdcm::PixelFormat::INT8:
+        return VTK_SIGNED_CHAR;
+    case gdcm::PixelFormat::UINT16:
+        return VTK_UNSIGNED_SHORT;
+    case gdcm::PixelFormat::INT16:
+        return VTK_SHORT;
+    case gdcm::PixelFormat::UINT32:
+        return VTK_UNSIGNED_INT;
+    case gdcm::PixelFormat::INT32:
+        return VTK_INT;
+    case gdcm::PixelFormat::FLOAT32:
+        return VTK_FLOAT;
+    case gdcm::PixelFormat::FLOAT64:
+        return VTK_DOUBLE;
+    default:
+        return VTK_VOID;
+    }
+}
+
+DecodedSlice DecodeSlice(const char *data, std::size_t size)
+{
+    MemoryStreamBuffer buffer(data, size);
+    std::istream stream(&buffer);
+    gdcm::ImageReader reader;
+    reader.SetStream(stream);
+    if (!reader.Read())
+    {
+        throw std::runtime_error("cannot decode DICOM image");
+    }
+
+    const gdcm::Image &image = reader.GetImage();
+    const gdcm::PixelFormat &format = image.GetPixelFormat();
+    if (image.GetNumberOfDimensions() != 2 || format.GetSamplesPerPixel() != 1)
+    {
+        throw std::runtime_error("only single-frame images with one sample per pixel are "
+                                 "supported");
+    }
+
+    DecodedSlice slice;
+    slice.columns = static_cast<int>(image.GetDimension(0));
+    slice.rows = static_cast<int>(image.GetDimension(1));
+    slice.scalarType = ScalarType(format);
+    slice.pixelSize = format.GetPixelSize();
+    if (slice.scalarType == VTK_VOID)
+    {
+        throw std::runtime_error("unsupported pixel type");
+    }
+    std::copy_n(image.GetSpacing(), 3, slice.spacing);
+    std::copy_n(image.GetOrigin(), 3, slice.position);
+    std::copy_n(image.GetDirectionCosines(), 6, slice.orientation);
+    slice.slope = image.GetSlope();
+    slice.intercept = image.GetIntercept();
+
+    slice.pixels.resize(image.GetBufferLength());
+    if (slice.pixels.size() < std::size_t(slice.columns) * slice.rows * slice.pixelSize ||
+        !image.GetBuffer(slice.pixels.data()))
+    {
+        throw std::runtime_error("cannot decode pixel data");
+    }
+    return slice;
+}
+
+} // namespace
+
+std::optional<DicomInstance> ParseDicomInstance(const std::string &path, DicomSeries *seriesFields)
+{
+    // Cheap check first so that stray files do not make the parser complain
+    if (!vtkDICOMUtilities::IsDICOMFile(path.c_str()))
+    {
+        return std::nullopt;
+    }
+
+    auto meta = vtkSmartPointer<vtkDICOMMetaData>::New();
+    auto parser = vtkSmartPointer<vtkDICOMParser>::New();
+    parser->SetMetaData(meta);
+    parser->SetFileName(path.c_str());
+    parser->Update();
+    if (parser->GetErrorCode() != 0 || !meta->Has(DC::SeriesInstanceUID))
+    {
+        return std::nullopt;
+    }
+
+    DicomInstance instance;
+    instance.path = path;
+    instance.seriesUID = meta->Get(DC::SeriesInstanceUID).AsString();
+    instance.instanceNumber = meta->Get(DC::InstanceNumber).AsInt();
+    instance.temporalPosition = meta->Get(DC::TemporalPositionIdentifier).AsInt();
+    instance.triggerTime = meta->Get(DC::TriggerTime).AsDouble();
+    const vtkDICOMValue &position = meta->Get(DC::ImagePositionPatient);
+    if (position.GetNumberOfValues() >= 3)
+    {
+        position.GetValues(instance.position, 3);
+        instance.hasPosition = true;
+    }
+
+    if (seriesFields)
+    {
+        seriesFields->uid = instance.seriesUID;
+        seriesFields->description = meta->Get(DC::SeriesDescription).AsString();
+        seriesFields->modality = meta->Get(DC::Modality).AsString();
+        seriesFields->imagesInAcquisition = meta->Get(DC::ImagesInAcquisition).AsInt();
+        seriesFields->temporalPositions = meta->Get(DC::NumberOfTemporalPositions).AsInt();
+    }
+    return instance;
+}
+
+void DicomCatalog::AddDirectory(const std::string &directory)
+{
+    namespace fs = std::filesystem;
+    std::vector<std::string> paths;
+    for (const fs::directory_entry &entry :
+         fs::recursive_directory_iterator(directory, fs::directory_options::skip_permission_denied))
+    {
+        if (entry.is_regular_file())
+        {
+            paths.push_back(entry.path().string());
+        }
+    }
+    std::sort(paths.begin(), paths.end());
+
+    // Header parsing is dominated by file access, so do it for all files at once
+    struct Parsed
+    {
+        std::optional<DicomInstance> instance;
+        DicomSeries fields;
+    };
+    std::vector<Parsed> parsed(paths.size());
+    vtkSMPTools::For(0, static_cast<vtkIdType>(paths.size()), [&](vtkIdType begin, vtkIdType end) {
+        for (vtkIdType i = begin; i < end; ++i)
+        {
+            parsed[i].instance = ParseDicomInstance(paths[i], &parsed[i].fields);
+        }
+    });
+    for (const Parsed &entry : parsed)
+    {
+        if (entry.instance)
+        {
+            AddInstance(*entry.instance, entry.fields);
+        }
+    }
+}
+
+DicomSeries *DicomCatalog::AddFile(const std::string &path)
+{
+    DicomSeries fields;
+    const std::optional<DicomInstance> instance = ParseDicomInstance(path, &fields);
+    return instance ? AddInstance(*instance, fields) : nullptr;
+}
+
+DicomSeries *DicomCatalog::AddInstance(const DicomInstance &instance, const DicomSeries &seriesFields)
+{
+    auto it = std::find_if(series_.begin(), series_.end(),
+                           [&](const DicomSeries &series) { return series.uid == instance.seriesUID; });
+    if (it == series_.end())
+    {
+        DicomSeries series = seriesFields;
+        series.uid = instance.seriesUID;
+        series.instances.clear();
+        series_.push_back(std::move(series));
+        it = series_.end() - 1;
+    }
+    if (paths_.insert(instance.path).second)
+    {
+        it->instances.push_back(instance);
+    }
+    return &*it;
+}
+
+const DicomSeries *DicomCatalog::FindSeries(const std::string &uid) const
+{
+    auto it = std::find_if(series_.begin(), series_.end(),
+                           [&](const DicomSeries &series) { return series.uid == uid; });
+    return it == series_.end() ? nullptr : &*it;
+}
+
+std::vector<std::vector<std::string>> SplitIntoPhases(const DicomSeries &series)
+{
+    std::vector<const DicomInstance *> sorted;
+    for (const DicomInstance &instance : series.instances)
+    {
+        sorted.push_back(&instance);
+    }
+    std::sort(sorted.begin(), sorted.end(), [](const DicomInstance *a, const DicomInstance *b) {
+        return std::tie(a->instanceNumber, a->path) < std::tie(b->instanceNumber, b->path);
+    });
+
+    // Phase key of every instance, by the first criterion that separates them
+    std::vector<double> keys(sorted.size(), 0.0);
+    auto distinct = [&]() { return std::set<double>(keys.begin(), keys.end()).size(); };
+    for (std::size_t i = 0; i < sorted.size(); ++i)
+    {
+        keys[i] = sorted[i]->temporalPosition;
+    }
+    if (distinct() < 2)
+    {
+        for (std::size_t i = 0; i < sorted.size(); ++i)
+        {
+            keys[i] = sorted[i]->triggerTime;
+        }
+    }
+    if (distinct() < 2)
+    {
+        // The n-th occurrence of a slice position belongs to the n-th phase
+        std::map<std::tuple<long long, long long, long long>, int> seen;
+        for (std::size_t i = 0; i < sorted.size(); ++i)
+        {
+            const double *p = sorted[i]->position;
+            const auto key = std::make_tuple(std::llround(p[0] * 1000.0), std::llround(p[1] * 1000.0),
+                                             std::llround(p[2] * 1000.0));
+            keys[i] = sorted[i]->hasPosition ? seen[key]++ : 0;
+        }
+    }
+
+    std::map<double, std::vector<std::string>> phases;
+    for (std::size_t i = 0; i < sorted.size(); ++i)
+    {
+        phases[keys[i]].push_back(sorted[i]->path);
+    }
+    std::vector<std::vector<std::string>> result;
+    for (auto &[key, files] : phases)
+    {
+        result.push_back(std::move(files));
+    }
+    return result;
+}
+
+vtkSmartPointer<vtkImageData> ReadDicomVolume(const std::vector<std::string> &files)
+{
+    auto names = vtkSmartPointer<vtkStringArray>::New();
+    for (const std::string &file : files)
+    {
+        names->InsertNextValue(file);
+    }
+    auto reader = vtkSmartPointer<vtkDICOMReader>::New();
+    reader->SetFileNames(names);
+    reader->Update();
+    if (reader->GetErrorCode() != 0)
+    {
+        throw std::runtime_error("cannot read DICOM volume from " +
+                                 (files.empty() ? std::string("no files") : files.front()));
+    }
+
+    // Detach the volume from the reader so that the reader can go away
+    auto volume = vtkSmartPointer<vtkImageData>::New();
+    volume->ShallowCopy(reader->GetOutput());
+    return volume;
+}
+
+vtkSmartPointer<vtkImageData> ReadDicomVolumeBatched(const std::vector<std::string> &files,
+                                                     const BatchedFileReaderOptions &options)
+{
+    if (files.empty())
+    {
+        throw std::runtime_error("cannot read DICOM volume from no files");
+    }
+
+    std::vector<DecodedSlice> slices(files.size());
+    BatchedFileReader reader(options);
+    reader.ReadAll(files, [&](std::size_t index, const char *data, std::size_t size) {
+        slices[index] = DecodeSlice(data, size);
+    });
+
+    const DecodedSlice &first = slices.front();
+    for (std::size_t i = 1; i < slices.size(); ++i)
+    {
+        if (slices[i].columns != first.columns || slices[i].rows != first.rows ||
+            slices[i].scalarType != first.scalarType)
+        {
+            throw std::runtime_error("slices of different size or type in DICOM volume from " +
+                                     files.front() + " and " + files[i]);
+        }
+        // vtkDICOMReader would bring such slices onto the scale of the first
+        // one; the stored values alone would not be the same volume
+        if (slices[i].slope != first.slope || slices[i].intercept != first.intercept)
+        {
+            throw std::runtime_error("slices with different rescale slope or intercept in DICOM "
+                                     "volume from " +
+                                     files.front() + " and " + files[i] +
+                                     "; read it with vtkDICOMReader (--io-depth 0)");
+        }
+    }
+
+    // Order slices by their distance along the normal of the first one
+    double normal[3];
+    vtkMath::Cross(first.orientation, first.orientation + 3, normal);
+    std::vector<std::pair<double, std::size_t>> order;
+    for (std::size_t i = 0; i < slices.size(); ++i)
+    {
+        order.emplace_back(vtkMath::Dot(slices[i].position, normal), i);
+    }
+    std::stable_sort(order.begin(), order.end(),
+                     [](const auto &a, const auto &b) { return a.first < b.first; });
+    double sliceSpacing = first.spacing[2];
+    if (order.size() > 1 && order.back().first > order.front().first)
+    {
+        sliceSpacing = (order.back().first - order.front().first) / double(order.size() - 1);
+    }
+
+    auto volume = vtkSmartPointer<vtkImageData>::New();
+    volume->SetDimensions(first.columns, first.rows, static_cast<int>(slices.size()));
+    volume->SetSpacing(first.spacing[0], first.spacing[1], sliceSpacing);
+    volume->AllocateScalars(first.scalarType, 1);
+
+    char *scalars = static_cast<char *>(volume->GetScalarPointer());
+    const std::size_t rowBytes = std::size_t(first.columns) * first.pixelSize;
+    const std::size_t sliceBytes = rowBytes * first.rows;
+    vtkSMPTools::For(0, static_cast<vtkIdType>(order.size()), [&](vtkIdType begin, vtkIdType end) {
+        for (vtkIdType k = begin; k < end; ++k)
+        {
+            std::vector<char> &pixels = slices[order[k].second].pixels;
+            char *target = scalars + std::size_t(k) * sliceBytes;
+            for (int row = 0; row < first.rows; ++row)
+            {
+                std::memcpy(target + std::size_t(first.rows - 1 - row) * rowBytes,
+                            pixels.data() + std::size_t(row) * rowBytes, rowBytes);
+            }
+            std::vector<char>().swap(pixels);
+        }
+    });
+    return volume;
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include "batched_file_reader.h"
+
+#include <vtkImageData.h>
+#include <vtkSmartPointer.h>
+
+#include <deque>
+#include <optional>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+// Header fields of one DICOM file that the catalog groups and sorts by
+struct DicomInstance
+{
+    std::string path;
+    std::string seriesUID;
+    int instanceNumber = 0;
+    int temporalPosition = 0; // TemporalPositionIdentifier, 0 if absent
+    double triggerTime = 0.0; // TriggerTime in ms, 0 if absent
+    double position[3] = {0.0, 0.0, 0.0};
+    bool hasPosition = false;
+};
+
+struct DicomSeries
+{
+    std::string uid;
+    std::string description;
+    std::string modality;
+    // Expected slices (ImagesInAcquisition) or phases (NumberOfTemporalPositions), 0 if unknown
+    int imagesInAcquisition = 0;
+    int temporalPositions = 0;
+    std::vector<DicomInstance> instances;
+};
+
+// Reads the header of one file with vtkDICOMParser. Returns nothing if the
+// file is not DICOM or has no SeriesInstanceUID.
+std::optional<DicomInstance> ParseDicomInstance(const std::string &path,
+                                                DicomSeries *seriesFields = nullptr);
+
+// Series found in a set of files, in the order they were first seen. Series
+// pointers stay valid while files are added.
+class DicomCatalog
+{
+public:
+    // Parses the headers of every file under directory (recursively) in
+    // parallel; files that are not DICOM are skipped.
+    void AddDirectory(const std::string &directory);
+
+    // Adds one file and returns the series it joined, or nullptr if the file
+    // is not DICOM. Adding the same path twice is a no-op.
+    DicomSeries *AddFile(const std::string &path);
+    DicomSeries *AddInstance(const DicomInstance &instance, const DicomSeries &seriesFields);
+
+    const std::deque<DicomSeries> &GetSeries() const { return series_; }
+    const DicomSeries *FindSeries(const std::string &uid) const;
+
+private:
+    std::deque<DicomSeries> series_;
+    std::unordered_set<std::string> paths_;
+};
+
+// Splits the files of a series into time phases, ordered in time, with each
+// phase sorted by InstanceNumber. Phases come from TemporalPositionIdentifier,
+// else from TriggerTime, else from repeated slice positions; a series without
+// any of these is a single phase.
+std::vector<std::vector<std::string>> SplitIntoPhases(const DicomSeries &series);
+
+// Reads a volume from the files of one phase with vtkDICOMReader, which sorts
+// the slices spatially. Throws std::runtime_error if the files cannot be read.
+vtkSmartPointer<vtkImageData> ReadDicomVolume(const std::vector<std::string> &files);
+
+// Reads the stored values of a volume like ReadDicomVolume, but fetches the
+// files with a BatchedFileReader and decodes each one with GDCM on the
+// reader's worker threads as soon as it is in memory. Slices are sorted along
+// their normal by ImagePositionPatient and rows are stored bottom-up, as
+// vtkDICOMReader does. Only single-frame, single-sample slices of one size,
+// type and rescale slope and intercept are supported, since vtkDICOMReader
+// rescales slices that differ; throws std::runtime_error otherwise or if a
+// file cannot be read.
+vtkSmartPointer<vtkImageData> ReadDicomVolumeBatched(const std::vector<std::string> &files,
+                                                     const BatchedFileReaderOptions &options = {});
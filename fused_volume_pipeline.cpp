@@ -0,0 +1,674 @@
+#include "fused_volume_pipeline.h"
+#include "array_dispatch.h"
+#include "isosurface.h"
+
+#include <vtkAlgorithm.h>
+#include <vtkCellArray.h>
+#include <vtkFloatArray.h>
+#include <vtkFlyingEdges3D.h>
+#include <vtkIdTypeArray.h>
+#include <vtkImageCast.h>
+#include <vtkImageGaussianSmooth.h>
+#include <vtkImageThreshold.h>
+#include <vtkMatrix3x3.h>
+#include <vtkPointData.h>
+#include <vtkPoints.h>
+#include <vtkSMPTools.h>
+#include <vtkType.h>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <map>
+#include <stdexcept>
+#include <utility>
+
+namespace
+{
+
+// Taps of the Gaussian vtkImageGaussianSmooth uses: radius = sigma * factor
+// rounded down, normalized to sum to one
+std::vector<float> GaussianWeights(const VolumeStage &stage)
+{
+    const int radius = static_cast<int>(stage.sigma * stage.radiusFactor);
+    std::vector<double> taps(2 * std::size_t(radius) + 1);
+    double sum = 0.0;
+    for (int i = -radius; i <= radius; ++i)
+    {
+        taps[i + radius] = std::exp(-0.5 * double(i) * i / (stage.sigma * stage.sigma));
+        sum += taps[i + radius];
+    }
+    std::vector<float> weights(taps.size());
+    for (std::size_t i = 0; i < taps.size(); ++i)
+    {
+        weights[i] = static_cast<float>(taps[i] / sum);
+    }
+    return weights;
+}
+
+// Kernel of two convolutions in a row
+std::vector<float> Convolve(const std::vector<float> &a, const std::vector<float> &b)
+{
+    std::vector<float> result(a.size() + b.size() - 1, 0.0f);
+    for (std::size_t i = 0; i < a.size(); ++i)
+    {
+        for (std::size_t j = 0; j < b.size(); ++j)
+        {
+            result[i + j] += a[i] * b[j];
+        }
+    }
+    return result;
+}
+
+void ApplyThresholds(const std::vector<VolumeStage> &stages, float *row, int n)
+{
+    for (const VolumeStage &stage : stages)
+    {
+        const float lower = static_cast<float>(stage.lower);
+        const float upper = static_cast<float>(stage.upper);
+        const float outside = static_cast<float>(stage.outsideValue);
+        for (int i = 0; i < n; ++i)
+        {
+            row[i] = row[i] >= lower && row[i] <= upper ? row[i] : outside;
+        }
+    }
+}
+
+// out = sum of weights[t] * rows[t] over the rows that exist, renormalized
+// when the volume boundary cuts the kernel off
+void WeightedSum(const float *const *rows, const float *weights, int taps, float *out, int n)
+{
+    float sum = 0.0f;
+    bool first = true;
+    for (int t = 0; t < taps; ++t)
+    {
+        if (!rows[t])
+        {
+            continue;
+        }
+        sum += weights[t];
+        const float *row = rows[t];
+        const float w = weights[t];
+        if (first)
+        {
+            for (int i = 0; i < n; ++i)
+            {
+                out[i] = w * row[i];
+            }
+            first = false;
+            continue;
+        }
+        for (int i = 0; i < n; ++i)
+        {
+            out[i] += w * row[i];
+        }
+    }
+    if (sum < 0.9999f || sum > 1.0001f)
+    {
+        const float scale = 1.0f / sum;
+        for (int i = 0; i < n; ++i)
+        {
+            out[i] *= scale;
+        }
+    }
+}
+
+// Convolution of a row along x, renormalized at both ends
+void SmoothRow(const float *in, const float *weights, int radius, float *out, int n)
+{
+    for (int x = 0; x < n; ++x)
+    {
+        if (x >= radius && x + radius < n)
+        {
+            const float *window = in + x - radius;
+            float value = 0.0f;
+            for (int t = 0; t <= 2 * radius; ++t)
+            {
+                value += weights[t] * window[t];
+            }
+            out[x] = value;
+            continue;
+        }
+        float value = 0.0f;
+        float sum = 0.0f;
+        for (int t = std::max(0, radius - x); t <= 2 * radius && x - radius + t < n; ++t)
+        {
+            value += weights[t] * in[x - radius + t];
+            sum += weights[t];
+        }
+        out[x] = value / sum;
+    }
+}
+
+// Surface of one slab: float xyz and normals per point, three point ids per
+// triangle
+struct SlabSurface
+{
+    std::vector<float> points;
+    std::vector<float> normals;
+    std::vector<vtkIdType> triangles;
+};
+
+void CopyIds(vtkDataArray *ids, std::vector<vtkIdType> &out)
+{
+    out.resize(static_cast<std::size_t>(ids->GetNumberOfValues()));
+    array_dispatch::Dispatch(ids, [&out](auto values) {
+        for (std::size_t i = 0; i < out.size(); ++i)
+        {
+            out[i] = static_cast<vtkIdType>(values.GetValue(static_cast<vtkIdType>(i)));
+        }
+    });
+}
+
+// Runs the compiled chain over the slabs of one volume
+class FusedKernel
+{
+public:
+    FusedKernel(vtkImageData *volume, const std::vector<VolumeStage> &before,
+                const std::vector<float> &weights, const std::vector<VolumeStage> &after,
+                int slabDepth)
+        : before_(before), after_(after), weights_(weights),
+          radius_(static_cast<int>(weights.size() / 2)), slabDepth_(slabDepth)
+    {
+        volume->GetExtent(extent_);
+        volume->GetOrigin(origin_);
+        volume->GetSpacing(spacing_);
+        nx_ = extent_[1] - extent_[0] + 1;
+        ny_ = extent_[3] - extent_[2] + 1;
+        nz_ = extent_[5] - extent_[4] + 1;
+        planeSize_ = std::size_t(nx_) * std::size_t(ny_);
+        read_ = array_dispatch::MakeFloatReader(volume->GetPointData()->GetScalars());
+    }
+
+    int GetNumberOfSlabs() const { return (nz_ - 1 + slabDepth_ - 1) / slabDepth_; }
+
+    // Cell layers of slab, [first, last)
+    std::pair<int, int> LayersOf(int slab) const
+    {
+        const int first = slab * slabDepth_;
+        return {first, std::min(first + slabDepth_, nz_ - 1)};
+    }
+
+    SlabSurface Extract(int slab, double isoValue) const;
+
+private:
+    // Plane z, thresholded and smoothed along x and y, into out
+    void ProcessPlane(int z, float *row, float *smoothedX, float *out) const;
+
+    // Planes first to last of the processed field
+    std::vector<float> ProcessPlanes(int first, int last) const;
+
+    // Gradient of the processed field at voxel (i, j, k), planes[k] being
+    // plane k of the slab buffer
+    void Gradient(const float *const *planes, int i, int j, int k, double gradient[3]) const;
+
+    const std::vector<VolumeStage> &before_;
+    const std::vector<VolumeStage> &after_;
+    const std::vector<float> &weights_;
+    int radius_;
+    int slabDepth_;
+    int extent_[6];
+    double origin_[3];
+    double spacing_[3];
+    int nx_, ny_, nz_;
+    std::size_t planeSize_;
+    array_dispatch::FloatReader read_;
+};
+
+void FusedKernel::ProcessPlane(int z, float *row, float *smoothedX, float *out) const
+{
+    const vtkIdType plane = static_cast<vtkIdType>(std::size_t(z) * planeSize_);
+    if (radius_ == 0)
+    {
+        read_(plane, static_cast<int>(planeSize_), out);
+        ApplyThresholds(before_, out, static_cast<int>(planeSize_));
+        return;
+    }
+    for (int j = 0; j < ny_; ++j)
+    {
+        read_(plane + vtkIdType(j) * nx_, nx_, row);
+        ApplyThresholds(before_, row, nx_);
+        SmoothRow(row, weights_.data(), radius_, smoothedX + std::size_t(j) * nx_, nx_);
+    }
+    std::vector<const float *> rows(weights_.size());
+    for (int j = 0; j < ny_; ++j)
+    {
+        for (int t = 0; t <= 2 * radius_; ++t)
+        {
+            const int source = j - radius_ + t;
+            rows[t] = source >= 0 && source < ny_ ? smoothedX + std::size_t(source) * nx_ : nullptr;
+        }
+        WeightedSum(rows.data(), weights_.data(), 2 * radius_ + 1, out + std::size_t(j) * nx_,
+                    nx_);
+    }
+}
+
+void FusedKernel::Gradient(const float *const *planes, int i, int j, int k,
+                           double gradient[3]) const
+{
+    const int index[3] = {i, j, k};
+    const int size[3] = {nx_, ny_, nz_};
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        // Central differences inside, one-sided ones on the boundary
+        const int lo = std::max(index[axis] - 1, 0);
+        const int hi = std::min(index[axis] + 1, size[axis] - 1);
+        if (lo == hi)
+        {
+            gradient[axis] = 0.0;
+            continue;
+        }
+        const std::size_t row = std::size_t(j) * nx_;
+        const std::size_t column = std::size_t(i);
+        double a;
+        double b;
+        switch (axis)
+        {
+        case 0:
+            a = planes[k][row + lo];
+            b = planes[k][row + hi];
+            break;
+        case 1:
+            a = planes[k][std::size_t(lo) * nx_ + column];
+            b = planes[k][std::size_t(hi) * nx_ + column];
+            break;
+        default:
+            a = planes[lo][row + column];
+            b = planes[hi][row + column];
+            break;
+        }
+        gradient[axis] = (b - a) / ((hi - lo) * spacing_[axis]);
+    }
+}
+
+std::vector<float> FusedKernel::ProcessPlanes(int first, int last) const
+{
+    std::vector<float> planes(std::size_t(last - first + 1) * planeSize_);
+
+    // The planes smoothed along x and y that the z pass of the current plane
+    // reads, in a ring of 2r+1
+    const int taps = 2 * radius_ + 1;
+    std::vector<float> row(radius_ > 0 ? nx_ : 0);
+    std::vector<float> smoothedX(radius_ > 0 ? planeSize_ : 0);
+    std::vector<float> ring(radius_ > 0 ? std::size_t(taps) * planeSize_ : 0);
+    std::vector<const float *> window(taps);
+    int next = std::max(first - radius_, 0);
+    for (int z = first; z <= last; ++z)
+    {
+        float *out = planes.data() + std::size_t(z - first) * planeSize_;
+        if (radius_ == 0)
+        {
+            ProcessPlane(z, nullptr, nullptr, out);
+        }
+        else
+        {
+            for (; next <= std::min(z + radius_, nz_ - 1); ++next)
+            {
+                ProcessPlane(next, row.data(), smoothedX.data(),
+                             ring.data() + std::size_t(next % taps) * planeSize_);
+            }
+            for (int t = 0; t < taps; ++t)
+            {
+                const int source = z - radius_ + t;
+                window[t] = source >= 0 && source < nz_
+                                ? ring.data() + std::size_t(source % taps) * planeSize_
+                                : nullptr;
+            }
+            WeightedSum(window.data(), weights_.data(), taps, out, static_cast<int>(planeSize_));
+        }
+        ApplyThresholds(after_, out, static_cast<int>(planeSize_));
+    }
+    return planes;
+}
+
+SlabSurface FusedKernel::Extract(int slab, double isoValue) const
+{
+    const auto [first, last] = LayersOf(slab);
+    // Planes the normals need, one beyond the slab on both sides
+    const int bufferFirst = std::max(first - 1, 0);
+    const int bufferLast = std::min(last + 1, nz_ - 1);
+    std::vector<float> buffer = ProcessPlanes(bufferFirst, bufferLast);
+
+    // The slab's planes as an image in place, without its direction so the
+    // points stay in index space scaled by the spacing
+    auto scalars = vtkSmartPointer<vtkFloatArray>::New();
+    scalars->SetArray(buffer.data() + std::size_t(first - bufferFirst) * planeSize_,
+                      static_cast<vtkIdType>(std::size_t(last - first + 1) * planeSize_), 1);
+    auto image = vtkSmartPointer<vtkImageData>::New();
+    image->SetExtent(extent_[0], extent_[1], extent_[2], extent_[3], extent_[4] + first,
+                     extent_[4] + last);
+    image->SetOrigin(origin_);
+    image->SetSpacing(spacing_);
+    image->GetPointData()->SetScalars(scalars);
+
+    auto flyingEdges = vtkSmartPointer<vtkFlyingEdges3D>::New();
+    flyingEdges->SetInputData(image);
+    flyingEdges->SetValue(0, isoValue);
+    flyingEdges->ComputeNormalsOff();
+    flyingEdges->ComputeGradientsOff();
+    flyingEdges->ComputeScalarsOff();
+    flyingEdges->Update();
+    vtkPolyData *output = flyingEdges->GetOutput();
+
+    SlabSurface surface;
+    const vtkIdType numPoints = output->GetNumberOfPoints();
+    if (numPoints == 0)
+    {
+        return surface;
+    }
+    CopyIds(output->GetPolys()->GetConnectivityArray(), surface.triangles);
+    surface.points.resize(3 * std::size_t(numPoints));
+    array_dispatch::DispatchReal(output->GetPoints()->GetData(), [&](auto xyz) {
+        for (vtkIdType id = 0; id < numPoints; ++id)
+        {
+            xyz.GetTuple(id, &surface.points[3 * id]);
+        }
+    });
+    surface.normals.resize(3 * std::size_t(numPoints));
+    std::vector<const float *> planes(nz_, nullptr);
+    for (int k = bufferFirst; k <= bufferLast; ++k)
+    {
+        planes[k] = buffer.data() + std::size_t(k - bufferFirst) * planeSize_;
+    }
+    const int size[3] = {nx_, ny_, nz_};
+    for (vtkIdType id = 0; id < numPoints; ++id)
+    {
+        const float *p = &surface.points[3 * id];
+
+        // Points lie on voxel edges: interpolate the gradients of the voxels
+        // around them
+        int corner[3];
+        double fraction[3];
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            const double index =
+                (p[axis] - origin_[axis]) / spacing_[axis] - extent_[2 * axis];
+            corner[axis] = std::clamp(static_cast<int>(std::floor(index)), 0,
+                                      std::max(size[axis] - 2, 0));
+            fraction[axis] = std::clamp(index - corner[axis], 0.0, 1.0);
+            if (fraction[axis] < 1e-6)
+            {
+                fraction[axis] = 0.0;
+            }
+            else if (fraction[axis] > 1.0 - 1e-6)
+            {
+                fraction[axis] = 0.0;
+                corner[axis] = std::min(corner[axis] + 1, size[axis] - 1);
+            }
+        }
+        double normal[3] = {0.0, 0.0, 0.0};
+        for (int c = 0; c < 8; ++c)
+        {
+            double weight = 1.0;
+            int voxel[3];
+            for (int axis = 0; axis < 3; ++axis)
+            {
+                const bool up = (c >> axis) & 1;
+                weight *= up ? fraction[axis] : 1.0 - fraction[axis];
+                voxel[axis] = corner[axis] + up;
+            }
+            if (weight == 0.0)
+            {
+                continue;
+            }
+            double gradient[3];
+            Gradient(planes.data(), voxel[0], voxel[1], voxel[2], gradient);
+            for (int axis = 0; axis < 3; ++axis)
+            {
+                normal[axis] -= weight * gradient[axis];
+            }
+        }
+        const double length = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] +
+                                         normal[2] * normal[2]);
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            surface.normals[3 * id + axis] =
+                static_cast<float>(length > 0.0 ? normal[axis] / length : 0.0);
+        }
+    }
+    return surface;
+}
+
+} // namespace
+
+VolumeStage VolumeStage::Threshold(double lower, double upper, double outsideValue)
+{
+    VolumeStage stage;
+    stage.kind = Kind::Threshold;
+    stage.lower = lower;
+    stage.upper = upper;
+    stage.outsideValue = outsideValue;
+    return stage;
+}
+
+VolumeStage VolumeStage::GaussianSmooth(double sigma, double radiusFactor)
+{
+    VolumeStage stage;
+    stage.kind = Kind::GaussianSmooth;
+    stage.sigma = sigma;
+    stage.radiusFactor = radiusFactor;
+    return stage;
+}
+
+VolumePipeline::VolumePipeline(std::vector<VolumeStage> stages, int slabDepth)
+    : stages_(std::move(stages)), slabDepth_(std::max(slabDepth, 1)), weights_(1, 1.0f)
+{
+    // Thresholds are pointwise and go on either side of the Gaussians;
+    // Gaussians in a row are one Gaussian of the convolved kernels. A
+    // threshold between two Gaussians needs the whole volume in between.
+    fused_ = true;
+    bool smoothed = false;
+    for (const VolumeStage &stage : stages_)
+    {
+        if (stage.kind == VolumeStage::Kind::Threshold)
+        {
+            if (stage.lower > stage.upper)
+            {
+                throw std::invalid_argument("threshold: lower bound above the upper bound");
+            }
+            (smoothed ? after_ : before_).push_back(stage);
+            continue;
+        }
+        if (!(stage.sigma > 0.0) || stage.radiusFactor < 0.0)
+        {
+            throw std::invalid_argument("Gaussian: sigma must be positive");
+        }
+        fused_ = fused_ && after_.empty();
+        weights_ = Convolve(weights_, GaussianWeights(stage));
+        smoothed = true;
+    }
+}
+
+vtkSmartPointer<vtkPolyData> VolumePipeline::Extract(vtkImageData *volume, double isoValue) const
+{
+    if (stages_.empty())
+    {
+        return ExtractIsosurface(volume, isoValue);
+    }
+    const int *dims = volume->GetDimensions();
+    if (!fused_ || volume->GetNumberOfScalarComponents() != 1 || dims[0] < 2 || dims[1] < 2 ||
+        dims[2] < 2)
+    {
+        return ExtractUnfused(volume, isoValue);
+    }
+    return ExtractFused(volume, isoValue);
+}
+
+vtkSmartPointer<vtkPolyData> VolumePipeline::ExtractFused(vtkImageData *volume,
+                                                          double isoValue) const
+{
+    const FusedKernel kernel(volume, before_, weights_, after_, slabDepth_);
+    const int numSlabs = kernel.GetNumberOfSlabs();
+    std::vector<SlabSurface> slabs(numSlabs);
+    vtkSMPTools::For(0, numSlabs, 1, [&](vtkIdType begin, vtkIdType end) {
+        for (vtkIdType slab = begin; slab < end; ++slab)
+        {
+            slabs[slab] = kernel.Extract(static_cast<int>(slab), isoValue);
+        }
+    });
+
+    // Points on the plane between two slabs come out of both; the upper slab
+    // uses the ids of the lower one. Both computed them from the same values,
+    // so they match bit for bit.
+    double origin[3];
+    double spacing[3];
+    int extent[6];
+    volume->GetOrigin(origin);
+    volume->GetSpacing(spacing);
+    volume->GetExtent(extent);
+    std::vector<std::vector<vtkIdType>> ids(numSlabs);
+    std::vector<vtkIdType> triangleOffsets(numSlabs + 1, 0);
+    vtkIdType numPoints = 0;
+    std::map<std::array<float, 3>, vtkIdType> shared;
+    for (int slab = 0; slab < numSlabs; ++slab)
+    {
+        const auto [first, last] = kernel.LayersOf(slab);
+        const double bottom = origin[2] + (extent[4] + first) * spacing[2];
+        const double top = origin[2] + (extent[4] + last) * spacing[2];
+        const double tolerance = 0.25 * std::abs(spacing[2]);
+        const std::vector<float> &points = slabs[slab].points;
+        std::map<std::array<float, 3>, vtkIdType> topPoints;
+        ids[slab].resize(points.size() / 3);
+        for (std::size_t i = 0; i < ids[slab].size(); ++i)
+        {
+            const std::array<float, 3> key = {points[3 * i], points[3 * i + 1], points[3 * i + 2]};
+            auto match = std::abs(key[2] - bottom) < tolerance ? shared.find(key) : shared.end();
+            ids[slab][i] = match != shared.end() ? match->second : numPoints++;
+            if (std::abs(key[2] - top) < tolerance)
+            {
+                topPoints.emplace(key, ids[slab][i]);
+            }
+        }
+        shared = std::move(topPoints);
+        triangleOffsets[slab + 1] =
+            triangleOffsets[slab] + static_cast<vtkIdType>(slabs[slab].triangles.size() / 3);
+    }
+    shared.clear();
+
+    // The direction of the volume, if any, turns the points about its origin
+    vtkMatrix3x3 *direction = volume->GetDirectionMatrix();
+    const bool rotate = direction && !direction->IsIdentity();
+    const double *matrix = direction ? direction->GetData() : nullptr;
+
+    auto coords = vtkSmartPointer<vtkFloatArray>::New();
+    coords->SetNumberOfComponents(3);
+    coords->SetNumberOfTuples(numPoints);
+    auto normals = vtkSmartPointer<vtkFloatArray>::New();
+    normals->SetName("Normals");
+    normals->SetNumberOfComponents(3);
+    normals->SetNumberOfTuples(numPoints);
+    const vtkIdType numTriangles = triangleOffsets.back();
+    auto offsets = vtkSmartPointer<vtkIdTypeArray>::New();
+    offsets->SetNumberOfValues(numTriangles + 1);
+    auto connectivity = vtkSmartPointer<vtkIdTypeArray>::New();
+    connectivity->SetNumberOfValues(3 * numTriangles);
+    float *outPoints = coords->GetPointer(0);
+    float *outNormals = normals->GetPointer(0);
+    vtkIdType *outOffsets = offsets->GetPointer(0);
+    vtkIdType *outIds = connectivity->GetPointer(0);
+    vtkSMPTools::For(0, numSlabs, 1, [&](vtkIdType begin, vtkIdType end) {
+        for (vtkIdType slab = begin; slab < end; ++slab)
+        {
+            SlabSurface &surface = slabs[slab];
+            const std::vector<vtkIdType> &slabIds = ids[slab];
+            for (std::size_t i = 0; i < slabIds.size(); ++i)
+            {
+                float *p = outPoints + 3 * slabIds[i];
+                float *n = outNormals + 3 * slabIds[i];
+                std::copy_n(&surface.points[3 * i], 3, p);
+                std::copy_n(&surface.normals[3 * i], 3, n);
+                if (rotate)
+                {
+                    const double local[3] = {p[0] - origin[0], p[1] - origin[1], p[2] - origin[2]};
+                    const double normal[3] = {n[0], n[1], n[2]};
+                    for (int row = 0; row < 3; ++row)
+                    {
+                        const double *m = matrix + 3 * row;
+                        p[row] = static_cast<float>(
+                            origin[row] + m[0] * local[0] + m[1] * local[1] + m[2] * local[2]);
+                        n[row] = static_cast<float>(m[0] * normal[0] + m[1] * normal[1] +
+                                                    m[2] * normal[2]);
+                    }
+                }
+            }
+            const vtkIdType firstTriangle = triangleOffsets[slab];
+            for (std::size_t c = 0; c < surface.triangles.size(); ++c)
+            {
+                outIds[3 * firstTriangle + c] = slabIds[surface.triangles[c]];
+            }
+            for (vtkIdType t = firstTriangle; t < triangleOffsets[slab + 1]; ++t)
+            {
+                outOffsets[t] = 3 * t;
+            }
+            surface = {};
+        }
+    });
+    outOffsets[numTriangles] = 3 * numTriangles;
+
+    auto points = vtkSmartPointer<vtkPoints>::New();
+    points->SetData(coords);
+    auto polys = vtkSmartPointer<vtkCellArray>::New();
+    polys->SetData(offsets, connectivity);
+    auto surface = vtkSmartPointer<vtkPolyData>::New();
+    surface->SetPoints(points);
+    surface->SetPolys(polys);
+    surface->GetPointData()->SetNormals(normals);
+    return surface;
+}
+
+vtkSmartPointer<vtkPolyData> VolumePipeline::ExtractUnfused(vtkImageData *volume,
+                                                            double isoValue) const
+{
+    std::vector<vtkSmartPointer<vtkAlgorithm>> filters;
+    auto append = [&](vtkAlgorithm *filter) {
+        if (filters.empty())
+        {
+            filter->SetInputDataObject(volume);
+        }
+        else
+        {
+            filter->SetInputConnection(filters.back()->GetOutputPort());
+        }
+        filters.emplace_back(filter);
+    };
+    for (const VolumeStage &stage : stages_)
+    {
+        if (stage.kind == VolumeStage::Kind::Threshold)
+        {
+            auto threshold = vtkSmartPointer<vtkImageThreshold>::New();
+            threshold->ThresholdBetween(stage.lower, stage.upper);
+            threshold->ReplaceInOff();
+            threshold->ReplaceOutOn();
+            threshold->SetOutValue(stage.outsideValue);
+            threshold->SetOutputScalarTypeToFloat();
+            append(threshold);
+            continue;
+        }
+        if (filters.empty() && volume->GetScalarType() != VTK_FLOAT)
+        {
+            auto cast = vtkSmartPointer<vtkImageCast>::New();
+            cast->SetOutputScalarTypeToFloat();
+            append(cast);
+        }
+        auto gaussian = vtkSmartPointer<vtkImageGaussianSmooth>::New();
+        gaussian->SetDimensionality(3);
+        gaussian->SetStandardDeviations(stage.sigma, stage.sigma, stage.sigma);
+        gaussian->SetRadiusFactors(stage.radiusFactor, stage.radiusFactor, stage.radiusFactor);
+        append(gaussian);
+    }
+    if (filters.empty())
+    {
+        return ExtractIsosurface(volume, isoValue);
+    }
+    auto flyingEdges = vtkSmartPointer<vtkFlyingEdges3D>::New();
+    append(flyingEdges);
+    flyingEdges->SetValue(0, isoValue);
+    flyingEdges->ComputeNormalsOn();
+    flyingEdges->ComputeScalarsOff();
+    flyingEdges->Update();
+
+    auto surface = vtkSmartPointer<vtkPolyData>::New();
+    surface->ShallowCopy(flyingEdges->GetOutput());
+    return surface;
+}
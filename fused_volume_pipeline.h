@@ -0,0 +1,73 @@
+#pragma once
+
+#include <vtkImageData.h>
+#include <vtkPolyData.h>
+#include <vtkSmartPointer.h>
+
+#include <vector>
+
+// One stage of the volume processing in front of the isosurface.
+struct VolumeStage
+{
+    enum class Kind
+    {
+        Threshold,      // values outside [lower, upper] become outsideValue
+        GaussianSmooth, // Gaussian of standard deviation sigma voxels, cut at radiusFactor sigmas
+    };
+
+    Kind kind = Kind::Threshold;
+    double lower = 0.0;
+    double upper = 0.0;
+    double outsideValue = 0.0;
+    double sigma = 0.0;
+    double radiusFactor = 1.5;
+
+    static VolumeStage Threshold(double lower, double upper, double outsideValue);
+    static VolumeStage GaussianSmooth(double sigma, double radiusFactor = 1.5);
+};
+
+// The stages of a volume followed by its isosurface, compiled into one pass.
+//
+// A chain of thresholds around at most one Gaussian (consecutive Gaussians are
+// folded into one) runs as a single kernel over slabs of z planes: each
+// thread thresholds and smooths the rows of a plane along x and y while they
+// are in cache, keeps the 2r+1 planes the z pass of the next output plane
+// needs, and hands the slab to vtkFlyingEdges3D once its planes are done. No
+// intermediate volume is stored; a thread holds a few planes of floats.
+// Normals are the gradients of the processed field, so they are continuous
+// across slabs, and the points on the planes two slabs share are merged.
+//
+// Other chains run as the VTK filters vtkImageThreshold, vtkImageGaussianSmooth
+// and vtkFlyingEdges3D, each writing its whole output, as ExtractUnfused does.
+// Both compute in float. The fused Gaussian renormalizes its kernel where the
+// volume boundary cuts it off, so the two differ slightly near the boundary.
+class VolumePipeline
+{
+public:
+    // slabDepth is the number of cell layers per slab. Throws
+    // std::invalid_argument for empty thresholds and sigmas that are not positive.
+    explicit VolumePipeline(std::vector<VolumeStage> stages = {}, int slabDepth = 16);
+
+    // Whether the stages compiled into the fused kernel
+    bool IsFused() const { return fused_; }
+
+    // Isosurface of the processed volume at isoValue, with point normals.
+    // Volumes with several components go through the VTK filters.
+    vtkSmartPointer<vtkPolyData> Extract(vtkImageData *volume, double isoValue) const;
+
+    // The same surface from the chain of VTK filters
+    vtkSmartPointer<vtkPolyData> ExtractUnfused(vtkImageData *volume, double isoValue) const;
+
+private:
+    vtkSmartPointer<vtkPolyData> ExtractFused(vtkImageData *volume, double isoValue) const;
+
+    std::vector<VolumeStage> stages_;
+    int slabDepth_;
+
+    // The compiled chain: thresholds before the Gaussian, the Gaussian, if
+    // any, and thresholds after it
+    bool fused_ = false;
+    std::vector<VolumeStage> before_;
+    std::vector<float> weights_; // 2r+1 taps, r = 0 without a Gaussian
+    std::vector<VolumeStage> after_;
+};
@@ -0,0 +1,691 @@
+#include "glb_exporter.h"
+
+#include "array_dispatch.h"
+
+#include <vtkActor.h>
+#include <vtkActorCollection.h>
+#include <vtkCellArray.h>
+#include <vtkDataArray.h>
+#include <vtkIdList.h>
+#include <vtkMapper.h>
+#include <vtkMatrix4x4.h>
+#include <vtkPointData.h>
+#include <vtkPolyData.h>
+#include <vtkProperty.h>
+#include <vtkRenderer.h>
+#include <vtkSMPThreadLocal.h>
+#include <vtkSMPTools.h>
+#include <vtkSmartPointer.h>
+
+#include <spdlog/fmt/fmt.h>
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <numeric>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#ifdef _WIN32
+#include <fstream>
+#else
+#include <cerrno>
+#include <climits>
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+
+// glTF constants
+constexpr int kArrayBuffer = 34962;
+constexpr int kElementArrayBuffer = 34963;
+constexpr int kByte = 5120;
+constexpr int kUnsignedShort = 5123;
+constexpr int kUnsignedInt = 5125;
+
+// Polygons remapped per task while clustering
+constexpr vtkIdType kChunkSize = 16384;
+
+struct Level
+{
+    std::vector<float> points;  // xyz
+    std::vector<float> normals; // xyz, empty if the surface has none
+    std::vector<std::uint32_t> triangles;
+};
+
+struct ExportedActor
+{
+    std::vector<Level> levels;
+    double origin[3];
+    double extent[3];
+    double color[4];
+    double matrix[16]; // row-major, as vtkMatrix4x4
+};
+
+// Triangle fans of the polygons, with float points and normals
+Level ExtractLevel(vtkPolyData *mesh)
+{
+    Level level;
+    const vtkIdType numPoints = mesh->GetNumberOfPoints();
+    level.points.resize(3 * numPoints);
+    vtkDataArray *normals = mesh->GetPointData()->GetNormals();
+    if (normals)
+    {
+        level.normals.resize(3 * numPoints);
+    }
+    // Typed copies; a loop per array keeps the kernels few
+    auto copyTuples = [numPoints](vtkDataArray *array, std::vector<float> &out) {
+        array_dispatch::DispatchReal(array, [&](auto xyz) {
+            vtkSMPTools::For(0, numPoints, [&](vtkIdType begin, vtkIdType end) {
+                for (vtkIdType i = begin; i < end; ++i)
+                {
+                    xyz.GetTuple(i, out.data() + 3 * i);
+                }
+            });
+        });
+    };
+    if (numPoints > 0)
+    {
+        copyTuples(mesh->GetPoints()->GetData(), level.points);
+    }
+    if (normals)
+    {
+        copyTuples(normals, level.normals);
+    }
+
+    vtkCellArray *polys = mesh->GetPolys();
+    const vtkIdType numPolys = polys->GetNumberOfCells();
+    std::vector<vtkIdType> firsts(numPolys + 1, 0);
+    vtkSMPTools::For(0, numPolys, [&](vtkIdType begin, vtkIdType end) {
+        for (vtkIdType cell = begin; cell < end; ++cell)
+        {
+            firsts[cell + 1] = std::max<vtkIdType>(polys->GetCellSize(cell) - 2, 0);
+        }
+    });
+    std::partial_sum(firsts.begin(), firsts.end(), firsts.begin());
+    level.triangles.resize(3 * firsts.back());
+    vtkSMPTools::For(0, numPolys, [&](vtkIdType begin, vtkIdType end) {
+        auto idList = vtkSmartPointer<vtkIdList>::New();
+        for (vtkIdType cell = begin; cell < end; ++cell)
+        {
+            vtkIdType npts = 0;
+            const vtkIdType *pts = nullptr;
+            polys->GetCellAtId(cell, npts, pts, idList);
+            std::uint32_t *out = &level.triangles[3 * firsts[cell]];
+            for (vtkIdType i = 2; i < npts; ++i)
+            {
+                *out++ = static_cast<std::uint32_t>(pts[0]);
+                *out++ = static_cast<std::uint32_t>(pts[i - 1]);
+                *out++ = static_cast<std::uint32_t>(pts[i]);
+            }
+        }
+    });
+    return level;
+}
+
+// Vertex clustering: the points in each cell of a grid with resolution cells
+// along the longest side of the bounding box merge into their mean, and the
+// triangles that do not collapse are kept.
+Level ClusterLevel(const Level &source, const ExportedActor &actor, int resolution)
+{
+    const double size =
+        std::max({actor.extent[0], actor.extent[1], actor.extent[2]}) / resolution;
+    const auto numPoints = static_cast<vtkIdType>(source.points.size() / 3);
+    std::vector<std::pair<std::uint64_t, std::uint32_t>> keys(numPoints);
+    vtkSMPTools::For(0, numPoints, [&](vtkIdType begin, vtkIdType end) {
+        for (vtkIdType i = begin; i < end; ++i)
+        {
+            std::uint64_t key = 0;
+            for (int k = 0; k < 3; ++k)
+            {
+                const double cell =
+                    size > 0.0 ? (source.points[3 * i + k] - actor.origin[k]) / size : 0.0;
+                key = (key << 21) |
+                      static_cast<std::uint64_t>(std::clamp(cell, 0.0, double(resolution - 1)));
+            }
+            keys[i] = {key, static_cast<std::uint32_t>(i)};
+        }
+    });
+    vtkSMPTools::Sort(keys.begin(), keys.end());
+
+    // Clusters are the runs of equal keys
+    std::vector<std::uint32_t> starts;
+    for (vtkIdType i = 0; i < numPoints; ++i)
+    {
+        if (i == 0 || keys[i].first != keys[i - 1].first)
+        {
+            starts.push_back(static_cast<std::uint32_t>(i));
+        }
+    }
+    const auto numClusters = static_cast<vtkIdType>(starts.size());
+    starts.push_back(static_cast<std::uint32_t>(numPoints));
+
+    Level level;
+    level.points.resize(3 * numClusters);
+    const bool normals = !source.normals.empty();
+    if (normals)
+    {
+        level.normals.resize(3 * numClusters);
+    }
+    std::vector<std::uint32_t> clusterOf(numPoints);
+    vtkSMPTools::For(0, numClusters, [&](vtkIdType begin, vtkIdType end) {
+        for (vtkIdType c = begin; c < end; ++c)
+        {
+            double p[3] = {0.0, 0.0, 0.0};
+            double n[3] = {0.0, 0.0, 0.0};
+            for (std::uint32_t i = starts[c]; i < starts[c + 1]; ++i)
+            {
+                const std::uint32_t point = keys[i].second;
+                clusterOf[point] = static_cast<std::uint32_t>(c);
+                for (int k = 0; k < 3; ++k)
+                {
+                    p[k] += source.points[3 * point + k];
+                    n[k] += normals ? source.normals[3 * point + k] : 0.0;
+                }
+            }
+            const double count = starts[c + 1] - starts[c];
+            const double length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+            for (int k = 0; k < 3; ++k)
+            {
+                level.points[3 * c + k] = static_cast<float>(p[k] / count);
+                if (normals)
+                {
+                    level.normals[3 * c + k] = static_cast<float>(length > 0.0 ? n[k] / length
+                                                                               : 0.0);
+                }
+            }
+        }
+    });
+
+    // Count the surviving triangles per chunk, then write them at their
+    // chunk's offset
+    const auto numTriangles = static_cast<vtkIdType>(source.triangles.size() / 3);
+    const vtkIdType chunks = (numTriangles + kChunkSize - 1) / kChunkSize;
+    auto remap = [&](vtkIdType t, std::uint32_t out[3]) {
+        for (int k = 0; k < 3; ++k)
+        {
+            out[k] = clusterOf[source.triangles[3 * t + k]];
+        }
+        return out[0] != out[1] && out[1] != out[2] && out[2] != out[0];
+    };
+    std::vector<vtkIdType> kept(chunks + 1, 0);
+    vtkSMPTools::For(0, chunks, [&](vtkIdType begin, vtkIdType end) {
+        std::uint32_t t3[3];
+        for (vtkIdType chunk = begin; chunk < end; ++chunk)
+        {
+            const vtkIdType last = std::min(numTriangles, (chunk + 1) * kChunkSize);
+            for (vtkIdType t = chunk * kChunkSize; t < last; ++t)
+            {
+                kept[chunk + 1] += remap(t, t3) ? 1 : 0;
+            }
+        }
+    });
+    std::partial_sum(kept.begin(), kept.end(), kept.begin());
+    level.triangles.resize(3 * kept.back());
+    vtkSMPTools::For(0, chunks, [&](vtkIdType begin, vtkIdType end) {
+        std::uint32_t t3[3];
+        for (vtkIdType chunk = begin; chunk < end; ++chunk)
+        {
+            std::uint32_t *out = level.triangles.data() + 3 * kept[chunk];
+            const vtkIdType last = std::min(numTriangles, (chunk + 1) * kChunkSize);
+            for (vtkIdType t = chunk * kChunkSize; t < last; ++t)
+            {
+                if (remap(t, t3))
+                {
+                    out = std::copy_n(t3, 3, out);
+                }
+            }
+        }
+    });
+    return level;
+}
+
+// Spreads the low 10 bits of v three apart
+std::uint32_t SpreadBits(std::uint32_t v)
+{
+    v = (v | (v << 16)) & 0x030000ff;
+    v = (v | (v << 8)) & 0x0300f00f;
+    v = (v | (v << 4)) & 0x030c30c3;
+    v = (v | (v << 2)) & 0x09249249;
+    return v;
+}
+
+// Sorts the triangles by the Morton code of their centroid
+void SortTriangles(Level &level, const ExportedActor &actor)
+{
+    const auto numTriangles = static_cast<vtkIdType>(level.triangles.size() / 3);
+    std::vector<std::pair<std::uint32_t, std::uint32_t>> codes(numTriangles);
+    vtkSMPTools::For(0, numTriangles, [&](vtkIdType begin, vtkIdType end) {
+        for (vtkIdType t = begin; t < end; ++t)
+        {
+            std::uint32_t code = 0;
+            for (int k = 0; k < 3; ++k)
+            {
+                const double centroid = (level.points[3 * level.triangles[3 * t] + k] +
+                                         level.points[3 * level.triangles[3 * t + 1] + k] +
+                                         level.points[3 * level.triangles[3 * t + 2] + k]) /
+                                        3.0;
+                const double cell = actor.extent[k] > 0.0
+                                        ? (centroid - actor.origin[k]) / actor.extent[k] * 1023.0
+                                        : 0.0;
+                code |= SpreadBits(static_cast<std::uint32_t>(std::clamp(cell, 0.0, 1023.0)))
+                        << k;
+            }
+            codes[t] = {code, static_cast<std::uint32_t>(t)};
+        }
+    });
+    vtkSMPTools::Sort(codes.begin(), codes.end());
+    std::vector<std::uint32_t> sorted(level.triangles.size());
+    vtkSMPTools::For(0, numTriangles, [&](vtkIdType begin, vtkIdType end) {
+        for (vtkIdType t = begin; t < end; ++t)
+        {
+            std::copy_n(&level.triangles[3 * codes[t].second], 3, &sorted[3 * t]);
+        }
+    });
+    level.triangles.swap(sorted);
+}
+
+// Interleaved vertex and index buffers of a level, ready to be written
+struct LevelBuffers
+{
+    std::vector<char> vertices;
+    std::vector<char> indices;
+    int stride = 0;
+    bool shortIndices = false;
+    std::array<int, 3> min{};
+    std::array<int, 3> max{};
+};
+
+// Scale of the node matrix along axis, from uint16 positions to world units
+double DequantizationScale(const ExportedActor &actor, int axis)
+{
+    return actor.extent[axis] > 0.0 ? actor.extent[axis] / 65535.0 : 1.0;
+}
+
+LevelBuffers QuantizeLevel(const Level &level, const ExportedActor &actor)
+{
+    LevelBuffers buffers;
+    const bool normals = !level.normals.empty();
+    // Positions are three uint16, normals three int8 at offset 8; strides
+    // are multiples of 4
+    buffers.stride = normals ? 12 : 8;
+    const auto numPoints = static_cast<vtkIdType>(level.points.size() / 3);
+    buffers.vertices.assign(static_cast<std::size_t>(numPoints) * buffers.stride, 0);
+    double scale[3];
+    for (int k = 0; k < 3; ++k)
+    {
+        scale[k] = DequantizationScale(actor, k);
+    }
+
+    using Range = std::array<int, 6>;
+    vtkSMPThreadLocal<Range> localRanges(Range{65535, 0, 65535, 0, 65535, 0});
+    vtkSMPTools::For(0, numPoints, [&](vtkIdType begin, vtkIdType end) {
+        Range &range = localRanges.Local();
+        for (vtkIdType i = begin; i < end; ++i)
+        {
+            char *vertex = &buffers.vertices[static_cast<std::size_t>(i) * buffers.stride];
+            std::uint16_t q[3];
+            for (int k = 0; k < 3; ++k)
+            {
+                const double t = actor.extent[k] > 0.0
+                                     ? (level.points[3 * i + k] - actor.origin[k]) /
+                                           actor.extent[k] * 65535.0
+                                     : 0.0;
+                q[k] = static_cast<std::uint16_t>(std::lround(std::clamp(t, 0.0, 65535.0)));
+                range[2 * k] = std::min<int>(range[2 * k], q[k]);
+                range[2 * k + 1] = std::max<int>(range[2 * k + 1], q[k]);
+            }
+            std::memcpy(vertex, q, sizeof(q));
+            if (normals)
+            {
+                // Viewers transform normals by the inverse transpose of the
+                // node matrix, which undoes its dequantization scale; scaling
+                // them by it first keeps them right when extents differ
+                double scaled[3];
+                for (int k = 0; k < 3; ++k)
+                {
+                    scaled[k] = level.normals[3 * i + k] * scale[k];
+                }
+                const double length = std::sqrt(scaled[0] * scaled[0] + scaled[1] * scaled[1] +
+                                                scaled[2] * scaled[2]);
+                std::int8_t n[3];
+                for (int k = 0; k < 3; ++k)
+                {
+                    const double unit = length > 0.0 ? scaled[k] / length : 0.0;
+                    n[k] = static_cast<std::int8_t>(
+                        std::lround(std::clamp(unit, -1.0, 1.0) * 127.0));
+                }
+                std::memcpy(vertex + 8, n, sizeof(n));
+            }
+        }
+    });
+    buffers.min = {65535, 65535, 65535};
+    for (const Range &range : localRanges)
+    {
+        for (int k = 0; k < 3; ++k)
+        {
+            buffers.min[k] = std::min(buffers.min[k], range[2 * k]);
+            buffers.max[k] = std::max(buffers.max[k], range[2 * k + 1]);
+        }
+    }
+
+    buffers.shortIndices = numPoints <= 65535;
+    const std::size_t count = level.triangles.size();
+    if (buffers.shortIndices)
+    {
+        // Padded to 4 bytes
+        buffers.indices.assign((2 * count + 3) & ~std::size_t(3), 0);
+        auto *out = reinterpret_cast<std::uint16_t *>(buffers.indices.data());
+        std::transform(level.triangles.begin(), level.triangles.end(), out,
+                       [](std::uint32_t index) { return static_cast<std::uint16_t>(index); });
+    }
+    else
+    {
+        buffers.indices.resize(4 * count);
+        std::memcpy(buffers.indices.data(), level.triangles.data(), 4 * count);
+    }
+    return buffers;
+}
+
+void AppendItem(std::string &list, const std::string &item)
+{
+    if (!list.empty())
+    {
+        list += ',';
+    }
+    list += item;
+}
+
+// Column-major node matrix: the actor's matrix after the dequantization
+std::string NodeMatrix(const ExportedActor &actor)
+{
+    double quantization[16] = {};
+    for (int k = 0; k < 3; ++k)
+    {
+        quantization[4 * k + k] = DequantizationScale(actor, k);
+        quantization[4 * k + 3] = actor.origin[k];
+    }
+    quantization[15] = 1.0;
+    std::string matrix;
+    for (int column = 0; column < 4; ++column)
+    {
+        for (int row = 0; row < 4; ++row)
+        {
+            double value = 0.0;
+            for (int k = 0; k < 4; ++k)
+            {
+                value += actor.matrix[4 * row + k] * quantization[4 * k + column];
+            }
+            AppendItem(matrix, fmt::format("{}", value));
+        }
+    }
+    return "[" + matrix + "]";
+}
+
+void WriteBuffers(const std::string &path,
+                  const std::vector<std::pair<const char *, std::size_t>> &parts)
+{
+#ifdef _WIN32
+    std::ofstream out(path, std::ios::binary);
+    for (const auto &[data, size] : parts)
+    {
+        out.write(data, static_cast<std::streamsize>(size));
+    }
+    if (!out)
+    {
+        throw std::runtime_error("cannot write " + path);
+    }
+#else
+    const int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+    {
+        throw std::runtime_error("cannot open " + path);
+    }
+    std::vector<iovec> iov;
+    for (const auto &[data, size] : parts)
+    {
+        if (size > 0)
+        {
+            iov.push_back({const_cast<char *>(data), size});
+        }
+    }
+    // One writev, repeated only for what the kernel did not take at once
+    std::size_t first = 0;
+    while (first < iov.size())
+    {
+        const int count = static_cast<int>(std::min<std::size_t>(iov.size() - first, IOV_MAX));
+        const ssize_t written = ::writev(fd, &iov[first], count);
+        if (written < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            ::close(fd);
+            throw std::runtime_error("cannot write " + path);
+        }
+        auto remaining = static_cast<std::size_t>(written);
+        while (first < iov.size() && remaining >= iov[first].iov_len)
+        {
+            remaining -= iov[first++].iov_len;
+        }
+        if (remaining > 0)
+        {
+            iov[first].iov_base = static_cast<char *>(iov[first].iov_base) + remaining;
+            iov[first].iov_len -= remaining;
+        }
+    }
+    if (::close(fd) != 0)
+    {
+        throw std::runtime_error("cannot write " + path);
+    }
+#endif
+}
+
+} // namespace
+
+void ExportSceneGLB(vtkRenderer *renderer, const std::string &path,
+                    const GLBExportOptions &options)
+{
+    const auto start = std::chrono::steady_clock::now();
+    const int levels = std::max(options.levels, 1);
+
+    std::vector<ExportedActor> actors;
+    vtkActorCollection *collection = renderer->GetActors();
+    collection->InitTraversal();
+    while (vtkActor *actor = collection->GetNextActor())
+    {
+        vtkMapper *mapper = actor->GetMapper();
+        if (!actor->GetVisibility() || !mapper)
+        {
+            continue;
+        }
+        mapper->Update();
+        auto *mesh = vtkPolyData::SafeDownCast(mapper->GetInputDataObject(0, 0));
+        if (!mesh || mesh->GetNumberOfPolys() == 0)
+        {
+            continue;
+        }
+
+        ExportedActor exported;
+        double bounds[6];
+        mesh->GetBounds(bounds);
+        for (int k = 0; k < 3; ++k)
+        {
+            exported.origin[k] = bounds[2 * k];
+            exported.extent[k] = bounds[2 * k + 1] - bounds[2 * k];
+        }
+        actor->GetProperty()->GetColor(exported.color);
+        exported.color[3] = actor->GetProperty()->GetOpacity();
+        std::copy_n(actor->GetMatrix()->GetData(), 16, exported.matrix);
+
+        exported.levels.push_back(ExtractLevel(mesh));
+        // About sqrt(points) cells along the longest side keeps the point
+        // count; halving it per level quarters the points
+        const double points = static_cast<double>(mesh->GetNumberOfPoints());
+        int resolution = static_cast<int>(std::min(std::sqrt(points), double(1 << 20)));
+        for (int level = 1; level < levels; ++level)
+        {
+            resolution /= 2;
+            if (resolution < 2)
+            {
+                break;
+            }
+            Level coarse = ClusterLevel(exported.levels.front(), exported, resolution);
+            if (coarse.triangles.empty())
+            {
+                break;
+            }
+            exported.levels.push_back(std::move(coarse));
+        }
+        for (Level &level : exported.levels)
+        {
+            SortTriangles(level, exported);
+        }
+        actors.push_back(std::move(exported));
+    }
+    if (actors.empty())
+    {
+        throw std::runtime_error("no polygonal actors to export");
+    }
+
+    std::vector<LevelBuffers> buffers;
+    std::string bufferViews, accessors, meshes, nodes, materials, sceneNodes;
+    std::size_t binaryBytes = 0;
+    std::size_t triangles = 0;
+    int nodeCount = 0;
+    int accessorCount = 0;
+    for (std::size_t a = 0; a < actors.size(); ++a)
+    {
+        const ExportedActor &actor = actors[a];
+        const double *c = actor.color;
+        const char *alphaMode = c[3] < 1.0 ? R"(,"alphaMode":"BLEND")" : "";
+        AppendItem(materials,
+                   fmt::format(R"({{"pbrMetallicRoughness":{{"baseColorFactor":[{},{},{},{}],)"
+                               R"("metallicFactor":0,"roughnessFactor":0.5}},)"
+                               R"("doubleSided":true{}}})",
+                               c[0], c[1], c[2], c[3], alphaMode));
+        const std::string matrix = NodeMatrix(actor);
+
+        std::string lodIds, coverage;
+        const auto numLevels = static_cast<int>(actor.levels.size());
+        for (int l = 0; l < numLevels; ++l)
+        {
+            const Level &level = actor.levels[l];
+            buffers.push_back(QuantizeLevel(level, actor));
+            const LevelBuffers &b = buffers.back();
+            const int view = static_cast<int>(2 * (buffers.size() - 1));
+            const std::size_t numPoints = level.points.size() / 3;
+            triangles += level.triangles.size() / 3;
+
+            AppendItem(bufferViews,
+                       fmt::format(R"({{"buffer":0,"byteOffset":{},"byteLength":{},)"
+                                   R"("byteStride":{},"target":{}}})",
+                                   binaryBytes, b.vertices.size(), b.stride, kArrayBuffer));
+            binaryBytes += b.vertices.size();
+            AppendItem(bufferViews,
+                       fmt::format(R"({{"buffer":0,"byteOffset":{},"byteLength":{},"target":{}}})",
+                                   binaryBytes, b.indices.size(), kElementArrayBuffer));
+            binaryBytes += b.indices.size();
+
+            const int position = accessorCount++;
+            AppendItem(accessors,
+                       fmt::format(R"({{"bufferView":{},"componentType":{},"count":{},)"
+                                   R"("type":"VEC3","min":[{},{},{}],"max":[{},{},{}]}})",
+                                   view, kUnsignedShort, numPoints, b.min[0], b.min[1], b.min[2],
+                                   b.max[0], b.max[1], b.max[2]));
+            std::string normal;
+            if (!level.normals.empty())
+            {
+                normal = fmt::format(R"(,"NORMAL":{})", accessorCount++);
+                AppendItem(accessors,
+                           fmt::format(R"({{"bufferView":{},"byteOffset":8,"componentType":{},)"
+                                       R"("normalized":true,"count":{},"type":"VEC3"}})",
+                                       view, kByte, numPoints));
+            }
+            const int indices = accessorCount++;
+            AppendItem(accessors,
+                       fmt::format(R"({{"bufferView":{},"componentType":{},"count":{},)"
+                                   R"("type":"SCALAR"}})",
+                                   view + 1, b.shortIndices ? kUnsignedShort : kUnsignedInt,
+                                   level.triangles.size()));
+            AppendItem(meshes,
+                       fmt::format(R"({{"primitives":[{{"attributes":{{"POSITION":{}{}}},)"
+                                   R"("indices":{},"material":{}}}]}})",
+                                   position, normal, indices, a));
+
+            // The full surface is the node in the scene, the coarser levels
+            // are the nodes that follow it
+            if (l > 0)
+            {
+                AppendItem(lodIds, std::to_string(nodeCount + l));
+            }
+            AppendItem(coverage,
+                       fmt::format("{}", l + 1 < numLevels ? std::pow(0.25, l + 1) : 0.0));
+        }
+
+        const int firstMesh = static_cast<int>(buffers.size()) - numLevels;
+        AppendItem(sceneNodes, std::to_string(nodeCount));
+        AppendItem(nodes, numLevels > 1
+                              ? fmt::format(R"({{"mesh":{},"matrix":{},)"
+                                            R"("extensions":{{"MSFT_lod":{{"ids":[{}]}}}},)"
+                                            R"("extras":{{"MSFT_screencoverage":[{}]}}}})",
+                                            firstMesh, matrix, lodIds, coverage)
+                              : fmt::format(R"({{"mesh":{},"matrix":{}}})", firstMesh, matrix));
+        for (int l = 1; l < numLevels; ++l)
+        {
+            AppendItem(nodes, fmt::format(R"({{"mesh":{},"matrix":{}}})", firstMesh + l, matrix));
+        }
+        nodeCount += numLevels;
+    }
+
+    std::string json = fmt::format(
+        R"({{"asset":{{"version":"2.0","generator":"simple_vtk_example"}},)"
+        R"("extensionsUsed":["KHR_mesh_quantization","MSFT_lod"],)"
+        R"("extensionsRequired":["KHR_mesh_quantization"],)"
+        R"("scene":0,"scenes":[{{"nodes":[{}]}}],"nodes":[{}],"meshes":[{}],)"
+        R"("materials":[{}],"accessors":[{}],"bufferViews":[{}],"buffers":[{{"byteLength":{}}}]}})",
+        sceneNodes, nodes, meshes, materials, accessors, bufferViews, binaryBytes);
+    json.resize((json.size() + 3) & ~std::size_t(3), ' ');
+
+    // GLB header, JSON chunk, then the binary chunk straight from the level
+    // buffers. Lengths in GLB are 32-bit.
+    const std::uint64_t fileBytes = 12 + 8 + std::uint64_t(json.size()) + 8 + binaryBytes;
+    if (fileBytes > std::numeric_limits<std::uint32_t>::max())
+    {
+        throw std::runtime_error(fmt::format("cannot write {}: {:.1f} GB is over the 4 GiB limit "
+                                             "of GLB files; use fewer levels or actors",
+                                             path, fileBytes / 1e9));
+    }
+    const auto totalBytes = static_cast<std::uint32_t>(fileBytes);
+    const std::uint32_t header[3] = {0x46546C67, 2, totalBytes}; // "glTF"
+    const std::uint32_t jsonChunk[2] = {static_cast<std::uint32_t>(json.size()),
+                                        0x4E4F534A}; // "JSON"
+    const std::uint32_t binaryChunk[2] = {static_cast<std::uint32_t>(binaryBytes),
+                                          0x004E4942}; // "BIN\0"
+    std::vector<std::pair<const char *, std::size_t>> parts = {
+        {reinterpret_cast<const char *>(header), sizeof(header)},
+        {reinterpret_cast<const char *>(jsonChunk), sizeof(jsonChunk)},
+        {json.data(), json.size()},
+        {reinterpret_cast<const char *>(binaryChunk), sizeof(binaryChunk)},
+    };
+    for (const LevelBuffers &b : buffers)
+    {
+        parts.emplace_back(b.vertices.data(), b.vertices.size());
+        parts.emplace_back(b.indices.data(), b.indices.size());
+    }
+    WriteBuffers(path, parts);
+
+    spdlog::info("Exported {} actors ({} levels, {} triangles) to {}, {:.1f} MB in {:.3f} s",
+                 actors.size(), buffers.size(), triangles, path, totalBytes / 1e6,
+                 std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+}
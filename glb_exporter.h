@@ -0,0 +1,24 @@
+#pragma once
+
+#include <string>
+
+class vtkRenderer;
+
+struct GLBExportOptions
+{
+    // Levels of detail per actor, the full surface included; each level has
+    // roughly a quarter of the triangles of the one before
+    int levels = 3;
+};
+
+// Writes the visible polygonal actors of renderer as a binary glTF 2.0 file.
+//
+// Every actor becomes a node whose levels of detail (MSFT_lod) are built in
+// parallel by vertex clustering. Vertices are interleaved and quantized
+// (KHR_mesh_quantization): 16-bit positions over the actor's bounding box,
+// undone by the node transform, and 8-bit normals. Triangles are sorted along
+// a Morton curve so that consecutive runs stay spatially compact. The file is
+// written with a single vectored write. Throws std::runtime_error on I/O
+// errors and for scenes over the 4 GiB a GLB file can hold.
+void ExportSceneGLB(vtkRenderer *renderer, const std::string &path,
+                    const GLBExportOptions &options = {});
@@ -0,0 +1,210 @@
+#include "incremental_isosurface.h"
+
+#include <vtkDataArray.h>
+#include <vtkFlyingEdges3D.h>
+#include <vtkPointData.h>
+#include <vtkSMPTools.h>
+
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+
+namespace
+{
+
+// 64-bit hash of a byte range, eight bytes per step
+std::uint64_t HashBytes(const char *data, std::size_t size, std::uint64_t hash)
+{
+    constexpr std::uint64_t kMultiplier = 0x9E3779B97F4A7C15ull;
+    std::size_t offset = 0;
+    for (; offset + 8 <= size; offset += 8)
+    {
+        std::uint64_t word;
+        std::memcpy(&word, data + offset, 8);
+        hash = (hash ^ word) * kMultiplier;
+        hash ^= hash >> 29;
+    }
+    std::uint64_t tail = 0;
+    std::memcpy(&tail, data + offset, size - offset);
+    hash = (hash ^ tail ^ size) * kMultiplier;
+    return hash ^ (hash >> 32);
+}
+
+// Calls fn(row, bytes) for every x row of the points in extent
+template <typename Fn>
+void ForEachRow(vtkImageData *volume, const int extent[6], std::size_t valueSize, Fn &&fn)
+{
+    const std::size_t rowBytes = std::size_t(extent[1] - extent[0] + 1) * valueSize;
+    for (int k = extent[4]; k <= extent[5]; ++k)
+    {
+        for (int j = extent[2]; j <= extent[3]; ++j)
+        {
+            fn(static_cast<const char *>(volume->GetScalarPointer(extent[0], j, k)), rowBytes);
+        }
+    }
+}
+
+std::uint64_t HashBlock(vtkImageData *volume, const int extent[6], std::size_t valueSize)
+{
+    std::uint64_t hash = 0;
+    ForEachRow(volume, extent, valueSize,
+               [&](const char *row, std::size_t bytes) { hash = HashBytes(row, bytes, hash); });
+    return hash;
+}
+
+vtkSmartPointer<vtkPolyData> ExtractBlock(vtkImageData *volume, const int extent[6],
+                                          std::size_t valueSize, double isoValue)
+{
+    // Copy the block into its own image; the extent keeps it in place
+    auto block = vtkSmartPointer<vtkImageData>::New();
+    block->SetExtent(extent[0], extent[1], extent[2], extent[3], extent[4], extent[5]);
+    block->SetOrigin(volume->GetOrigin());
+    block->SetSpacing(volume->GetSpacing());
+    block->SetDirectionMatrix(volume->GetDirectionMatrix());
+    block->AllocateScalars(volume->GetScalarType(), 1);
+    char *out = static_cast<char *>(block->GetScalarPointer());
+    ForEachRow(volume, extent, valueSize, [&](const char *row, std::size_t bytes) {
+        std::memcpy(out, row, bytes);
+        out += bytes;
+    });
+
+    auto flyingEdges = vtkSmartPointer<vtkFlyingEdges3D>::New();
+    flyingEdges->SetInputData(block);
+    flyingEdges->SetValue(0, isoValue);
+    flyingEdges->ComputeNormalsOn();
+    flyingEdges->ComputeScalarsOff();
+    flyingEdges->Update();
+
+    vtkPolyData *output = flyingEdges->GetOutput();
+    if (output->GetNumberOfPolys() == 0)
+    {
+        return nullptr;
+    }
+    auto surface = vtkSmartPointer<vtkPolyData>::New();
+    surface->ShallowCopy(output);
+    return surface;
+}
+
+} // namespace
+
+IncrementalIsosurface::IncrementalIsosurface(int blockSize)
+    : blockSize_(std::max(blockSize, 2))
+{
+}
+
+bool IncrementalIsosurface::SameLayout(vtkImageData *volume, double isoValue) const
+{
+    int extent[6];
+    volume->GetExtent(extent);
+    double origin[3];
+    double spacing[3];
+    volume->GetOrigin(origin);
+    volume->GetSpacing(spacing);
+    return std::equal(extent, extent + 6, extent_) && std::equal(origin, origin + 3, origin_) &&
+           std::equal(spacing, spacing + 3, spacing_) && volume->GetScalarType() == scalarType_ &&
+           isoValue == isoValue_;
+}
+
+void IncrementalIsosurface::Layout(vtkImageData *volume, double isoValue)
+{
+    volume->GetExtent(extent_);
+    volume->GetOrigin(origin_);
+    volume->GetSpacing(spacing_);
+    scalarType_ = volume->GetScalarType();
+    isoValue_ = isoValue;
+
+    // Blocks own blockSize cells per axis plus the shared plane at their end
+    blocks_.clear();
+    int counts[3];
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        const int cells = extent_[2 * axis + 1] - extent_[2 * axis];
+        counts[axis] = std::max(1, (cells + blockSize_ - 1) / blockSize_);
+    }
+    blocks_.reserve(std::size_t(counts[0]) * counts[1] * counts[2]);
+    for (int bz = 0; bz < counts[2]; ++bz)
+    {
+        for (int by = 0; by < counts[1]; ++by)
+        {
+            for (int bx = 0; bx < counts[0]; ++bx)
+            {
+                Block block;
+                const int index[3] = {bx, by, bz};
+                for (int axis = 0; axis < 3; ++axis)
+                {
+                    const int first = extent_[2 * axis] + index[axis] * blockSize_;
+                    block.extent[2 * axis] = first;
+                    block.extent[2 * axis + 1] = std::min(first + blockSize_, extent_[2 * axis + 1]);
+                }
+                blocks_.push_back(std::move(block));
+            }
+        }
+    }
+}
+
+vtkSmartPointer<vtkMultiBlockDataSet> IncrementalIsosurface::Update(vtkImageData *volume,
+                                                                    double isoValue)
+{
+    vtkDataArray *scalars = volume->GetPointData()->GetScalars();
+    if (!scalars || scalars->GetNumberOfComponents() != 1)
+    {
+        throw std::invalid_argument("incremental isosurface needs single-component scalars");
+    }
+    const std::size_t valueSize = static_cast<std::size_t>(scalars->GetDataTypeSize());
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    const auto start = std::chrono::steady_clock::now();
+
+    bool rebuild = !SameLayout(volume, isoValue);
+    if (rebuild)
+    {
+        Layout(volume, isoValue);
+    }
+
+    // Hash every block, then re-extract the ones that changed
+    std::vector<std::uint8_t> changed(blocks_.size(), 0);
+    vtkSMPTools::For(0, static_cast<vtkIdType>(blocks_.size()), [&](vtkIdType begin, vtkIdType end) {
+        for (vtkIdType b = begin; b < end; ++b)
+        {
+            Block &block = blocks_[b];
+            const std::uint64_t hash = HashBlock(volume, block.extent, valueSize);
+            if (rebuild || hash != block.hash)
+            {
+                block.hash = hash;
+                block.surface = ExtractBlock(volume, block.extent, valueSize, isoValue);
+                changed[b] = 1;
+            }
+        }
+    });
+
+    auto surface = vtkSmartPointer<vtkMultiBlockDataSet>::New();
+    surface->SetNumberOfBlocks(static_cast<unsigned int>(blocks_.size()));
+    for (std::size_t b = 0; b < blocks_.size(); ++b)
+    {
+        surface->SetBlock(static_cast<unsigned int>(b), blocks_[b].surface);
+    }
+
+    lastStats_.blocks = blocks_.size();
+    lastStats_.changedBlocks = static_cast<std::size_t>(std::count(changed.begin(), changed.end(), 1));
+    lastStats_.seconds =
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    spdlog::debug("incremental isosurface: {}/{} blocks changed, {:.3f} s", lastStats_.changedBlocks,
+                  lastStats_.blocks, lastStats_.seconds);
+    return surface;
+}
+
+IncrementalIsosurfaceStats IncrementalIsosurface::GetLastStats()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return lastStats_;
+}
+
+void IncrementalIsosurface::Reset()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    blocks_.clear();
+    scalarType_ = -1;
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <vtkImageData.h>
+#include <vtkMultiBlockDataSet.h>
+#include <vtkPolyData.h>
+#include <vtkSmartPointer.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+struct IncrementalIsosurfaceStats
+{
+    std::size_t blocks = 0;
+    std::size_t changedBlocks = 0;
+    double seconds = 0.0; // hashing plus re-extraction
+};
+
+// Isosurface of a sequence of volumes that re-extracts only what changed.
+//
+// The volume is cut into blocks of blockSize cells per axis that share their
+// boundary plane with the next block, so the block surfaces meet without
+// cracks. Each update hashes the scalars of every block and runs
+// vtkFlyingEdges3D only on blocks whose hash differs from the previous
+// volume; the other blocks keep their surface. The result has one polydata
+// per block (nullptr for blocks without surface) for a
+// vtkCompositePolyDataMapper, which re-uploads only the blocks that were
+// replaced. Normals are computed per block, so they are one-sided on block
+// boundaries.
+class IncrementalIsosurface
+{
+public:
+    explicit IncrementalIsosurface(int blockSize = 32);
+
+    // Surface of volume at isoValue. Calls are serialized, so one instance can
+    // be shared by several threads; a change of geometry, scalar type or
+    // isovalue re-extracts every block.
+    vtkSmartPointer<vtkMultiBlockDataSet> Update(vtkImageData *volume, double isoValue);
+
+    IncrementalIsosurfaceStats GetLastStats();
+
+    // Forgets the previous volume
+    void Reset();
+
+private:
+    struct Block
+    {
+        int extent[6];
+        std::uint64_t hash = 0;
+        vtkSmartPointer<vtkPolyData> surface;
+    };
+
+    bool SameLayout(vtkImageData *volume, double isoValue) const;
+    void Layout(vtkImageData *volume, double isoValue);
+
+    int blockSize_;
+    std::mutex mutex_;
+    int extent_[6] = {0, -1, 0, -1, 0, -1};
+    double origin_[3] = {0.0, 0.0, 0.0};
+    double spacing_[3] = {0.0, 0.0, 0.0};
+    int scalarType_ = -1;
+    double isoValue_ = 0.0;
+    std::vector<Block> blocks_;
+    IncrementalIsosurfaceStats lastStats_;
+};
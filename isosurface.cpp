@@ -0,0 +1,31 @@
+#include "isosurface.h"
+
+#include <vtkDataArray.h>
+#include <vtkFlyingEdges3D.h>
+#include <vtkPointData.h>
+
+vtkSmartPointer<vtkPolyData> ExtractIsosurface(vtkImageData *volume, double isoValue)
+{
+    auto flyingEdges = vtkSmartPointer<vtkFlyingEdges3D>::New();
+    flyingEdges->SetInputData(volume);
+    flyingEdges->SetValue(0, isoValue);
+    flyingEdges->ComputeNormalsOn();
+    flyingEdges->ComputeScalarsOff();
+    flyingEdges->Update();
+
+    auto surface = vtkSmartPointer<vtkPolyData>::New();
+    surface->ShallowCopy(flyingEdges->GetOutput());
+    return surface;
+}
+
+double DefaultIsoValue(vtkImageData *volume)
+{
+    vtkDataArray *scalars = volume->GetPointData()->GetScalars();
+    if (!scalars)
+    {
+        return 0.0;
+    }
+    double range[2];
+    scalars->GetRange(range);
+    return 0.5 * (range[0] + range[1]);
+}
@@ -0,0 +1,12 @@
+#pragma once
+
+#include <vtkImageData.h>
+#include <vtkPolyData.h>
+#include <vtkSmartPointer.h>
+
+// Isosurface of a volume with vtkFlyingEdges3D, with point normals, detached
+// from the pipeline so it can be handed between threads.
+vtkSmartPointer<vtkPolyData> ExtractIsosurface(vtkImageData *volume, double isoValue);
+
+// Middle of the scalar range, used when no isovalue is given.
+double DefaultIsoValue(vtkImageData *volume);
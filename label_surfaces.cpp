@@ -0,0 +1,368 @@
+#include "label_surfaces.h"
+
+#include "array_dispatch.h"
+#include "mesh_topology.h"
+
+#include <vtkCellArray.h>
+#include <vtkCellData.h>
+#include <vtkFloatArray.h>
+#include <vtkIdTypeArray.h>
+#include <vtkMatrix3x3.h>
+#include <vtkPointData.h>
+#include <vtkPoints.h>
+#include <vtkSMPTools.h>
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <map>
+#include <numeric>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace
+{
+
+// Calls fn(axis, lower, upper) for the faces between voxels of different
+// labels that belong to cube s of a row: the faces at its lowest voxel toward
+// +x, +y and +z whose four surrounding cubes exist. rows are the four voxel
+// rows of the cube row, (j, k), (j + 1, k), (j, k + 1) and (j + 1, k + 1),
+// with voxel i at i + 1; j and k are the indices of the cube row.
+template <typename Label, typename Fn>
+void ForEachFace(const Label *const rows[4], int s, int j, int k, Fn &&fn)
+{
+    const Label *row = rows[0];
+    if (j >= 0 && k >= 0 && row[s] != row[s + 1])
+    {
+        fn(0, row[s], row[s + 1]);
+    }
+    if (s >= 1 && k >= 0 && row[s] != rows[1][s])
+    {
+        fn(1, row[s], rows[1][s]);
+    }
+    if (s >= 1 && j >= 0 && row[s] != rows[2][s])
+    {
+        fn(2, row[s], rows[2][s]);
+    }
+}
+
+// Surface nets over cubes of 2x2x2 voxels. Cubes are indexed by their lowest
+// voxel, from -1 to n - 1 along every axis, so the cubes on the border hold
+// the background voxels outside the volume; cube i is stored at i + 1. A cube
+// whose voxels are not all of one label gets a point at its center.
+template <typename Labels>
+vtkSmartPointer<vtkPolyData> ExtractBoundaries(Labels labels, vtkImageData *volume,
+                                               double background)
+{
+    using Label = typename Labels::ValueType;
+    const Label outside = static_cast<Label>(background);
+    int extent[6];
+    volume->GetExtent(extent);
+    const int nx = extent[1] - extent[0] + 1;
+    const int ny = extent[3] - extent[2] + 1;
+    const int nz = extent[5] - extent[4] + 1;
+    const vtkIdType rowsPerPlane = ny + 1;
+    const vtkIdType numRows = rowsPerPlane * (nz + 1);
+    const int rowWords = (nx + 1 + 63) / 64;
+    const std::size_t rowLength = std::size_t(nx) + 2;
+
+    // The voxel rows of cube row r, background past the ends and outside
+    auto loadRows = [&](vtkIdType r, std::vector<Label> &buffer, const Label *rows[4]) {
+        const int j = static_cast<int>(r % rowsPerPlane) - 1;
+        const int k = static_cast<int>(r / rowsPerPlane) - 1;
+        buffer.assign(4 * rowLength, outside);
+        for (int q = 0; q < 4; ++q)
+        {
+            const int y = j + (q & 1);
+            const int z = k + (q >> 1);
+            Label *row = buffer.data() + q * rowLength;
+            rows[q] = row;
+            if (y < 0 || y >= ny || z < 0 || z >= nz)
+            {
+                continue;
+            }
+            const vtkIdType first = vtkIdType(nx) * (y + vtkIdType(ny) * z);
+            for (int i = 0; i < nx; ++i)
+            {
+                row[i + 1] = labels.Get(first + i, 0);
+            }
+        }
+        return std::make_pair(j, k);
+    };
+
+    // Count: a bit per cube that gets a point, and the quads of every row
+    std::vector<std::uint64_t> mixed(std::size_t(numRows) * rowWords, 0);
+    std::vector<vtkIdType> quadOffsets(numRows + 1, 0);
+    vtkSMPTools::For(0, numRows, [&](vtkIdType begin, vtkIdType end) {
+        std::vector<Label> buffer;
+        const Label *rows[4];
+        for (vtkIdType r = begin; r < end; ++r)
+        {
+            const auto [j, k] = loadRows(r, buffer, rows);
+            std::uint64_t *bits = &mixed[std::size_t(r) * rowWords];
+            vtkIdType quads = 0;
+            for (int s = 0; s <= nx; ++s)
+            {
+                const Label first = rows[0][s];
+                bool isMixed = false;
+                for (int q = 0; q < 4; ++q)
+                {
+                    isMixed |= rows[q][s] != first || rows[q][s + 1] != first;
+                }
+                if (isMixed)
+                {
+                    bits[s / 64] |= std::uint64_t(1) << (s % 64);
+                }
+                ForEachFace(rows, s, j, k, [&](int, Label, Label) { ++quads; });
+            }
+            quadOffsets[r + 1] = quads;
+        }
+    });
+
+    // Point ids in cube order: the first id of every word of bits
+    std::vector<vtkIdType> firstIds(mixed.size() + 1, 0);
+    for (std::size_t w = 0; w < mixed.size(); ++w)
+    {
+        firstIds[w + 1] = firstIds[w] + std::popcount(mixed[w]);
+    }
+    std::partial_sum(quadOffsets.begin(), quadOffsets.end(), quadOffsets.begin());
+    const vtkIdType numPoints = firstIds.back();
+    const vtkIdType numQuads = quadOffsets.back();
+    auto pointOf = [&](int s, int j, int k) {
+        const std::size_t word =
+            std::size_t((k + 1) * rowsPerPlane + (j + 1)) * rowWords + std::size_t(s / 64);
+        const std::uint64_t below = (std::uint64_t(1) << (s % 64)) - 1;
+        return firstIds[word] + std::popcount(mixed[word] & below);
+    };
+
+    // The direction of the volume, if any, turns the points about its origin
+    double origin[3];
+    double spacing[3];
+    volume->GetOrigin(origin);
+    volume->GetSpacing(spacing);
+    vtkMatrix3x3 *direction = volume->GetDirectionMatrix();
+    const bool rotate = direction && !direction->IsIdentity();
+    const double *matrix = direction ? direction->GetData() : nullptr;
+
+    // Fill
+    auto coords = vtkSmartPointer<vtkFloatArray>::New();
+    coords->SetNumberOfComponents(3);
+    coords->SetNumberOfTuples(numPoints);
+    auto offsets = vtkSmartPointer<vtkIdTypeArray>::New();
+    offsets->SetNumberOfValues(numQuads + 1);
+    auto connectivity = vtkSmartPointer<vtkIdTypeArray>::New();
+    connectivity->SetNumberOfValues(4 * numQuads);
+    auto quadLabels = vtkSmartPointer<vtkAOSDataArrayTemplate<Label>>::New();
+    quadLabels->SetName("Labels");
+    quadLabels->SetNumberOfComponents(2);
+    quadLabels->SetNumberOfTuples(numQuads);
+    float *xyz = coords->GetPointer(0);
+    vtkIdType *conn = connectivity->GetPointer(0);
+    Label *sides = quadLabels->GetPointer(0);
+    vtkSMPTools::For(0, numRows, [&](vtkIdType begin, vtkIdType end) {
+        std::vector<Label> buffer;
+        const Label *rows[4];
+        for (vtkIdType r = begin; r < end; ++r)
+        {
+            const auto [j, k] = loadRows(r, buffer, rows);
+            const std::uint64_t *bits = &mixed[std::size_t(r) * rowWords];
+            vtkIdType id = firstIds[std::size_t(r) * rowWords];
+            vtkIdType at = quadOffsets[r];
+            for (int s = 0; s <= nx; ++s)
+            {
+                if ((bits[s / 64] >> (s % 64)) & 1)
+                {
+                    const double index[3] = {extent[0] + s - 0.5, extent[2] + j + 0.5,
+                                             extent[4] + k + 0.5};
+                    double local[3];
+                    for (int axis = 0; axis < 3; ++axis)
+                    {
+                        local[axis] = index[axis] * spacing[axis];
+                    }
+                    float *p = xyz + 3 * id++;
+                    for (int row = 0; row < 3; ++row)
+                    {
+                        const double *m = rotate ? matrix + 3 * row : nullptr;
+                        p[row] = static_cast<float>(
+                            origin[row] +
+                            (m ? m[0] * local[0] + m[1] * local[1] + m[2] * local[2]
+                               : local[row]));
+                    }
+                }
+                // Counterclockwise seen from the upper voxel
+                ForEachFace(rows, s, j, k, [&](int axis, Label lower, Label upper) {
+                    vtkIdType *quad = conn + 4 * at;
+                    switch (axis)
+                    {
+                    case 0:
+                        quad[0] = pointOf(s, j - 1, k - 1);
+                        quad[1] = pointOf(s, j, k - 1);
+                        quad[2] = pointOf(s, j, k);
+                        quad[3] = pointOf(s, j - 1, k);
+                        break;
+                    case 1:
+                        quad[0] = pointOf(s - 1, j, k - 1);
+                        quad[1] = pointOf(s - 1, j, k);
+                        quad[2] = pointOf(s, j, k);
+                        quad[3] = pointOf(s, j, k - 1);
+                        break;
+                    default:
+                        quad[0] = pointOf(s - 1, j - 1, k);
+                        quad[1] = pointOf(s, j - 1, k);
+                        quad[2] = pointOf(s, j, k);
+                        quad[3] = pointOf(s - 1, j, k);
+                        break;
+                    }
+                    sides[2 * at] = lower;
+                    sides[2 * at + 1] = upper;
+                    ++at;
+                });
+            }
+        }
+    });
+    vtkIdType *off = offsets->GetPointer(0);
+    vtkSMPTools::For(0, numQuads + 1, [&](vtkIdType begin, vtkIdType end) {
+        for (vtkIdType q = begin; q < end; ++q)
+        {
+            off[q] = 4 * q;
+        }
+    });
+
+    auto points = vtkSmartPointer<vtkPoints>::New();
+    points->SetData(coords);
+    auto polys = vtkSmartPointer<vtkCellArray>::New();
+    polys->SetData(offsets, connectivity);
+    auto boundaries = vtkSmartPointer<vtkPolyData>::New();
+    boundaries->SetPoints(points);
+    boundaries->SetPolys(polys);
+    boundaries->GetCellData()->AddArray(quadLabels);
+    return boundaries;
+}
+
+} // namespace
+
+vtkSmartPointer<vtkPolyData> ExtractLabelBoundaries(vtkImageData *labels, double background)
+{
+    vtkDataArray *scalars = labels->GetPointData()->GetScalars();
+    if (!scalars)
+    {
+        throw std::invalid_argument("label volume without scalars");
+    }
+    vtkSmartPointer<vtkPolyData> boundaries;
+    array_dispatch::Dispatch(scalars, [&](auto values) {
+        boundaries = ExtractBoundaries(values, labels, background);
+    });
+    return boundaries;
+}
+
+std::vector<LabelSurface> SplitLabelBoundaries(vtkPolyData *boundaries, double background)
+{
+    vtkDataArray *sides = boundaries->GetCellData()->GetArray("Labels");
+    if (!sides || sides->GetNumberOfComponents() != 2)
+    {
+        throw std::invalid_argument("label boundaries without a two-component Labels array");
+    }
+    const MeshTopology &topology = *MeshTopology::Get(boundaries);
+    const vtkIdType numPolys = topology.GetNumberOfPolygons();
+
+    // The polygons of every label, ~id for those that face into it.
+    // Neighboring polygons mostly separate the same labels, so the last list
+    // of each side is kept at hand.
+    std::map<double, std::vector<vtkIdType>> polygons;
+    array_dispatch::Dispatch(sides, [&](auto values) {
+        double lastLabel[2] = {background, background};
+        std::vector<vtkIdType> *lastList[2] = {nullptr, nullptr};
+        for (vtkIdType cell = 0; cell < numPolys; ++cell)
+        {
+            for (int side = 0; side < 2; ++side)
+            {
+                const double label = static_cast<double>(values.Get(cell, side));
+                if (label == background)
+                {
+                    continue;
+                }
+                if (!lastList[side] || label != lastLabel[side])
+                {
+                    lastLabel[side] = label;
+                    lastList[side] = &polygons[label];
+                }
+                lastList[side]->push_back(side == 0 ? cell : ~cell);
+            }
+        }
+    });
+
+    std::vector<LabelSurface> surfaces;
+    surfaces.reserve(polygons.size());
+    std::vector<const std::vector<vtkIdType> *> lists;
+    for (const auto &[label, list] : polygons)
+    {
+        surfaces.push_back({label, nullptr});
+        lists.push_back(&list);
+    }
+    array_dispatch::DispatchReal(boundaries->GetPoints()->GetData(), [&](auto xyz) {
+        vtkSMPTools::For(0, vtkIdType(surfaces.size()), 1, [&](vtkIdType begin, vtkIdType end) {
+            for (vtkIdType l = begin; l < end; ++l)
+            {
+                const std::vector<vtkIdType> &cells = *lists[l];
+
+                // The points of the label's polygons, renumbered in order
+                std::vector<vtkIdType> used;
+                vtkIdType numCorners = 0;
+                for (const vtkIdType cell : cells)
+                {
+                    const vtkIdType p = cell < 0 ? ~cell : cell;
+                    const auto first = topology.corners.begin() + topology.cornerOffsets[p];
+                    const auto last = topology.corners.begin() + topology.cornerOffsets[p + 1];
+                    used.insert(used.end(), first, last);
+                    numCorners += last - first;
+                }
+                std::sort(used.begin(), used.end());
+                used.erase(std::unique(used.begin(), used.end()), used.end());
+
+                auto coords = vtkSmartPointer<vtkFloatArray>::New();
+                coords->SetNumberOfComponents(3);
+                coords->SetNumberOfTuples(static_cast<vtkIdType>(used.size()));
+                float *out = coords->GetPointer(0);
+                for (std::size_t i = 0; i < used.size(); ++i)
+                {
+                    xyz.GetTuple(used[i], out + 3 * i);
+                }
+
+                const vtkIdType numCells = static_cast<vtkIdType>(cells.size());
+                auto offsets = vtkSmartPointer<vtkIdTypeArray>::New();
+                offsets->SetNumberOfValues(numCells + 1);
+                auto connectivity = vtkSmartPointer<vtkIdTypeArray>::New();
+                connectivity->SetNumberOfValues(numCorners);
+                vtkIdType *off = offsets->GetPointer(0);
+                vtkIdType *conn = connectivity->GetPointer(0);
+                vtkIdType at = 0;
+                for (vtkIdType c = 0; c < numCells; ++c)
+                {
+                    const bool inward = cells[c] < 0;
+                    const vtkIdType p = inward ? ~cells[c] : cells[c];
+                    const vtkIdType c0 = topology.cornerOffsets[p];
+                    const vtkIdType c1 = topology.cornerOffsets[p + 1];
+                    off[c] = at;
+                    for (vtkIdType i = 0; i < c1 - c0; ++i)
+                    {
+                        const vtkIdType corner = topology.corners[inward ? c1 - 1 - i : c0 + i];
+                        conn[at++] = std::lower_bound(used.begin(), used.end(), corner) -
+                                     used.begin();
+                    }
+                }
+                off[numCells] = at;
+
+                auto points = vtkSmartPointer<vtkPoints>::New();
+                points->SetData(coords);
+                auto polys = vtkSmartPointer<vtkCellArray>::New();
+                polys->SetData(offsets, connectivity);
+                auto surface = vtkSmartPointer<vtkPolyData>::New();
+                surface->SetPoints(points);
+                surface->SetPolys(polys);
+                surfaces[l].surface = surface;
+            }
+        });
+    });
+    return surfaces;
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <vtkImageData.h>
+#include <vtkPolyData.h>
+#include <vtkSmartPointer.h>
+
+#include <vector>
+
+// Boundaries between the labels of a segmentation, for all labels in one
+// parallel pass over the volume (surface nets without relaxation): every
+// face between two voxels of different labels becomes a quad joining the
+// centers of the four 2x2x2 voxel cubes around it. A face between two labels
+// is one quad shared by both surfaces, so neighboring labels meet without
+// gaps or overlaps. Voxels outside the volume count as background, which
+// closes the surfaces of labels touching its border.
+//
+// The quads carry the labels on their two sides in the two-component cell
+// array "Labels": the quad faces from the first toward the second. Points are
+// float, in world coordinates, direction matrix included. Label is the first
+// component of the scalars.
+vtkSmartPointer<vtkPolyData> ExtractLabelBoundaries(vtkImageData *labels,
+                                                    double background = 0.0);
+
+struct LabelSurface
+{
+    double label;
+    vtkSmartPointer<vtkPolyData> surface;
+};
+
+// The closed surface of every label but background in boundaries, as made by
+// ExtractLabelBoundaries and possibly smoothed since, in increasing label
+// order. Each surface has its own points and faces outward, for one actor per
+// label. Throws std::invalid_argument if boundaries has no "Labels" array of
+// two components.
+std::vector<LabelSurface> SplitLabelBoundaries(vtkPolyData *boundaries, double background = 0.0);
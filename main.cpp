@@ -1,44 +1,671 @@
+#include "app_options.h"
+#include "batched_file_reader.h"
+#include "benchmarks.h"
+#include "clip_widgets.h"
+#include "clipping.h"
+#include "connected_components_filter.h"
+#include "dicom_catalog.h"
+#include "fused_volume_pipeline.h"
+#include "glb_exporter.h"
+#include "incremental_isosurface.h"
+#include "isosurface.h"
+#include "label_surfaces.h"
+#include "mesh_measurements.h"
+#include "mesh_readers.h"
+#include "mesh_writers.h"
+#include "octree_point_cloud.h"
+#include "phase_playback.h"
+#include "point_octree.h"
+#include "region_growing_tool.h"
+#include "scene_snapshot.h"
+#include "shared_volume_cache.h"
+#include "sinc_smooth_filter.h"
+#include "sparse_sdf_image_source.h"
+#include "spool_watcher.h"
+#include "startup.h"
+#include "triangle_bvh.h"
+#include "volume_readers.h"
+#include "vtkhdf_io.h"
+
 #include <vtkSmartPointer.h>
 #include <vtkCubeSource.h>
 #include <vtkPolyDataMapper.h>
 #include <vtkActor.h>
+#include <vtkFlyingEdges3D.h>
+#include <vtkMath.h>
+#include <vtkProperty.h>
 #include <vtkRenderer.h>
 #include <vtkRenderWindow.h>
 #include <vtkRenderWindowInteractor.h>
 
-int main(int, char *[])
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <exception>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+
+namespace
+{
+
+// Time phases of the first series found under the --dicom directory
+std::vector<std::vector<std::string>> LoadDicomPhases(const AppOptions &options,
+                                                      std::string *seriesUID = nullptr)
 {
-    // Create a cube
-    auto cubeSource = vtkSmartPointer<vtkCubeSource>::New();
-    cubeSource->SetXLength(10.0);
-    cubeSource->SetYLength(10.0);
-    cubeSource->SetZLength(10.0);
+    const auto start = std::chrono::steady_clock::now();
+    DicomCatalog catalog;
+    catalog.AddDirectory(options.dicomPath);
+    if (catalog.GetSeries().empty())
+    {
+        throw std::runtime_error("no DICOM series under " + options.dicomPath);
+    }
+    const DicomSeries &series = catalog.GetSeries().front();
+    auto phases = SplitIntoPhases(series);
+    if (seriesUID)
+    {
+        *seriesUID = series.uid;
+    }
+    spdlog::info("Series {} ({}): {} files in {} phases, indexed in {:.3f} s", series.description,
+                 series.modality, series.instances.size(), phases.size(),
+                 std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+    return phases;
+}
+
+// First phase of the --dicom series, from the volume cache if one is given, or
+// the --volume file (VTKHDF, NRRD or NIfTI), written to the --save-volume file
+// if one was given
+vtkSmartPointer<vtkImageData> LoadVolume(const AppOptions &options, SharedVolumeCache *cache)
+{
+    vtkSmartPointer<vtkImageData> volume;
+    if (options.volumePath.empty())
+    {
+        std::string seriesUID;
+        const std::vector<std::string> files = LoadDicomPhases(options, &seriesUID).front();
+        auto read = [&]() -> vtkSmartPointer<vtkImageData> {
+            if (options.ioDepth <= 0)
+            {
+                return ReadDicomVolume(files);
+            }
+            BatchedFileReaderOptions batched;
+            batched.queueDepth = options.ioDepth;
+            const auto start = std::chrono::steady_clock::now();
+            auto batchedVolume = ReadDicomVolumeBatched(files, batched);
+            const double seconds =
+                std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            spdlog::info("Read {} DICOM slices in {:.3f} s", files.size(), seconds);
+            return batchedVolume;
+        };
+        volume = cache ? cache->Acquire(seriesUID, read) : read();
+    }
+    else
+    {
+        const auto start = std::chrono::steady_clock::now();
+        const int *extent = options.volumeExtent.empty() ? nullptr : options.volumeExtent.data();
+        volume = ReadVolumeFile(options.volumePath, extent);
+        const double seconds =
+            std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        const int *dims = volume->GetDimensions();
+        spdlog::info("Loaded {} ({}x{}x{} voxels) in {:.3f} s", options.volumePath, dims[0],
+                     dims[1], dims[2], seconds);
+    }
+    if (!options.saveVolumePath.empty())
+    {
+        VTKHDFOptions hdf;
+        std::fill_n(hdf.chunkSize, 3, options.hdfChunk);
+        const auto start = std::chrono::steady_clock::now();
+        WriteVTKHDF(volume, options.saveVolumePath, hdf);
+        const double seconds =
+            std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        spdlog::info("Saved the volume to {} in {:.3f} s", options.saveVolumePath, seconds);
+    }
+    return volume;
+}
 
+// Threshold and Gaussian of the volume in front of the isosurface, run as one
+// fused kernel
+VolumePipeline VolumePipelineOf(const AppOptions &options)
+{
+    std::vector<VolumeStage> stages;
+    if (!options.threshold.empty())
+    {
+        const double lower = options.threshold[0];
+        stages.push_back(VolumeStage::Threshold(lower, options.threshold[1], lower));
+    }
+    if (options.volumeSigma > 0.0)
+    {
+        stages.push_back(VolumeStage::GaussianSmooth(options.volumeSigma));
+    }
+    return VolumePipeline(std::move(stages));
+}
+
+vtkSmartPointer<vtkPolyData> IsosurfaceOf(const VolumePipeline &pipeline, vtkImageData *volume,
+                                          double isoValue)
+{
+    return pipeline.Extract(volume, std::isnan(isoValue) ? DefaultIsoValue(volume) : isoValue);
+}
+
+// Island removal stage between extraction and smoothing, or nullptr when no
+// component is dropped
+vtkSmartPointer<ConnectedComponentsFilter> NewComponentFilter(int largest, double minimumArea)
+{
+    if (largest <= 0 && minimumArea <= 0.0)
+    {
+        return nullptr;
+    }
+    auto filter = vtkSmartPointer<ConnectedComponentsFilter>::New();
+    filter->SetLargestComponents(std::max(largest, 0));
+    filter->SetMinimumArea(minimumArea);
+    return filter;
+}
+
+// Smoothing stage between extraction and the mapper
+vtkSmartPointer<SincSmoothPolyDataFilter> NewSmoother(int iterations)
+{
+    auto smoother = vtkSmartPointer<SincSmoothPolyDataFilter>::New();
+    smoother->SetNumberOfIterations(iterations);
+    return smoother;
+}
+
+// Zero level set of the narrow-band distance field of surface, extracted from
+// the field's image source
+vtkSmartPointer<vtkAlgorithm> DistanceFieldSurface(vtkPolyData *surface, int resolution)
+{
+    const auto start = std::chrono::steady_clock::now();
+    TriangleBVH bvh(surface);
+    double bounds[6];
+    bvh.GetBounds(bounds);
+    auto grid = CreateDistanceFieldGrid(bounds, resolution);
+    const double bandWidth = 3.0 * grid->GetSpacing()[0];
+    auto field = std::make_shared<const SparseDistanceField>(bvh, grid, bandWidth);
+    spdlog::info("Distance field: {} of {} blocks stored, {:.1f} MB instead of {:.1f} MB dense, "
+                 "built in {:.3f} s",
+                 field->GetNumberOfStoredBlocks(), field->GetNumberOfBlocks(),
+                 field->GetMemorySize() / 1e6, field->GetDenseMemorySize() / 1e6,
+                 std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+
+    auto source = vtkSmartPointer<SparseSDFImageSource>::New();
+    source->SetField(field);
+    auto flyingEdges = vtkSmartPointer<vtkFlyingEdges3D>::New();
+    flyingEdges->SetInputConnection(source->GetOutputPort());
+    flyingEdges->SetValue(0, 0.0);
+    flyingEdges->ComputeNormalsOn();
+    flyingEdges->ComputeScalarsOff();
+    return flyingEdges;
+}
+
+// Surface of a volume read by a background thread: isosurface, island removal
+// and smoothing, without the pipeline
+PhasePlayback::Preprocessor NewPreprocessor(const AppOptions &options)
+{
+    const double isoValue = options.isoValue;
+    const int smoothIterations = options.smoothIterations;
+    const int keepComponents = options.keepComponents;
+    const double minimumArea = options.minimumArea;
+    const VolumePipeline pipeline = VolumePipelineOf(options);
+    return [=](vtkImageData *volume) {
+        vtkSmartPointer<vtkPolyData> surface = IsosurfaceOf(pipeline, volume, isoValue);
+        if (auto components = NewComponentFilter(keepComponents, minimumArea))
+        {
+            components->SetInputData(surface);
+            components->Update();
+            surface = components->GetOutput();
+        }
+        if (smoothIterations > 0)
+        {
+            auto smoother = NewSmoother(smoothIterations);
+            smoother->SetInputData(surface);
+            smoother->Update();
+            surface = smoother->GetOutput();
+        }
+        return vtkSmartPointer<vtkDataObject>(surface);
+    };
+}
+
+// Widgets of the surface pipeline, switched on once the interactor exists
+struct SurfaceWidgets
+{
+    std::unique_ptr<PlaneClipWidget> clip;
+    std::unique_ptr<BoxCropWidget> crop;
+    std::unique_ptr<RegionGrowingTool> grow;
+};
+
+// The polydata actor shown when no point cloud is streamed: a mesh file if
+// one was given, the cube otherwise.
+vtkSmartPointer<vtkActor> CreateSurfaceActor(const AppOptions &options, SurfaceWidgets &widgets,
+                                             SharedVolumeCache *volumeCache)
+{
     // Create a mapper
     auto mapper = vtkSmartPointer<vtkPolyDataMapper>::New();
-    mapper->SetInputConnection(cubeSource->GetOutputPort());
+
+    if (!options.meshPath.empty())
+    {
+        // Load a mesh with the parallel readers
+        const auto start = std::chrono::steady_clock::now();
+        auto mesh = ReadMeshFile(options.meshPath);
+        spdlog::info("Loaded {} ({} points, {} cells) in {:.3f} s", options.meshPath,
+                     mesh->GetNumberOfPoints(), mesh->GetNumberOfCells(),
+                     std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+        mapper->SetInputData(mesh);
+    }
+    else if (!options.dicomPath.empty() || !options.volumePath.empty())
+    {
+        // Isosurface the first phase of the series or the volume file
+        auto volume = LoadVolume(options, volumeCache);
+        // Fixed on the whole volume, so that crops keep it
+        const double isoValue =
+            std::isnan(options.isoValue) ? DefaultIsoValue(volume) : options.isoValue;
+        const VolumePipeline pipeline = VolumePipelineOf(options);
+        auto surface = IsosurfaceOf(pipeline, volume, isoValue);
+        mapper->SetInputData(surface);
+        if (options.crop)
+        {
+            widgets.crop = std::make_unique<BoxCropWidget>(
+                volume, surface, [pipeline, isoValue](vtkImageData *cropped) {
+                    return IsosurfaceOf(pipeline, cropped, isoValue);
+                });
+        }
+        if (!options.growRange.empty())
+        {
+            // Seeds are picked on the isosurface
+            widgets.grow = std::make_unique<RegionGrowingTool>(volume, options.growRange[0],
+                                                               options.growRange[1]);
+        }
+    }
+    else
+    {
+        // Create a cube
+        auto cubeSource = vtkSmartPointer<vtkCubeSource>::New();
+        cubeSource->SetXLength(10.0);
+        cubeSource->SetYLength(10.0);
+        cubeSource->SetZLength(10.0);
+        mapper->SetInputConnection(cubeSource->GetOutputPort());
+    }
+
+    if (options.sdfResolution > 0)
+    {
+        // Show the surface rebuilt from its distance field instead
+        mapper->GetInputAlgorithm()->Update();
+        auto surface = DistanceFieldSurface(mapper->GetInput(), options.sdfResolution);
+        mapper->SetInputConnection(surface->GetOutputPort());
+    }
+    if (auto components = NewComponentFilter(options.keepComponents, options.minimumArea))
+    {
+        components->SetInputConnection(mapper->GetInputConnection(0, 0));
+        mapper->SetInputConnection(components->GetOutputPort());
+    }
+    if (options.smoothIterations > 0)
+    {
+        auto smoother = NewSmoother(options.smoothIterations);
+        smoother->SetInputConnection(mapper->GetInputConnection(0, 0));
+        mapper->SetInputConnection(smoother->GetOutputPort());
+    }
+    if (options.measure)
+    {
+        // The whole surface, before any clipping
+        mapper->GetInputAlgorithm()->Update();
+        const auto start = std::chrono::steady_clock::now();
+        const MeshMeasurements measurements = MeasureMesh(mapper->GetInput(), true);
+        LogMeasurements("Surface", measurements);
+        const double seconds =
+            std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        spdlog::info("Measured the surface in {:.3f} s", seconds);
+    }
+    if (!options.savePath.empty())
+    {
+        mapper->GetInputAlgorithm()->Update();
+        CompressedMeshOptions compression;
+        compression.positionBits = options.saveBits;
+        const auto start = std::chrono::steady_clock::now();
+        WriteMeshFile(mapper->GetInput(), options.savePath, compression);
+        const double seconds =
+            std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        spdlog::info("Saved the surface to {} in {:.3f} s", options.savePath, seconds);
+    }
+    if (options.clip)
+    {
+        // Last, so that dragging the plane re-runs nothing else
+        mapper->GetInputAlgorithm()->Update();
+        double bounds[6];
+        mapper->GetInput()->GetBounds(bounds);
+        auto clipper = vtkSmartPointer<ClipPolyDataFilter>::New();
+        clipper->SetInputConnection(mapper->GetInputConnection(0, 0));
+        mapper->SetInputConnection(clipper->GetOutputPort());
+        widgets.clip = std::make_unique<PlaneClipWidget>(clipper, bounds);
+    }
 
     // Create an actor
     auto actor = vtkSmartPointer<vtkActor>::New();
     actor->SetMapper(mapper);
+    return actor;
+}
+
+// One actor per label of the --dicom or --volume segmentation, all extracted
+// in one pass; the boundaries are smoothed before they are split, so that
+// neighboring labels keep meeting. --save writes the boundaries.
+void AddLabelActors(const AppOptions &options, vtkRenderer *renderer,
+                    SharedVolumeCache *volumeCache)
+{
+    auto volume = LoadVolume(options, volumeCache);
+    auto start = std::chrono::steady_clock::now();
+    auto elapsed = [&start]() {
+        const auto now = std::chrono::steady_clock::now();
+        const double seconds = std::chrono::duration<double>(now - start).count();
+        start = now;
+        return seconds;
+    };
+    vtkSmartPointer<vtkPolyData> boundaries = ExtractLabelBoundaries(volume);
+    spdlog::info("Label boundaries: {} points, {} quads in {:.3f} s",
+                 boundaries->GetNumberOfPoints(), boundaries->GetNumberOfPolys(), elapsed());
+    if (options.smoothIterations > 0)
+    {
+        auto smoother = NewSmoother(options.smoothIterations);
+        smoother->SetInputData(boundaries);
+        smoother->Update();
+        boundaries = smoother->GetOutput();
+        spdlog::info("Smoothed the label boundaries in {:.3f} s", elapsed());
+    }
+    if (!options.savePath.empty())
+    {
+        CompressedMeshOptions compression;
+        compression.positionBits = options.saveBits;
+        WriteMeshFile(boundaries, options.savePath, compression);
+        spdlog::info("Saved the label boundaries to {} in {:.3f} s", options.savePath,
+                     elapsed());
+    }
+    const std::vector<LabelSurface> surfaces = SplitLabelBoundaries(boundaries);
+    spdlog::info("Split into {} label surfaces in {:.3f} s", surfaces.size(), elapsed());
+
+    // Hues a golden ratio apart, so that neighboring labels differ
+    double hue = 0.0;
+    for (const LabelSurface &label : surfaces)
+    {
+        auto mapper = vtkSmartPointer<vtkPolyDataMapper>::New();
+        mapper->SetInputData(label.surface);
+        auto actor = vtkSmartPointer<vtkActor>::New();
+        actor->SetMapper(mapper);
+        double rgb[3];
+        vtkMath::HSVToRGB(hue, 0.6, 0.9, rgb, rgb + 1, rgb + 2);
+        actor->GetProperty()->SetColor(rgb);
+        renderer->AddActor(actor);
+        hue = std::fmod(hue + 0.618033988749895, 1.0);
+    }
+}
+
+// Appends the path, size and modification time of a file to key
+void AppendFileState(std::string &key, const std::filesystem::path &file)
+{
+    std::error_code error;
+    const auto size = std::filesystem::file_size(file, error);
+    const auto changed = std::filesystem::last_write_time(file, error);
+    if (!error)
+    {
+        key += file.string() + " " + std::to_string(size) + " " +
+               std::to_string(changed.time_since_epoch().count()) + "\n";
+    }
+}
+
+// The scene the options build: the arguments and the sizes and times of
+// their input files. Directories list every file under them, since
+// rewriting a slice in place leaves the directory's own time alone.
+std::string SceneSnapshotKey(const AppOptions &options)
+{
+    std::string key = options.sceneArguments;
+    for (const std::string &input : {options.meshPath, options.volumePath, options.dicomPath})
+    {
+        std::error_code error;
+        if (input.empty())
+        {
+            continue;
+        }
+        if (!std::filesystem::is_directory(input, error))
+        {
+            AppendFileState(key, input);
+            continue;
+        }
+        std::vector<std::filesystem::path> files;
+        std::filesystem::recursive_directory_iterator it(
+            input, std::filesystem::directory_options::skip_permission_denied, error);
+        for (; !error && it != std::filesystem::recursive_directory_iterator(); it.increment(error))
+        {
+            if (it->is_regular_file(error))
+            {
+                files.push_back(it->path());
+            }
+        }
+        std::sort(files.begin(), files.end());
+        for (const std::filesystem::path &file : files)
+        {
+            AppendFileState(key, file);
+        }
+    }
+    return key;
+}
+
+int Run(const AppOptions &options)
+{
+    if (!options.benchmark.empty())
+    {
+        if (!RunBenchmark(options.benchmark, options.benchmarkArgs))
+        {
+            spdlog::error("unknown benchmark {}", options.benchmark);
+            return 1;
+        }
+        return 0;
+    }
+    if (!options.octreeInput.empty())
+    {
+        BuildPointOctree(options.octreeInput, options.octreeOutput);
+        return 0;
+    }
+    InitializeRenderingModules();
+
+    // Declared before everything attached to it, which detaches from it when
+    // destroyed; nothing else keeps it alive
+    auto renderWindowInteractor = vtkSmartPointer<vtkRenderWindowInteractor>::New();
+
+    std::unique_ptr<OctreePointCloud> pointCloud;
+    if (!options.octreePath.empty())
+    {
+        pointCloud = std::make_unique<OctreePointCloud>(options.octreePath);
+        pointCloud->SetPointBudget(options.pointBudget);
+    }
+
+    std::unique_ptr<PhasePlayback> playback;
+    if (options.play)
+    {
+        // Workers start prefetching while the window opens
+        const double isoValue = options.isoValue;
+        PhasePlayback::Preprocessor preprocess = NewPreprocessor(options);
+        if (options.incremental)
+        {
+            // One extractor shared by the workers, so each phase diffs against the last one.
+            // The default isovalue is fixed on the first phase; a new one re-extracts everything.
+            // Blocks are neither smoothed nor cut to components, since either would need the
+            // whole surface.
+            struct Shared
+            {
+                IncrementalIsosurface extractor;
+                std::once_flag once;
+                double isoValue;
+            };
+            auto shared = std::make_shared<Shared>();
+            shared->isoValue = isoValue;
+            preprocess = [shared](vtkImageData *volume) {
+                std::call_once(shared->once, [&] {
+                    if (std::isnan(shared->isoValue))
+                    {
+                        shared->isoValue = DefaultIsoValue(volume);
+                    }
+                });
+                return shared->extractor.Update(volume, shared->isoValue);
+            };
+        }
+        playback = std::make_unique<PhasePlayback>(LoadDicomPhases(options), preprocess,
+                                                   options.ringSize);
+    }
 
-    // Create a renderer
+    std::unique_ptr<DicomSpoolWatcher> watcher;
+    if (!options.watchPath.empty())
+    {
+        // Series already in the folder are processed while the window opens
+        watcher = std::make_unique<DicomSpoolWatcher>(options.watchPath, NewPreprocessor(options),
+                                                      options.settleSeconds);
+    }
+
+    // Create a renderer and a render window
     auto renderer = vtkSmartPointer<vtkRenderer>::New();
-    renderer->AddActor(actor);
     renderer->SetBackground(0.1, 0.2, 0.4);
-
-    // Create a render window
     auto renderWindow = vtkSmartPointer<vtkRenderWindow>::New();
     renderWindow->AddRenderer(renderer);
     renderWindow->SetSize(600, 600);
 
-    // Create a render window interactor
-    auto renderWindowInteractor = vtkSmartPointer<vtkRenderWindowInteractor>::New();
+    // A snapshot of the same scene replaces building it
+    const std::string snapshotKey = SceneSnapshotKey(options);
+    const bool restored = !options.snapshotPath.empty() &&
+                          RestoreSceneSnapshot(options.snapshotPath, snapshotKey, renderer,
+                                               renderWindow);
+
+    // Volumes shared with other viewers stay held until the window closes
+    std::unique_ptr<SharedVolumeCache> volumeCache;
+    if (!options.volumeCache.empty() && !restored)
+    {
+        volumeCache = std::make_unique<SharedVolumeCache>(options.volumeCache);
+    }
+
+    SurfaceWidgets widgets;
+    if (!pointCloud && !playback && !watcher && !restored)
+    {
+        if (options.labels)
+        {
+            AddLabelActors(options, renderer, volumeCache.get());
+        }
+        else
+        {
+            renderer->AddActor(CreateSurfaceActor(options, widgets, volumeCache.get()));
+        }
+    }
+    if (!options.glbPath.empty())
+    {
+        GLBExportOptions exportOptions;
+        exportOptions.levels = options.glbLevels;
+        ExportSceneGLB(renderer, options.glbPath, exportOptions);
+    }
+
     renderWindowInteractor->SetRenderWindow(renderWindow);
 
+    if (pointCloud)
+    {
+        // Stream octree nodes on every render; the timer needs an initialized interactor
+        renderWindowInteractor->Initialize();
+        pointCloud->Attach(renderer, renderWindowInteractor);
+        double bounds[6];
+        pointCloud->GetBounds(bounds);
+        renderer->ResetCamera(bounds);
+    }
+    if (playback)
+    {
+        // Frames are swapped in from a timer, which needs an initialized interactor
+        renderWindowInteractor->Initialize();
+        playback->Attach(renderer, renderWindowInteractor, options.framesPerSecond);
+    }
+    if (watcher)
+    {
+        // Completed series are swapped in from a timer as well
+        renderWindowInteractor->Initialize();
+        watcher->Attach(renderer, renderWindowInteractor);
+    }
+
+    if (widgets.clip)
+    {
+        widgets.clip->Attach(renderer, renderWindowInteractor);
+    }
+    if (widgets.crop)
+    {
+        widgets.crop->Attach(renderer, renderWindowInteractor);
+    }
+    if (widgets.grow)
+    {
+        // Region surfaces are swapped in from a timer
+        renderWindowInteractor->Initialize();
+        widgets.grow->Attach(renderer, renderWindowInteractor);
+    }
+
     // Start rendering
+    MarkStartupPhase("scene");
     renderWindow->Render();
-    renderWindowInteractor->Start();
+    MarkStartupPhase("first frame");
+    spdlog::info("First frame after {:.3f} s ({})", SecondsSinceStartup(),
+                 restored ? "warm start from the scene snapshot" : "cold start");
+    if (options.startupProfile)
+    {
+        LogStartupProfile();
+    }
+    else
+    {
+        renderWindowInteractor->Start();
+    }
+
+    if (!options.snapshotPath.empty() && !restored)
+    {
+        // With the camera as it was left
+        WriteSceneSnapshot(options.snapshotPath, snapshotKey, renderer, renderWindow);
+    }
+
+    if (playback)
+    {
+        playback->LogStats();
+    }
+    if (watcher)
+    {
+        watcher->LogStats();
+    }
+    if (widgets.clip)
+    {
+        widgets.clip->LogStats();
+    }
+    if (widgets.grow)
+    {
+        widgets.grow->LogStats();
+    }
 
     return 0;
 }
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    MarkStartupPhase("static initialization");
+    AppOptions options;
+    try
+    {
+        options = ParseOptions(argc, argv);
+    }
+    catch (const std::exception &e)
+    {
+        spdlog::error("{}", e.what());
+        PrintUsage(argv[0]);
+        return 1;
+    }
+    if (options.showHelp)
+    {
+        PrintUsage(argv[0]);
+        return 0;
+    }
+
+    MarkStartupPhase("options");
+
+    try
+    {
+        return Run(options);
+    }
+    catch (const std::exception &e)
+    {
+        spdlog::error("{}", e.what());
+        return 1;
+    }
+}
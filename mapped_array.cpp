@@ -0,0 +1,47 @@
+#include "mapped_array.h"
+
+#include <mutex>
+#include <unordered_map>
+
+namespace
+{
+
+// Mappings that back arrays, by the address of the array data; the arrays
+// release them through ReleaseMapping
+struct MappingRegistry
+{
+    std::mutex mutex;
+    std::unordered_map<const void *, std::shared_ptr<const MappedFile>> mappings;
+};
+
+MappingRegistry &Registry()
+{
+    static MappingRegistry registry;
+    return registry;
+}
+
+void ReleaseMapping(void *data)
+{
+    MappingRegistry &registry = Registry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    registry.mappings.erase(data);
+}
+
+} // namespace
+
+vtkSmartPointer<vtkDataArray> MapArray(const std::shared_ptr<const MappedFile> &file,
+                                       std::size_t offset, int vtkType, int components,
+                                       vtkIdType tuples)
+{
+    auto array = vtkSmartPointer<vtkDataArray>::Take(vtkDataArray::CreateDataArray(vtkType));
+    array->SetNumberOfComponents(components);
+    char *data = const_cast<char *>(file->data()) + offset;
+    {
+        MappingRegistry &registry = Registry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        registry.mappings[data] = file;
+    }
+    array->SetVoidArray(data, tuples * components, 0, VTK_DATA_ARRAY_USER_DEFINED);
+    array->SetArrayFreeFunction(ReleaseMapping);
+    return array;
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+#include "mapped_file.h"
+
+#include <vtkDataArray.h>
+#include <vtkSmartPointer.h>
+
+#include <cstddef>
+#include <memory>
+
+// Array of tuples x components values of vtkType stored in file at offset,
+// without a copy. The array keeps the mapping alive until it is deleted; map
+// the file copy-on-write if the array may be written to.
+vtkSmartPointer<vtkDataArray> MapArray(const std::shared_ptr<const MappedFile> &file,
+                                       std::size_t offset, int vtkType, int components,
+                                       vtkIdType tuples);
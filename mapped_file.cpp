@@ -0,0 +1,126 @@
+#include "mapped_file.h"
+
+#include <stdexcept>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+
+MappedFile::MappedFile(const std::string &path, bool copyOnWrite)
+    : path_(path)
+{
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                              OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        throw std::runtime_error("cannot open " + path);
+    }
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size))
+    {
+        CloseHandle(file);
+        throw std::runtime_error("cannot stat " + path);
+    }
+    fileHandle_ = file;
+    size_ = static_cast<std::size_t>(size.QuadPart);
+    if (size_ == 0)
+    {
+        return;
+    }
+
+    HANDLE mapping = CreateFileMappingA(file, nullptr, copyOnWrite ? PAGE_WRITECOPY : PAGE_READONLY,
+                                        0, 0, nullptr);
+    if (!mapping)
+    {
+        CloseHandle(file);
+        throw std::runtime_error("cannot map " + path);
+    }
+    mappingHandle_ = mapping;
+    const DWORD access = copyOnWrite ? FILE_MAP_COPY : FILE_MAP_READ;
+    data_ = static_cast<const char *>(MapViewOfFile(mapping, access, 0, 0, 0));
+    if (!data_)
+    {
+        CloseHandle(mapping);
+        CloseHandle(file);
+        throw std::runtime_error("cannot map " + path);
+    }
+}
+
+MappedFile::~MappedFile()
+{
+    if (data_)
+    {
+        UnmapViewOfFile(data_);
+    }
+    if (mappingHandle_)
+    {
+        CloseHandle(mappingHandle_);
+    }
+    if (fileHandle_)
+    {
+        CloseHandle(fileHandle_);
+    }
+}
+
+void MappedFile::AdviseSequential() const
+{
+}
+
+#else
+
+MappedFile::MappedFile(const std::string &path, bool copyOnWrite)
+    : path_(path)
+{
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        throw std::runtime_error("cannot open " + path);
+    }
+    struct stat st;
+    if (::fstat(fd, &st) != 0)
+    {
+        ::close(fd);
+        throw std::runtime_error("cannot stat " + path);
+    }
+    size_ = static_cast<std::size_t>(st.st_size);
+    if (size_ > 0)
+    {
+        const int protection = copyOnWrite ? PROT_READ | PROT_WRITE : PROT_READ;
+        void *ptr = ::mmap(nullptr, size_, protection, MAP_PRIVATE, fd, 0);
+        if (ptr == MAP_FAILED)
+        {
+            ::close(fd);
+            throw std::runtime_error("cannot map " + path);
+        }
+        data_ = static_cast<const char *>(ptr);
+    }
+    // The mapping keeps the file alive; the descriptor is no longer needed
+    ::close(fd);
+}
+
+MappedFile::~MappedFile()
+{
+    if (data_)
+    {
+        ::munmap(const_cast<char *>(data_), size_);
+    }
+}
+
+void MappedFile::AdviseSequential() const
+{
+    if (data_)
+    {
+        ::madvise(const_cast<char *>(data_), size_, MADV_SEQUENTIAL);
+        ::madvise(const_cast<char *>(data_), size_, MADV_WILLNEED);
+    }
+}
+
+#endif
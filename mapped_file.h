@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+// Read-only memory mapping of a whole file. Throws std::runtime_error if the
+// file cannot be opened or mapped. Empty files map to a null/zero-size view.
+//
+// Copy-on-write mappings may also be written through a const_cast of data():
+// touched pages become private copies and the file is never modified. They
+// back arrays handed to code that assumes it owns writable memory.
+class MappedFile
+{
+public:
+    explicit MappedFile(const std::string &path, bool copyOnWrite = false);
+    ~MappedFile();
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    const char *data() const { return data_; }
+    std::size_t size() const { return size_; }
+    const std::string &path() const { return path_; }
+
+    // Hint the kernel that the mapping will be read front to back.
+    void AdviseSequential() const;
+
+private:
+    std::string path_;
+    const char *data_ = nullptr;
+    std::size_t size_ = 0;
+#ifdef _WIN32
+    void *fileHandle_ = nullptr;
+    void *mappingHandle_ = nullptr;
+#endif
+};
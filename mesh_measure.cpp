@@ -0,0 +1,174 @@
+// Batch measurement of meshes: mesh_measure [--thickness] [--csv FILE] PATH...
+//
+// Every PATH is a mesh file or a directory searched recursively for .stl,
+// .ply, .obj and .qmesh files. Each mesh is read and measured in parallel,
+// one after another; a mesh that fails is logged and skipped.
+
+#include "mesh_measurements.h"
+#include "mesh_readers.h"
+
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+void PrintUsage(const char *program)
+{
+    spdlog::info("Usage: {} [--thickness] [--csv FILE] PATH...", program);
+    spdlog::info("  PATH                   mesh file, or directory searched for mesh files");
+    spdlog::info("  --thickness            also ray-cast the wall thickness at every point");
+    spdlog::info("  --csv FILE             write one row of measurements per mesh to FILE");
+    spdlog::info("  -h, --help             show this help");
+}
+
+bool IsMeshFile(const std::filesystem::path &path)
+{
+    std::string extension = path.extension().string();
+    std::transform(extension.begin(), extension.end(), extension.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    return extension == ".stl" || extension == ".ply" || extension == ".obj" ||
+           extension == ".qmesh";
+}
+
+std::vector<std::string> CollectMeshFiles(const std::vector<std::string> &arguments)
+{
+    namespace fs = std::filesystem;
+    std::vector<std::string> paths;
+    for (const std::string &argument : arguments)
+    {
+        if (!fs::is_directory(argument))
+        {
+            paths.push_back(argument);
+            continue;
+        }
+        std::vector<std::string> found;
+        for (const fs::directory_entry &entry : fs::recursive_directory_iterator(
+                 argument, fs::directory_options::skip_permission_denied))
+        {
+            if (entry.is_regular_file() && IsMeshFile(entry.path()))
+            {
+                found.push_back(entry.path().string());
+            }
+        }
+        std::sort(found.begin(), found.end());
+        paths.insert(paths.end(), found.begin(), found.end());
+    }
+    return paths;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    bool thickness = false;
+    std::string csvPath;
+    std::vector<std::string> arguments;
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+        if (arg == "-h" || arg == "--help")
+        {
+            PrintUsage(argv[0]);
+            return 0;
+        }
+        else if (arg == "--thickness")
+        {
+            thickness = true;
+        }
+        else if (arg == "--csv")
+        {
+            if (i + 1 >= argc)
+            {
+                spdlog::error("Missing value for --csv");
+                PrintUsage(argv[0]);
+                return 1;
+            }
+            csvPath = argv[++i];
+        }
+        else if (!arg.empty() && arg[0] == '-')
+        {
+            spdlog::error("Unknown option: {}", arg);
+            PrintUsage(argv[0]);
+            return 1;
+        }
+        else
+        {
+            arguments.push_back(arg);
+        }
+    }
+    if (arguments.empty())
+    {
+        PrintUsage(argv[0]);
+        return 1;
+    }
+
+    try
+    {
+        const std::vector<std::string> paths = CollectMeshFiles(arguments);
+        std::ofstream csv;
+        if (!csvPath.empty())
+        {
+            csv.open(csvPath);
+            if (!csv)
+            {
+                throw std::runtime_error("Cannot write " + csvPath);
+            }
+            csv << "path,points,triangles,boundary_points,area,volume,mean_curvature,"
+                   "gaussian_curvature,total_gaussian_curvature,thickness_samples,"
+                   "mean_thickness,min_thickness,max_thickness,seconds\n";
+            csv.precision(10);
+        }
+
+        const auto start = std::chrono::steady_clock::now();
+        std::size_t failed = 0;
+        vtkIdType triangles = 0;
+        for (const std::string &path : paths)
+        {
+            const auto meshStart = std::chrono::steady_clock::now();
+            try
+            {
+                const MeshMeasurements m = MeasureMesh(ReadMeshFile(path), thickness);
+                const double seconds = std::chrono::duration<double>(
+                                           std::chrono::steady_clock::now() - meshStart)
+                                           .count();
+                LogMeasurements(path, m);
+                triangles += m.triangles;
+                if (csv.is_open())
+                {
+                    csv << '"' << path << "\"," << m.points << ',' << m.triangles << ','
+                        << m.boundaryPoints << ',' << m.area << ',' << m.volume << ','
+                        << m.meanCurvature << ',' << m.gaussianCurvature << ','
+                        << m.totalGaussianCurvature << ',' << m.thicknessSamples << ','
+                        << m.meanThickness << ',' << m.minThickness << ',' << m.maxThickness
+                        << ',' << seconds << '\n';
+                }
+            }
+            catch (const std::exception &e)
+            {
+                spdlog::error("{}: {}", path, e.what());
+                ++failed;
+            }
+        }
+        const double seconds =
+            std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        spdlog::info("Measured {} of {} meshes ({} triangles) in {:.3f} s, {:.2f} ms per mesh",
+                     paths.size() - failed, paths.size(), triangles, seconds,
+                     paths.empty() ? 0.0 : 1000.0 * seconds / static_cast<double>(paths.size()));
+        return failed == 0 ? 0 : 1;
+    }
+    catch (const std::exception &e)
+    {
+        spdlog::error("{}", e.what());
+        return 1;
+    }
+}
@@ -0,0 +1,304 @@
+#include "mesh_measurements.h"
+
+#include "triangle_bvh.h"
+
+#include <vtkSMPThreadLocal.h>
+#include <vtkSMPTools.h>
+
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <numbers>
+#include <vector>
+
+namespace
+{
+
+void Subtract(const double *a, const double *b, double *out)
+{
+    out[0] = a[0] - b[0];
+    out[1] = a[1] - b[1];
+    out[2] = a[2] - b[2];
+}
+
+double Dot(const double *a, const double *b)
+{
+    return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+}
+
+void Cross(const double *a, const double *b, double *out)
+{
+    out[0] = a[1] * b[2] - a[2] * b[1];
+    out[1] = a[2] * b[0] - a[0] * b[2];
+    out[2] = a[0] * b[1] - a[1] * b[0];
+}
+
+struct SurfaceSums
+{
+    double area = 0.0;
+    double volume = 0.0;
+};
+
+struct CurvatureSums
+{
+    vtkIdType boundaryPoints = 0;
+    double interiorArea = 0.0;
+    double meanCurvature = 0.0;     // integral over the interior area
+    double gaussianCurvature = 0.0; // integral over the interior area
+};
+
+struct ThicknessSums
+{
+    vtkIdType samples = 0;
+    double sum = 0.0;
+    double min = std::numeric_limits<double>::max();
+    double max = 0.0;
+};
+
+// Triangles around each point: offsets has a row per point (plus one), and
+// the triangles of a row are ascending.
+void BuildPointTriangles(const std::vector<std::int32_t> &triangles, std::size_t numberOfPoints,
+                         std::vector<vtkIdType> &offsets, std::vector<std::int32_t> &rows)
+{
+    const auto numberOfCorners = static_cast<vtkIdType>(triangles.size());
+    std::vector<std::uint64_t> keys(triangles.size());
+    vtkSMPTools::For(0, numberOfCorners, [&](vtkIdType begin, vtkIdType end) {
+        for (vtkIdType corner = begin; corner < end; ++corner)
+        {
+            keys[corner] = (static_cast<std::uint64_t>(triangles[corner]) << 32) |
+                           static_cast<std::uint64_t>(corner / 3);
+        }
+    });
+    vtkSMPTools::Sort(keys.begin(), keys.end());
+
+    offsets.resize(numberOfPoints + 1);
+    vtkSMPTools::For(0, static_cast<vtkIdType>(numberOfPoints + 1),
+                     [&](vtkIdType begin, vtkIdType end) {
+                         for (vtkIdType point = begin; point < end; ++point)
+                         {
+                             offsets[point] =
+                                 std::lower_bound(keys.begin(), keys.end(),
+                                                  static_cast<std::uint64_t>(point) << 32) -
+                                 keys.begin();
+                         }
+                     });
+    rows.resize(keys.size());
+    vtkSMPTools::For(0, numberOfCorners, [&](vtkIdType begin, vtkIdType end) {
+        for (vtkIdType i = begin; i < end; ++i)
+        {
+            rows[i] = static_cast<std::int32_t>(keys[i] & 0xffffffffu);
+        }
+    });
+}
+
+} // namespace
+
+MeshMeasurements MeasureMesh(vtkPolyData *mesh, bool thickness)
+{
+    // Welds the points and triangulates; throws if there are no polygons
+    const TriangleBVH bvh(mesh);
+    const std::vector<double> &points = bvh.GetPoints();
+    const std::vector<std::int32_t> &triangles = bvh.GetTriangles();
+    const std::size_t numberOfPoints = points.size() / 3;
+    const vtkIdType numberOfTriangles = bvh.GetNumberOfTriangles();
+
+    MeshMeasurements result;
+    result.points = static_cast<vtkIdType>(numberOfPoints);
+    result.triangles = numberOfTriangles;
+
+    // Area, and volume as the sum of the signed tetrahedra to the origin
+    vtkSMPThreadLocal<SurfaceSums> localSurface;
+    vtkSMPTools::For(0, numberOfTriangles, [&](vtkIdType begin, vtkIdType end) {
+        SurfaceSums &sums = localSurface.Local();
+        for (vtkIdType t = begin; t < end; ++t)
+        {
+            const double *p0 = &points[3 * triangles[3 * t]];
+            const double *p1 = &points[3 * triangles[3 * t + 1]];
+            const double *p2 = &points[3 * triangles[3 * t + 2]];
+            double u[3], v[3], n[3], c[3];
+            Subtract(p1, p0, u);
+            Subtract(p2, p0, v);
+            Cross(u, v, n);
+            sums.area += 0.5 * std::sqrt(Dot(n, n));
+            Cross(p1, p2, c);
+            sums.volume += Dot(p0, c) / 6.0;
+        }
+    });
+    for (const SurfaceSums &sums : localSurface)
+    {
+        result.area += sums.area;
+        result.volume += sums.volume;
+    }
+    // Normals below point out of the enclosed volume
+    const double outward = result.volume < 0.0 ? -1.0 : 1.0;
+
+    std::vector<vtkIdType> offsets;
+    std::vector<std::int32_t> pointTriangles;
+    BuildPointTriangles(triangles, numberOfPoints, offsets, pointTriangles);
+
+    // Per point: angle deficit, cotangent Laplacian and angle-weighted normal
+    // over the triangles around it. A point is on the boundary unless every
+    // neighbor is shared by exactly two of its triangles.
+    std::vector<double> normals(3 * numberOfPoints, 0.0);
+    vtkSMPThreadLocal<CurvatureSums> localCurvature;
+    vtkSMPThreadLocal<std::vector<std::int32_t>> localNeighbors;
+    vtkSMPTools::For(0, static_cast<vtkIdType>(numberOfPoints), [&](vtkIdType begin,
+                                                                    vtkIdType end) {
+        CurvatureSums &sums = localCurvature.Local();
+        std::vector<std::int32_t> &neighbors = localNeighbors.Local();
+        for (vtkIdType point = begin; point < end; ++point)
+        {
+            const double *p = &points[3 * point];
+            double angles = 0.0;
+            double area = 0.0;
+            double laplacian[3] = {0.0, 0.0, 0.0};
+            double *normal = &normals[3 * point];
+            neighbors.clear();
+            for (vtkIdType i = offsets[point]; i < offsets[point + 1]; ++i)
+            {
+                const std::int32_t *corners = &triangles[3 * pointTriangles[i]];
+                const int k = corners[0] == point ? 0 : (corners[1] == point ? 1 : 2);
+                const std::int32_t qi = corners[(k + 1) % 3];
+                const std::int32_t ri = corners[(k + 2) % 3];
+                neighbors.push_back(qi);
+                neighbors.push_back(ri);
+
+                const double *q = &points[3 * qi];
+                const double *r = &points[3 * ri];
+                double pq[3], pr[3], qr[3], n[3];
+                Subtract(q, p, pq);
+                Subtract(r, p, pr);
+                Subtract(r, q, qr);
+                Cross(pq, pr, n);
+                const double twiceArea = std::sqrt(Dot(n, n));
+                if (twiceArea == 0.0)
+                {
+                    continue;
+                }
+                const double angle = std::atan2(twiceArea, Dot(pq, pr));
+                angles += angle;
+                area += twiceArea / 6.0;
+                // Cotangents of the angles at q and at r
+                const double cotQ = -Dot(pq, qr) / twiceArea;
+                const double cotR = Dot(pr, qr) / twiceArea;
+                for (int axis = 0; axis < 3; ++axis)
+                {
+                    laplacian[axis] += cotR * pq[axis] + cotQ * pr[axis];
+                    normal[axis] += angle * n[axis] / twiceArea;
+                }
+            }
+
+            std::sort(neighbors.begin(), neighbors.end());
+            bool interior = !neighbors.empty();
+            for (std::size_t i = 0; interior && i < neighbors.size(); i += 2)
+            {
+                interior = i + 1 < neighbors.size() && neighbors[i] == neighbors[i + 1] &&
+                           (i + 2 == neighbors.size() || neighbors[i + 2] != neighbors[i]);
+            }
+            if (!interior)
+            {
+                ++sums.boundaryPoints;
+            }
+            else if (area > 0.0)
+            {
+                // The Laplacian points to the inside of convex surfaces, which
+                // have positive mean curvature
+                const double length = std::sqrt(Dot(laplacian, laplacian));
+                const double sign = outward * Dot(laplacian, normal) > 0.0 ? -1.0 : 1.0;
+                sums.interiorArea += area;
+                sums.meanCurvature += sign * 0.25 * length;
+                sums.gaussianCurvature += 2.0 * std::numbers::pi - angles;
+            }
+            const double length = std::sqrt(Dot(normal, normal));
+            for (int axis = 0; axis < 3; ++axis)
+            {
+                normal[axis] = length > 0.0 ? outward * normal[axis] / length : 0.0;
+            }
+        }
+    });
+    double interiorArea = 0.0;
+    for (const CurvatureSums &sums : localCurvature)
+    {
+        result.boundaryPoints += sums.boundaryPoints;
+        interiorArea += sums.interiorArea;
+        result.meanCurvature += sums.meanCurvature;
+        result.totalGaussianCurvature += sums.gaussianCurvature;
+    }
+    if (interiorArea > 0.0)
+    {
+        result.meanCurvature /= interiorArea;
+        result.gaussianCurvature = result.totalGaussianCurvature / interiorArea;
+    }
+
+    if (!thickness)
+    {
+        return result;
+    }
+
+    // Rays start on the surface, so the triangles around their origin are
+    // skipped by a minimum distance
+    double bounds[6];
+    bvh.GetBounds(bounds);
+    const double diagonal =
+        std::sqrt((bounds[1] - bounds[0]) * (bounds[1] - bounds[0]) +
+                  (bounds[3] - bounds[2]) * (bounds[3] - bounds[2]) +
+                  (bounds[5] - bounds[4]) * (bounds[5] - bounds[4]));
+    const double minDistance = 1e-6 * diagonal;
+    vtkSMPThreadLocal<ThicknessSums> localThickness;
+    vtkSMPTools::For(0, static_cast<vtkIdType>(numberOfPoints), [&](vtkIdType begin,
+                                                                    vtkIdType end) {
+        ThicknessSums &sums = localThickness.Local();
+        TriangleBVH::Hit hit;
+        for (vtkIdType point = begin; point < end; ++point)
+        {
+            const double *normal = &normals[3 * point];
+            if (Dot(normal, normal) == 0.0)
+            {
+                continue;
+            }
+            const double inward[3] = {-normal[0], -normal[1], -normal[2]};
+            if (bvh.IntersectRay(&points[3 * point], inward, minDistance, diagonal, hit))
+            {
+                const double distance = std::sqrt(hit.distance2);
+                ++sums.samples;
+                sums.sum += distance;
+                sums.min = std::min(sums.min, distance);
+                sums.max = std::max(sums.max, distance);
+            }
+        }
+    });
+    double minThickness = std::numeric_limits<double>::max();
+    for (const ThicknessSums &sums : localThickness)
+    {
+        result.thicknessSamples += sums.samples;
+        result.meanThickness += sums.sum;
+        minThickness = std::min(minThickness, sums.min);
+        result.maxThickness = std::max(result.maxThickness, sums.max);
+    }
+    if (result.thicknessSamples > 0)
+    {
+        result.meanThickness /= static_cast<double>(result.thicknessSamples);
+        result.minThickness = minThickness;
+    }
+    return result;
+}
+
+void LogMeasurements(const std::string &name, const MeshMeasurements &measurements)
+{
+    spdlog::info("{}: {} points ({} on the boundary), {} triangles", name, measurements.points,
+                 measurements.boundaryPoints, measurements.triangles);
+    spdlog::info("{}: area {:.6g}, volume {:.6g}", name, measurements.area,
+                 std::abs(measurements.volume));
+    spdlog::info("{}: mean curvature {:.6g}, Gaussian curvature {:.6g} (total {:.4f} pi)", name,
+                 measurements.meanCurvature, measurements.gaussianCurvature,
+                 measurements.totalGaussianCurvature / std::numbers::pi);
+    if (measurements.thicknessSamples > 0)
+    {
+        spdlog::info("{}: thickness {:.6g} mean, {:.6g} min, {:.6g} max over {} points", name,
+                     measurements.meanThickness, measurements.minThickness,
+                     measurements.maxThickness, measurements.thicknessSamples);
+    }
+}
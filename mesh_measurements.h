@@ -0,0 +1,44 @@
+#pragma once
+
+#include <vtkPolyData.h>
+#include <vtkType.h>
+
+#include <string>
+
+// Measurements of a triangulated surface, as vtkMassProperties and
+// vtkCurvatures report them, computed as parallel reductions.
+struct MeshMeasurements
+{
+    // After welding points with identical coordinates
+    vtkIdType points = 0;
+    vtkIdType triangles = 0;
+    vtkIdType boundaryPoints = 0;
+
+    double area = 0.0;
+    // Enclosed volume by the divergence theorem; negative when the triangles
+    // face inward, and only meaningful for closed surfaces
+    double volume = 0.0;
+
+    // Area-weighted means over the interior points of the discrete mean
+    // curvature (cotangent Laplacian) and Gaussian curvature (angle deficit),
+    // and the integral of the Gaussian curvature, 2 pi times the Euler
+    // characteristic of a closed surface
+    double meanCurvature = 0.0;
+    double gaussianCurvature = 0.0;
+    double totalGaussianCurvature = 0.0;
+
+    // Wall thickness: distance from every point along its inward normal to
+    // the opposite wall, over the points whose ray hits one
+    vtkIdType thicknessSamples = 0;
+    double meanThickness = 0.0;
+    double minThickness = 0.0;
+    double maxThickness = 0.0;
+};
+
+// Measures the polygons of mesh (as triangle fans). Thickness needs a ray per
+// point and is only computed when asked for. Throws std::invalid_argument if
+// the mesh has no polygons.
+MeshMeasurements MeasureMesh(vtkPolyData *mesh, bool thickness = false);
+
+// Logs the measurements of the mesh called name
+void LogMeasurements(const std::string &name, const MeshMeasurements &measurements);
@@ -0,0 +1,1252 @@
+#include "mesh_readers.h"
+#include "compressed_mesh.h"
+#include "mapped_file.h"
+#include "vtkhdf_io.h"
+
+#include <vtkCellArray.h>
+#include <vtkFloatArray.h>
+#include <vtkIdTypeArray.h>
+#include <vtkPointData.h>
+#include <vtkPoints.h>
+#include <vtkSMPTools.h>
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cctype>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <numeric>
+#include <stdexcept>
+#include <string_view>
+#include <vector>
+
+namespace
+{
+
+// Chunks smaller than this are not worth a task of their own
+constexpr std::size_t kMinChunkBytes = std::size_t(1) << 20;
+
+struct Range
+{
+    const char *begin;
+    const char *end;
+};
+
+// Splits [begin, end) into roughly equal ranges that end just after a
+// newline, so that every range holds whole lines.
+std::vector<Range> SplitOnLines(const char *begin, const char *end)
+{
+    const std::size_t size = static_cast<std::size_t>(end - begin);
+    const std::size_t threads = static_cast<std::size_t>(
+        std::max(1, vtkSMPTools::GetEstimatedNumberOfThreads()));
+    const std::size_t chunks = std::clamp<std::size_t>(size / kMinChunkBytes, 1, threads * 8);
+
+    std::vector<Range> ranges;
+    const char *start = begin;
+    for (std::size_t i = 1; i <= chunks && start < end; ++i)
+    {
+        const char *stop = (i == chunks) ? end : std::max(start, begin + size * i / chunks);
+        if (stop < end)
+        {
+            const void *nl = std::memchr(stop, '\n', static_cast<std::size_t>(end - stop));
+            stop = nl ? static_cast<const char *>(nl) + 1 : end;
+        }
+        if (stop > start)
+        {
+            ranges.push_back({start, stop});
+        }
+        start = stop;
+    }
+    return ranges;
+}
+
+inline bool IsBlank(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+inline const char *SkipBlanks(const char *p, const char *end)
+{
+    while (p < end && IsBlank(*p))
+    {
+        ++p;
+    }
+    return p;
+}
+
+inline const char *SkipToken(const char *p, const char *end)
+{
+    while (p < end && !IsBlank(*p))
+    {
+        ++p;
+    }
+    return p;
+}
+
+// Calls fn(first, eol) for every non-empty line of the range, with leading
+// blanks already skipped.
+template <typename LineFn>
+void ForEachLine(const Range &range, LineFn &&fn)
+{
+    const char *p = range.begin;
+    while (p < range.end)
+    {
+        const void *nl = std::memchr(p, '\n', static_cast<std::size_t>(range.end - p));
+        const char *eol = nl ? static_cast<const char *>(nl) : range.end;
+        const char *first = SkipBlanks(p, eol);
+        if (first < eol)
+        {
+            fn(first, eol);
+        }
+        p = (eol < range.end) ? eol + 1 : range.end;
+    }
+}
+
+inline bool StartsWithKeyword(const char *p, const char *eol, std::string_view keyword)
+{
+    const auto length = static_cast<std::ptrdiff_t>(keyword.size());
+    return eol - p > length && std::memcmp(p, keyword.data(), keyword.size()) == 0 &&
+           IsBlank(p[length]);
+}
+
+// Parses one number after optional blanks. Returns nullptr on failure.
+template <typename T>
+const char *ParseNumber(const char *p, const char *end, T &value)
+{
+    p = SkipBlanks(p, end);
+    if (p < end && *p == '+')
+    {
+        ++p;
+    }
+    auto [ptr, ec] = std::from_chars(p, end, value);
+    return ec == std::errc() ? ptr : nullptr;
+}
+
+vtkSmartPointer<vtkFloatArray> NewFloatTuples(vtkIdType count, const char *name = nullptr)
+{
+    auto array = vtkSmartPointer<vtkFloatArray>::New();
+    array->SetNumberOfComponents(3);
+    array->SetNumberOfTuples(count);
+    if (name)
+    {
+        array->SetName(name);
+    }
+    return array;
+}
+
+vtkSmartPointer<vtkIdTypeArray> NewIds(vtkIdType count)
+{
+    auto array = vtkSmartPointer<vtkIdTypeArray>::New();
+    array->SetNumberOfValues(count);
+    return array;
+}
+
+// Offsets 0, n, 2n, ... and connectivity 0, 1, 2, ... for cells of a fixed
+// size that use the points in order.
+vtkSmartPointer<vtkCellArray> NewSequentialCells(vtkIdType numCells, vtkIdType cellSize)
+{
+    auto offsets = NewIds(numCells + 1);
+    auto connectivity = NewIds(numCells * cellSize);
+    vtkIdType *off = offsets->GetPointer(0);
+    vtkIdType *conn = connectivity->GetPointer(0);
+    vtkSMPTools::For(0, numCells + 1, [&](vtkIdType begin, vtkIdType end) {
+        for (vtkIdType i = begin; i < end; ++i)
+        {
+            off[i] = i * cellSize;
+        }
+    });
+    vtkSMPTools::For(0, numCells * cellSize, [&](vtkIdType begin, vtkIdType end) {
+        std::iota(conn + begin, conn + end, begin);
+    });
+    auto cells = vtkSmartPointer<vtkCellArray>::New();
+    cells->SetData(offsets, connectivity);
+    return cells;
+}
+
+vtkSmartPointer<vtkPolyData> NewPolyData(vtkFloatArray *coords)
+{
+    auto points = vtkSmartPointer<vtkPoints>::New();
+    points->SetData(coords);
+    auto poly = vtkSmartPointer<vtkPolyData>::New();
+    poly->SetPoints(points);
+    return poly;
+}
+
+vtkSmartPointer<vtkPolyData> NewTriangleSoup(vtkFloatArray *coords)
+{
+    auto poly = NewPolyData(coords);
+    poly->SetPolys(NewSequentialCells(coords->GetNumberOfTuples() / 3, 3));
+    return poly;
+}
+
+std::string Lowercase(std::string text)
+{
+    std::transform(text.begin(), text.end(), text.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    return text;
+}
+
+//------------------------------------------------------------------------------
+// STL
+
+vtkSmartPointer<vtkPolyData> ReadBinarySTL(const MappedFile &file, std::uint32_t numTriangles)
+{
+    constexpr std::size_t kHeaderSize = 84;
+    constexpr std::size_t kRecordSize = 50;
+    constexpr std::size_t kNormalSize = 12;
+
+    auto coords = NewFloatTuples(vtkIdType(numTriangles) * 3);
+    float *xyz = coords->GetPointer(0);
+    const char *records = file.data() + kHeaderSize;
+    vtkSMPTools::For(0, numTriangles, [&](vtkIdType begin, vtkIdType end) {
+        for (vtkIdType t = begin; t < end; ++t)
+        {
+            // Records are 50 bytes, so the floats are unaligned: copy bytewise
+            std::memcpy(xyz + 9 * t, records + t * kRecordSize + kNormalSize, 9 * sizeof(float));
+        }
+    });
+    if constexpr (std::endian::native == std::endian::big)
+    {
+        vtkSMPTools::For(0, vtkIdType(numTriangles) * 9, [&](vtkIdType begin, vtkIdType end) {
+            auto *bytes = reinterpret_cast<unsigned char *>(xyz);
+            for (vtkIdType i = begin; i < end; ++i)
+            {
+                std::reverse(bytes + 4 * i, bytes + 4 * i + 4);
+            }
+        });
+    }
+    return NewTriangleSoup(coords);
+}
+
+vtkSmartPointer<vtkPolyData> ReadAsciiSTL(const MappedFile &file)
+{
+    const std::vector<Range> ranges = SplitOnLines(file.data(), file.data() + file.size());
+    const auto numRanges = static_cast<vtkIdType>(ranges.size());
+
+    // Pass 1: count the vertex records of every chunk
+    std::vector<vtkIdType> vertexBase(ranges.size() + 1, 0);
+    vtkSMPTools::For(0, numRanges, [&](vtkIdType begin, vtkIdType end) {
+        for (vtkIdType c = begin; c < end; ++c)
+        {
+            vtkIdType count = 0;
+            ForEachLine(ranges[c], [&](const char *p, const char *eol) {
+                count += StartsWithKeyword(p, eol, "vertex") ? 1 : 0;
+            });
+            vertexBase[c + 1] = count;
+        }
+    });
+    std::partial_sum(vertexBase.begin(), vertexBase.end(), vertexBase.begin());
+    const vtkIdType numVertices = vertexBase.back();
+    if (numVertices % 3 != 0)
+    {
+        throw std::runtime_error(file.path() + ": vertex count is not a multiple of 3");
+    }
+
+    // Pass 2: parse every chunk into its slice of the point array
+    auto coords = NewFloatTuples(numVertices);
+    float *xyz = coords->GetPointer(0);
+    std::atomic<bool> malformed{false};
+    vtkSMPTools::For(0, numRanges, [&](vtkIdType begin, vtkIdType end) {
+        for (vtkIdType c = begin; c < end; ++c)
+        {
+            float *out = xyz + 3 * vertexBase[c];
+            ForEachLine(ranges[c], [&](const char *p, const char *eol) {
+                if (!StartsWithKeyword(p, eol, "vertex"))
+                {
+                    return;
+                }
+                p += 6;
+                for (int k = 0; k < 3 && p; ++k)
+                {
+                    p = ParseNumber(p, eol, out[k]);
+                }
+                if (!p)
+                {
+                    malformed = true;
+                }
+                out += 3;
+            });
+        }
+    });
+    if (malformed)
+    {
+        throw std::runtime_error(file.path() + ": malformed vertex record");
+    }
+    return NewTriangleSoup(coords);
+}
+
+//------------------------------------------------------------------------------
+// OBJ
+
+struct ObjCounts
+{
+    vtkIdType vertices = 0;
+    vtkIdType faces = 0;
+    vtkIdType indices = 0;
+};
+
+inline bool IsObjRecord(const char *p, const char *eol, char type)
+{
+    return eol - p > 1 && p[0] == type && IsBlank(p[1]);
+}
+
+//------------------------------------------------------------------------------
+// PLY
+
+enum class PlyType
+{
+    Int8,
+    UInt8,
+    Int16,
+    UInt16,
+    Int32,
+    UInt32,
+    Float32,
+    Float64
+};
+
+enum class PlyFormat
+{
+    Ascii,
+    BinaryLittleEndian,
+    BinaryBigEndian
+};
+
+struct PlyProperty
+{
+    std::string name;
+    PlyType type = PlyType::Float32;
+    bool isList = false;
+    PlyType countType = PlyType::UInt8;
+};
+
+struct PlyElement
+{
+    std::string name;
+    vtkIdType count = 0;
+    std::vector<PlyProperty> properties;
+
+    int Find(std::string_view property) const
+    {
+        for (std::size_t i = 0; i < properties.size(); ++i)
+        {
+            if (properties[i].name == property)
+            {
+                return static_cast<int>(i);
+            }
+        }
+        return -1;
+    }
+};
+
+struct PlyHeader
+{
+    PlyFormat format = PlyFormat::Ascii;
+    std::vector<PlyElement> elements;
+    std::size_t bodyOffset = 0;
+};
+
+std::size_t PlyTypeSize(PlyType type)
+{
+    switch (type)
+    {
+    case PlyType::Int8:
+    case PlyType::UInt8:
+        return 1;
+    case PlyType::Int16:
+    case PlyType::UInt16:
+        return 2;
+    case PlyType::Int32:
+    case PlyType::UInt32:
+    case PlyType::Float32:
+        return 4;
+    case PlyType::Float64:
+        return 8;
+    }
+    return 0;
+}
+
+bool ParsePlyType(std::string_view name, PlyType &type)
+{
+    static const std::pair<std::string_view, PlyType> kNames[] = {
+        {"char", PlyType::Int8},      {"int8", PlyType::Int8},       {"uchar", PlyType::UInt8},
+        {"uint8", PlyType::UInt8},    {"short", PlyType::Int16},     {"int16", PlyType::Int16},
+        {"ushort", PlyType::UInt16},  {"uint16", PlyType::UInt16},   {"int", PlyType::Int32},
+        {"int32", PlyType::Int32},    {"uint", PlyType::UInt32},     {"uint32", PlyType::UInt32},
+        {"float", PlyType::Float32},  {"float32", PlyType::Float32}, {"double", PlyType::Float64},
+        {"float64", PlyType::Float64}};
+    for (const auto &[text, value] : kNames)
+    {
+        if (text == name)
+        {
+            type = value;
+            return true;
+        }
+    }
+    return false;
+}
+
+std::vector<std::string_view> SplitTokens(const char *p, const char *eol)
+{
+    std::vector<std::string_view> tokens;
+    p = SkipBlanks(p, eol);
+    while (p < eol)
+    {
+        const char *stop = SkipToken(p, eol);
+        tokens.emplace_back(p, static_cast<std::size_t>(stop - p));
+        p = SkipBlanks(stop, eol);
+    }
+    return tokens;
+}
+
+PlyHeader ParsePlyHeader(const MappedFile &file)
+{
+    const char *p = file.data();
+    const char *end = p + file.size();
+    PlyHeader header;
+    bool sawFormat = false;
+    int lineNumber = 0;
+    while (p < end)
+    {
+        const void *nl = std::memchr(p, '\n', static_cast<std::size_t>(end - p));
+        if (!nl)
+        {
+            break;
+        }
+        const char *eol = static_cast<const char *>(nl);
+        const std::vector<std::string_view> tokens = SplitTokens(p, eol);
+        p = eol + 1;
+        if (lineNumber++ == 0)
+        {
+            if (tokens.size() != 1 || tokens[0] != "ply")
+            {
+                break;
+            }
+            continue;
+        }
+        if (tokens.empty() || tokens[0] == "comment" || tokens[0] == "obj_info")
+        {
+            continue;
+        }
+        if (tokens[0] == "end_header")
+        {
+            if (!sawFormat)
+            {
+                break;
+            }
+            header.bodyOffset = static_cast<std::size_t>(p - file.data());
+            return header;
+        }
+        if (tokens[0] == "format" && tokens.size() >= 2)
+        {
+            sawFormat = true;
+            if (tokens[1] == "ascii")
+            {
+                header.format = PlyFormat::Ascii;
+            }
+            else if (tokens[1] == "binary_little_endian")
+            {
+                header.format = PlyFormat::BinaryLittleEndian;
+            }
+            else if (tokens[1] == "binary_big_endian")
+            {
+                header.format = PlyFormat::BinaryBigEndian;
+            }
+            else
+            {
+                break;
+            }
+        }
+        else if (tokens[0] == "element" && tokens.size() == 3)
+        {
+            PlyElement element;
+            element.name = tokens[1];
+            long long count = 0;
+            if (std::from_chars(tokens[2].data(), tokens[2].data() + tokens[2].size(), count).ec !=
+                    std::errc() ||
+                count < 0)
+            {
+                break;
+            }
+            element.count = static_cast<vtkIdType>(count);
+            header.elements.push_back(std::move(element));
+        }
+        else if (tokens[0] == "property" && !header.elements.empty())
+        {
+            PlyProperty property;
+            if (tokens.size() == 5 && tokens[1] == "list")
+            {
+                property.isList = true;
+                if (!ParsePlyType(tokens[2], property.countType) ||
+                    !ParsePlyType(tokens[3], property.type))
+                {
+                    break;
+                }
+                property.name = tokens[4];
+            }
+            else if (tokens.size() == 3)
+            {
+                if (!ParsePlyType(tokens[1], property.type))
+                {
+                    break;
+                }
+                property.name = tokens[2];
+            }
+            else
+            {
+                break;
+            }
+            header.elements.back().properties.push_back(std::move(property));
+        }
+        else
+        {
+            break;
+        }
+    }
+    throw std::runtime_error(file.path() + ": invalid PLY header");
+}
+
+template <typename T>
+inline T LoadScalar(const char *p, bool swap)
+{
+    char bytes[sizeof(T)];
+    std::memcpy(bytes, p, sizeof(T));
+    if (swap)
+    {
+        std::reverse(bytes, bytes + sizeof(T));
+    }
+    T value;
+    std::memcpy(&value, bytes, sizeof(T));
+    return value;
+}
+
+inline double LoadPlyValue(const char *p, PlyType type, bool swap)
+{
+    switch (type)
+    {
+    case PlyType::Int8:
+        return LoadScalar<std::int8_t>(p, false);
+    case PlyType::UInt8:
+        return LoadScalar<std::uint8_t>(p, false);
+    case PlyType::Int16:
+        return LoadScalar<std::int16_t>(p, swap);
+    case PlyType::UInt16:
+        return LoadScalar<std::uint16_t>(p, swap);
+    case PlyType::Int32:
+        return LoadScalar<std::int32_t>(p, swap);
+    case PlyType::UInt32:
+        return LoadScalar<std::uint32_t>(p, swap);
+    case PlyType::Float32:
+        return LoadScalar<float>(p, swap);
+    case PlyType::Float64:
+        return LoadScalar<double>(p, swap);
+    }
+    return 0.0;
+}
+
+inline vtkIdType LoadPlyIndex(const char *p, PlyType type, bool swap)
+{
+    return static_cast<vtkIdType>(LoadPlyValue(p, type, swap));
+}
+
+// Which vertex properties end up in the output, by property index
+struct PlyVertexLayout
+{
+    int position[3] = {-1, -1, -1};
+    int normal[3] = {-1, -1, -1};
+
+    explicit PlyVertexLayout(const PlyElement &vertex)
+    {
+        const char *positionNames[3] = {"x", "y", "z"};
+        const char *normalNames[3] = {"nx", "ny", "nz"};
+        for (int k = 0; k < 3; ++k)
+        {
+            position[k] = vertex.Find(positionNames[k]);
+            normal[k] = vertex.Find(normalNames[k]);
+        }
+    }
+
+    bool HasPosition() const { return position[0] >= 0 && position[1] >= 0 && position[2] >= 0; }
+    bool HasNormal() const { return normal[0] >= 0 && normal[1] >= 0 && normal[2] >= 0; }
+};
+
+int FindFaceList(const PlyElement &face)
+{
+    int index = face.Find("vertex_indices");
+    if (index < 0)
+    {
+        index = face.Find("vertex_index");
+    }
+    if (index < 0 || !face.properties[index].isList)
+    {
+        return -1;
+    }
+    return index;
+}
+
+// Size of one record of an element, or 0 if it contains list properties
+std::size_t FixedStride(const PlyElement &element)
+{
+    std::size_t stride = 0;
+    for (const PlyProperty &property : element.properties)
+    {
+        if (property.isList)
+        {
+            return 0;
+        }
+        stride += PlyTypeSize(property.type);
+    }
+    return stride;
+}
+
+// Size of one binary property value starting at p, or 0 if it runs past end
+std::size_t BinaryPropertySize(const PlyProperty &property, const char *p, const char *end,
+                               bool swap)
+{
+    if (!property.isList)
+    {
+        return p + PlyTypeSize(property.type) <= end ? PlyTypeSize(property.type) : 0;
+    }
+    const std::size_t countSize = PlyTypeSize(property.countType);
+    if (p + countSize > end)
+    {
+        return 0;
+    }
+    const vtkIdType count = LoadPlyIndex(p, property.countType, swap);
+    const std::size_t size = countSize + static_cast<std::size_t>(count) * PlyTypeSize(property.type);
+    return count >= 0 && p + size <= end ? size : 0;
+}
+
+// Size of one binary record starting at p, or 0 if it runs past end
+std::size_t BinaryRecordSize(const PlyElement &element, const char *p, const char *end, bool swap)
+{
+    std::size_t size = 0;
+    for (const PlyProperty &property : element.properties)
+    {
+        const std::size_t propertySize = BinaryPropertySize(property, p + size, end, swap);
+        if (propertySize == 0)
+        {
+            return 0;
+        }
+        size += propertySize;
+    }
+    return size;
+}
+
+struct PlyOutput
+{
+    vtkSmartPointer<vtkFloatArray> coords;
+    vtkSmartPointer<vtkFloatArray> normals;
+    vtkSmartPointer<vtkIdTypeArray> offsets;
+    vtkSmartPointer<vtkIdTypeArray> connectivity;
+};
+
+void ReadBinaryPlyVertices(const PlyElement &vertex, const char *records, bool swap,
+                           PlyOutput &out)
+{
+    const PlyVertexLayout layout(vertex);
+    std::vector<std::size_t> byteOffset(vertex.properties.size() + 1, 0);
+    for (std::size_t i = 0; i < vertex.properties.size(); ++i)
+    {
+        byteOffset[i + 1] = byteOffset[i] + PlyTypeSize(vertex.properties[i].type);
+    }
+    const std::size_t stride = byteOffset.back();
+
+    float *xyz = out.coords->GetPointer(0);
+    float *nxyz = out.normals ? out.normals->GetPointer(0) : nullptr;
+    vtkSMPTools::For(0, vertex.count, [&](vtkIdType begin, vtkIdType end) {
+        for (vtkIdType i = begin; i < end; ++i)
+        {
+            const char *record = records + i * stride;
+            for (int k = 0; k < 3; ++k)
+            {
+                const int pos = layout.position[k];
+                xyz[3 * i + k] = static_cast<float>(
+                    LoadPlyValue(record + byteOffset[pos], vertex.properties[pos].type, swap));
+                if (nxyz)
+                {
+                    const int nrm = layout.normal[k];
+                    nxyz[3 * i + k] = static_cast<float>(
+                        LoadPlyValue(record + byteOffset[nrm], vertex.properties[nrm].type, swap));
+                }
+            }
+        }
+    });
+}
+
+// Reads the face element, returning the pointer just past it.
+const char *ReadBinaryPlyFaces(const PlyElement &face, const char *records, const char *end,
+                               bool swap, const std::string &path, PlyOutput &out)
+{
+    const int listIndex = FindFaceList(face);
+    if (listIndex < 0)
+    {
+        throw std::runtime_error(path + ": PLY face element has no vertex_indices list");
+    }
+    const PlyProperty &list = face.properties[listIndex];
+    const std::size_t countSize = PlyTypeSize(list.countType);
+    const std::size_t indexSize = PlyTypeSize(list.type);
+
+    // Fast path: every face is a triangle and every other property is a
+    // scalar, so the records have a fixed stride and can be addressed directly.
+    std::size_t before = 0;
+    std::size_t after = 0;
+    bool fixedOtherwise = true;
+    for (std::size_t i = 0; i < face.properties.size(); ++i)
+    {
+        if (static_cast<int>(i) == listIndex)
+        {
+            continue;
+        }
+        fixedOtherwise = fixedOtherwise && !face.properties[i].isList;
+        (static_cast<int>(i) < listIndex ? before : after) += PlyTypeSize(face.properties[i].type);
+    }
+    const std::size_t triangleStride = before + countSize + 3 * indexSize + after;
+    if (fixedOtherwise && records + face.count * triangleStride <= end)
+    {
+        std::atomic<bool> allTriangles{true};
+        vtkSMPTools::For(0, face.count, [&](vtkIdType begin, vtkIdType stop) {
+            for (vtkIdType f = begin; f < stop && allTriangles; ++f)
+            {
+                if (LoadPlyIndex(records + f * triangleStride + before, list.countType, swap) != 3)
+                {
+                    allTriangles = false;
+                }
+            }
+        });
+        if (allTriangles)
+        {
+            out.offsets = NewIds(face.count + 1);
+            out.connectivity = NewIds(face.count * 3);
+            vtkIdType *off = out.offsets->GetPointer(0);
+            vtkIdType *conn = out.connectivity->GetPointer(0);
+            vtkSMPTools::For(0, face.count, [&](vtkIdType begin, vtkIdType stop) {
+                for (vtkIdType f = begin; f < stop; ++f)
+                {
+                    const char *ids = records + f * triangleStride + before + countSize;
+                    off[f] = 3 * f;
+                    for (int k = 0; k < 3; ++k)
+                    {
+                        conn[3 * f + k] = LoadPlyIndex(ids + k * indexSize, list.type, swap);
+                    }
+                }
+            });
+            off[face.count] = 3 * face.count;
+            return records + face.count * triangleStride;
+        }
+    }
+
+    // General case: the record boundaries depend on every list count, so find
+    // them with a sequential scan and parse the index lists in parallel.
+    std::vector<const char *> lists(static_cast<std::size_t>(face.count));
+    out.offsets = NewIds(face.count + 1);
+    vtkIdType *off = out.offsets->GetPointer(0);
+    off[0] = 0;
+    const char *p = records;
+    for (vtkIdType f = 0; f < face.count; ++f)
+    {
+        for (std::size_t i = 0; i < face.properties.size(); ++i)
+        {
+            const std::size_t size = BinaryPropertySize(face.properties[i], p, end, swap);
+            if (size == 0)
+            {
+                throw std::runtime_error(path + ": truncated PLY face element");
+            }
+            if (static_cast<int>(i) == listIndex)
+            {
+                lists[f] = p;
+                off[f + 1] = off[f] + LoadPlyIndex(p, list.countType, swap);
+            }
+            p += size;
+        }
+    }
+    out.connectivity = NewIds(off[face.count]);
+    vtkIdType *conn = out.connectivity->GetPointer(0);
+    vtkSMPTools::For(0, face.count, [&](vtkIdType begin, vtkIdType stop) {
+        for (vtkIdType f = begin; f < stop; ++f)
+        {
+            const char *ids = lists[f] + countSize;
+            for (vtkIdType k = 0; k < off[f + 1] - off[f]; ++k)
+            {
+                conn[off[f] + k] = LoadPlyIndex(ids + k * indexSize, list.type, swap);
+            }
+        }
+    });
+    return p;
+}
+
+void ReadBinaryPly(const MappedFile &file, const PlyHeader &header, PlyOutput &out)
+{
+    const bool littleEndian = header.format == PlyFormat::BinaryLittleEndian;
+    const bool swap = littleEndian != (std::endian::native == std::endian::little);
+    const char *p = file.data() + header.bodyOffset;
+    const char *end = file.data() + file.size();
+
+    for (const PlyElement &element : header.elements)
+    {
+        const std::size_t stride = FixedStride(element);
+        if (element.name == "vertex")
+        {
+            if (stride == 0 || p + element.count * stride > end)
+            {
+                throw std::runtime_error(file.path() + ": unsupported or truncated PLY vertices");
+            }
+            ReadBinaryPlyVertices(element, p, swap, out);
+            p += element.count * stride;
+        }
+        else if (element.name == "face")
+        {
+            p = ReadBinaryPlyFaces(element, p, end, swap, file.path(), out);
+        }
+        else if (stride > 0)
+        {
+            p += element.count * stride;
+        }
+        else
+        {
+            for (vtkIdType i = 0; i < element.count; ++i)
+            {
+                const std::size_t size = BinaryRecordSize(element, p, end, swap);
+                if (size == 0)
+                {
+                    throw std::runtime_error(file.path() + ": truncated PLY element " +
+                                             element.name);
+                }
+                p += size;
+            }
+        }
+        if (p > end)
+        {
+            throw std::runtime_error(file.path() + ": truncated PLY body");
+        }
+    }
+}
+
+void ReadAsciiPly(const MappedFile &file, const PlyHeader &header, PlyOutput &out)
+{
+    const std::vector<Range> ranges =
+        SplitOnLines(file.data() + header.bodyOffset, file.data() + file.size());
+    const auto numRanges = static_cast<vtkIdType>(ranges.size());
+
+    // Every record is one line; element e owns lines [first[e], first[e + 1])
+    std::vector<vtkIdType> first(header.elements.size() + 1, 0);
+    int vertexElement = -1;
+    int faceElement = -1;
+    for (std::size_t e = 0; e < header.elements.size(); ++e)
+    {
+        first[e + 1] = first[e] + header.elements[e].count;
+        if (header.elements[e].name == "vertex")
+        {
+            vertexElement = static_cast<int>(e);
+        }
+        else if (header.elements[e].name == "face")
+        {
+            faceElement = static_cast<int>(e);
+        }
+    }
+    const PlyElement *face = faceElement >= 0 ? &header.elements[faceElement] : nullptr;
+    const int listIndex = face ? FindFaceList(*face) : -1;
+    if (face && listIndex < 0)
+    {
+        throw std::runtime_error(file.path() + ": PLY face element has no vertex_indices list");
+    }
+
+    // Skips the properties before the face list and returns its count
+    auto faceListCount = [&](const char *&p, const char *eol) -> vtkIdType {
+        for (int i = 0; i < listIndex && p; ++i)
+        {
+            double ignored;
+            p = ParseNumber(p, eol, ignored);
+        }
+        long long count = -1;
+        if (p)
+        {
+            p = ParseNumber(p, eol, count);
+        }
+        return p ? static_cast<vtkIdType>(count) : -1;
+    };
+
+    // Pass 1: lines per chunk; pass 2: face indices per chunk
+    std::vector<vtkIdType> lineBase(ranges.size() + 1, 0);
+    std::vector<vtkIdType> indexBase(ranges.size() + 1, 0);
+    vtkSMPTools::For(0, numRanges, [&](vtkIdType begin, vtkIdType end) {
+        for (vtkIdType c = begin; c < end; ++c)
+        {
+            vtkIdType lines = 0;
+            ForEachLine(ranges[c], [&](const char *, const char *) { ++lines; });
+            lineBase[c + 1] = lines;
+        }
+    });
+    std::partial_sum(lineBase.begin(), lineBase.end(), lineBase.begin());
+    if (lineBase.back() < first.back())
+    {
+        throw std::runtime_error(file.path() + ": truncated PLY body");
+    }
+
+    std::atomic<bool> malformed{false};
+    if (face)
+    {
+        vtkSMPTools::For(0, numRanges, [&](vtkIdType begin, vtkIdType end) {
+            for (vtkIdType c = begin; c < end; ++c)
+            {
+                vtkIdType line = lineBase[c];
+                vtkIdType indices = 0;
+                ForEachLine(ranges[c], [&](const char *p, const char *eol) {
+                    if (line >= first[faceElement] && line < first[faceElement + 1])
+                    {
+                        const vtkIdType count = faceListCount(p, eol);
+                        malformed = malformed || count < 0;
+                        indices += std::max<vtkIdType>(count, 0);
+                    }
+                    ++line;
+                });
+                indexBase[c + 1] = indices;
+            }
+        });
+        std::partial_sum(indexBase.begin(), indexBase.end(), indexBase.begin());
+        out.offsets = NewIds(face->count + 1);
+        out.connectivity = NewIds(indexBase.back());
+        out.offsets->SetValue(face->count, indexBase.back());
+    }
+
+    // Pass 3: parse vertices and faces into their slices
+    const PlyElement &vertex = header.elements[vertexElement];
+    const PlyVertexLayout layout(vertex);
+    float *xyz = out.coords->GetPointer(0);
+    float *nxyz = out.normals ? out.normals->GetPointer(0) : nullptr;
+    vtkIdType *off = out.offsets ? out.offsets->GetPointer(0) : nullptr;
+    vtkIdType *conn = out.connectivity ? out.connectivity->GetPointer(0) : nullptr;
+    vtkSMPTools::For(0, numRanges, [&](vtkIdType begin, vtkIdType end) {
+        std::vector<double> values(vertex.properties.size());
+        for (vtkIdType c = begin; c < end; ++c)
+        {
+            vtkIdType line = lineBase[c];
+            vtkIdType index = indexBase[c];
+            ForEachLine(ranges[c], [&](const char *p, const char *eol) {
+                if (line >= first[vertexElement] && line < first[vertexElement + 1])
+                {
+                    const vtkIdType v = line - first[vertexElement];
+                    for (std::size_t i = 0; i < values.size() && p; ++i)
+                    {
+                        p = ParseNumber(p, eol, values[i]);
+                    }
+                    malformed = malformed || !p;
+                    for (int k = 0; k < 3 && p; ++k)
+                    {
+                        xyz[3 * v + k] = static_cast<float>(values[layout.position[k]]);
+                        if (nxyz)
+                        {
+                            nxyz[3 * v + k] = static_cast<float>(values[layout.normal[k]]);
+                        }
+                    }
+                }
+                else if (face && line >= first[faceElement] && line < first[faceElement + 1])
+                {
+                    const vtkIdType f = line - first[faceElement];
+                    const vtkIdType count = faceListCount(p, eol);
+                    off[f] = index;
+                    for (vtkIdType k = 0; k < count && p; ++k)
+                    {
+                        long long id = 0;
+                        p = ParseNumber(p, eol, id);
+                        conn[index++] = static_cast<vtkIdType>(id);
+                    }
+                    malformed = malformed || !p || count < 0;
+                }
+                ++line;
+            });
+        }
+    });
+    if (malformed)
+    {
+        throw std::runtime_error(file.path() + ": malformed PLY record");
+    }
+}
+
+} // namespace
+
+vtkSmartPointer<vtkPolyData> ReadSTLParallel(const std::string &path)
+{
+    MappedFile file(path);
+    file.AdviseSequential();
+
+    // A binary file is identified by its size; ASCII files start with "solid",
+    // but so do many binary ones, hence the size check first.
+    if (file.size() >= 84)
+    {
+        std::uint32_t numTriangles = 0;
+        std::memcpy(&numTriangles, file.data() + 80, sizeof(numTriangles));
+        if constexpr (std::endian::native == std::endian::big)
+        {
+            numTriangles = LoadScalar<std::uint32_t>(file.data() + 80, true);
+        }
+        const std::uint64_t expected = 84 + 50 * std::uint64_t(numTriangles);
+        const bool startsWithSolid = std::memcmp(file.data(), "solid", 5) == 0;
+        if (expected == file.size() || (!startsWithSolid && expected <= file.size()))
+        {
+            return ReadBinarySTL(file, numTriangles);
+        }
+    }
+    return ReadAsciiSTL(file);
+}
+
+vtkSmartPointer<vtkPolyData> ReadPLYParallel(const std::string &path)
+{
+    MappedFile file(path);
+    file.AdviseSequential();
+    const PlyHeader header = ParsePlyHeader(file);
+
+    const PlyElement *vertex = nullptr;
+    const PlyElement *face = nullptr;
+    for (const PlyElement &element : header.elements)
+    {
+        if (element.name == "vertex")
+        {
+            vertex = &element;
+        }
+        else if (element.name == "face")
+        {
+            face = &element;
+        }
+    }
+    if (!vertex || !PlyVertexLayout(*vertex).HasPosition())
+    {
+        throw std::runtime_error(path + ": PLY file has no vertex positions");
+    }
+
+    PlyOutput out;
+    out.coords = NewFloatTuples(vertex->count);
+    if (PlyVertexLayout(*vertex).HasNormal())
+    {
+        out.normals = NewFloatTuples(vertex->count, "Normals");
+    }
+    if (header.format == PlyFormat::Ascii)
+    {
+        ReadAsciiPly(file, header, out);
+    }
+    else
+    {
+        ReadBinaryPly(file, header, out);
+    }
+
+    auto poly = NewPolyData(out.coords);
+    if (out.normals)
+    {
+        poly->GetPointData()->SetNormals(out.normals);
+    }
+    if (face && out.offsets)
+    {
+        // Out-of-range indices would crash the mapper, so reject them here
+        const vtkIdType *conn = out.connectivity->GetPointer(0);
+        const vtkIdType numVertices = vertex->count;
+        std::atomic<bool> outOfRange{false};
+        vtkSMPTools::For(0, out.connectivity->GetNumberOfValues(),
+                         [&](vtkIdType begin, vtkIdType end) {
+                             for (vtkIdType i = begin; i < end; ++i)
+                             {
+                                 if (conn[i] < 0 || conn[i] >= numVertices)
+                                 {
+                                     outOfRange = true;
+                                 }
+                             }
+                         });
+        if (outOfRange)
+        {
+            throw std::runtime_error(path + ": PLY face index out of range");
+        }
+        auto polys = vtkSmartPointer<vtkCellArray>::New();
+        polys->SetData(out.offsets, out.connectivity);
+        poly->SetPolys(polys);
+    }
+    else
+    {
+        poly->SetVerts(NewSequentialCells(vertex->count, 1));
+    }
+    return poly;
+}
+
+PlyVertexRecords LocatePlyVertexRecords(const MappedFile &file)
+{
+    const PlyHeader header = ParsePlyHeader(file);
+    const bool littleEndian = header.format == PlyFormat::BinaryLittleEndian;
+    if (header.format == PlyFormat::Ascii ||
+        littleEndian != (std::endian::native == std::endian::little))
+    {
+        throw std::runtime_error(file.path() + ": expected a binary PLY file in host byte order");
+    }
+
+    PlyVertexRecords records;
+    records.offset = header.bodyOffset;
+    for (const PlyElement &element : header.elements)
+    {
+        const std::size_t stride = FixedStride(element);
+        if (stride == 0)
+        {
+            break;
+        }
+        if (element.name != "vertex")
+        {
+            records.offset += element.count * stride;
+            continue;
+        }
+
+        const PlyVertexLayout layout(element);
+        if (!layout.HasPosition())
+        {
+            break;
+        }
+        const PlyType type = element.properties[layout.position[0]].type;
+        std::vector<std::size_t> byteOffset(element.properties.size() + 1, 0);
+        for (std::size_t i = 0; i < element.properties.size(); ++i)
+        {
+            byteOffset[i + 1] = byteOffset[i] + PlyTypeSize(element.properties[i].type);
+        }
+        for (int k = 0; k < 3; ++k)
+        {
+            if (element.properties[layout.position[k]].type != type ||
+                (type != PlyType::Float32 && type != PlyType::Float64))
+            {
+                throw std::runtime_error(file.path() + ": PLY positions must all be float or double");
+            }
+            records.position[k] = byteOffset[layout.position[k]];
+        }
+        records.stride = stride;
+        records.count = element.count;
+        records.doublePrecision = type == PlyType::Float64;
+        if (records.offset + records.count * records.stride > file.size())
+        {
+            throw std::runtime_error(file.path() + ": truncated PLY vertices");
+        }
+        return records;
+    }
+    throw std::runtime_error(file.path() + ": no fixed-size PLY vertex element to stream");
+}
+
+vtkSmartPointer<vtkPolyData> ReadOBJParallel(const std::string &path)
+{
+    MappedFile file(path);
+    file.AdviseSequential();
+    const std::vector<Range> ranges = SplitOnLines(file.data(), file.data() + file.size());
+    const auto numRanges = static_cast<vtkIdType>(ranges.size());
+
+    // Pass 1: count vertices, faces and face indices of every chunk
+    std::vector<ObjCounts> base(ranges.size() + 1);
+    vtkSMPTools::For(0, numRanges, [&](vtkIdType begin, vtkIdType end) {
+        for (vtkIdType c = begin; c < end; ++c)
+        {
+            ObjCounts counts;
+            ForEachLine(ranges[c], [&](const char *p, const char *eol) {
+                if (IsObjRecord(p, eol, 'v'))
+                {
+                    ++counts.vertices;
+                }
+                else if (IsObjRecord(p, eol, 'f'))
+                {
+                    ++counts.faces;
+                    for (p = SkipBlanks(p + 1, eol); p < eol; p = SkipBlanks(SkipToken(p, eol), eol))
+                    {
+                        ++counts.indices;
+                    }
+                }
+            });
+            base[c + 1] = counts;
+        }
+    });
+    for (std::size_t c = 1; c < base.size(); ++c)
+    {
+        base[c].vertices += base[c - 1].vertices;
+        base[c].faces += base[c - 1].faces;
+        base[c].indices += base[c - 1].indices;
+    }
+    const ObjCounts total = base.back();
+
+    // Pass 2: parse every chunk into its slice of the preallocated arrays
+    auto coords = NewFloatTuples(total.vertices);
+    auto offsets = NewIds(total.faces + 1);
+    auto connectivity = NewIds(total.indices);
+    float *xyz = coords->GetPointer(0);
+    vtkIdType *off = offsets->GetPointer(0);
+    vtkIdType *conn = connectivity->GetPointer(0);
+    off[total.faces] = total.indices;
+    std::atomic<bool> malformed{false};
+    vtkSMPTools::For(0, numRanges, [&](vtkIdType begin, vtkIdType end) {
+        for (vtkIdType c = begin; c < end; ++c)
+        {
+            vtkIdType vertex = base[c].vertices;
+            vtkIdType face = base[c].faces;
+            vtkIdType index = base[c].indices;
+            ForEachLine(ranges[c], [&](const char *p, const char *eol) {
+                if (IsObjRecord(p, eol, 'v'))
+                {
+                    ++p;
+                    float *out = xyz + 3 * vertex++;
+                    for (int k = 0; k < 3 && p; ++k)
+                    {
+                        p = ParseNumber(p, eol, out[k]);
+                    }
+                    malformed = malformed || !p;
+                }
+                else if (IsObjRecord(p, eol, 'f'))
+                {
+                    off[face++] = index;
+                    for (p = SkipBlanks(p + 1, eol); p < eol; p = SkipBlanks(SkipToken(p, eol), eol))
+                    {
+                        // "v", "v/vt", "v//vn" and "v/vt/vn" all start with v
+                        long long id = 0;
+                        const char *stop = ParseNumber(p, eol, id);
+                        if (id < 0)
+                        {
+                            // Relative to the vertices defined so far
+                            id += vertex;
+                        }
+                        else
+                        {
+                            id -= 1;
+                        }
+                        malformed = malformed || !stop || id < 0 || id >= total.vertices;
+                        conn[index++] = static_cast<vtkIdType>(id);
+                    }
+                }
+            });
+        }
+    });
+    if (malformed)
+    {
+        throw std::runtime_error(path + ": malformed OBJ record");
+    }
+
+    auto poly = NewPolyData(coords);
+    auto polys = vtkSmartPointer<vtkCellArray>::New();
+    polys->SetData(offsets, connectivity);
+    poly->SetPolys(polys);
+    return poly;
+}
+
+vtkSmartPointer<vtkPolyData> ReadMeshFile(const std::string &path)
+{
+    const std::size_t dot = path.find_last_of('.');
+    const std::string extension = dot == std::string::npos ? "" : Lowercase(path.substr(dot));
+    if (extension == ".stl")
+    {
+        return ReadSTLParallel(path);
+    }
+    if (extension == ".ply")
+    {
+        return ReadPLYParallel(path);
+    }
+    if (extension == ".obj")
+    {
+        return ReadOBJParallel(path);
+    }
+    if (extension == ".qmesh")
+    {
+        return ReadCompressedMesh(path);
+    }
+    if (extension == ".vtkhdf" || extension == ".hdf")
+    {
+        return ReadVTKHDFPolyData(path);
+    }
+    throw std::runtime_error("unsupported mesh format: " + path);
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <vtkPolyData.h>
+#include <vtkSmartPointer.h>
+
+#include <cstddef>
+#include <string>
+
+class MappedFile;
+
+// Parallel mesh readers. Each reader maps the file, splits it into chunks on
+// record boundaries (lines for the text formats, fixed-size records for the
+// binary ones), counts the records per chunk, and then parses every chunk on
+// vtkSMPTools straight into preallocated vtkPoints / vtkCellArray storage.
+// Floats are parsed with std::from_chars. Malformed input throws
+// std::runtime_error.
+
+// Binary and ASCII STL. The output is a triangle soup (points are not merged,
+// unlike vtkSTLReader's default), which vtkPolyDataMapper renders directly.
+vtkSmartPointer<vtkPolyData> ReadSTLParallel(const std::string &path);
+
+// ASCII and binary (either endianness) PLY. Reads the vertex positions,
+// optional vertex normals and the face lists. A file without faces becomes a
+// point cloud with one vertex cell per point.
+vtkSmartPointer<vtkPolyData> ReadPLYParallel(const std::string &path);
+
+// Wavefront OBJ. Reads "v" and "f" records, including negative (relative)
+// indices; polygons are kept as-is. Texture coordinates and normals are
+// ignored.
+vtkSmartPointer<vtkPolyData> ReadOBJParallel(const std::string &path);
+
+// Picks one of the readers above from the file extension (case-insensitive),
+// ReadCompressedMesh for .qmesh files or ReadVTKHDFPolyData for .vtkhdf/.hdf
+// files.
+vtkSmartPointer<vtkPolyData> ReadMeshFile(const std::string &path);
+
+// Layout of the fixed-size vertex records of a binary PLY file in host byte
+// order, for callers that stream positions straight out of a MappedFile
+// instead of loading a vtkPolyData (e.g. the point-cloud octree builder).
+struct PlyVertexRecords
+{
+    std::size_t offset = 0;       // first record, from the start of the file
+    std::size_t stride = 0;       // bytes per record
+    vtkIdType count = 0;
+    std::size_t position[3] = {}; // byte offsets of x, y, z within a record
+    bool doublePrecision = false; // x, y, z are double rather than float
+};
+
+// Throws std::runtime_error if the file is ASCII, in foreign byte order, or
+// its vertex element is preceded by variable-size records.
+PlyVertexRecords LocatePlyVertexRecords(const MappedFile &file);
@@ -0,0 +1,195 @@
+#include "mesh_topology.h"
+
+#include <vtkIdList.h>
+#include <vtkInformation.h>
+#include <vtkInformationObjectBaseKey.h>
+#include <vtkObjectFactory.h>
+#include <vtkSMPTools.h>
+
+#include <algorithm>
+#include <chrono>
+#include <numeric>
+
+vtkStandardNewMacro(MeshTopology);
+vtkInformationKeyMacro(MeshTopology, TOPOLOGY, ObjectBase);
+
+namespace
+{
+
+// CSR offsets of keys sorted ascending in [0, count): offsets[v] is the
+// first position of key v, and offsets[count] the number of keys
+template <typename Key>
+std::vector<vtkIdType> SortedOffsets(const std::vector<std::pair<vtkIdType, Key>> &sorted,
+                                     vtkIdType count)
+{
+    std::vector<vtkIdType> offsets(count + 1);
+    const vtkIdType size = static_cast<vtkIdType>(sorted.size());
+    // Position i starts the keys between the one before it and its own
+    vtkSMPTools::For(0, size + 1, [&](vtkIdType begin, vtkIdType end) {
+        for (vtkIdType i = begin; i < end; ++i)
+        {
+            const vtkIdType low = i == 0 ? 0 : sorted[i - 1].first + 1;
+            const vtkIdType high = i == size ? count : sorted[i].first;
+            for (vtkIdType key = low; key <= high; ++key)
+            {
+                offsets[key] = i;
+            }
+        }
+    });
+    return offsets;
+}
+
+} // namespace
+
+MeshTopology *MeshTopology::Get(vtkPolyData *mesh)
+{
+    vtkInformation *information = mesh->GetInformation();
+    auto *cached = MeshTopology::SafeDownCast(information->Get(TOPOLOGY()));
+    if (cached && cached->IsValidFor(mesh))
+    {
+        return cached;
+    }
+    auto topology = vtkSmartPointer<MeshTopology>::New();
+    topology->Build(mesh);
+    information->Set(TOPOLOGY(), topology);
+    return topology;
+}
+
+void MeshTopology::Share(vtkPolyData *source, vtkPolyData *target)
+{
+    auto *cached = MeshTopology::SafeDownCast(source->GetInformation()->Get(TOPOLOGY()));
+    if (cached && cached->IsValidFor(target))
+    {
+        target->GetInformation()->Set(TOPOLOGY(), cached);
+    }
+}
+
+bool MeshTopology::IsValidFor(vtkPolyData *mesh) const
+{
+    vtkCellArray *polys = mesh->GetPolys();
+    return polys == polys_ && polys->GetMTime() == polysTime_ &&
+           mesh->GetNumberOfPoints() == GetNumberOfPoints();
+}
+
+void MeshTopology::Build(vtkPolyData *mesh)
+{
+    const auto start = std::chrono::steady_clock::now();
+    polys_ = mesh->GetPolys();
+    polysTime_ = polys_->GetMTime();
+    const vtkIdType numPoints = mesh->GetNumberOfPoints();
+    const vtkIdType numPolys = polys_->GetNumberOfCells();
+
+    // Polygon corners
+    std::vector<vtkIdType> sizes(numPolys);
+    vtkSMPTools::For(0, numPolys, [&](vtkIdType begin, vtkIdType end) {
+        for (vtkIdType cell = begin; cell < end; ++cell)
+        {
+            sizes[cell] = polys_->GetCellSize(cell);
+        }
+    });
+    cornerOffsets.assign(numPolys + 1, 0);
+    std::partial_sum(sizes.begin(), sizes.end(), cornerOffsets.begin() + 1);
+    corners.resize(cornerOffsets.back());
+
+    // Every corner with its polygon, and every polygon edge once per polygon
+    std::vector<std::pair<vtkIdType, vtkIdType>> pointFaces(corners.size());
+    std::vector<std::pair<vtkIdType, vtkIdType>> polygonEdges(corners.size());
+    vtkSMPTools::For(0, numPolys, [&](vtkIdType begin, vtkIdType end) {
+        auto idList = vtkSmartPointer<vtkIdList>::New();
+        for (vtkIdType cell = begin; cell < end; ++cell)
+        {
+            vtkIdType npts = 0;
+            const vtkIdType *pts = nullptr;
+            polys_->GetCellAtId(cell, npts, pts, idList);
+            const vtkIdType first = cornerOffsets[cell];
+            for (vtkIdType i = 0; i < npts; ++i)
+            {
+                const vtkIdType a = pts[i];
+                const vtkIdType b = pts[(i + 1) % npts];
+                corners[first + i] = a;
+                pointFaces[first + i] = {a, cell};
+                polygonEdges[first + i] = {std::min(a, b), std::max(a, b)};
+            }
+        }
+    });
+
+    vtkSMPTools::Sort(pointFaces.begin(), pointFaces.end());
+    faceOffsets = SortedOffsets(pointFaces, numPoints);
+    faces.resize(pointFaces.size());
+    vtkSMPTools::For(0, static_cast<vtkIdType>(faces.size()), [&](vtkIdType begin, vtkIdType end) {
+        for (vtkIdType i = begin; i < end; ++i)
+        {
+            faces[i] = pointFaces[i].second;
+        }
+    });
+    pointFaces = {};
+
+    // Unique edges and their use counts, without collapsed ones
+    vtkSMPTools::Sort(polygonEdges.begin(), polygonEdges.end());
+    edges.clear();
+    edgeUses.clear();
+    for (std::size_t first = 0; first < polygonEdges.size();)
+    {
+        std::size_t last = first + 1;
+        while (last < polygonEdges.size() && polygonEdges[last] == polygonEdges[first])
+        {
+            ++last;
+        }
+        if (polygonEdges[first].first != polygonEdges[first].second)
+        {
+            edges.push_back(polygonEdges[first]);
+            edgeUses.push_back(static_cast<std::uint32_t>(last - first));
+        }
+        first = last;
+    }
+    polygonEdges = {};
+
+    // Both ends of every edge; ordered by edge, the neighbors of a vertex come
+    // out ascending, those below it first
+    const vtkIdType numEdges = static_cast<vtkIdType>(edges.size());
+    std::vector<std::pair<vtkIdType, vtkIdType>> pointEdges(2 * edges.size());
+    vtkSMPTools::For(0, numEdges, [&](vtkIdType begin, vtkIdType end) {
+        for (vtkIdType e = begin; e < end; ++e)
+        {
+            pointEdges[2 * e] = {edges[e].first, e};
+            pointEdges[2 * e + 1] = {edges[e].second, e};
+        }
+    });
+    vtkSMPTools::Sort(pointEdges.begin(), pointEdges.end());
+    neighborOffsets = SortedOffsets(pointEdges, numPoints);
+    neighbors.resize(pointEdges.size());
+    boundary.assign(numPoints, 0);
+    vtkSMPTools::For(0, numPoints, [&](vtkIdType begin, vtkIdType end) {
+        for (vtkIdType id = begin; id < end; ++id)
+        {
+            for (vtkIdType n = neighborOffsets[id]; n < neighborOffsets[id + 1]; ++n)
+            {
+                const auto [a, b] = edges[pointEdges[n].second];
+                neighbors[n] = a == id ? b : a;
+                boundary[id] |= edgeUses[pointEdges[n].second] == 1 ? 1 : 0;
+            }
+        }
+    });
+
+    buildSeconds_ =
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+std::size_t MeshTopology::GetMemorySize() const
+{
+    return (cornerOffsets.capacity() + corners.capacity() + faceOffsets.capacity() +
+            faces.capacity() + neighborOffsets.capacity() + neighbors.capacity()) *
+               sizeof(vtkIdType) +
+           edges.capacity() * sizeof(edges[0]) + edgeUses.capacity() * sizeof(std::uint32_t) +
+           boundary.capacity();
+}
+
+void MeshTopology::PrintSelf(ostream &os, vtkIndent indent)
+{
+    this->Superclass::PrintSelf(os, indent);
+    os << indent << "Points: " << GetNumberOfPoints() << "\n";
+    os << indent << "Polygons: " << GetNumberOfPolygons() << "\n";
+    os << indent << "Edges: " << edges.size() << "\n";
+    os << indent << "Memory: " << GetMemorySize() << " bytes\n";
+    os << indent << "Build time: " << buildSeconds_ << " s\n";
+}
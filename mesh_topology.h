@@ -0,0 +1,79 @@
+#pragma once
+
+#include <vtkCellArray.h>
+#include <vtkObject.h>
+#include <vtkPolyData.h>
+#include <vtkSmartPointer.h>
+#include <vtkType.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+class vtkInformationObjectBaseKey;
+
+// Compressed (CSR) topology of the polygons of a vtkPolyData: the polygon
+// corners, the polygons around every vertex, the unique edges with the number
+// of polygons using them, and the neighbors of every vertex. It is built in
+// parallel by sorting and cached in the polydata's information, so the mesh
+// stages in front of the mapper (smoothing, connectivity, normals) share one
+// copy instead of each calling BuildLinks. The cache is dropped when the
+// polygons are modified or replaced or the number of points changes; moving
+// points keeps it.
+class MeshTopology : public vtkObject
+{
+public:
+    static MeshTopology *New();
+    vtkTypeMacro(MeshTopology, vtkObject);
+    void PrintSelf(ostream &os, vtkIndent indent) override;
+
+    // Cached topology of mesh, built on first use
+    static MeshTopology *Get(vtkPolyData *mesh);
+
+    // Hands the cache of source to target when target shares its polygons,
+    // as filters that only move points do (CopyStructure)
+    static void Share(vtkPolyData *source, vtkPolyData *target);
+
+    // Cache slot in vtkDataObject::GetInformation()
+    static vtkInformationObjectBaseKey *TOPOLOGY();
+
+    vtkIdType GetNumberOfPoints() const { return static_cast<vtkIdType>(boundary.size()); }
+    vtkIdType GetNumberOfPolygons() const
+    {
+        return static_cast<vtkIdType>(cornerOffsets.size()) - 1;
+    }
+    std::size_t GetMemorySize() const;
+    double GetBuildSeconds() const { return buildSeconds_; }
+
+    // Polygon p has the points corners[cornerOffsets[p] .. cornerOffsets[p + 1])
+    std::vector<vtkIdType> cornerOffsets;
+    std::vector<vtkIdType> corners;
+    // Polygons using vertex v, ascending
+    std::vector<vtkIdType> faceOffsets;
+    std::vector<vtkIdType> faces;
+    // Unique edges, smaller id first, sorted, and how many polygons use each
+    std::vector<std::pair<vtkIdType, vtkIdType>> edges;
+    std::vector<std::uint32_t> edgeUses;
+    // Vertices sharing an edge with vertex v, ascending
+    std::vector<vtkIdType> neighborOffsets;
+    std::vector<vtkIdType> neighbors;
+    // Whether a vertex is on an edge used by one polygon
+    std::vector<std::uint8_t> boundary;
+
+protected:
+    MeshTopology() = default;
+    ~MeshTopology() override = default;
+
+private:
+    MeshTopology(const MeshTopology &) = delete;
+    void operator=(const MeshTopology &) = delete;
+
+    void Build(vtkPolyData *mesh);
+    bool IsValidFor(vtkPolyData *mesh) const;
+
+    // What the topology was built from
+    vtkSmartPointer<vtkCellArray> polys_;
+    vtkMTimeType polysTime_ = 0;
+    double buildSeconds_ = 0.0;
+};
@@ -0,0 +1,64 @@
+#include "mesh_writers.h"
+#include "vtkhdf_io.h"
+
+#include <vtkOBJWriter.h>
+#include <vtkPLYWriter.h>
+#include <vtkSTLWriter.h>
+#include <vtkSmartPointer.h>
+
+#include <algorithm>
+#include <cctype>
+#include <stdexcept>
+
+namespace
+{
+
+template <typename Writer>
+void WriteWith(Writer *writer, vtkPolyData *mesh, const std::string &path)
+{
+    writer->SetInputData(mesh);
+    writer->SetFileName(path.c_str());
+    if (writer->Write() != 1)
+    {
+        throw std::runtime_error("cannot write " + path);
+    }
+}
+
+} // namespace
+
+void WriteMeshFile(vtkPolyData *mesh, const std::string &path,
+                   const CompressedMeshOptions &options)
+{
+    std::string extension = path.substr(std::min(path.size(), path.find_last_of('.')));
+    std::transform(extension.begin(), extension.end(), extension.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+
+    if (extension == ".qmesh")
+    {
+        WriteCompressedMesh(mesh, path, options);
+    }
+    else if (extension == ".vtkhdf" || extension == ".hdf")
+    {
+        WriteVTKHDF(mesh, path);
+    }
+    else if (extension == ".stl")
+    {
+        auto writer = vtkSmartPointer<vtkSTLWriter>::New();
+        writer->SetFileTypeToBinary();
+        WriteWith(writer.Get(), mesh, path);
+    }
+    else if (extension == ".ply")
+    {
+        auto writer = vtkSmartPointer<vtkPLYWriter>::New();
+        writer->SetFileTypeToBinary();
+        WriteWith(writer.Get(), mesh, path);
+    }
+    else if (extension == ".obj")
+    {
+        WriteWith(vtkSmartPointer<vtkOBJWriter>::New().Get(), mesh, path);
+    }
+    else
+    {
+        throw std::runtime_error("unsupported mesh format: " + path);
+    }
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+#include "compressed_mesh.h"
+
+#include <vtkPolyData.h>
+
+#include <string>
+
+// Writes mesh in the format picked from the file extension
+// (case-insensitive): .qmesh through WriteCompressedMesh with options,
+// .vtkhdf/.hdf through WriteVTKHDF, and binary STL, binary PLY or OBJ through
+// the VTK writers. Throws std::runtime_error on unsupported formats and I/O
+// errors.
+void WriteMeshFile(vtkPolyData *mesh, const std::string &path,
+                   const CompressedMeshOptions &options = {});
@@ -0,0 +1,378 @@
+#include "octree_point_cloud.h"
+#include "mapped_file.h"
+
+#include <vtkCamera.h>
+#include <vtkCellArray.h>
+#include <vtkCommand.h>
+#include <vtkCompositePolyDataMapper.h>
+#include <vtkFloatArray.h>
+#include <vtkMath.h>
+#include <vtkMultiBlockDataSet.h>
+#include <vtkPoints.h>
+#include <vtkPolyData.h>
+#include <vtkProperty.h>
+#include <vtkRenderWindowInteractor.h>
+#include <vtkRenderer.h>
+#include <vtkTypeInt32Array.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <numeric>
+#include <queue>
+#include <stdexcept>
+
+OctreePointCloud::OctreePointCloud(const std::string &path, int loaderThreads)
+    : file_(std::make_unique<MappedFile>(path))
+{
+    if (file_->size() < sizeof(OctreeFileHeader))
+    {
+        throw std::runtime_error(path + ": not an octree file");
+    }
+    std::memcpy(&header_, file_->data(), sizeof(header_));
+    const std::uint64_t nodesEnd =
+        sizeof(OctreeFileHeader) + std::uint64_t(header_.nodeCount) * sizeof(OctreeNode);
+    if (std::memcmp(header_.magic, kOctreeMagic, sizeof(kOctreeMagic)) != 0 ||
+        header_.version != kOctreeVersion || header_.nodeCount == 0 ||
+        header_.pointsOffset < nodesEnd ||
+        header_.pointsOffset + header_.totalPoints * 3 * sizeof(float) > file_->size())
+    {
+        throw std::runtime_error(path + ": not an octree file or truncated");
+    }
+    nodes_ = reinterpret_cast<const OctreeNode *>(file_->data() + sizeof(OctreeFileHeader));
+    points_ = reinterpret_cast<const float *>(file_->data() + header_.pointsOffset);
+    // Children come after their parent, which also rules out cycles
+    for (std::uint32_t index = 0; index < header_.nodeCount; ++index)
+    {
+        const OctreeNode &node = nodes_[index];
+        bool valid = node.firstPoint <= header_.totalPoints &&
+                     node.pointCount <= header_.totalPoints - node.firstPoint;
+        for (std::int32_t child : node.children)
+        {
+            valid &= child < 0 || (std::uint32_t(child) > index &&
+                                   std::uint32_t(child) < header_.nodeCount);
+        }
+        if (!valid)
+        {
+            throw std::runtime_error(path + ": corrupt octree node " + std::to_string(index));
+        }
+    }
+
+    mapper_ = vtkSmartPointer<vtkCompositePolyDataMapper>::New();
+    mapper_->ScalarVisibilityOff();
+    mapper_->SetInputDataObject(vtkSmartPointer<vtkMultiBlockDataSet>::New());
+    actor_ = vtkSmartPointer<vtkActor>::New();
+    actor_->SetMapper(mapper_);
+    // Points are stored relative to the origin to keep float precision
+    actor_->SetPosition(header_.origin[0], header_.origin[1], header_.origin[2]);
+    actor_->GetProperty()->SetRepresentationToPoints();
+    actor_->GetProperty()->SetPointSize(2.0f);
+    actor_->GetProperty()->SetColor(0.9, 0.9, 0.8);
+
+    for (int i = 0; i < std::max(loaderThreads, 1); ++i)
+    {
+        loaders_.emplace_back(&OctreePointCloud::LoaderLoop, this);
+    }
+}
+
+OctreePointCloud::~OctreePointCloud()
+{
+    if (renderer_)
+    {
+        renderer_->RemoveObserver(renderObserver_);
+    }
+    if (interactor_)
+    {
+        interactor_->DestroyTimer(timerId_);
+        interactor_->RemoveObserver(timerObserver_);
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    wake_.notify_all();
+    for (std::thread &loader : loaders_)
+    {
+        loader.join();
+    }
+}
+
+void OctreePointCloud::Attach(vtkRenderer *renderer, vtkRenderWindowInteractor *interactor)
+{
+    renderer_ = renderer;
+    renderer_->AddActor(actor_);
+    renderObserver_ =
+        renderer_->AddObserver(vtkCommand::StartEvent, this, &OctreePointCloud::OnRenderStart);
+    if (interactor)
+    {
+        interactor_ = interactor;
+        timerObserver_ =
+            interactor_->AddObserver(vtkCommand::TimerEvent, this, &OctreePointCloud::OnTimer);
+        timerId_ = interactor_->CreateRepeatingTimer(50);
+    }
+}
+
+void OctreePointCloud::GetBounds(double bounds[6]) const
+{
+    for (int k = 0; k < 3; ++k)
+    {
+        bounds[2 * k] = header_.origin[k];
+        bounds[2 * k + 1] = header_.origin[k] + header_.size;
+    }
+}
+
+void OctreePointCloud::OnTimer()
+{
+    if (hasCompleted_ && interactor_)
+    {
+        interactor_->Render();
+    }
+}
+
+void OctreePointCloud::OnRenderStart()
+{
+    // Adopt the nodes the loaders finished since the last frame
+    std::vector<std::pair<int, vtkSmartPointer<vtkPolyData>>> completed;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        completed.swap(completed_);
+        hasCompleted_ = false;
+    }
+    for (auto &[index, points] : completed)
+    {
+        cache_[index] = CachedNode{points, frame_};
+    }
+
+    std::vector<int> selected;
+    std::vector<std::pair<double, int>> requests;
+    SelectNodes(selected, requests);
+
+    // Replace the load queue: what was wanted last frame may be off screen now
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        queue_.clear();
+        for (const auto &request : requests)
+        {
+            if (std::find(inFlight_.begin(), inFlight_.end(), request.second) == inFlight_.end())
+            {
+                queue_.push_back(request);
+            }
+        }
+        std::sort(queue_.begin(), queue_.end());
+    }
+    wake_.notify_all();
+
+    std::vector<int> shown;
+    for (int index : selected)
+    {
+        auto it = cache_.find(index);
+        if (it != cache_.end())
+        {
+            it->second.lastUsedFrame = frame_;
+            shown.push_back(index);
+        }
+    }
+    if (shown != shown_)
+    {
+        auto blocks = vtkSmartPointer<vtkMultiBlockDataSet>::New();
+        blocks->SetNumberOfBlocks(static_cast<unsigned int>(shown.size()));
+        for (std::size_t i = 0; i < shown.size(); ++i)
+        {
+            blocks->SetBlock(static_cast<unsigned int>(i), cache_[shown[i]].points);
+        }
+        mapper_->SetInputDataObject(blocks);
+        shown_ = shown;
+    }
+
+    double bounds[6];
+    GetBounds(bounds);
+    renderer_->ResetCameraClippingRange(bounds);
+
+    EvictUnused(shown);
+    ++frame_;
+}
+
+void OctreePointCloud::SelectNodes(std::vector<int> &selected,
+                                   std::vector<std::pair<double, int>> &requests)
+{
+    vtkCamera *camera = renderer_->GetActiveCamera();
+    double planes[24];
+    camera->GetFrustumPlanes(renderer_->GetTiledAspectRatio(), planes);
+    double eye[3];
+    camera->GetPosition(eye);
+    const double height = std::max(renderer_->GetSize()[1], 1);
+    const bool parallel = camera->GetParallelProjection() != 0;
+    const double halfAngle = vtkMath::RadiansFromDegrees(camera->GetViewAngle()) / 2.0;
+    const double pixelsPerUnit = parallel ? height / (2.0 * camera->GetParallelScale())
+                                          : height / (2.0 * std::tan(halfAngle));
+
+    // World-space cell of a node
+    auto cell = [&](const OctreeNode &node, double lo[3], double hi[3]) {
+        for (int k = 0; k < 3; ++k)
+        {
+            lo[k] = header_.origin[k] + node.min[k];
+            hi[k] = lo[k] + node.size;
+        }
+    };
+    auto visible = [&](const OctreeNode &node) {
+        double lo[3], hi[3];
+        cell(node, lo, hi);
+        for (int p = 0; p < 6; ++p)
+        {
+            // The corner furthest along the inward plane normal
+            const double *plane = planes + 4 * p;
+            double distance = plane[3];
+            for (int k = 0; k < 3; ++k)
+            {
+                distance += plane[k] * (plane[k] >= 0.0 ? hi[k] : lo[k]);
+            }
+            if (distance < 0.0)
+            {
+                return false;
+            }
+        }
+        return true;
+    };
+    auto screenSpaceError = [&](const OctreeNode &node) {
+        const double spacing =
+            node.spacing > 0.0f ? node.spacing
+                                : node.size / std::sqrt(std::max<double>(node.pointCount, 1.0));
+        if (parallel)
+        {
+            return spacing * pixelsPerUnit;
+        }
+        double lo[3], hi[3];
+        cell(node, lo, hi);
+        double squared = 0.0;
+        for (int k = 0; k < 3; ++k)
+        {
+            const double d = 0.5 * (lo[k] + hi[k]) - eye[k];
+            squared += d * d;
+        }
+        // Distance to the cell's bounding sphere
+        const double distance =
+            std::max(std::sqrt(squared) - node.size * 0.8660254, 1e-6 * header_.size);
+        return spacing / distance * pixelsPerUnit;
+    };
+
+    std::priority_queue<std::pair<double, int>> candidates;
+    if (visible(Node(0)))
+    {
+        candidates.emplace(screenSpaceError(Node(0)), 0);
+    }
+    std::uint64_t used = 0;
+    while (!candidates.empty() && used < pointBudget_)
+    {
+        const auto [error, index] = candidates.top();
+        candidates.pop();
+        const OctreeNode &node = Node(index);
+        if (used + node.pointCount > pointBudget_)
+        {
+            continue;
+        }
+        used += node.pointCount;
+        selected.push_back(index);
+        if (cache_.find(index) == cache_.end())
+        {
+            requests.emplace_back(error, index);
+        }
+        if (node.spacing > 0.0f && error > maxScreenSpaceError_)
+        {
+            for (std::int32_t child : node.children)
+            {
+                if (child >= 0 && visible(Node(child)))
+                {
+                    candidates.emplace(screenSpaceError(Node(child)), child);
+                }
+            }
+        }
+    }
+}
+
+void OctreePointCloud::EvictUnused(const std::vector<int> &shown)
+{
+    // Keep up to twice the budget around so that panning back is free
+    std::uint64_t cached = 0;
+    for (const auto &[index, entry] : cache_)
+    {
+        cached += Node(index).pointCount;
+    }
+    if (cached <= 2 * pointBudget_)
+    {
+        return;
+    }
+    std::vector<std::pair<std::uint64_t, int>> victims;
+    for (const auto &[index, entry] : cache_)
+    {
+        if (std::find(shown.begin(), shown.end(), index) == shown.end())
+        {
+            victims.emplace_back(entry.lastUsedFrame, index);
+        }
+    }
+    std::sort(victims.begin(), victims.end());
+    for (const auto &[lastUsed, index] : victims)
+    {
+        if (cached <= 2 * pointBudget_)
+        {
+            break;
+        }
+        cached -= Node(index).pointCount;
+        cache_.erase(index);
+    }
+}
+
+void OctreePointCloud::LoaderLoop()
+{
+    for (;;)
+    {
+        int index = -1;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            wake_.wait(lock, [this] { return stopping_ || !queue_.empty(); });
+            if (stopping_)
+            {
+                return;
+            }
+            index = queue_.back().second;
+            queue_.pop_back();
+            inFlight_.push_back(index);
+        }
+        vtkSmartPointer<vtkPolyData> points = LoadNode(index);
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            completed_.emplace_back(index, points);
+            inFlight_.erase(std::find(inFlight_.begin(), inFlight_.end(), index));
+        }
+        hasCompleted_ = true;
+    }
+}
+
+vtkSmartPointer<vtkPolyData> OctreePointCloud::LoadNode(int index) const
+{
+    const OctreeNode &node = Node(index);
+    const auto count = static_cast<vtkIdType>(node.pointCount);
+
+    // Copying out of the mapping faults the pages in on this thread
+    auto coords = vtkSmartPointer<vtkFloatArray>::New();
+    coords->SetNumberOfComponents(3);
+    coords->SetNumberOfTuples(count);
+    std::memcpy(coords->GetPointer(0), points_ + 3 * node.firstPoint, count * 3 * sizeof(float));
+    auto points = vtkSmartPointer<vtkPoints>::New();
+    points->SetData(coords);
+
+    // A single poly-vertex cell with 32-bit ids keeps the cell array small
+    auto offsets = vtkSmartPointer<vtkTypeInt32Array>::New();
+    offsets->SetNumberOfValues(2);
+    offsets->SetValue(0, 0);
+    offsets->SetValue(1, static_cast<int>(count));
+    auto connectivity = vtkSmartPointer<vtkTypeInt32Array>::New();
+    connectivity->SetNumberOfValues(count);
+    std::iota(connectivity->GetPointer(0), connectivity->GetPointer(0) + count, 0);
+    auto verts = vtkSmartPointer<vtkCellArray>::New();
+    verts->SetData(offsets, connectivity);
+
+    auto poly = vtkSmartPointer<vtkPolyData>::New();
+    poly->SetPoints(points);
+    poly->SetVerts(verts);
+    return poly;
+}
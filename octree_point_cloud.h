@@ -0,0 +1,106 @@
+#pragma once
+
+#include "point_octree.h"
+
+#include <vtkActor.h>
+#include <vtkCompositePolyDataMapper.h>
+#include <vtkPolyData.h>
+#include <vtkSmartPointer.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+class MappedFile;
+class vtkRenderer;
+class vtkRenderWindowInteractor;
+
+// Streams an octree file written by BuildPointOctree into a vtkRenderer.
+//
+// Every render of the renderer walks the node table (which stays mapped)
+// from the root, largest screen-space error first, keeping the nodes inside
+// the view frustum until the point budget is used up; nodes whose projected
+// point spacing is still above the error threshold are refined into their
+// children. Nodes not yet in memory are queued for a pool of loader threads
+// in priority order, and the nodes that are loaded are shown as the blocks of
+// one vtkCompositePolyDataMapper, so a block is uploaded to the GPU once and
+// reused while it stays visible. Points are rendered additively: a refined
+// node keeps showing its subsample under its children.
+class OctreePointCloud
+{
+public:
+    // Throws std::runtime_error if path is not an octree file or is corrupt.
+    explicit OctreePointCloud(const std::string &path, int loaderThreads = 2);
+    ~OctreePointCloud();
+
+    OctreePointCloud(const OctreePointCloud &) = delete;
+    OctreePointCloud &operator=(const OctreePointCloud &) = delete;
+
+    // Maximum number of points drawn per frame
+    void SetPointBudget(std::uint64_t points) { pointBudget_ = points; }
+    // Nodes are refined while their point spacing projects to more pixels
+    void SetMaxScreenSpaceError(double pixels) { maxScreenSpaceError_ = pixels; }
+
+    // Adds the point cloud to renderer and starts streaming on its renders.
+    // If an interactor is given it is re-rendered when loads complete; it must
+    // be initialized already so that it can create a timer, and outlive the
+    // point cloud, which removes its timer when destroyed.
+    void Attach(vtkRenderer *renderer, vtkRenderWindowInteractor *interactor = nullptr);
+
+    // World bounds of the whole cloud, for vtkRenderer::ResetCamera
+    void GetBounds(double bounds[6]) const;
+
+    vtkActor *GetActor() const { return actor_; }
+
+private:
+    struct CachedNode
+    {
+        vtkSmartPointer<vtkPolyData> points;
+        std::uint64_t lastUsedFrame = 0;
+    };
+
+    const OctreeNode &Node(int index) const { return nodes_[index]; }
+    void OnRenderStart();
+    void OnTimer();
+    void SelectNodes(std::vector<int> &selected, std::vector<std::pair<double, int>> &requests);
+    void LoaderLoop();
+    vtkSmartPointer<vtkPolyData> LoadNode(int index) const;
+    void EvictUnused(const std::vector<int> &shown);
+
+    std::unique_ptr<MappedFile> file_;
+    OctreeFileHeader header_{};
+    const OctreeNode *nodes_ = nullptr;
+    const float *points_ = nullptr;
+
+    std::uint64_t pointBudget_ = 5000000;
+    double maxScreenSpaceError_ = 2.0;
+
+    vtkSmartPointer<vtkCompositePolyDataMapper> mapper_;
+    vtkSmartPointer<vtkActor> actor_;
+    vtkRenderer *renderer_ = nullptr;
+    vtkRenderWindowInteractor *interactor_ = nullptr;
+    unsigned long renderObserver_ = 0;
+    unsigned long timerObserver_ = 0;
+    int timerId_ = -1;
+
+    // Render thread only
+    std::map<int, CachedNode> cache_;
+    std::vector<int> shown_;
+    std::uint64_t frame_ = 0;
+
+    // Shared with the loaders, guarded by mutex_
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::vector<std::pair<double, int>> queue_; // (priority, node), highest last
+    std::vector<int> inFlight_;
+    std::vector<std::pair<int, vtkSmartPointer<vtkPolyData>>> completed_;
+    bool stopping_ = false;
+    std::atomic<bool> hasCompleted_{false};
+    std::vector<std::thread> loaders_;
+};
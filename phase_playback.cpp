@@ -0,0 +1,175 @@
+#include "phase_playback.h"
+#include "dicom_catalog.h"
+#include "process_stats.h"
+
+#include <vtkCommand.h>
+#include <vtkPolyData.h>
+#include <vtkRenderWindowInteractor.h>
+#include <vtkRenderer.h>
+
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <exception>
+
+PhasePlayback::PhasePlayback(std::vector<std::vector<std::string>> phases, Preprocessor preprocess,
+                             int ringSize, int workers)
+    : phases_(std::move(phases))
+    , preprocess_(std::move(preprocess))
+    , ring_(static_cast<std::size_t>(std::max(ringSize, 1)))
+{
+    mapper_ = vtkSmartPointer<vtkCompositePolyDataMapper>::New();
+    actor_ = vtkSmartPointer<vtkActor>::New();
+    actor_->SetMapper(mapper_);
+
+    // Start filling the ring right away so playback starts with a full buffer
+    for (int i = 0; i < std::max(workers, 1); ++i)
+    {
+        workers_.emplace_back(&PhasePlayback::WorkerLoop, this);
+    }
+}
+
+PhasePlayback::~PhasePlayback()
+{
+    if (interactor_)
+    {
+        interactor_->DestroyTimer(timerId_);
+        interactor_->RemoveObserver(timerObserver_);
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    slotFreed_.notify_all();
+    for (std::thread &worker : workers_)
+    {
+        worker.join();
+    }
+}
+
+void PhasePlayback::Attach(vtkRenderer *renderer, vtkRenderWindowInteractor *interactor,
+                           double framesPerSecond)
+{
+    renderer->AddActor(actor_);
+    renderer_ = renderer;
+    interactor_ = interactor;
+    period_ = std::chrono::duration<double>(1.0 / std::max(framesPerSecond, 1.0));
+    timerObserver_ = interactor_->AddObserver(vtkCommand::TimerEvent, this, &PhasePlayback::OnTimer);
+    timerId_ = interactor_->CreateRepeatingTimer(
+        static_cast<unsigned long>(std::max(1.0, period_.count() * 1000.0)));
+    started_ = lastShown_ = std::chrono::steady_clock::now();
+}
+
+void PhasePlayback::WorkerLoop()
+{
+    for (;;)
+    {
+        std::uint64_t sequence = 0;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            // The slot of frame n is free once frame n - size has been shown
+            slotFreed_.wait(lock, [this] {
+                return stopping_ || nextToProduce_ < nextToShow_ + ring_.size();
+            });
+            if (stopping_)
+            {
+                return;
+            }
+            sequence = nextToProduce_++;
+            Slot &slot = ring_[sequence % ring_.size()];
+            slot.sequence = sequence;
+            slot.ready = false;
+            slot.surface = nullptr;
+        }
+
+        const std::size_t phase = sequence % phases_.size();
+        vtkSmartPointer<vtkDataObject> surface;
+        try
+        {
+            vtkSmartPointer<vtkImageData> volume = ReadDicomVolume(phases_[phase]);
+            surface = preprocess_(volume);
+        }
+        catch (const std::exception &e)
+        {
+            spdlog::error("phase {}: {}", phase, e.what());
+        }
+        if (!surface)
+        {
+            // Keep the sequence moving; an empty frame shows the failure
+            surface = vtkSmartPointer<vtkPolyData>::New();
+        }
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        Slot &slot = ring_[sequence % ring_.size()];
+        slot.surface = surface;
+        slot.ready = true;
+    }
+}
+
+void PhasePlayback::OnTimer()
+{
+    const auto now = std::chrono::steady_clock::now();
+    vtkSmartPointer<vtkDataObject> surface;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        Slot &slot = ring_[nextToShow_ % ring_.size()];
+        if (slot.ready && slot.sequence == nextToShow_)
+        {
+            // The mapper keeps the frame alive; the slot is free for reuse
+            surface = slot.surface;
+            slot.surface = nullptr;
+            slot.ready = false;
+            ++nextToShow_;
+        }
+    }
+    if (!surface)
+    {
+        ++notReady_;
+        return;
+    }
+    slotFreed_.notify_all();
+
+    if (shown_ > 0 && now - lastShown_ > 1.5 * period_)
+    {
+        ++late_;
+    }
+    lastShown_ = now;
+    mapper_->SetInputDataObject(surface);
+    if (shown_++ == 0)
+    {
+        renderer_->ResetCamera();
+    }
+    interactor_->Render();
+
+    // One report per loop over the series
+    if (shown_ % phases_.size() == 0)
+    {
+        LogStats();
+    }
+}
+
+void PhasePlayback::LogStats()
+{
+    std::size_t ringBytes = 0;
+    std::size_t ready = 0;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (const Slot &slot : ring_)
+        {
+            if (slot.ready && slot.surface)
+            {
+                ringBytes += static_cast<std::size_t>(slot.surface->GetActualMemorySize()) * 1024;
+                ++ready;
+            }
+        }
+    }
+    const double elapsed = std::chrono::duration<double>(lastShown_ - started_).count();
+    spdlog::info("playback: {} frames shown at {:.1f} fps (target {:.1f}), {} dropped "
+                 "({} not ready, {} late)",
+                 shown_, elapsed > 0.0 ? (shown_ - 1) / elapsed : 0.0, 1.0 / period_.count(),
+                 notReady_ + late_, notReady_, late_);
+    spdlog::info("playback: ring {}/{} frames ready, {:.1f} MB; process RSS {:.1f} MB "
+                 "(peak {:.1f} MB)",
+                 ready, ring_.size(), ringBytes / 1e6, CurrentResidentBytes() / 1e6,
+                 PeakResidentBytes() / 1e6);
+}
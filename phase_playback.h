@@ -0,0 +1,91 @@
+#pragma once
+
+#include <vtkActor.h>
+#include <vtkCompositePolyDataMapper.h>
+#include <vtkDataObject.h>
+#include <vtkImageData.h>
+#include <vtkSmartPointer.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+class vtkRenderer;
+class vtkRenderWindowInteractor;
+
+// Loops over the phases of a time-resolved series in a render window.
+//
+// Worker threads read phase after phase ahead of playback, run the
+// preprocessing step on it (e.g. isosurfacing to a polydata or a multiblock
+// of polydata) and park the result in a
+// fixed-size ring buffer; the ring holds at most ringSize frames, so memory
+// stays bounded however long the series is. A repeating interactor timer at
+// the target rate shows the next frame if it is ready. A tick whose frame is
+// not ready yet, or that comes late, counts as a dropped frame.
+class PhasePlayback
+{
+public:
+    using Preprocessor = std::function<vtkSmartPointer<vtkDataObject>(vtkImageData *)>;
+
+    PhasePlayback(std::vector<std::vector<std::string>> phases, Preprocessor preprocess,
+                  int ringSize = 8, int workers = 2);
+    ~PhasePlayback();
+
+    PhasePlayback(const PhasePlayback &) = delete;
+    PhasePlayback &operator=(const PhasePlayback &) = delete;
+
+    // Adds the surface actor to renderer and starts playing at the target
+    // rate; the camera is reset to the first frame shown. The interactor must
+    // be initialized so that it can create a timer, and outlive the playback,
+    // which removes its timer when destroyed.
+    void Attach(vtkRenderer *renderer, vtkRenderWindowInteractor *interactor,
+                double framesPerSecond);
+
+    // Logs frames shown and dropped, achieved rate and memory use
+    void LogStats();
+
+    vtkActor *GetActor() const { return actor_; }
+
+private:
+    struct Slot
+    {
+        std::uint64_t sequence = 0;
+        bool ready = false;
+        vtkSmartPointer<vtkDataObject> surface;
+    };
+
+    void WorkerLoop();
+    void OnTimer();
+
+    std::vector<std::vector<std::string>> phases_;
+    Preprocessor preprocess_;
+
+    vtkSmartPointer<vtkCompositePolyDataMapper> mapper_;
+    vtkSmartPointer<vtkActor> actor_;
+    vtkRenderer *renderer_ = nullptr;
+    vtkRenderWindowInteractor *interactor_ = nullptr;
+    unsigned long timerObserver_ = 0;
+    int timerId_ = -1;
+    std::chrono::duration<double> period_{0.05};
+
+    // Ring of frames; frame n lives in slot n % size while it waits
+    std::mutex mutex_;
+    std::condition_variable slotFreed_;
+    std::vector<Slot> ring_;
+    std::uint64_t nextToProduce_ = 0;
+    std::uint64_t nextToShow_ = 0;
+    bool stopping_ = false;
+    std::vector<std::thread> workers_;
+
+    // Playback statistics, timer thread only
+    std::uint64_t shown_ = 0;
+    std::uint64_t notReady_ = 0;
+    std::uint64_t late_ = 0;
+    std::chrono::steady_clock::time_point started_;
+    std::chrono::steady_clock::time_point lastShown_;
+};
@@ -0,0 +1,444 @@
+#include "point_octree.h"
+#include "mapped_file.h"
+#include "mesh_readers.h"
+
+#include <vtkSMPThreadLocal.h>
+#include <vtkSMPTools.h>
+
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <queue>
+#include <stdexcept>
+#include <vector>
+
+namespace
+{
+
+// Bits per axis of the Morton codes, i.e. the deepest possible level
+constexpr int kMortonBits = 21;
+
+// Points written per batch when emitting the final file
+constexpr std::uint64_t kWriteBatchPoints = std::uint64_t(16) << 20;
+
+struct SortRecord
+{
+    std::uint64_t code;
+    float xyz[3]; // relative to the octree origin
+};
+
+// Positions of the input, read straight from the file mapping
+class PointInput
+{
+public:
+    explicit PointInput(const std::string &path)
+        : file_(path)
+    {
+        std::string extension = std::filesystem::path(path).extension().string();
+        std::transform(extension.begin(), extension.end(), extension.begin(),
+                       [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+        if (extension == ".ply")
+        {
+            records_ = LocatePlyVertexRecords(file_);
+        }
+        else
+        {
+            if (file_.size() % (3 * sizeof(float)) != 0)
+            {
+                throw std::runtime_error(path + ": raw point file size is not a multiple of 12");
+            }
+            records_.stride = 3 * sizeof(float);
+            records_.count = static_cast<vtkIdType>(file_.size() / records_.stride);
+            records_.position[1] = sizeof(float);
+            records_.position[2] = 2 * sizeof(float);
+        }
+        file_.AdviseSequential();
+    }
+
+    std::uint64_t Count() const { return static_cast<std::uint64_t>(records_.count); }
+
+    void Get(std::uint64_t i, double p[3]) const
+    {
+        const char *record = file_.data() + records_.offset + i * records_.stride;
+        for (int k = 0; k < 3; ++k)
+        {
+            if (records_.doublePrecision)
+            {
+                std::memcpy(&p[k], record + records_.position[k], sizeof(double));
+            }
+            else
+            {
+                float value;
+                std::memcpy(&value, record + records_.position[k], sizeof(float));
+                p[k] = value;
+            }
+        }
+    }
+
+private:
+    MappedFile file_;
+    PlyVertexRecords records_;
+};
+
+// Spreads the low 21 bits of v so that there are two zero bits between each
+inline std::uint64_t SpreadBits(std::uint64_t v)
+{
+    v &= 0x1fffff;
+    v = (v | v << 32) & 0x1f00000000ffff;
+    v = (v | v << 16) & 0x1f0000ff0000ff;
+    v = (v | v << 8) & 0x100f00f00f00f00f;
+    v = (v | v << 4) & 0x10c30c30c30c30c3;
+    v = (v | v << 2) & 0x1249249249249249;
+    return v;
+}
+
+inline std::uint64_t MortonCode(const float local[3], double size)
+{
+    constexpr double kCells = double(1 << kMortonBits);
+    std::uint64_t code = 0;
+    for (int k = 0; k < 3; ++k)
+    {
+        const double cell = std::clamp(local[k] / size * kCells, 0.0, kCells - 1.0);
+        code |= SpreadBits(static_cast<std::uint64_t>(cell)) << k;
+    }
+    return code;
+}
+
+struct FileCloser
+{
+    void operator()(std::FILE *file) const { std::fclose(file); }
+};
+using FilePtr = std::unique_ptr<std::FILE, FileCloser>;
+
+FilePtr OpenFile(const std::filesystem::path &path, const char *mode)
+{
+    FilePtr file(std::fopen(path.string().c_str(), mode));
+    if (!file)
+    {
+        throw std::runtime_error("cannot open " + path.string());
+    }
+    return file;
+}
+
+void WriteAll(std::FILE *file, const void *data, std::size_t bytes)
+{
+    if (bytes > 0 && std::fwrite(data, 1, bytes, file) != bytes)
+    {
+        throw std::runtime_error("write failed (disk full?)");
+    }
+}
+
+// Buffered sequential reader over one sorted run
+class RunReader
+{
+public:
+    explicit RunReader(const std::filesystem::path &path)
+        : file_(OpenFile(path, "rb"))
+        , buffer_(kBufferRecords)
+    {
+        Refill();
+    }
+
+    bool Done() const { return pos_ == size_; }
+    const SortRecord &Front() const { return buffer_[pos_]; }
+
+    void Pop()
+    {
+        if (++pos_ == size_)
+        {
+            Refill();
+        }
+    }
+
+private:
+    static constexpr std::size_t kBufferRecords = std::size_t(1) << 16;
+
+    void Refill()
+    {
+        size_ = std::fread(buffer_.data(), sizeof(SortRecord), buffer_.size(), file_.get());
+        pos_ = 0;
+    }
+
+    FilePtr file_;
+    std::vector<SortRecord> buffer_;
+    std::size_t pos_ = 0;
+    std::size_t size_ = 0;
+};
+
+struct BuildNode
+{
+    OctreeNode node;
+    std::uint64_t begin; // range in the sorted records
+    std::uint64_t end;
+    std::uint64_t stride; // sampling stride over the range
+};
+
+double SecondsSince(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+} // namespace
+
+void BuildPointOctree(const std::string &input, const std::string &output,
+                      const OctreeBuildOptions &options)
+{
+    namespace fs = std::filesystem;
+    const auto start = std::chrono::steady_clock::now();
+
+    const PointInput points(input);
+    const std::uint64_t count = points.Count();
+    if (count == 0)
+    {
+        throw std::runtime_error(input + ": no points");
+    }
+
+    // Bounding cube of the input
+    using Bounds = std::array<double, 6>;
+    vtkSMPThreadLocal<Bounds> localBounds(
+        Bounds{std::numeric_limits<double>::max(), -std::numeric_limits<double>::max(),
+               std::numeric_limits<double>::max(), -std::numeric_limits<double>::max(),
+               std::numeric_limits<double>::max(), -std::numeric_limits<double>::max()});
+    vtkSMPTools::For(0, static_cast<vtkIdType>(count), [&](vtkIdType begin, vtkIdType end) {
+        Bounds &bounds = localBounds.Local();
+        double p[3];
+        for (vtkIdType i = begin; i < end; ++i)
+        {
+            points.Get(static_cast<std::uint64_t>(i), p);
+            for (int k = 0; k < 3; ++k)
+            {
+                bounds[2 * k] = std::min(bounds[2 * k], p[k]);
+                bounds[2 * k + 1] = std::max(bounds[2 * k + 1], p[k]);
+            }
+        }
+    });
+    double origin[3] = {std::numeric_limits<double>::max(), std::numeric_limits<double>::max(),
+                        std::numeric_limits<double>::max()};
+    double size = 0.0;
+    {
+        double upper[3] = {-std::numeric_limits<double>::max(), -std::numeric_limits<double>::max(),
+                           -std::numeric_limits<double>::max()};
+        for (const Bounds &bounds : localBounds)
+        {
+            for (int k = 0; k < 3; ++k)
+            {
+                origin[k] = std::min(origin[k], bounds[2 * k]);
+                upper[k] = std::max(upper[k], bounds[2 * k + 1]);
+            }
+        }
+        for (int k = 0; k < 3; ++k)
+        {
+            size = std::max(size, upper[k] - origin[k]);
+        }
+        // Keep the far faces inside the last cell
+        size = std::max(size * (1.0 + 1e-6), 1e-6);
+    }
+
+    // Sort runs that fit in memory and spill them to disk
+    const fs::path tempDirectory = options.tempDirectory.empty()
+                                       ? fs::absolute(output).parent_path()
+                                       : fs::path(options.tempDirectory);
+    const std::string stem = fs::path(output).filename().string();
+    const std::size_t runLength = std::max<std::size_t>(options.pointsPerRun, 1);
+    std::vector<fs::path> runPaths;
+    {
+        std::vector<SortRecord> run;
+        for (std::uint64_t first = 0; first < count; first += runLength)
+        {
+            const auto n = static_cast<vtkIdType>(std::min<std::uint64_t>(runLength, count - first));
+            run.resize(static_cast<std::size_t>(n));
+            vtkSMPTools::For(0, n, [&](vtkIdType begin, vtkIdType end) {
+                double p[3];
+                for (vtkIdType i = begin; i < end; ++i)
+                {
+                    points.Get(first + static_cast<std::uint64_t>(i), p);
+                    SortRecord &record = run[i];
+                    for (int k = 0; k < 3; ++k)
+                    {
+                        record.xyz[k] = static_cast<float>(p[k] - origin[k]);
+                    }
+                    record.code = MortonCode(record.xyz, size);
+                }
+            });
+            vtkSMPTools::Sort(run.begin(), run.end(),
+                              [](const SortRecord &a, const SortRecord &b) { return a.code < b.code; });
+
+            runPaths.push_back(tempDirectory / (stem + ".run" + std::to_string(runPaths.size())));
+            FilePtr file = OpenFile(runPaths.back(), "wb");
+            WriteAll(file.get(), run.data(), run.size() * sizeof(SortRecord));
+        }
+    }
+    spdlog::info("octree: sorted {} points into {} runs in {:.1f} s", count, runPaths.size(),
+                 SecondsSince(start));
+
+    // K-way merge of the runs into one sorted file
+    fs::path sortedPath = runPaths.front();
+    if (runPaths.size() > 1)
+    {
+        sortedPath = tempDirectory / (stem + ".sorted");
+        FilePtr out = OpenFile(sortedPath, "wb");
+        std::vector<std::unique_ptr<RunReader>> readers;
+        using HeapEntry = std::pair<std::uint64_t, std::size_t>;
+        std::priority_queue<HeapEntry, std::vector<HeapEntry>, std::greater<>> heap;
+        for (const fs::path &path : runPaths)
+        {
+            readers.push_back(std::make_unique<RunReader>(path));
+            if (!readers.back()->Done())
+            {
+                heap.emplace(readers.back()->Front().code, readers.size() - 1);
+            }
+        }
+        std::vector<SortRecord> buffer;
+        buffer.reserve(std::size_t(1) << 16);
+        while (!heap.empty())
+        {
+            RunReader &reader = *readers[heap.top().second];
+            const std::size_t index = heap.top().second;
+            heap.pop();
+            buffer.push_back(reader.Front());
+            reader.Pop();
+            if (!reader.Done())
+            {
+                heap.emplace(reader.Front().code, index);
+            }
+            if (buffer.size() == buffer.capacity())
+            {
+                WriteAll(out.get(), buffer.data(), buffer.size() * sizeof(SortRecord));
+                buffer.clear();
+            }
+        }
+        WriteAll(out.get(), buffer.data(), buffer.size() * sizeof(SortRecord));
+        readers.clear();
+        for (const fs::path &path : runPaths)
+        {
+            fs::remove(path);
+        }
+        spdlog::info("octree: merged runs in {:.1f} s", SecondsSince(start));
+    }
+
+    // Cut the hierarchy out of the Morton order: every node is a contiguous
+    // range, and its children split the range on the next three code bits.
+    std::uint64_t totalPoints = 0;
+    {
+        MappedFile sortedFile(sortedPath.string());
+        const auto *records = reinterpret_cast<const SortRecord *>(sortedFile.data());
+
+        std::vector<BuildNode> nodes;
+        BuildNode root{};
+        root.end = count;
+        root.node.size = static_cast<float>(size);
+        nodes.push_back(root);
+        for (std::size_t i = 0; i < nodes.size(); ++i)
+        {
+            BuildNode current = nodes[i];
+            const std::uint64_t n = current.end - current.begin;
+            std::fill(std::begin(current.node.children), std::end(current.node.children), -1);
+            if (n <= options.maxLeafPoints || current.node.depth == kMortonBits)
+            {
+                current.stride = 1;
+                current.node.pointCount = static_cast<std::uint32_t>(n);
+                current.node.spacing = 0.0f;
+                nodes[i] = current;
+                continue;
+            }
+
+            const std::uint64_t budget = std::max<std::uint32_t>(options.nodePoints, 1);
+            current.stride = (n + budget - 1) / budget;
+            current.node.pointCount =
+                static_cast<std::uint32_t>((n + current.stride - 1) / current.stride);
+            current.node.spacing =
+                current.node.size / std::sqrt(static_cast<float>(current.node.pointCount));
+
+            const int shift = 3 * (kMortonBits - 1 - static_cast<int>(current.node.depth));
+            const SortRecord *childBegin = records + current.begin;
+            for (int c = 0; c < 8; ++c)
+            {
+                const SortRecord *childEnd = std::partition_point(
+                    childBegin, records + current.end,
+                    [&](const SortRecord &r) { return int((r.code >> shift) & 7) <= c; });
+                if (childEnd == childBegin)
+                {
+                    continue;
+                }
+                BuildNode child{};
+                child.begin = static_cast<std::uint64_t>(childBegin - records);
+                child.end = static_cast<std::uint64_t>(childEnd - records);
+                child.node.depth = current.node.depth + 1;
+                child.node.size = current.node.size * 0.5f;
+                for (int k = 0; k < 3; ++k)
+                {
+                    child.node.min[k] = current.node.min[k] + ((c >> k) & 1) * child.node.size;
+                }
+                current.node.children[c] = static_cast<std::int32_t>(nodes.size());
+                nodes.push_back(child);
+                childBegin = childEnd;
+            }
+            nodes[i] = current;
+        }
+        for (BuildNode &bn : nodes)
+        {
+            bn.node.firstPoint = totalPoints;
+            totalPoints += bn.node.pointCount;
+        }
+
+        OctreeFileHeader header{};
+        std::memcpy(header.magic, kOctreeMagic, sizeof(kOctreeMagic));
+        header.version = kOctreeVersion;
+        header.nodeCount = static_cast<std::uint32_t>(nodes.size());
+        std::copy(origin, origin + 3, header.origin);
+        header.size = size;
+        header.pointsOffset = sizeof(OctreeFileHeader) + nodes.size() * sizeof(OctreeNode);
+        header.totalPoints = totalPoints;
+        header.sourcePoints = count;
+
+        FilePtr out = OpenFile(output, "wb");
+        WriteAll(out.get(), &header, sizeof(header));
+        for (const BuildNode &bn : nodes)
+        {
+            WriteAll(out.get(), &bn.node, sizeof(OctreeNode));
+        }
+
+        // Gather the points of a batch of nodes in parallel, then append them
+        std::vector<float> buffer;
+        for (std::size_t first = 0; first < nodes.size();)
+        {
+            std::size_t last = first;
+            std::uint64_t batchPoints = 0;
+            while (last < nodes.size() &&
+                   (last == first || batchPoints + nodes[last].node.pointCount <= kWriteBatchPoints))
+            {
+                batchPoints += nodes[last++].node.pointCount;
+            }
+            buffer.resize(3 * batchPoints);
+            const std::uint64_t batchBase = nodes[first].node.firstPoint;
+            vtkSMPTools::For(static_cast<vtkIdType>(first), static_cast<vtkIdType>(last),
+                             [&](vtkIdType begin, vtkIdType end) {
+                                 for (vtkIdType n = begin; n < end; ++n)
+                                 {
+                                     const BuildNode &bn = nodes[n];
+                                     float *out = buffer.data() + 3 * (bn.node.firstPoint - batchBase);
+                                     for (std::uint32_t j = 0; j < bn.node.pointCount; ++j)
+                                     {
+                                         std::memcpy(out + 3 * j, records[bn.begin + j * bn.stride].xyz,
+                                                     3 * sizeof(float));
+                                     }
+                                 }
+                             });
+            WriteAll(out.get(), buffer.data(), buffer.size() * sizeof(float));
+            first = last;
+        }
+        spdlog::info("octree: wrote {} nodes, {} points ({} source) to {} in {:.1f} s",
+                     nodes.size(), totalPoints, count, output, SecondsSince(start));
+    }
+    fs::remove(sortedPath);
+}
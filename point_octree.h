@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// On-disk LOD octree for point clouds too large for a vtkPolyData.
+//
+// Layout: an OctreeFileHeader, then header.nodeCount OctreeNode records in
+// breadth-first order (root first), then the points of every node as float
+// x, y, z triples relative to header.origin. Leaves hold all points of their
+// cell; interior nodes hold an evenly strided subsample of their subtree, so
+// a coarse view only needs the top of the tree.
+
+constexpr char kOctreeMagic[8] = {'S', 'V', 'E', 'O', 'C', 'T', '\0', '\0'};
+constexpr std::uint32_t kOctreeVersion = 1;
+
+struct OctreeFileHeader
+{
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t nodeCount;
+    double origin[3];
+    double size;                // edge length of the root cube
+    std::uint64_t pointsOffset; // byte offset of the first point
+    std::uint64_t totalPoints;  // points stored, including the LOD samples
+    std::uint64_t sourcePoints; // points in the input
+};
+
+struct OctreeNode
+{
+    std::uint64_t firstPoint; // index into the point array
+    std::uint32_t pointCount;
+    std::uint32_t depth;
+    std::int32_t children[8]; // -1 where the child cell is empty
+    float min[3];             // cell corner relative to the origin
+    float size;               // cell edge length
+    float spacing;            // typical distance between the node's points, 0 for leaves
+};
+
+struct OctreeBuildOptions
+{
+    // Points sorted in memory at once; each run costs 24 bytes per point
+    std::size_t pointsPerRun = std::size_t(32) << 20;
+    // Cells with more points than this are split
+    std::uint32_t maxLeafPoints = 100000;
+    // Subsample size stored in every interior node
+    std::uint32_t nodePoints = 65536;
+    // Where the sorted runs go; defaults to the output directory
+    std::string tempDirectory;
+};
+
+// Builds an octree file from a binary PLY (fixed-size vertex records) or a
+// raw file of float32 x, y, z triples (.xyz / .bin). The input is streamed
+// from a file mapping: points are Morton-coded and sorted in parallel in runs
+// of options.pointsPerRun, the runs are k-way merged on disk, and the node
+// hierarchy is cut from the merged order. Throws std::runtime_error on I/O
+// errors or unsupported input.
+void BuildPointOctree(const std::string &input, const std::string &output,
+                      const OctreeBuildOptions &options = {});
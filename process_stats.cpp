@@ -0,0 +1,66 @@
+#include "process_stats.h"
+
+#if defined(__linux__)
+#include <cstdio>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+std::size_t CurrentResidentBytes()
+{
+#if defined(__linux__)
+    std::FILE *statm = std::fopen("/proc/self/statm", "r");
+    if (!statm)
+    {
+        return 0;
+    }
+    unsigned long size = 0;
+    unsigned long resident = 0;
+    const int fields = std::fscanf(statm, "%lu %lu", &size, &resident);
+    std::fclose(statm);
+    return fields == 2 ? resident * static_cast<std::size_t>(sysconf(_SC_PAGESIZE)) : 0;
+#else
+    return 0;
+#endif
+}
+
+std::size_t PeakResidentBytes()
+{
+#if defined(__linux__)
+    // VmHWM is what clear_refs resets; ru_maxrss also keeps the peaks of
+    // exited threads, which would carry over from before a reset
+    std::FILE *status = std::fopen("/proc/self/status", "r");
+    if (!status)
+    {
+        return 0;
+    }
+    char line[256];
+    unsigned long kilobytes = 0;
+    bool found = false;
+    while (!found && std::fgets(line, sizeof(line), status))
+    {
+        found = std::sscanf(line, "VmHWM: %lu kB", &kilobytes) == 1;
+    }
+    std::fclose(status);
+    return found ? static_cast<std::size_t>(kilobytes) * 1024 : 0;
+#else
+    return 0;
+#endif
+}
+
+bool ResetPeakResidentBytes()
+{
+#if defined(__linux__)
+    // Writing 5 to clear_refs resets the high-water mark (Linux 4.0 and later)
+    const int fd = open("/proc/self/clear_refs", O_WRONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        return false;
+    }
+    const bool reset = write(fd, "5", 1) == 1;
+    close(fd);
+    return reset;
+#else
+    return false;
+#endif
+}
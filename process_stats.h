@@ -0,0 +1,13 @@
+#pragma once
+
+#include <cstddef>
+
+// Resident set size of this process in bytes, or 0 where unsupported.
+std::size_t CurrentResidentBytes();
+
+// Peak resident set size of this process in bytes, or 0 where unsupported.
+std::size_t PeakResidentBytes();
+
+// Starts the peak resident set size over from the current one, so that
+// PeakResidentBytes covers what follows. Returns false where unsupported.
+bool ResetPeakResidentBytes();
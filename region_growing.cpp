@@ -0,0 +1,255 @@
+#include "region_growing.h"
+
+#include "array_dispatch.h"
+
+#include <vtkPointData.h>
+#include <vtkSMPThreadLocal.h>
+#include <vtkSMPTools.h>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+namespace
+{
+
+using Bounds = std::array<int, 6>;
+
+constexpr Bounds kEmptyBounds = {std::numeric_limits<int>::max(), std::numeric_limits<int>::min(),
+                                 std::numeric_limits<int>::max(), std::numeric_limits<int>::min(),
+                                 std::numeric_limits<int>::max(), std::numeric_limits<int>::min()};
+
+void Include(Bounds &bounds, int i, int j, int k)
+{
+    bounds[0] = std::min(bounds[0], i);
+    bounds[1] = std::max(bounds[1], i);
+    bounds[2] = std::min(bounds[2], j);
+    bounds[3] = std::max(bounds[3], j);
+    bounds[4] = std::min(bounds[4], k);
+    bounds[5] = std::max(bounds[5], k);
+}
+
+} // namespace
+
+RegionGrowing::RegionGrowing(vtkImageData *volume, double lower, double upper)
+    : volume_(volume), scalars_(volume->GetPointData()->GetScalars()), lower_(lower),
+      upper_(upper)
+{
+    if (!scalars_)
+    {
+        throw std::invalid_argument("region growing needs a volume with scalars");
+    }
+    if (!(lower <= upper))
+    {
+        throw std::invalid_argument("region growing needs lower <= upper");
+    }
+    volume->GetDimensions(dims_);
+    const vtkIdType numVoxels = volume->GetNumberOfPoints();
+    const std::size_t words = (std::size_t(numVoxels) + 63) / 64;
+    visited_ = std::make_unique<std::atomic<std::uint64_t>[]>(words);
+    vtkSMPTools::For(0, vtkIdType(words), [&](vtkIdType begin, vtkIdType end) {
+        for (vtkIdType w = begin; w < end; ++w)
+        {
+            visited_[w].store(0, std::memory_order_relaxed);
+        }
+    });
+    bounds_ = kEmptyBounds;
+}
+
+bool RegionGrowing::AddSeed(const int ijk[3])
+{
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        if (ijk[axis] < 0 || ijk[axis] >= dims_[axis])
+        {
+            return false;
+        }
+    }
+    const vtkIdType voxel = ijk[0] + vtkIdType(dims_[0]) * (ijk[1] + vtkIdType(dims_[1]) * ijk[2]);
+    const double value = scalars_->GetComponent(voxel, 0);
+    // Written so that NaN is out of range, as in FindSeed
+    if (!(value >= lower_ && value <= upper_) || Contains(voxel))
+    {
+        return false;
+    }
+    visited_[voxel / 64].fetch_or(std::uint64_t(1) << (voxel % 64), std::memory_order_relaxed);
+    frontier_.push_back(voxel);
+    ++numVoxels_;
+    Include(bounds_, ijk[0], ijk[1], ijk[2]);
+    return true;
+}
+
+bool RegionGrowing::FindSeed(const double point[3], int radius, int ijk[3]) const
+{
+    double index[3];
+    volume_->TransformPhysicalPointToContinuousIndex(point[0], point[1], point[2], index);
+    const int *extent = volume_->GetExtent();
+    int center[3];
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        center[axis] = static_cast<int>(std::lround(index[axis])) - extent[2 * axis];
+    }
+    double nearest = std::numeric_limits<double>::max();
+    for (int dk = -radius; dk <= radius; ++dk)
+    {
+        for (int dj = -radius; dj <= radius; ++dj)
+        {
+            for (int di = -radius; di <= radius; ++di)
+            {
+                const int candidate[3] = {center[0] + di, center[1] + dj, center[2] + dk};
+                bool inside = true;
+                for (int axis = 0; axis < 3; ++axis)
+                {
+                    inside &= candidate[axis] >= 0 && candidate[axis] < dims_[axis];
+                }
+                const double distance = double(di) * di + double(dj) * dj + double(dk) * dk;
+                if (!inside || distance >= nearest)
+                {
+                    continue;
+                }
+                const vtkIdType voxel =
+                    candidate[0] +
+                    vtkIdType(dims_[0]) * (candidate[1] + vtkIdType(dims_[1]) * candidate[2]);
+                const double value = scalars_->GetComponent(voxel, 0);
+                if (value >= lower_ && value <= upper_)
+                {
+                    nearest = distance;
+                    std::copy_n(candidate, 3, ijk);
+                }
+            }
+        }
+    }
+    return nearest != std::numeric_limits<double>::max();
+}
+
+vtkIdType RegionGrowing::Step()
+{
+    if (frontier_.empty())
+    {
+        return 0;
+    }
+    const int nx = dims_[0];
+    const int ny = dims_[1];
+    const int nz = dims_[2];
+    const vtkIdType slice = vtkIdType(nx) * ny;
+    vtkSMPThreadLocal<std::vector<vtkIdType>> localNext;
+    vtkSMPThreadLocal<Bounds> localBounds(kEmptyBounds);
+    std::atomic<std::uint64_t> *visited = visited_.get();
+    const std::vector<vtkIdType> &frontier = frontier_;
+    const double lower = lower_;
+    const double upper = upper_;
+    array_dispatch::Dispatch(scalars_, [&](auto values) {
+        vtkSMPTools::For(0, vtkIdType(frontier.size()), [&](vtkIdType begin, vtkIdType end) {
+            std::vector<vtkIdType> &next = localNext.Local();
+            Bounds &bounds = localBounds.Local();
+            auto visit = [&](vtkIdType voxel, int i, int j, int k) {
+                std::atomic<std::uint64_t> &word = visited[voxel / 64];
+                const std::uint64_t bit = std::uint64_t(1) << (voxel % 64);
+                // Most neighbors are in the region already; a plain load
+                // rules them out without taking the cache line
+                if (word.load(std::memory_order_relaxed) & bit)
+                {
+                    return;
+                }
+                const double value = values.Get(voxel, 0);
+                if (!(value >= lower && value <= upper) ||
+                    (word.fetch_or(bit, std::memory_order_relaxed) & bit))
+                {
+                    return;
+                }
+                next.push_back(voxel);
+                Include(bounds, i, j, k);
+            };
+            for (vtkIdType f = begin; f < end; ++f)
+            {
+                const vtkIdType voxel = frontier[f];
+                const int i = static_cast<int>(voxel % nx);
+                const int j = static_cast<int>((voxel / nx) % ny);
+                const int k = static_cast<int>(voxel / slice);
+                if (i > 0)
+                {
+                    visit(voxel - 1, i - 1, j, k);
+                }
+                if (i + 1 < nx)
+                {
+                    visit(voxel + 1, i + 1, j, k);
+                }
+                if (j > 0)
+                {
+                    visit(voxel - nx, i, j - 1, k);
+                }
+                if (j + 1 < ny)
+                {
+                    visit(voxel + nx, i, j + 1, k);
+                }
+                if (k > 0)
+                {
+                    visit(voxel - slice, i, j, k - 1);
+                }
+                if (k + 1 < nz)
+                {
+                    visit(voxel + slice, i, j, k + 1);
+                }
+            }
+        });
+    });
+
+    // The thread queues become the next frontier
+    frontier_.clear();
+    for (const std::vector<vtkIdType> &next : localNext)
+    {
+        frontier_.insert(frontier_.end(), next.begin(), next.end());
+    }
+    for (const Bounds &bounds : localBounds)
+    {
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            bounds_[2 * axis] = std::min(bounds_[2 * axis], bounds[2 * axis]);
+            bounds_[2 * axis + 1] = std::max(bounds_[2 * axis + 1], bounds[2 * axis + 1]);
+        }
+    }
+    const vtkIdType added = static_cast<vtkIdType>(frontier_.size());
+    numVoxels_ += added;
+    ++steps_;
+    return added;
+}
+
+bool RegionGrowing::Contains(vtkIdType voxel) const
+{
+    return (visited_[voxel / 64].load(std::memory_order_relaxed) >> (voxel % 64)) & 1;
+}
+
+vtkSmartPointer<vtkImageData> RegionGrowing::GetMask() const
+{
+    if (numVoxels_ == 0)
+    {
+        return nullptr;
+    }
+    const int *extent = volume_->GetExtent();
+    auto mask = vtkSmartPointer<vtkImageData>::New();
+    mask->CopyStructure(volume_);
+    mask->SetExtent(extent[0] + bounds_[0], extent[0] + bounds_[1], extent[2] + bounds_[2],
+                    extent[2] + bounds_[3], extent[4] + bounds_[4], extent[4] + bounds_[5]);
+    mask->AllocateScalars(VTK_UNSIGNED_CHAR, 1);
+    auto *values = static_cast<unsigned char *>(mask->GetScalarPointer());
+    const int width = bounds_[1] - bounds_[0] + 1;
+    const int height = bounds_[3] - bounds_[2] + 1;
+    const int depth = bounds_[5] - bounds_[4] + 1;
+    vtkSMPTools::For(0, vtkIdType(height) * depth, [&](vtkIdType begin, vtkIdType end) {
+        for (vtkIdType row = begin; row < end; ++row)
+        {
+            const int j = bounds_[2] + static_cast<int>(row % height);
+            const int k = bounds_[4] + static_cast<int>(row / height);
+            const vtkIdType first =
+                bounds_[0] + vtkIdType(dims_[0]) * (j + vtkIdType(dims_[1]) * k);
+            unsigned char *out = values + row * width;
+            for (int i = 0; i < width; ++i)
+            {
+                out[i] = Contains(first + i) ? 1 : 0;
+            }
+        }
+    });
+    return mask;
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <vtkDataArray.h>
+#include <vtkImageData.h>
+#include <vtkSmartPointer.h>
+#include <vtkType.h>
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// Seeded region growing: the voxels with a value in [lower, upper] that are
+// 6-connected to a seed through such voxels.
+//
+// The region grows level by level from a frontier, the voxels added last:
+// every Step visits the frontier in parallel, each thread appending the
+// neighbors it claims to a queue of its own, and the queues become the next
+// frontier. Claims are atomic bit sets in a mask of one bit per voxel, so a
+// voxel reached by several threads is added once. A step is one voxel of
+// growth in every direction, which makes it a natural unit for showing the
+// region while it grows.
+//
+// Seeds may be added between steps; their growth merges with the region's.
+// Not thread-safe: seed and step from one thread.
+class RegionGrowing
+{
+public:
+    // Throws std::invalid_argument if volume has no scalars or lower > upper.
+    // The first component of the scalars is compared; NaN is never in range.
+    RegionGrowing(vtkImageData *volume, double lower, double upper);
+
+    vtkImageData *GetVolume() const { return volume_; }
+
+    // Adds the voxel at structured coordinates ijk (0 to dimension - 1) to the
+    // region and the frontier. Returns false if it is outside the volume or
+    // the range, or already in the region.
+    bool AddSeed(const int ijk[3]);
+
+    // Structured coordinates of the voxel in range nearest to the world point,
+    // looking up to radius voxels away along every axis, since picks land on
+    // surfaces, where values change. Returns false if there is none. Reads
+    // only the volume, so it may run while another thread steps.
+    bool FindSeed(const double point[3], int radius, int ijk[3]) const;
+
+    // Grows the region by one level; returns the number of voxels added
+    vtkIdType Step();
+
+    // True once the frontier is empty
+    bool IsDone() const { return frontier_.empty(); }
+
+    vtkIdType GetNumberOfVoxels() const { return numVoxels_; }
+    int GetNumberOfSteps() const { return steps_; }
+    bool Contains(vtkIdType voxel) const;
+
+    // The region as unsigned chars, 1 inside and 0 outside, over the
+    // smallest extent that holds it, with the geometry of the volume; nullptr
+    // if the region is empty
+    vtkSmartPointer<vtkImageData> GetMask() const;
+
+private:
+    vtkSmartPointer<vtkImageData> volume_;
+    vtkDataArray *scalars_;
+    double lower_;
+    double upper_;
+    int dims_[3];
+
+    std::unique_ptr<std::atomic<std::uint64_t>[]> visited_; // one bit per voxel in the region
+    std::vector<vtkIdType> frontier_;
+    vtkIdType numVoxels_ = 0;
+    int steps_ = 0;
+    std::array<int, 6> bounds_; // structured coordinates of the region, min > max while empty
+};
@@ -0,0 +1,205 @@
+#include "region_growing_tool.h"
+
+#include "label_surfaces.h"
+
+#include <vtkCellPicker.h>
+#include <vtkCommand.h>
+#include <vtkProperty.h>
+#include <vtkRenderWindowInteractor.h>
+#include <vtkRenderer.h>
+
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+
+namespace
+{
+
+// Interval of the timer that swaps region surfaces in
+constexpr unsigned long kTimerMilliseconds = 10;
+
+// Voxels searched around a pick for one within range
+constexpr int kSeedRadius = 2;
+
+double Seconds(std::chrono::steady_clock::duration duration)
+{
+    return std::chrono::duration<double>(duration).count();
+}
+
+} // namespace
+
+RegionGrowingTool::RegionGrowingTool(vtkImageData *volume, double lower, double upper,
+                                     std::chrono::milliseconds publishInterval)
+    : publishInterval_(publishInterval), region_(volume, lower, upper)
+{
+    mapper_ = vtkSmartPointer<vtkPolyDataMapper>::New();
+    mapper_->SetInputData(vtkSmartPointer<vtkPolyData>::New());
+    actor_ = vtkSmartPointer<vtkActor>::New();
+    actor_->SetMapper(mapper_);
+    actor_->GetProperty()->SetColor(1.0, 0.55, 0.1);
+    // Picks go through the region to the surface behind it
+    actor_->PickableOff();
+    picker_ = vtkSmartPointer<vtkCellPicker>::New();
+    picker_->SetTolerance(0.0005);
+    grower_ = std::thread(&RegionGrowingTool::GrowLoop, this);
+}
+
+RegionGrowingTool::~RegionGrowingTool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    seedAdded_.notify_all();
+    grower_.join();
+    if (interactor_)
+    {
+        interactor_->DestroyTimer(timerId_);
+        interactor_->RemoveObserver(timerObserver_);
+        interactor_->RemoveObserver(keyObserver_);
+    }
+}
+
+void RegionGrowingTool::Attach(vtkRenderer *renderer, vtkRenderWindowInteractor *interactor)
+{
+    renderer->AddActor(actor_);
+    renderer_ = renderer;
+    interactor_ = interactor;
+    keyObserver_ =
+        interactor_->AddObserver(vtkCommand::KeyPressEvent, this, &RegionGrowingTool::OnKeyPress);
+    timerObserver_ =
+        interactor_->AddObserver(vtkCommand::TimerEvent, this, &RegionGrowingTool::OnTimer);
+    timerId_ = interactor_->CreateRepeatingTimer(kTimerMilliseconds);
+    spdlog::info("Region growing: press g over the surface to grow a region from there");
+}
+
+void RegionGrowingTool::GrowLoop()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;)
+    {
+        seedAdded_.wait(lock, [this] { return stopping_ || !seeds_.empty(); });
+        if (stopping_)
+        {
+            return;
+        }
+        const vtkIdType before = region_.GetNumberOfVoxels();
+        const int firstStep = region_.GetNumberOfSteps();
+        double stepSeconds = 0.0;
+        Clock::time_point nextPublish = Clock::now();
+        do
+        {
+            // Seeds picked meanwhile join the frontier
+            std::vector<std::array<int, 3>> seeds;
+            seeds.swap(seeds_);
+            lock.unlock();
+            for (const std::array<int, 3> &seed : seeds)
+            {
+                region_.AddSeed(seed.data());
+            }
+            const Clock::time_point start = Clock::now();
+            region_.Step();
+            const Clock::time_point end = Clock::now();
+            stepSeconds += Seconds(end - start);
+            if (end >= nextPublish || region_.IsDone())
+            {
+                Publish();
+                // Surfaces of large regions take a while; keep them to about
+                // a fifth of the time, so that growth keeps most of it
+                const Clock::time_point published = Clock::now();
+                nextPublish = published + std::max<Clock::duration>(publishInterval_,
+                                                                      4 * (published - end));
+            }
+            lock.lock();
+        } while (!stopping_ && (!region_.IsDone() || !seeds_.empty()));
+        if (stopping_)
+        {
+            return;
+        }
+        ++grown_;
+        growSeconds_ += stepSeconds;
+        const vtkIdType added = region_.GetNumberOfVoxels() - before;
+        spdlog::info("Region growing: {} voxels added in {} steps and {:.3f} s "
+                     "({:.1f} M voxels/s), {} in the region",
+                     added, region_.GetNumberOfSteps() - firstStep, stepSeconds,
+                     stepSeconds > 0.0 ? added / stepSeconds / 1e6 : 0.0,
+                     region_.GetNumberOfVoxels());
+    }
+}
+
+void RegionGrowingTool::Publish()
+{
+    const Clock::time_point start = Clock::now();
+    vtkSmartPointer<vtkImageData> mask = region_.GetMask();
+    vtkSmartPointer<vtkPolyData> surface =
+        mask ? ExtractLabelBoundaries(mask) : vtkSmartPointer<vtkPolyData>::New();
+    const double seconds = Seconds(Clock::now() - start);
+    std::lock_guard<std::mutex> lock(mutex_);
+    latest_ = surface;
+    ++published_;
+    publishSeconds_ += seconds;
+    maxPublishSeconds_ = std::max(maxPublishSeconds_, seconds);
+}
+
+void RegionGrowingTool::OnKeyPress()
+{
+    if (interactor_->GetKeyCode() != 'g')
+    {
+        return;
+    }
+    const int *position = interactor_->GetEventPosition();
+    if (!picker_->Pick(position[0], position[1], 0.0, renderer_))
+    {
+        spdlog::info("Region growing: no surface under the pointer");
+        return;
+    }
+    double point[3];
+    picker_->GetPickPosition(point);
+    std::array<int, 3> seed;
+    if (!region_.FindSeed(point, kSeedRadius, seed.data()))
+    {
+        spdlog::info("Region growing: no voxel within the range near ({:.1f}, {:.1f}, {:.1f})",
+                     point[0], point[1], point[2]);
+        return;
+    }
+    spdlog::info("Region growing: seed at voxel ({}, {}, {})", seed[0], seed[1], seed[2]);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        seeds_.push_back(seed);
+    }
+    seedAdded_.notify_one();
+}
+
+void RegionGrowingTool::OnTimer()
+{
+    vtkSmartPointer<vtkPolyData> surface;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        surface = latest_;
+        latest_ = nullptr;
+        if (surface)
+        {
+            ++shown_;
+        }
+    }
+    if (!surface)
+    {
+        return;
+    }
+    mapper_->SetInputData(surface);
+    interactor_->Render();
+}
+
+void RegionGrowingTool::LogStats()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (grown_ == 0)
+    {
+        return;
+    }
+    spdlog::info("Region growing: {} growths, {:.3f} s growing, {} surfaces shown of {} built in "
+                 "{:.1f} ms mean, {:.1f} ms worst",
+                 grown_, growSeconds_, shown_, published_,
+                 published_ > 0 ? 1000.0 * publishSeconds_ / published_ : 0.0,
+                 1000.0 * maxPublishSeconds_);
+}
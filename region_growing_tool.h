@@ -0,0 +1,87 @@
+#pragma once
+
+#include "region_growing.h"
+
+#include <vtkActor.h>
+#include <vtkImageData.h>
+#include <vtkPolyData.h>
+#include <vtkPolyDataMapper.h>
+#include <vtkSmartPointer.h>
+
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class vtkCellPicker;
+class vtkRenderer;
+class vtkRenderWindowInteractor;
+
+// Interactive region growing in the render window: pressing g with the
+// mouse over a surface seeds the region at the picked point, and the region
+// grows on a thread of its own while the window stays interactive.
+//
+// Between steps the grower turns the region into a surface (the boundaries
+// of its mask, see label_surfaces.h) at most every publish interval; an
+// interactor timer swaps the newest one in and renders it, so the region is
+// seen spreading. Seeds picked while it grows join the growth.
+class RegionGrowingTool
+{
+public:
+    // Regions of the voxels of volume within [lower, upper]
+    RegionGrowingTool(vtkImageData *volume, double lower, double upper,
+                      std::chrono::milliseconds publishInterval = std::chrono::milliseconds(20));
+    ~RegionGrowingTool();
+
+    RegionGrowingTool(const RegionGrowingTool &) = delete;
+    RegionGrowingTool &operator=(const RegionGrowingTool &) = delete;
+
+    // Adds the region actor to renderer and starts listening for picks. The
+    // interactor must be initialized so that it can create a timer, and
+    // outlive the tool, which stops growing and detaches when destroyed.
+    void Attach(vtkRenderer *renderer, vtkRenderWindowInteractor *interactor);
+
+    // Logs the regions grown, their growth rate and the surfaces shown
+    void LogStats();
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    void GrowLoop();
+    // Surface of the region so far, handed to the timer
+    void Publish();
+    void OnKeyPress();
+    void OnTimer();
+
+    std::chrono::milliseconds publishInterval_;
+
+    // Grower thread only, apart from FindSeed, which reads the volume only
+    RegionGrowing region_;
+
+    std::mutex mutex_;
+    std::condition_variable seedAdded_;
+    std::vector<std::array<int, 3>> seeds_;
+    vtkSmartPointer<vtkPolyData> latest_; // newest surface not yet shown
+    bool stopping_ = false;
+    std::thread grower_;
+
+    vtkSmartPointer<vtkPolyDataMapper> mapper_;
+    vtkSmartPointer<vtkActor> actor_;
+    vtkSmartPointer<vtkCellPicker> picker_;
+    vtkRenderer *renderer_ = nullptr;
+    vtkRenderWindowInteractor *interactor_ = nullptr;
+    unsigned long keyObserver_ = 0;
+    unsigned long timerObserver_ = 0;
+    int timerId_ = -1;
+
+    // Statistics, under mutex_
+    std::uint64_t grown_ = 0;     // growths run to the end
+    std::uint64_t published_ = 0; // surfaces handed to the timer
+    std::uint64_t shown_ = 0;     // and rendered
+    double growSeconds_ = 0.0;    // in steps, without the surfaces
+    double publishSeconds_ = 0.0;
+    double maxPublishSeconds_ = 0.0;
+};
@@ -0,0 +1,438 @@
+#include "scene_snapshot.h"
+#include "mapped_array.h"
+#include "mapped_file.h"
+
+#include <vtkActor.h>
+#include <vtkActorCollection.h>
+#include <vtkCamera.h>
+#include <vtkCellArray.h>
+#include <vtkDataArray.h>
+#include <vtkMatrix4x4.h>
+#include <vtkPointData.h>
+#include <vtkPoints.h>
+#include <vtkPolyData.h>
+#include <vtkPolyDataMapper.h>
+#include <vtkProperty.h>
+#include <vtkRenderWindow.h>
+#include <vtkRenderer.h>
+#include <vtkSmartPointer.h>
+
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace
+{
+
+constexpr char kMagic[8] = {'V', 'T', 'K', 'S', 'C', 'E', 'N', 'E'};
+constexpr std::uint32_t kVersion = 1;
+
+// Alignment of the arrays in the file, enough for any element type and for
+// vectorized loads
+constexpr std::size_t kAlignment = 64;
+
+enum CellKind
+{
+    kVerts,
+    kLines,
+    kPolys,
+    kStrips,
+    kCellKinds
+};
+
+struct SnapshotHeader
+{
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t actors;
+    std::uint64_t keyBytes; // the key follows the header
+    std::int32_t windowSize[2];
+    double background[3];
+    double cameraPosition[3];
+    double cameraFocalPoint[3];
+    double cameraViewUp[3];
+    double cameraViewAngle;
+    double cameraParallelScale;
+    double cameraClippingRange[2];
+    std::int32_t cameraParallelProjection;
+    std::int32_t reserved;
+};
+
+// An array stored in the file; offset 0 for none
+struct ArrayRecord
+{
+    std::uint64_t offset;
+    std::int64_t tuples;
+    std::int32_t vtkType;
+    std::int32_t components;
+};
+
+struct ActorRecord
+{
+    double matrix[16];
+    double color[3];
+    double opacity;
+    double ambient;
+    double diffuse;
+    double specular;
+    double specularPower;
+    double scalarRange[2];
+    std::int32_t representation;
+    std::int32_t interpolation;
+    std::int32_t visibility;
+    std::int32_t scalarVisibility;
+    ArrayRecord points;
+    ArrayRecord normals;
+    ArrayRecord scalars;
+    ArrayRecord cellOffsets[kCellKinds];
+    ArrayRecord cellConnectivity[kCellKinds];
+};
+
+std::size_t Align(std::size_t offset)
+{
+    return (offset + kAlignment - 1) / kAlignment * kAlignment;
+}
+
+std::size_t ArrayBytes(const ArrayRecord &record)
+{
+    return std::size_t(record.tuples) * std::size_t(record.components) *
+           std::size_t(vtkDataArray::GetDataTypeSize(record.vtkType));
+}
+
+// Offset of the first actor record, after the header and the key
+std::size_t RecordsOffset(std::size_t keyBytes)
+{
+    return Align(sizeof(SnapshotHeader) + keyBytes);
+}
+
+vtkCellArray *Cells(vtkPolyData *mesh, int kind)
+{
+    switch (kind)
+    {
+    case kVerts:
+        return mesh->GetVerts();
+    case kLines:
+        return mesh->GetLines();
+    case kPolys:
+        return mesh->GetPolys();
+    default:
+        return mesh->GetStrips();
+    }
+}
+
+// Arrays to write after the actor records, laid out as they are added
+class ArrayLayout
+{
+public:
+    explicit ArrayLayout(std::size_t start)
+        : end_(start)
+    {
+    }
+
+    ArrayRecord Add(vtkDataArray *array)
+    {
+        ArrayRecord record{};
+        if (!array || array->GetNumberOfTuples() == 0)
+        {
+            return record;
+        }
+        end_ = Align(end_);
+        record.offset = end_;
+        record.tuples = array->GetNumberOfTuples();
+        record.vtkType = array->GetDataType();
+        record.components = array->GetNumberOfComponents();
+        end_ += ArrayBytes(record);
+        arrays_.emplace_back(array, record);
+        return record;
+    }
+
+    const std::vector<std::pair<vtkSmartPointer<vtkDataArray>, ArrayRecord>> &Arrays() const
+    {
+        return arrays_;
+    }
+
+    std::size_t End() const { return end_; }
+
+private:
+    std::size_t end_;
+    std::vector<std::pair<vtkSmartPointer<vtkDataArray>, ArrayRecord>> arrays_;
+};
+
+// The array of record, used in place in file
+vtkSmartPointer<vtkDataArray> MapRecord(const std::shared_ptr<const MappedFile> &file,
+                                        const ArrayRecord &record)
+{
+    if (record.offset == 0)
+    {
+        return nullptr;
+    }
+    if (record.tuples < 0 || record.components < 1 ||
+        vtkDataArray::GetDataTypeSize(record.vtkType) == 0 || record.offset % kAlignment != 0 ||
+        record.offset > file->size() || ArrayBytes(record) > file->size() - record.offset)
+    {
+        throw std::runtime_error("malformed scene snapshot " + file->path());
+    }
+    return MapArray(file, record.offset, record.vtkType, record.components, record.tuples);
+}
+
+} // namespace
+
+void WriteSceneSnapshot(const std::string &path, const std::string &key, vtkRenderer *renderer,
+                        vtkRenderWindow *window)
+{
+    const auto start = std::chrono::steady_clock::now();
+
+    std::vector<std::pair<vtkActor *, vtkPolyData *>> actors;
+    vtkActorCollection *collection = renderer->GetActors();
+    collection->InitTraversal();
+    while (vtkActor *actor = collection->GetNextActor())
+    {
+        vtkMapper *mapper = actor->GetMapper();
+        if (!mapper)
+        {
+            continue;
+        }
+        mapper->Update();
+        if (auto *mesh = vtkPolyData::SafeDownCast(mapper->GetInputDataObject(0, 0)))
+        {
+            actors.emplace_back(actor, mesh);
+        }
+    }
+
+    SnapshotHeader header{};
+    std::copy_n(kMagic, sizeof(kMagic), header.magic);
+    header.version = kVersion;
+    header.actors = static_cast<std::uint32_t>(actors.size());
+    header.keyBytes = key.size();
+    const int *size = window->GetSize();
+    header.windowSize[0] = size[0];
+    header.windowSize[1] = size[1];
+    renderer->GetBackground(header.background);
+    vtkCamera *camera = renderer->GetActiveCamera();
+    camera->GetPosition(header.cameraPosition);
+    camera->GetFocalPoint(header.cameraFocalPoint);
+    camera->GetViewUp(header.cameraViewUp);
+    header.cameraViewAngle = camera->GetViewAngle();
+    header.cameraParallelScale = camera->GetParallelScale();
+    std::copy_n(camera->GetClippingRange(), 2, header.cameraClippingRange);
+    header.cameraParallelProjection = camera->GetParallelProjection();
+
+    const std::size_t recordsOffset = RecordsOffset(key.size());
+    ArrayLayout layout(recordsOffset + actors.size() * sizeof(ActorRecord));
+    std::vector<ActorRecord> records(actors.size());
+    for (std::size_t a = 0; a < actors.size(); ++a)
+    {
+        vtkActor *actor = actors[a].first;
+        vtkPolyData *mesh = actors[a].second;
+        vtkMapper *mapper = actor->GetMapper();
+        vtkProperty *property = actor->GetProperty();
+        ActorRecord &record = records[a];
+        actor->GetMatrix(record.matrix);
+        property->GetColor(record.color);
+        record.opacity = property->GetOpacity();
+        record.ambient = property->GetAmbient();
+        record.diffuse = property->GetDiffuse();
+        record.specular = property->GetSpecular();
+        record.specularPower = property->GetSpecularPower();
+        record.representation = property->GetRepresentation();
+        record.interpolation = property->GetInterpolation();
+        record.visibility = actor->GetVisibility();
+        record.scalarVisibility = mapper->GetScalarVisibility();
+        mapper->GetScalarRange(record.scalarRange);
+
+        record.points = layout.Add(mesh->GetPoints() ? mesh->GetPoints()->GetData() : nullptr);
+        record.normals = layout.Add(mesh->GetPointData()->GetNormals());
+        record.scalars = layout.Add(mesh->GetPointData()->GetScalars());
+        for (int kind = 0; kind < kCellKinds; ++kind)
+        {
+            vtkCellArray *cells = Cells(mesh, kind);
+            if (cells && cells->GetNumberOfCells() > 0)
+            {
+                record.cellOffsets[kind] = layout.Add(cells->GetOffsetsArray());
+                record.cellConnectivity[kind] = layout.Add(cells->GetConnectivityArray());
+            }
+        }
+    }
+
+    // Written beside the old snapshot and renamed over it, so that a running
+    // viewer mapping the old one keeps its data
+    const std::string temporary = path + ".tmp";
+    {
+        std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+        if (!out)
+        {
+            throw std::runtime_error("cannot write " + temporary);
+        }
+        const std::vector<char> padding(kAlignment, 0);
+        std::size_t offset = 0;
+        auto write = [&](const void *data, std::size_t bytes) {
+            out.write(static_cast<const char *>(data), std::streamsize(bytes));
+            offset += bytes;
+        };
+        auto padTo = [&](std::size_t target) { write(padding.data(), target - offset); };
+
+        write(&header, sizeof(header));
+        write(key.data(), key.size());
+        padTo(recordsOffset);
+        write(records.data(), records.size() * sizeof(ActorRecord));
+        for (const auto &[array, record] : layout.Arrays())
+        {
+            padTo(record.offset);
+            write(array->GetVoidPointer(0), ArrayBytes(record));
+        }
+        out.close();
+        if (!out)
+        {
+            throw std::runtime_error("cannot write " + temporary);
+        }
+    }
+    std::filesystem::rename(temporary, path);
+
+    const double seconds =
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    spdlog::info("Wrote scene snapshot {} ({} actors, {:.1f} MB) in {:.3f} s", path, actors.size(),
+                 layout.End() / 1e6, seconds);
+}
+
+bool RestoreSceneSnapshot(const std::string &path, const std::string &key, vtkRenderer *renderer,
+                          vtkRenderWindow *window)
+{
+    if (!std::filesystem::exists(path))
+    {
+        return false;
+    }
+    const auto start = std::chrono::steady_clock::now();
+
+    // Copy-on-write, since VTK assumes it may write to arrays it is handed
+    auto file = std::make_shared<const MappedFile>(path, true);
+    SnapshotHeader header;
+    if (file->size() < sizeof(header))
+    {
+        throw std::runtime_error("malformed scene snapshot " + path);
+    }
+    std::memcpy(&header, file->data(), sizeof(header));
+    if (!std::equal(kMagic, kMagic + sizeof(kMagic), header.magic))
+    {
+        throw std::runtime_error(path + " is not a scene snapshot");
+    }
+    if (header.version != kVersion || header.keyBytes != key.size() ||
+        file->size() - sizeof(header) < key.size() ||
+        std::memcmp(file->data() + sizeof(header), key.data(), key.size()) != 0)
+    {
+        spdlog::info("Scene snapshot {} was written for other options or inputs; rebuilding", path);
+        return false;
+    }
+    const std::size_t recordsOffset = RecordsOffset(key.size());
+    if (recordsOffset > file->size() ||
+        header.actors > (file->size() - recordsOffset) / sizeof(ActorRecord))
+    {
+        throw std::runtime_error("malformed scene snapshot " + path);
+    }
+
+    // Build everything before touching the scene, so that a malformed file
+    // leaves it as it was
+    std::vector<vtkSmartPointer<vtkActor>> actors;
+    for (std::uint32_t a = 0; a < header.actors; ++a)
+    {
+        ActorRecord record;
+        std::memcpy(&record, file->data() + recordsOffset + a * sizeof(ActorRecord),
+                    sizeof(record));
+
+        auto mesh = vtkSmartPointer<vtkPolyData>::New();
+        if (auto data = MapRecord(file, record.points))
+        {
+            auto points = vtkSmartPointer<vtkPoints>::New();
+            points->SetData(data);
+            mesh->SetPoints(points);
+        }
+        if (auto normals = MapRecord(file, record.normals))
+        {
+            mesh->GetPointData()->SetNormals(normals);
+        }
+        if (auto scalars = MapRecord(file, record.scalars))
+        {
+            mesh->GetPointData()->SetScalars(scalars);
+        }
+        for (int kind = 0; kind < kCellKinds; ++kind)
+        {
+            auto offsets = MapRecord(file, record.cellOffsets[kind]);
+            auto connectivity = MapRecord(file, record.cellConnectivity[kind]);
+            if (!offsets || !connectivity)
+            {
+                continue;
+            }
+            auto cells = vtkSmartPointer<vtkCellArray>::New();
+            if (!cells->SetData(offsets, connectivity))
+            {
+                throw std::runtime_error("malformed cells in scene snapshot " + path);
+            }
+            switch (kind)
+            {
+            case kVerts:
+                mesh->SetVerts(cells);
+                break;
+            case kLines:
+                mesh->SetLines(cells);
+                break;
+            case kPolys:
+                mesh->SetPolys(cells);
+                break;
+            default:
+                mesh->SetStrips(cells);
+                break;
+            }
+        }
+
+        auto mapper = vtkSmartPointer<vtkPolyDataMapper>::New();
+        mapper->SetInputData(mesh);
+        mapper->SetScalarVisibility(record.scalarVisibility);
+        mapper->SetScalarRange(record.scalarRange[0], record.scalarRange[1]);
+
+        auto actor = vtkSmartPointer<vtkActor>::New();
+        actor->SetMapper(mapper);
+        auto matrix = vtkSmartPointer<vtkMatrix4x4>::New();
+        matrix->DeepCopy(record.matrix);
+        actor->SetUserMatrix(matrix);
+        actor->SetVisibility(record.visibility);
+        vtkProperty *property = actor->GetProperty();
+        property->SetColor(record.color);
+        property->SetOpacity(record.opacity);
+        property->SetAmbient(record.ambient);
+        property->SetDiffuse(record.diffuse);
+        property->SetSpecular(record.specular);
+        property->SetSpecularPower(record.specularPower);
+        property->SetRepresentation(record.representation);
+        property->SetInterpolation(record.interpolation);
+        actors.push_back(actor);
+    }
+
+    for (const auto &actor : actors)
+    {
+        renderer->AddActor(actor);
+    }
+    renderer->SetBackground(header.background);
+    vtkCamera *camera = renderer->GetActiveCamera();
+    camera->SetPosition(header.cameraPosition);
+    camera->SetFocalPoint(header.cameraFocalPoint);
+    camera->SetViewUp(header.cameraViewUp);
+    camera->SetViewAngle(header.cameraViewAngle);
+    camera->SetParallelScale(header.cameraParallelScale);
+    camera->SetParallelProjection(header.cameraParallelProjection);
+    camera->SetClippingRange(header.cameraClippingRange);
+    window->SetSize(header.windowSize[0], header.windowSize[1]);
+
+    const double seconds =
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    spdlog::info("Restored {} actors from scene snapshot {} in {:.3f} s", actors.size(), path,
+                 seconds);
+    return true;
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <string>
+
+class vtkRenderWindow;
+class vtkRenderer;
+
+// Snapshot of a built scene, restored at startup instead of running the
+// pipeline that built it.
+//
+// The file holds the polygonal data of every actor (points, normals, scalars
+// and cells, each aligned so that it can be used in place), the actor
+// properties and matrices, the camera and the window settings. Restoring maps
+// the file copy-on-write and hands the arrays to VTK without copying them, so
+// pages are read from disk only as the first render touches them.
+//
+// A snapshot records the key it was written with, typically the options and
+// inputs that built the scene, and is only restored for the same key.
+
+// Writes the actors of renderer with polygonal input, its camera and the
+// window settings to path, replacing it atomically. Throws
+// std::runtime_error if the file cannot be written.
+void WriteSceneSnapshot(const std::string &path, const std::string &key, vtkRenderer *renderer,
+                        vtkRenderWindow *window);
+
+// Adds the actors of the snapshot at path to renderer and restores its camera
+// and the window settings. Returns false, changing nothing, if there is no
+// file at path or it was written with another key or version. Throws
+// std::runtime_error if the file is malformed.
+bool RestoreSceneSnapshot(const std::string &path, const std::string &key, vtkRenderer *renderer,
+                          vtkRenderWindow *window);
@@ -0,0 +1,808 @@
+#include "shared_volume_cache.h"
+
+#include <vtkDataArray.h>
+#include <vtkMatrix3x3.h>
+#include <vtkPointData.h>
+
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <stdexcept>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+#ifdef __linux__
+
+namespace
+{
+
+// Longest key, more than the 64 characters of a DICOM UID
+constexpr std::size_t kMaxKey = 127;
+
+enum class MessageType : std::uint32_t
+{
+    Acquire, // client: wants the volume of key
+    Publish, // client: loaded the volume of key, passing its descriptor
+    Abandon, // client: could not load the volume of key
+    Release, // client: no longer holds the volume of key
+    Hit,     // host: here is the volume, with its descriptor
+    Miss,    // host: nobody has the volume, load it
+};
+
+// Everything needed to wrap the shared scalars as a vtkImageData
+struct VolumeHeader
+{
+    std::int32_t dimensions[3];
+    std::int32_t scalarType;
+    std::int32_t components;
+    double spacing[3];
+    double origin[3];
+    double direction[9];
+    std::uint64_t bytes;
+};
+
+struct Message
+{
+    MessageType type;
+    char key[kMaxKey + 1];
+    VolumeHeader header;
+};
+
+Message NewMessage(MessageType type, const std::string &key)
+{
+    Message message{};
+    message.type = type;
+    key.copy(message.key, kMaxKey);
+    return message;
+}
+
+// Sends one message, with descriptor fd attached if it is not negative
+bool SendMessage(int socket, const Message &message, int fd = -1)
+{
+    iovec data{const_cast<Message *>(&message), sizeof(message)};
+    msghdr header{};
+    header.msg_iov = &data;
+    header.msg_iovlen = 1;
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))] = {};
+    if (fd >= 0)
+    {
+        header.msg_control = control;
+        header.msg_controllen = sizeof(control);
+        cmsghdr *rights = CMSG_FIRSTHDR(&header);
+        rights->cmsg_level = SOL_SOCKET;
+        rights->cmsg_type = SCM_RIGHTS;
+        rights->cmsg_len = CMSG_LEN(sizeof(int));
+        std::memcpy(CMSG_DATA(rights), &fd, sizeof(int));
+    }
+    ssize_t sent;
+    do
+    {
+        sent = sendmsg(socket, &header, MSG_NOSIGNAL);
+    } while (sent < 0 && errno == EINTR);
+    return sent == ssize_t(sizeof(message));
+}
+
+// Receives one message and the descriptor attached to it, -1 if none. Returns
+// false when the peer is gone.
+bool ReceiveMessage(int socket, Message &message, int &fd)
+{
+    fd = -1;
+    iovec data{&message, sizeof(message)};
+    msghdr header{};
+    header.msg_iov = &data;
+    header.msg_iovlen = 1;
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))] = {};
+    header.msg_control = control;
+    header.msg_controllen = sizeof(control);
+    ssize_t received;
+    do
+    {
+        received = recvmsg(socket, &header, MSG_CMSG_CLOEXEC);
+    } while (received < 0 && errno == EINTR);
+    for (cmsghdr *rights = CMSG_FIRSTHDR(&header); rights; rights = CMSG_NXTHDR(&header, rights))
+    {
+        if (rights->cmsg_level == SOL_SOCKET && rights->cmsg_type == SCM_RIGHTS)
+        {
+            std::memcpy(&fd, CMSG_DATA(rights), sizeof(int));
+        }
+    }
+    if (received != ssize_t(sizeof(message)))
+    {
+        if (fd >= 0)
+        {
+            close(fd);
+            fd = -1;
+        }
+        return false;
+    }
+    message.key[kMaxKey] = '\0';
+    return true;
+}
+
+// Abstract socket address of a cache name, which goes away with its socket
+sockaddr_un CacheAddress(const std::string &name, socklen_t &length)
+{
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    const std::string path = "simple_vtk_example/" + name;
+    if (path.size() >= sizeof(address.sun_path))
+    {
+        throw std::invalid_argument("volume cache name too long: " + name);
+    }
+    path.copy(address.sun_path + 1, path.size());
+    length = socklen_t(offsetof(sockaddr_un, sun_path) + 1 + path.size());
+    return address;
+}
+
+// Whether the process at the other end of socket runs as this user. Abstract
+// socket names have no permissions, so anyone could host a cache or connect
+// to one.
+bool IsSameUser(int socket)
+{
+    ucred peer{};
+    socklen_t length = sizeof(peer);
+    return getsockopt(socket, SOL_SOCKET, SO_PEERCRED, &peer, &length) == 0 &&
+           peer.uid == getuid();
+}
+
+// Whether fd is sealed against changes and holds bytes. A memfd that could
+// still shrink would fault every process mapping it.
+bool IsSealedVolume(int fd, std::uint64_t bytes)
+{
+    const int seals = fcntl(fd, F_GET_SEALS);
+    constexpr int kRequired = F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE;
+    struct stat status;
+    return seals >= 0 && (seals & kRequired) == kRequired && fstat(fd, &status) == 0 &&
+           std::uint64_t(status.st_size) >= bytes;
+}
+
+// Copies the scalars of volume into a new memfd sealed against changes and
+// fills in header
+int CopyToMemfd(vtkImageData *volume, const std::string &key, VolumeHeader &header)
+{
+    vtkDataArray *scalars = volume->GetPointData()->GetScalars();
+    if (!scalars)
+    {
+        throw std::runtime_error("cannot share volume " + key + " without scalars");
+    }
+    const int *dims = volume->GetDimensions();
+    std::copy_n(dims, 3, header.dimensions);
+    header.scalarType = scalars->GetDataType();
+    header.components = scalars->GetNumberOfComponents();
+    volume->GetSpacing(header.spacing);
+    volume->GetOrigin(header.origin);
+    std::copy_n(volume->GetDirectionMatrix()->GetData(), 9, header.direction);
+    header.bytes = std::uint64_t(scalars->GetNumberOfValues()) * scalars->GetDataTypeSize();
+    if (header.bytes == 0)
+    {
+        throw std::runtime_error("cannot share empty volume " + key);
+    }
+
+    const int fd = memfd_create(("volume " + key).c_str(), MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (fd < 0)
+    {
+        throw std::runtime_error(std::string("memfd_create: ") + std::strerror(errno));
+    }
+    const char *data = static_cast<const char *>(scalars->GetVoidPointer(0));
+    std::uint64_t written = 0;
+    while (written < header.bytes)
+    {
+        const ssize_t count = pwrite(fd, data + written, header.bytes - written, off_t(written));
+        if (count < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (count <= 0)
+        {
+            const int error = errno;
+            close(fd);
+            throw std::runtime_error("cannot copy volume " + key + " to shared memory: " +
+                                     std::strerror(error));
+        }
+        written += std::uint64_t(count);
+    }
+    if (fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL) != 0)
+    {
+        const int error = errno;
+        close(fd);
+        throw std::runtime_error(std::string("cannot seal shared volume: ") +
+                                 std::strerror(error));
+    }
+    return fd;
+}
+
+// Mappings wrapped as scalars, which tell the host when their arrays go away
+struct SharedMapping
+{
+    std::size_t bytes = 0;
+    std::function<void()> release;
+};
+
+struct SharedMappingRegistry
+{
+    std::mutex mutex;
+    std::unordered_map<void *, SharedMapping> mappings;
+};
+
+SharedMappingRegistry &Registry()
+{
+    static SharedMappingRegistry registry;
+    return registry;
+}
+
+void ReleaseSharedMapping(void *data)
+{
+    SharedMapping mapping;
+    {
+        SharedMappingRegistry &registry = Registry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        auto it = registry.mappings.find(data);
+        if (it == registry.mappings.end())
+        {
+            return;
+        }
+        mapping = std::move(it->second);
+        registry.mappings.erase(it);
+    }
+    munmap(data, mapping.bytes);
+    mapping.release();
+}
+
+// Maps the shared scalars read-only and wraps them as a volume whose scalars
+// call release when deleted; fd can be closed afterwards
+vtkSmartPointer<vtkImageData> WrapShared(const VolumeHeader &header, int fd,
+                                         const std::string &key, std::function<void()> release)
+{
+    auto scalars =
+        vtkSmartPointer<vtkDataArray>::Take(vtkDataArray::CreateDataArray(header.scalarType));
+    if (!scalars || header.components < 1)
+    {
+        throw std::runtime_error("shared volume " + key + " has an unknown scalar type");
+    }
+    const vtkIdType values = vtkIdType(header.dimensions[0]) * header.dimensions[1] *
+                             header.dimensions[2] * header.components;
+    if (values <= 0 || std::uint64_t(values) * scalars->GetDataTypeSize() != header.bytes)
+    {
+        throw std::runtime_error("shared volume " + key + " does not match its dimensions");
+    }
+
+    if (!IsSealedVolume(fd, header.bytes))
+    {
+        throw std::runtime_error("shared volume " + key + " is not sealed or too small");
+    }
+    void *data = mmap(nullptr, header.bytes, PROT_READ, MAP_SHARED, fd, 0);
+    if (data == MAP_FAILED)
+    {
+        throw std::runtime_error("cannot map shared volume " + key + ": " + std::strerror(errno));
+    }
+    {
+        SharedMappingRegistry &registry = Registry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        registry.mappings[data] = SharedMapping{std::size_t(header.bytes), std::move(release)};
+    }
+    scalars->SetNumberOfComponents(header.components);
+    scalars->SetVoidArray(data, values, 0, VTK_DATA_ARRAY_USER_DEFINED);
+    scalars->SetArrayFreeFunction(ReleaseSharedMapping);
+
+    auto volume = vtkSmartPointer<vtkImageData>::New();
+    volume->SetDimensions(header.dimensions[0], header.dimensions[1], header.dimensions[2]);
+    volume->SetSpacing(header.spacing[0], header.spacing[1], header.spacing[2]);
+    volume->SetOrigin(header.origin[0], header.origin[1], header.origin[2]);
+    volume->SetDirectionMatrix(header.direction);
+    volume->GetPointData()->SetScalars(scalars);
+    return volume;
+}
+
+} // namespace
+
+// The socket of a process connected to the host. Acquire sends requests and
+// waits for replies under the cache mutex; releases from any thread only send.
+class SharedVolumeCache::Connection
+{
+public:
+    explicit Connection(int socket)
+        : socket_(socket)
+    {
+    }
+
+    ~Connection() { close(socket_); }
+
+    Connection(const Connection &) = delete;
+    Connection &operator=(const Connection &) = delete;
+
+    bool Send(const Message &message, int fd = -1)
+    {
+        std::lock_guard<std::mutex> lock(sendMutex_);
+        return SendMessage(socket_, message, fd);
+    }
+
+    bool Receive(Message &message, int &fd) { return ReceiveMessage(socket_, message, fd); }
+
+private:
+    int socket_;
+    std::mutex sendMutex_;
+};
+
+// Registry of the shared volumes, served on a thread of the hosting process.
+// Clients are served one message at a time, so no locking is needed.
+class SharedVolumeCache::Server
+{
+public:
+    explicit Server(int listener)
+        : listener_(listener)
+    {
+        if (pipe2(wake_, O_CLOEXEC) != 0)
+        {
+            close(listener_);
+            throw std::runtime_error(std::string("pipe: ") + std::strerror(errno));
+        }
+        thread_ = std::thread(&Server::Run, this);
+    }
+
+    ~Server()
+    {
+        const char stop = 0;
+        while (write(wake_[1], &stop, 1) < 0 && errno == EINTR)
+        {
+        }
+        thread_.join();
+        for (auto &[client, held] : clients_)
+        {
+            close(client);
+        }
+        for (auto &[key, entry] : entries_)
+        {
+            if (entry.fd >= 0)
+            {
+                close(entry.fd);
+            }
+        }
+        close(listener_);
+        close(wake_[0]);
+        close(wake_[1]);
+    }
+
+    Server(const Server &) = delete;
+    Server &operator=(const Server &) = delete;
+
+private:
+    struct Entry
+    {
+        int fd = -1; // memfd once published
+        VolumeHeader header{};
+        int holders = 0;
+        int loader = -1; // client loading the volume
+        std::deque<int> waiting;
+    };
+
+    void Run()
+    {
+        std::vector<pollfd> polled;
+        while (true)
+        {
+            polled.assign({{wake_[0], POLLIN, 0}, {listener_, POLLIN, 0}});
+            for (const auto &[client, held] : clients_)
+            {
+                polled.push_back({client, POLLIN, 0});
+            }
+            if (poll(polled.data(), polled.size(), -1) < 0)
+            {
+                if (errno == EINTR)
+                {
+                    continue;
+                }
+                spdlog::error("volume cache: poll failed: {}", std::strerror(errno));
+                return;
+            }
+            if (polled[0].revents != 0)
+            {
+                return;
+            }
+            if (polled[1].revents & POLLIN)
+            {
+                const int client = accept4(listener_, nullptr, nullptr, SOCK_CLOEXEC);
+                if (client >= 0 && IsSameUser(client))
+                {
+                    clients_[client];
+                }
+                else if (client >= 0)
+                {
+                    spdlog::warn("volume cache: refused a process of another user");
+                    close(client);
+                }
+            }
+            for (std::size_t i = 2; i < polled.size(); ++i)
+            {
+                if (polled[i].revents == 0)
+                {
+                    continue;
+                }
+                Message message;
+                int fd;
+                if (ReceiveMessage(polled[i].fd, message, fd))
+                {
+                    Handle(polled[i].fd, message, fd);
+                }
+                else
+                {
+                    Disconnect(polled[i].fd);
+                }
+            }
+        }
+    }
+
+    void Handle(int client, const Message &message, int fd)
+    {
+        const std::string key = message.key;
+        switch (message.type)
+        {
+        case MessageType::Acquire:
+        {
+            Entry &entry = entries_[key];
+            if (entry.fd >= 0)
+            {
+                Grant(client, key, entry);
+            }
+            else if (entry.loader >= 0)
+            {
+                entry.waiting.push_back(client);
+            }
+            else
+            {
+                entry.loader = client;
+                SendMessage(client, NewMessage(MessageType::Miss, key));
+            }
+            break;
+        }
+        case MessageType::Publish:
+        {
+            auto it = entries_.find(key);
+            if (fd < 0 || it == entries_.end() || it->second.loader != client)
+            {
+                break;
+            }
+            if (!IsSealedVolume(fd, message.header.bytes))
+            {
+                // As if the loader had failed: a waiting client loads it
+                spdlog::warn("volume cache: refused {}, which is not sealed", key);
+                PassLoad(key);
+                break;
+            }
+            Entry &entry = it->second;
+            entry.fd = std::exchange(fd, -1);
+            entry.header = message.header;
+            entry.loader = -1;
+            ++entry.holders;
+            ++clients_[client][key];
+            for (int waiter : entry.waiting)
+            {
+                Grant(waiter, key, entry);
+            }
+            entry.waiting.clear();
+            spdlog::info("volume cache: shared {} ({:.1f} MB)", key, entry.header.bytes / 1e6);
+            break;
+        }
+        case MessageType::Abandon:
+            if (auto it = entries_.find(key); it != entries_.end() && it->second.loader == client)
+            {
+                PassLoad(key);
+            }
+            break;
+        case MessageType::Release:
+        {
+            auto held = clients_[client].find(key);
+            if (held != clients_[client].end())
+            {
+                if (--held->second == 0)
+                {
+                    clients_[client].erase(held);
+                }
+                --entries_[key].holders;
+                EvictIfUnused(key);
+            }
+            break;
+        }
+        default:
+            break;
+        }
+        if (fd >= 0)
+        {
+            close(fd);
+        }
+    }
+
+    // Sends the volume of key to client, who holds it from then on
+    void Grant(int client, const std::string &key, Entry &entry)
+    {
+        Message reply = NewMessage(MessageType::Hit, key);
+        reply.header = entry.header;
+        if (SendMessage(client, reply, entry.fd))
+        {
+            ++entry.holders;
+            ++clients_[client][key];
+        }
+    }
+
+    // Lets the next waiting client load key after its loader failed or left
+    void PassLoad(const std::string &key)
+    {
+        Entry &entry = entries_[key];
+        entry.loader = -1;
+        while (!entry.waiting.empty() && entry.loader < 0)
+        {
+            const int next = entry.waiting.front();
+            entry.waiting.pop_front();
+            if (SendMessage(next, NewMessage(MessageType::Miss, key)))
+            {
+                entry.loader = next;
+            }
+        }
+        EvictIfUnused(key);
+    }
+
+    void EvictIfUnused(const std::string &key)
+    {
+        auto it = entries_.find(key);
+        if (it == entries_.end())
+        {
+            return;
+        }
+        Entry &entry = it->second;
+        if (entry.holders > 0 || entry.loader >= 0 || !entry.waiting.empty())
+        {
+            return;
+        }
+        if (entry.fd >= 0)
+        {
+            close(entry.fd);
+            spdlog::info("volume cache: evicted {}", key);
+        }
+        entries_.erase(it);
+    }
+
+    // Drops everything client held or waited for
+    void Disconnect(int client)
+    {
+        std::map<std::string, int> held = std::move(clients_[client]);
+        clients_.erase(client);
+        close(client);
+
+        std::vector<std::string> loading;
+        for (auto &[key, entry] : entries_)
+        {
+            auto &waiting = entry.waiting;
+            waiting.erase(std::remove(waiting.begin(), waiting.end(), client), waiting.end());
+            if (entry.loader == client)
+            {
+                loading.push_back(key);
+            }
+        }
+        for (const auto &[key, count] : held)
+        {
+            entries_[key].holders -= count;
+            EvictIfUnused(key);
+        }
+        for (const std::string &key : loading)
+        {
+            PassLoad(key);
+        }
+    }
+
+    int listener_;
+    int wake_[2] = {-1, -1};
+    std::map<std::string, Entry> entries_;
+    std::map<int, std::map<std::string, int>> clients_; // volumes held by each client
+    std::thread thread_;
+};
+
+SharedVolumeCache::SharedVolumeCache(const std::string &name)
+    : name_(name)
+{
+    socklen_t length;
+    CacheAddress(name_, length); // reject bad names early
+    if (!Connect())
+    {
+        spdlog::warn("volume cache {} is unavailable; volumes are loaded by this process only",
+                     name_);
+    }
+}
+
+SharedVolumeCache::~SharedVolumeCache()
+{
+    // Volumes still used elsewhere in this process just unmap when released
+    volumes_.clear();
+    connection_.reset();
+    server_.reset();
+}
+
+bool SharedVolumeCache::Connect()
+{
+    socklen_t length;
+    const sockaddr_un address = CacheAddress(name_, length);
+    for (int attempt = 0; attempt < 3; ++attempt)
+    {
+        const int client = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+        if (client < 0)
+        {
+            return false;
+        }
+        if (connect(client, reinterpret_cast<const sockaddr *>(&address), length) == 0)
+        {
+            if (!IsSameUser(client))
+            {
+                // The name is taken by someone else's process; do not trust it
+                spdlog::warn("volume cache {} is hosted by another user", name_);
+                close(client);
+                return false;
+            }
+            connection_ = std::make_shared<Connection>(client);
+            return true;
+        }
+        close(client);
+
+        // Nobody hosts the cache; host it unless another process just started to
+        const int listener = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+        if (listener < 0)
+        {
+            return false;
+        }
+        if (bind(listener, reinterpret_cast<const sockaddr *>(&address), length) == 0 &&
+            listen(listener, SOMAXCONN) == 0)
+        {
+            server_.reset();
+            server_ = std::make_unique<Server>(listener);
+            spdlog::info("Hosting volume cache {}", name_);
+        }
+        else
+        {
+            close(listener);
+        }
+    }
+    return false;
+}
+
+vtkSmartPointer<vtkImageData> SharedVolumeCache::Acquire(const std::string &key,
+                                                         const Loader &load)
+{
+    if (key.empty() || key.size() > kMaxKey)
+    {
+        throw std::invalid_argument("volume cache keys must have 1 to " +
+                                    std::to_string(kMaxKey) + " characters");
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (auto it = volumes_.find(key); it != volumes_.end())
+    {
+        return it->second;
+    }
+
+    // A second attempt reconnects if the host went away
+    for (int attempt = 0; attempt < 2; ++attempt)
+    {
+        if (!connection_ && !Connect())
+        {
+            break;
+        }
+        Message reply;
+        int fd;
+        if (!connection_->Send(NewMessage(MessageType::Acquire, key)) ||
+            !connection_->Receive(reply, fd))
+        {
+            connection_.reset();
+            continue;
+        }
+
+        // Tells the host once the scalars of this process are gone
+        auto release = [weak = std::weak_ptr<Connection>(connection_), key] {
+            if (auto connection = weak.lock())
+            {
+                connection->Send(NewMessage(MessageType::Release, key));
+            }
+        };
+        vtkSmartPointer<vtkImageData> volume;
+        if (reply.type == MessageType::Hit && fd >= 0)
+        {
+            try
+            {
+                volume = WrapShared(reply.header, fd, key, release);
+            }
+            catch (...)
+            {
+                close(fd);
+                release();
+                throw;
+            }
+            close(fd);
+            spdlog::info("Mapped shared volume {} ({:.1f} MB)", key, reply.header.bytes / 1e6);
+        }
+        else
+        {
+            if (fd >= 0)
+            {
+                close(fd);
+                fd = -1;
+            }
+            Message publish = NewMessage(MessageType::Publish, key);
+            try
+            {
+                vtkSmartPointer<vtkImageData> loaded = load();
+                fd = CopyToMemfd(loaded, key, publish.header);
+                volume = WrapShared(publish.header, fd, key, release);
+            }
+            catch (...)
+            {
+                if (fd >= 0)
+                {
+                    close(fd);
+                }
+                connection_->Send(NewMessage(MessageType::Abandon, key));
+                throw;
+            }
+            connection_->Send(publish, fd);
+            close(fd);
+        }
+        volumes_[key] = volume;
+        return volume;
+    }
+
+    spdlog::warn("volume cache {} is unavailable; loading {} in this process only", name_, key);
+    vtkSmartPointer<vtkImageData> volume = load();
+    volumes_[key] = volume;
+    return volume;
+}
+
+#else
+
+class SharedVolumeCache::Connection
+{
+};
+
+class SharedVolumeCache::Server
+{
+};
+
+SharedVolumeCache::SharedVolumeCache(const std::string &name)
+    : name_(name)
+{
+    spdlog::warn("volume cache {} needs memfd, which only Linux has; volumes are loaded by "
+                 "this process only",
+                 name_);
+}
+
+SharedVolumeCache::~SharedVolumeCache() = default;
+
+bool SharedVolumeCache::Connect()
+{
+    return false;
+}
+
+vtkSmartPointer<vtkImageData> SharedVolumeCache::Acquire(const std::string &key,
+                                                         const Loader &load)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = volumes_.find(key);
+    if (it == volumes_.end())
+    {
+        it = volumes_.emplace(key, load()).first;
+    }
+    return it->second;
+}
+
+#endif
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <vtkImageData.h>
+#include <vtkSmartPointer.h>
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+// Decoded volumes shared read-only between the viewer processes of one
+// workstation, keyed by SeriesInstanceUID.
+//
+// The first process to open a cache name hosts it: a thread of that process
+// listens on an abstract local socket and keeps the registry. A volume loaded
+// by one process is copied once into a sealed memfd, whose descriptor the host
+// passes to every process that asks for the same key; each one maps it
+// read-only and wraps the mapping as the scalars of a vtkImageData, without a
+// copy. Processes asking for a volume another one is still loading wait for it
+// instead of loading it too.
+//
+// A process holds the volumes it acquired until its cache is destroyed or it
+// exits. The host counts the holders of every volume and closes its descriptor
+// once there are none, so the kernel frees the memory with the last mapping.
+// If the hosting process exits, the others keep their volumes and one of them
+// hosts the cache from its next request on.
+//
+// Only processes of the same user share: the host refuses clients of other
+// users, a client refuses a host of another user and loads its volumes
+// itself, and descriptors that are not sealed against changes or are smaller
+// than their volume are refused on both sides. memfd is Linux only; elsewhere
+// every process loads its own volumes.
+class SharedVolumeCache
+{
+public:
+    using Loader = std::function<vtkSmartPointer<vtkImageData>()>;
+
+    // Connects to the cache called name, hosting it if no process does.
+    explicit SharedVolumeCache(const std::string &name);
+    ~SharedVolumeCache();
+
+    SharedVolumeCache(const SharedVolumeCache &) = delete;
+    SharedVolumeCache &operator=(const SharedVolumeCache &) = delete;
+
+    // Returns the volume for key, calling load if no process has it yet. The
+    // scalars of the volume must not be written to. If load throws, a process
+    // waiting for the same key loads it instead and the exception is rethrown.
+    // Loads locally, without sharing, if the cache cannot be reached.
+    vtkSmartPointer<vtkImageData> Acquire(const std::string &key, const Loader &load);
+
+private:
+    class Connection; // the socket of this process, shared with the mapped arrays
+    class Server;     // the registry, in the hosting process only
+
+    // Connects to the host, hosting the cache first if there is none
+    bool Connect();
+
+    std::string name_;
+    std::mutex mutex_; // one request at a time
+    std::map<std::string, vtkSmartPointer<vtkImageData>> volumes_;
+    std::unique_ptr<Server> server_;
+    std::shared_ptr<Connection> connection_;
+};
@@ -0,0 +1,315 @@
+#include "sinc_smooth_filter.h"
+
+#include "array_dispatch.h"
+#include "mesh_topology.h"
+
+#include <vtkCellArray.h>
+#include <vtkCellData.h>
+#include <vtkFloatArray.h>
+#include <vtkInformation.h>
+#include <vtkInformationVector.h>
+#include <vtkMath.h>
+#include <vtkObjectFactory.h>
+#include <vtkPointData.h>
+#include <vtkPoints.h>
+#include <vtkPolyData.h>
+#include <vtkSMPTools.h>
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <utility>
+#include <vector>
+
+vtkStandardNewMacro(SincSmoothPolyDataFilter);
+
+namespace
+{
+
+// Coefficients of the Chebyshev expansion of the Hamming-windowed sinc
+// filter, with the cut-off shifted so that the response at the pass band is
+// one, as in vtkWindowedSincPolyDataFilter. They are then scaled to sum to
+// one, so a flat region (and the mesh as a whole) does not drift.
+std::vector<double> SincCoefficients(int iterations, double passBand)
+{
+    const double thetaPass = std::acos(1.0 - 0.5 * passBand);
+    const double pi = vtkMath::Pi();
+    std::vector<double> window(iterations + 1);
+    for (int i = 0; i <= iterations; ++i)
+    {
+        window[i] = 0.54 + 0.46 * std::cos(i * pi / (iterations + 1));
+    }
+    std::vector<double> coefficients(iterations + 1);
+    auto compute = [&](double theta) {
+        coefficients[0] = window[0] * theta / pi;
+        for (int i = 1; i <= iterations; ++i)
+        {
+            coefficients[i] = window[i] * 2.0 * std::sin(i * theta) / (i * pi);
+        }
+    };
+
+    // Newton iterations on the shift sigma
+    double sigma = 0.0;
+    for (int step = 0; step < 50; ++step)
+    {
+        compute(thetaPass + sigma);
+        double response = 0.0;
+        double derivative = window[0] / pi;
+        for (int i = 0; i <= iterations; ++i)
+        {
+            response += coefficients[i] * std::cos(i * thetaPass);
+            if (i > 0)
+            {
+                derivative +=
+                    window[i] * 2.0 * std::cos(i * (thetaPass + sigma)) * std::cos(i * thetaPass) / pi;
+            }
+        }
+        if (std::fabs(response - 1.0) < 1e-10 || derivative == 0.0)
+        {
+            break;
+        }
+        sigma -= (response - 1.0) / derivative;
+    }
+    compute(thetaPass + sigma);
+    const double sum = std::accumulate(coefficients.begin(), coefficients.end(), 0.0);
+    for (double &coefficient : coefficients)
+    {
+        coefficient /= sum;
+    }
+    return coefficients;
+}
+
+// Positions as one float array per axis
+struct Positions
+{
+    std::vector<float> axis[3];
+
+    explicit Positions(vtkIdType count)
+    {
+        for (std::vector<float> &values : axis)
+        {
+            values.resize(count);
+        }
+    }
+};
+
+} // namespace
+
+void SincSmoothPolyDataFilter::SetNumberOfIterations(int iterations)
+{
+    iterations = std::max(iterations, 0);
+    if (numberOfIterations_ != iterations)
+    {
+        numberOfIterations_ = iterations;
+        this->Modified();
+    }
+}
+
+void SincSmoothPolyDataFilter::SetPassBand(double passBand)
+{
+    passBand = std::clamp(passBand, 0.0, 2.0);
+    if (passBand_ != passBand)
+    {
+        passBand_ = passBand;
+        this->Modified();
+    }
+}
+
+void SincSmoothPolyDataFilter::SetBoundarySmoothing(bool smoothing)
+{
+    if (boundarySmoothing_ != smoothing)
+    {
+        boundarySmoothing_ = smoothing;
+        this->Modified();
+    }
+}
+
+int SincSmoothPolyDataFilter::RequestData(vtkInformation *, vtkInformationVector **inputVector,
+                                          vtkInformationVector *outputVector)
+{
+    vtkPolyData *input = vtkPolyData::GetData(inputVector[0]);
+    vtkPolyData *output = vtkPolyData::GetData(outputVector);
+    output->CopyStructure(input);
+    output->GetPointData()->PassData(input->GetPointData());
+    output->GetCellData()->PassData(input->GetCellData());
+
+    const vtkIdType numPoints = input->GetNumberOfPoints();
+    if (numPoints == 0 || input->GetNumberOfPolys() == 0 || numberOfIterations_ == 0)
+    {
+        return 1;
+    }
+    // Shared with the stages before and after, which keep the polygons
+    const MeshTopology &topology = *MeshTopology::Get(input);
+    MeshTopology::Share(input, output);
+
+    // Center the coordinates to keep float precision
+    double bounds[6];
+    input->GetBounds(bounds);
+    const double center[3] = {0.5 * (bounds[0] + bounds[1]), 0.5 * (bounds[2] + bounds[3]),
+                              0.5 * (bounds[4] + bounds[5])};
+    vtkDataArray *inPoints = input->GetPoints()->GetData();
+    Positions previous(numPoints);
+    array_dispatch::DispatchReal(inPoints, [&](auto xyz) {
+        vtkSMPTools::For(0, numPoints, [&](vtkIdType begin, vtkIdType end) {
+            for (int a = 0; a < 3; ++a)
+            {
+                float *axis = previous.axis[a].data();
+                for (vtkIdType id = begin; id < end; ++id)
+                {
+                    axis[id] = static_cast<float>(xyz.Get(id, a) - center[a]);
+                }
+            }
+        });
+    });
+
+    auto fixed = [&](vtkIdType id) {
+        return topology.neighborOffsets[id] == topology.neighborOffsets[id + 1] ||
+               (!boundarySmoothing_ && topology.boundary[id]);
+    };
+
+    // Chebyshev recurrence on the operator x + (mean of neighbors - x) / 2:
+    // x1 = A x0, x(i) = 2 A x(i-1) - x(i-2), and the result sums c(i) x(i)
+    const std::vector<double> c = SincCoefficients(numberOfIterations_, passBand_);
+    Positions current(numPoints);
+    Positions next(numPoints);
+    Positions result(numPoints);
+    auto step = [&](const Positions &x, const Positions *before, Positions &out, float scale,
+                    float coefficient, bool first) {
+        vtkSMPTools::For(0, numPoints, [&](vtkIdType begin, vtkIdType end) {
+            for (vtkIdType id = begin; id < end; ++id)
+            {
+                // One pass over the neighbors for all three axes
+                float delta[3] = {0.0f, 0.0f, 0.0f};
+                const vtkIdType n0 = topology.neighborOffsets[id];
+                const vtkIdType n1 = topology.neighborOffsets[id + 1];
+                if (!fixed(id))
+                {
+                    for (vtkIdType n = n0; n < n1; ++n)
+                    {
+                        const vtkIdType neighbor = topology.neighbors[n];
+                        delta[0] += x.axis[0][neighbor];
+                        delta[1] += x.axis[1][neighbor];
+                        delta[2] += x.axis[2][neighbor];
+                    }
+                    for (int a = 0; a < 3; ++a)
+                    {
+                        delta[a] = delta[a] / float(n1 - n0) - x.axis[a][id];
+                    }
+                }
+                for (int a = 0; a < 3; ++a)
+                {
+                    float value = scale * (x.axis[a][id] + 0.5f * delta[a]);
+                    if (before)
+                    {
+                        value -= before->axis[a][id];
+                    }
+                    out.axis[a][id] = value;
+                    result.axis[a][id] = first ? float(c[0]) * x.axis[a][id] + coefficient * value
+                                               : result.axis[a][id] + coefficient * value;
+                }
+            }
+        });
+    };
+    step(previous, nullptr, current, 1.0f, float(c[1]), true);
+    for (int i = 2; i <= numberOfIterations_; ++i)
+    {
+        step(current, &previous, next, 2.0f, float(c[i]), false);
+        std::swap(previous, current);
+        std::swap(current, next);
+    }
+
+    auto coords = vtkSmartPointer<vtkFloatArray>::New();
+    coords->SetNumberOfComponents(3);
+    coords->SetNumberOfTuples(numPoints);
+    float *xyz = coords->GetPointer(0);
+    array_dispatch::DispatchReal(inPoints, [&](auto original) {
+        vtkSMPTools::For(0, numPoints, [&](vtkIdType begin, vtkIdType end) {
+            for (vtkIdType id = begin; id < end; ++id)
+            {
+                if (fixed(id))
+                {
+                    original.GetTuple(id, xyz + 3 * id);
+                    continue;
+                }
+                for (int a = 0; a < 3; ++a)
+                {
+                    xyz[3 * id + a] = static_cast<float>(result.axis[a][id] + center[a]);
+                }
+            }
+        });
+    });
+    auto points = vtkSmartPointer<vtkPoints>::New();
+    points->SetData(coords);
+    output->SetPoints(points);
+
+    if (input->GetPointData()->GetNormals())
+    {
+        // Area-weighted polygon normals (Newell's method) summed per vertex
+        const vtkIdType numPolys = input->GetNumberOfPolys();
+        std::vector<float> faceNormals(3 * std::size_t(numPolys));
+        vtkSMPTools::For(0, numPolys, [&](vtkIdType begin, vtkIdType end) {
+            for (vtkIdType cell = begin; cell < end; ++cell)
+            {
+                float normal[3] = {0.0f, 0.0f, 0.0f};
+                const vtkIdType c0 = topology.cornerOffsets[cell];
+                const vtkIdType c1 = topology.cornerOffsets[cell + 1];
+                for (vtkIdType c = c0; c < c1; ++c)
+                {
+                    const float *p = xyz + 3 * topology.corners[c];
+                    const float *q = xyz + 3 * topology.corners[c + 1 < c1 ? c + 1 : c0];
+                    normal[0] += (p[1] - q[1]) * (p[2] + q[2]);
+                    normal[1] += (p[2] - q[2]) * (p[0] + q[0]);
+                    normal[2] += (p[0] - q[0]) * (p[1] + q[1]);
+                }
+                std::copy_n(normal, 3, &faceNormals[3 * cell]);
+            }
+        });
+
+        // Keep the side the input normals pointed to
+        vtkDataArray *inNormals = input->GetPointData()->GetNormals();
+        auto normals = vtkSmartPointer<vtkFloatArray>::New();
+        normals->SetName(inNormals->GetName());
+        normals->SetNumberOfComponents(3);
+        normals->SetNumberOfTuples(numPoints);
+        float *n = normals->GetPointer(0);
+        array_dispatch::DispatchReal(inNormals, [&](auto before) {
+            vtkSMPTools::For(0, numPoints, [&](vtkIdType begin, vtkIdType end) {
+                for (vtkIdType id = begin; id < end; ++id)
+                {
+                    float sum[3] = {0.0f, 0.0f, 0.0f};
+                    const vtkIdType f1 = topology.faceOffsets[id + 1];
+                    for (vtkIdType f = topology.faceOffsets[id]; f < f1; ++f)
+                    {
+                        for (int a = 0; a < 3; ++a)
+                        {
+                            sum[a] += faceNormals[3 * topology.faces[f] + a];
+                        }
+                    }
+                    double old[3];
+                    before.GetTuple(id, old);
+                    const float length =
+                        std::sqrt(sum[0] * sum[0] + sum[1] * sum[1] + sum[2] * sum[2]);
+                    const float scale =
+                        length == 0.0f ? 0.0f
+                                       : (sum[0] * old[0] + sum[1] * old[1] + sum[2] * old[2] < 0.0
+                                              ? -1.0f / length
+                                              : 1.0f / length);
+                    for (int a = 0; a < 3; ++a)
+                    {
+                        n[3 * id + a] = sum[a] * scale;
+                    }
+                }
+            });
+        });
+        output->GetPointData()->SetNormals(normals);
+    }
+    return 1;
+}
+
+void SincSmoothPolyDataFilter::PrintSelf(ostream &os, vtkIndent indent)
+{
+    this->Superclass::PrintSelf(os, indent);
+    os << indent << "Number of iterations: " << numberOfIterations_ << "\n";
+    os << indent << "Pass band: " << passBand_ << "\n";
+    os << indent << "Boundary smoothing: " << (boundarySmoothing_ ? "On" : "Off") << "\n";
+}
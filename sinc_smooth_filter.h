@@ -0,0 +1,47 @@
+#pragma once
+
+#include <vtkPolyDataAlgorithm.h>
+
+// Windowed-sinc smoothing of polygonal surfaces (Taubin, Zhang and Golub),
+// the filter of vtkWindowedSincPolyDataFilter run in parallel.
+//
+// The vertex adjacency comes from the MeshTopology cache of the input, which
+// the output shares; every Chebyshev iteration then updates all vertices in
+// parallel from structure-of-arrays float buffers. Boundary vertices are
+// smoothed along with the rest unless BoundarySmoothing is off; there is no
+// feature-edge detection. Output points are float, and point normals are
+// recomputed for the smoothed surface when the input had any.
+class SincSmoothPolyDataFilter : public vtkPolyDataAlgorithm
+{
+public:
+    static SincSmoothPolyDataFilter *New();
+    vtkTypeMacro(SincSmoothPolyDataFilter, vtkPolyDataAlgorithm);
+    void PrintSelf(ostream &os, vtkIndent indent) override;
+
+    // Degree of the Chebyshev polynomial (20)
+    void SetNumberOfIterations(int iterations);
+    int GetNumberOfIterations() const { return numberOfIterations_; }
+
+    // Pass band in (0, 2); smaller values smooth more (0.1)
+    void SetPassBand(double passBand);
+    double GetPassBand() const { return passBand_; }
+
+    // Whether vertices on boundary edges move (on)
+    void SetBoundarySmoothing(bool smoothing);
+    bool GetBoundarySmoothing() const { return boundarySmoothing_; }
+
+protected:
+    SincSmoothPolyDataFilter() = default;
+    ~SincSmoothPolyDataFilter() override = default;
+
+    int RequestData(vtkInformation *request, vtkInformationVector **inputVector,
+                    vtkInformationVector *outputVector) override;
+
+private:
+    SincSmoothPolyDataFilter(const SincSmoothPolyDataFilter &) = delete;
+    void operator=(const SincSmoothPolyDataFilter &) = delete;
+
+    int numberOfIterations_ = 20;
+    double passBand_ = 0.1;
+    bool boundarySmoothing_ = true;
+};
@@ -0,0 +1,272 @@
+#include "sparse_distance_field.h"
+
+#include <vtkSMPTools.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <limits>
+
+namespace
+{
+
+constexpr int kBlockSize = SparseDistanceField::kBlockSize;
+
+std::size_t PointIndex(int x, int y, int z)
+{
+    return (std::size_t(z) * kBlockSize + y) * kBlockSize + x;
+}
+
+} // namespace
+
+SparseDistanceField::SparseDistanceField(const TriangleBVH &bvh, vtkImageData *grid,
+                                         double bandWidth)
+{
+    grid->GetExtent(extent_);
+    grid->GetOrigin(origin_);
+    grid->GetSpacing(spacing_);
+    bandWidth_ = std::max(bandWidth, 2.0 * std::max({spacing_[0], spacing_[1], spacing_[2]}));
+    int points[3];
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        points[axis] = std::max(0, extent_[2 * axis + 1] - extent_[2 * axis] + 1);
+        blockCounts_[axis] = (points[axis] + kBlockSize - 1) / kBlockSize;
+    }
+    blockTable_.assign(std::size_t(blockCounts_[0]) * blockCounts_[1] * blockCounts_[2], kOutside);
+    if (blockTable_.empty())
+    {
+        return;
+    }
+
+    // Mark the blocks that the band around every triangle's bounds overlaps
+    std::vector<std::atomic<std::uint8_t>> touched(blockTable_.size());
+    vtkSMPTools::For(0, bvh.GetNumberOfTriangles(), [&](vtkIdType begin, vtkIdType end) {
+        for (vtkIdType t = begin; t < end; ++t)
+        {
+            double bounds[6];
+            bvh.GetTriangleBounds(t, bounds);
+            int first[3], last[3];
+            bool inside = true;
+            for (int axis = 0; axis < 3; ++axis)
+            {
+                const double low = (bounds[2 * axis] - bandWidth_ - origin_[axis]) / spacing_[axis];
+                const double high =
+                    (bounds[2 * axis + 1] + bandWidth_ - origin_[axis]) / spacing_[axis];
+                const int lowPoint =
+                    std::max(0, static_cast<int>(std::ceil(low)) - extent_[2 * axis]);
+                const int highPoint = std::min(
+                    points[axis] - 1, static_cast<int>(std::floor(high)) - extent_[2 * axis]);
+                inside = inside && lowPoint <= highPoint;
+                first[axis] = lowPoint / kBlockSize;
+                last[axis] = highPoint / kBlockSize;
+            }
+            if (!inside)
+            {
+                continue;
+            }
+            for (int bz = first[2]; bz <= last[2]; ++bz)
+            {
+                for (int by = first[1]; by <= last[1]; ++by)
+                {
+                    for (int bx = first[0]; bx <= last[0]; ++bx)
+                    {
+                        touched[(std::size_t(bz) * blockCounts_[1] + by) * blockCounts_[0] + bx]
+                            .store(1, std::memory_order_relaxed);
+                    }
+                }
+            }
+        }
+    });
+
+    std::vector<std::size_t> stored;
+    for (std::size_t b = 0; b < blockTable_.size(); ++b)
+    {
+        if (touched[b].load(std::memory_order_relaxed))
+        {
+            blockTable_[b] = static_cast<std::int32_t>(stored.size());
+            stored.push_back(b);
+        }
+    }
+    blocks_.resize(stored.size());
+
+    // Exact distances for every point of the stored blocks
+    const float band = static_cast<float>(bandWidth_);
+    vtkSMPTools::For(0, static_cast<vtkIdType>(stored.size()), [&](vtkIdType begin, vtkIdType end) {
+        for (vtkIdType s = begin; s < end; ++s)
+        {
+            const std::size_t b = stored[s];
+            const int block[3] = {int(b % blockCounts_[0]),
+                                  int(b / blockCounts_[0] % blockCounts_[1]),
+                                  int(b / blockCounts_[0] / blockCounts_[1])};
+            std::array<float, kBlockPoints> &values = blocks_[s];
+            for (int z = 0; z < kBlockSize; ++z)
+            {
+                for (int y = 0; y < kBlockSize; ++y)
+                {
+                    for (int x = 0; x < kBlockSize; ++x)
+                    {
+                        const int local[3] = {x, y, z};
+                        double p[3];
+                        for (int axis = 0; axis < 3; ++axis)
+                        {
+                            // Points past the end of the extent are padding
+                            const int index = std::min(block[axis] * kBlockSize + local[axis],
+                                                       points[axis] - 1);
+                            p[axis] = origin_[axis] + (extent_[2 * axis] + index) * spacing_[axis];
+                        }
+                        const double distance =
+                            bvh.SignedDistance(p, std::numeric_limits<double>::infinity());
+                        values[PointIndex(x, y, z)] =
+                            std::clamp(static_cast<float>(distance), -band, band);
+                    }
+                }
+            }
+        }
+    });
+
+    FillTileSigns();
+}
+
+void SparseDistanceField::FillTileSigns()
+{
+    // Sign of the x face of a stored block that is farthest from the surface
+    auto faceSign = [&](std::int32_t block, int x) {
+        float farthest = 0.0f;
+        for (int z = 0; z < kBlockSize; ++z)
+        {
+            for (int y = 0; y < kBlockSize; ++y)
+            {
+                const float value = blocks_[block][PointIndex(x, y, z)];
+                if (std::fabs(value) > std::fabs(farthest))
+                {
+                    farthest = value;
+                }
+            }
+        }
+        return farthest < 0.0f ? kInside : kOutside;
+    };
+
+    // Tiles take the sign of the nearest stored block on their left, or on
+    // their right at the start of a row; the band keeps the surface out of
+    // the space between them
+    const vtkIdType rows = vtkIdType(blockCounts_[1]) * blockCounts_[2];
+    vtkSMPTools::For(0, rows, [&](vtkIdType begin, vtkIdType end) {
+        for (vtkIdType row = begin; row < end; ++row)
+        {
+            std::int32_t *table = &blockTable_[std::size_t(row) * blockCounts_[0]];
+            std::int32_t sign = kOutside;
+            for (int bx = 0; bx < blockCounts_[0]; ++bx)
+            {
+                if (table[bx] >= 0)
+                {
+                    sign = faceSign(table[bx], 0);
+                    break;
+                }
+            }
+            for (int bx = 0; bx < blockCounts_[0]; ++bx)
+            {
+                if (table[bx] >= 0)
+                {
+                    const int width = extent_[1] - extent_[0] + 1 - bx * kBlockSize;
+                    sign = faceSign(table[bx], std::min(kBlockSize, width) - 1);
+                }
+                else
+                {
+                    table[bx] = sign;
+                }
+            }
+        }
+    });
+}
+
+float SparseDistanceField::GetValue(int i, int j, int k) const
+{
+    i -= extent_[0];
+    j -= extent_[2];
+    k -= extent_[4];
+    const std::int32_t block = BlockAt(i / kBlockSize, j / kBlockSize, k / kBlockSize);
+    if (block < 0)
+    {
+        return block == kInside ? -float(bandWidth_) : float(bandWidth_);
+    }
+    return blocks_[block][PointIndex(i % kBlockSize, j % kBlockSize, k % kBlockSize)];
+}
+
+void SparseDistanceField::Sample(const int extent[6], float *out) const
+{
+    const int nx = extent[1] - extent[0] + 1;
+    const int ny = extent[3] - extent[2] + 1;
+    const int nz = extent[5] - extent[4] + 1;
+    if (nx <= 0 || ny <= 0 || nz <= 0)
+    {
+        return;
+    }
+    const float band = static_cast<float>(bandWidth_);
+    vtkSMPTools::For(0, nz, [&](vtkIdType begin, vtkIdType end) {
+        for (vtkIdType slice = begin; slice < end; ++slice)
+        {
+            const int k = extent[4] + int(slice) - extent_[4];
+            for (int row = 0; row < ny; ++row)
+            {
+                const int j = extent[2] + row - extent_[2];
+                float *values = out + (std::size_t(slice) * ny + row) * nx;
+                // Copy a run of up to a block's width at a time
+                for (int i = extent[0] - extent_[0]; i <= extent[1] - extent_[0];)
+                {
+                    const int run =
+                        std::min(kBlockSize - i % kBlockSize, extent[1] - extent_[0] - i + 1);
+                    const std::int32_t block =
+                        BlockAt(i / kBlockSize, j / kBlockSize, k / kBlockSize);
+                    if (block < 0)
+                    {
+                        std::fill_n(values, run, block == kInside ? -band : band);
+                    }
+                    else
+                    {
+                        std::copy_n(&blocks_[block][PointIndex(i % kBlockSize, j % kBlockSize,
+                                                               k % kBlockSize)],
+                                    run, values);
+                    }
+                    values += run;
+                    i += run;
+                }
+            }
+        }
+    });
+}
+
+std::size_t SparseDistanceField::GetMemorySize() const
+{
+    return blockTable_.capacity() * sizeof(std::int32_t) +
+           blocks_.capacity() * sizeof(std::array<float, kBlockPoints>);
+}
+
+std::size_t SparseDistanceField::GetDenseMemorySize() const
+{
+    std::size_t points = 1;
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        points *= std::size_t(std::max(0, extent_[2 * axis + 1] - extent_[2 * axis] + 1));
+    }
+    return points * sizeof(float);
+}
+
+vtkSmartPointer<vtkImageData> CreateDistanceFieldGrid(const double bounds[6], int resolution,
+                                                      int padding)
+{
+    const double longest = std::max({bounds[1] - bounds[0], bounds[3] - bounds[2],
+                                      bounds[5] - bounds[4], std::numeric_limits<double>::min()});
+    const double spacing = longest / std::max(resolution - 1, 1);
+    auto grid = vtkSmartPointer<vtkImageData>::New();
+    int dimensions[3];
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        const double length = bounds[2 * axis + 1] - bounds[2 * axis];
+        dimensions[axis] = static_cast<int>(std::ceil(length / spacing)) + 1 + 2 * padding;
+    }
+    grid->SetDimensions(dimensions);
+    grid->SetOrigin(bounds[0] - padding * spacing, bounds[2] - padding * spacing,
+                    bounds[4] - padding * spacing);
+    grid->SetSpacing(spacing, spacing, spacing);
+    return grid;
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include "triangle_bvh.h"
+
+#include <vtkImageData.h>
+#include <vtkSmartPointer.h>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Narrow-band signed distance field of a mesh on the points of a grid, in a
+// sparse two-level layout in the spirit of OpenVDB: a table over blocks of
+// 8^3 points, where only blocks within bandWidth of a triangle hold values.
+// Every other block is a tile that stores nothing but its sign, found by
+// scanning each row of blocks from the nearest stored block. Values are
+// clamped to +-bandWidth, which is also the value of tiles.
+class SparseDistanceField
+{
+public:
+    static constexpr int kBlockSize = 8;
+    static constexpr int kBlockPoints = kBlockSize * kBlockSize * kBlockSize;
+
+    // Samples bvh on the extent, origin and spacing of grid. Distances are
+    // exact within bandWidth (world units, at least two voxels); the grid is
+    // expected to enclose the mesh.
+    SparseDistanceField(const TriangleBVH &bvh, vtkImageData *grid, double bandWidth);
+
+    // Value at the point (i, j, k) of the extent
+    float GetValue(int i, int j, int k) const;
+
+    // Copies the values of a sub-extent into out, x fastest
+    void Sample(const int extent[6], float *out) const;
+
+    const int *GetExtent() const { return extent_; }
+    const double *GetOrigin() const { return origin_; }
+    const double *GetSpacing() const { return spacing_; }
+    double GetBandWidth() const { return bandWidth_; }
+
+    std::size_t GetNumberOfBlocks() const { return blockTable_.size(); }
+    std::size_t GetNumberOfStoredBlocks() const { return blocks_.size(); }
+    std::size_t GetMemorySize() const;
+    // Size of the same field as a dense float image
+    std::size_t GetDenseMemorySize() const;
+
+private:
+    // Block table entries below zero are tiles
+    static constexpr std::int32_t kOutside = -1;
+    static constexpr std::int32_t kInside = -2;
+
+    std::int32_t BlockAt(int bx, int by, int bz) const
+    {
+        return blockTable_[(std::size_t(bz) * blockCounts_[1] + by) * blockCounts_[0] + bx];
+    }
+    void FillTileSigns();
+
+    int extent_[6];
+    double origin_[3];
+    double spacing_[3];
+    double bandWidth_;
+    int blockCounts_[3];
+    std::vector<std::int32_t> blockTable_;
+    std::vector<std::array<float, kBlockPoints>> blocks_;
+};
+
+// Grid without scalars for a distance field of bounds: isotropic, with
+// resolution points along the longest side and padding more on every side.
+vtkSmartPointer<vtkImageData> CreateDistanceFieldGrid(const double bounds[6], int resolution,
+                                                      int padding = 3);
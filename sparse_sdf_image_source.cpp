@@ -0,0 +1,60 @@
+#include "sparse_sdf_image_source.h"
+
+#include <vtkDataArray.h>
+#include <vtkDataObject.h>
+#include <vtkImageData.h>
+#include <vtkInformation.h>
+#include <vtkInformationVector.h>
+#include <vtkObjectFactory.h>
+#include <vtkPointData.h>
+#include <vtkStreamingDemandDrivenPipeline.h>
+
+vtkStandardNewMacro(SparseSDFImageSource);
+
+SparseSDFImageSource::SparseSDFImageSource()
+{
+    this->SetNumberOfInputPorts(0);
+}
+
+void SparseSDFImageSource::SetField(std::shared_ptr<const SparseDistanceField> field)
+{
+    if (field_ != field)
+    {
+        field_ = std::move(field);
+        this->Modified();
+    }
+}
+
+int SparseSDFImageSource::RequestInformation(vtkInformation *, vtkInformationVector **,
+                                             vtkInformationVector *outputVector)
+{
+    if (!field_)
+    {
+        vtkErrorMacro("No distance field set");
+        return 0;
+    }
+    vtkInformation *outInfo = outputVector->GetInformationObject(0);
+    outInfo->Set(vtkStreamingDemandDrivenPipeline::WHOLE_EXTENT(), field_->GetExtent(), 6);
+    outInfo->Set(vtkDataObject::ORIGIN(), field_->GetOrigin(), 3);
+    outInfo->Set(vtkDataObject::SPACING(), field_->GetSpacing(), 3);
+    vtkDataObject::SetPointDataActiveScalarInfo(outInfo, VTK_FLOAT, 1);
+    return 1;
+}
+
+void SparseSDFImageSource::ExecuteDataWithInformation(vtkDataObject *output, vtkInformation *outInfo)
+{
+    vtkImageData *image = this->AllocateOutputData(output, outInfo);
+    image->GetPointData()->GetScalars()->SetName("SignedDistance");
+    field_->Sample(image->GetExtent(), static_cast<float *>(image->GetScalarPointer()));
+}
+
+void SparseSDFImageSource::PrintSelf(ostream &os, vtkIndent indent)
+{
+    this->Superclass::PrintSelf(os, indent);
+    if (field_)
+    {
+        os << indent << "Band width: " << field_->GetBandWidth() << "\n";
+        os << indent << "Stored blocks: " << field_->GetNumberOfStoredBlocks() << " of "
+           << field_->GetNumberOfBlocks() << "\n";
+    }
+}
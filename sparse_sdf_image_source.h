@@ -0,0 +1,35 @@
+#pragma once
+
+#include "sparse_distance_field.h"
+
+#include <vtkImageAlgorithm.h>
+
+#include <memory>
+
+// Source that presents a SparseDistanceField as a float image, so it can feed
+// any image filter (vtkFlyingEdges3D at 0 gives the surface back). Only the
+// requested update extent is expanded to dense storage.
+class SparseSDFImageSource : public vtkImageAlgorithm
+{
+public:
+    static SparseSDFImageSource *New();
+    vtkTypeMacro(SparseSDFImageSource, vtkImageAlgorithm);
+    void PrintSelf(ostream &os, vtkIndent indent) override;
+
+    void SetField(std::shared_ptr<const SparseDistanceField> field);
+    const SparseDistanceField *GetField() const { return field_.get(); }
+
+protected:
+    SparseSDFImageSource();
+    ~SparseSDFImageSource() override = default;
+
+    int RequestInformation(vtkInformation *request, vtkInformationVector **inputVector,
+                           vtkInformationVector *outputVector) override;
+    void ExecuteDataWithInformation(vtkDataObject *output, vtkInformation *outInfo) override;
+
+private:
+    SparseSDFImageSource(const SparseSDFImageSource &) = delete;
+    void operator=(const SparseSDFImageSource &) = delete;
+
+    std::shared_ptr<const SparseDistanceField> field_;
+};
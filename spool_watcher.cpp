@@ -0,0 +1,372 @@
+#include "spool_watcher.h"
+
+#include <vtkCommand.h>
+#include <vtkPolyData.h>
+#include <vtkRenderWindowInteractor.h>
+#include <vtkRenderer.h>
+#include <vtkSMPTools.h>
+
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <exception>
+#include <filesystem>
+#include <optional>
+#include <stdexcept>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+
+// Longest the watcher sleeps, so that it notices being stopped
+constexpr std::chrono::milliseconds kPollInterval(100);
+
+// Interval of the timer that swaps finished surfaces in
+constexpr unsigned long kTimerMilliseconds = 50;
+
+#ifdef __linux__
+constexpr std::uint32_t kDirectoryEvents = IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE;
+#endif
+
+double Seconds(std::chrono::steady_clock::duration duration)
+{
+    return std::chrono::duration<double>(duration).count();
+}
+
+} // namespace
+
+DicomSpoolWatcher::DicomSpoolWatcher(const std::string &directory, Preprocessor preprocess,
+                                     double settleSeconds)
+    : directory_(directory)
+    , preprocess_(std::move(preprocess))
+    , settle_(std::chrono::duration_cast<Clock::duration>(
+          std::chrono::duration<double>(std::max(settleSeconds, 0.0))))
+{
+    if (!std::filesystem::is_directory(directory_))
+    {
+        throw std::runtime_error("cannot watch " + directory_ + ": not a directory");
+    }
+    mapper_ = vtkSmartPointer<vtkCompositePolyDataMapper>::New();
+    actor_ = vtkSmartPointer<vtkActor>::New();
+    actor_->SetMapper(mapper_);
+
+#ifdef __linux__
+    inotify_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotify_ < 0)
+    {
+        throw std::runtime_error("cannot watch " + directory_ + ": inotify unavailable");
+    }
+#endif
+    // Watches go in before the listing, so that no file slips between them
+    std::vector<std::string> initial = WatchTree(directory_);
+    spdlog::info("spool: watching {} ({} files already there)", directory_, initial.size());
+    worker_ = std::thread(&DicomSpoolWatcher::WorkerLoop, this);
+    watcher_ = std::thread(&DicomSpoolWatcher::WatchLoop, this, std::move(initial));
+}
+
+DicomSpoolWatcher::~DicomSpoolWatcher()
+{
+    if (interactor_)
+    {
+        interactor_->DestroyTimer(timerId_);
+        interactor_->RemoveObserver(timerObserver_);
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    jobAdded_.notify_all();
+    watcher_.join();
+    worker_.join();
+#ifdef __linux__
+    ::close(inotify_);
+#endif
+}
+
+void DicomSpoolWatcher::Attach(vtkRenderer *renderer, vtkRenderWindowInteractor *interactor)
+{
+    renderer->AddActor(actor_);
+    renderer_ = renderer;
+    interactor_ = interactor;
+    timerObserver_ =
+        interactor_->AddObserver(vtkCommand::TimerEvent, this, &DicomSpoolWatcher::OnTimer);
+    timerId_ = interactor_->CreateRepeatingTimer(kTimerMilliseconds);
+}
+
+std::vector<std::string> DicomSpoolWatcher::WatchTree(const std::string &root)
+{
+    namespace fs = std::filesystem;
+    std::vector<std::string> directories = {root};
+    std::vector<std::string> files;
+    std::error_code error;
+    for (fs::recursive_directory_iterator it(root, fs::directory_options::skip_permission_denied,
+                                             error),
+         end;
+         !error && it != end; it.increment(error))
+    {
+        if (it->is_directory(error))
+        {
+            directories.push_back(it->path().string());
+        }
+        else if (it->is_regular_file(error))
+        {
+            files.push_back(it->path().string());
+        }
+    }
+#ifdef __linux__
+    for (const std::string &directory : directories)
+    {
+        const int watch = inotify_add_watch(inotify_, directory.c_str(), kDirectoryEvents);
+        if (watch >= 0)
+        {
+            watches_[watch] = directory;
+        }
+        else if (directory == root && root == directory_)
+        {
+            throw std::runtime_error("cannot watch " + directory_);
+        }
+    }
+#endif
+    return files;
+}
+
+void DicomSpoolWatcher::WatchLoop(std::vector<std::string> initial)
+{
+    Ingest(std::move(initial));
+#ifdef __linux__
+    alignas(inotify_event) char buffer[64 * 1024];
+#endif
+    while (!stopping_)
+    {
+        const Clock::duration untilSettled = SubmitCompleteSeries();
+        const auto wait = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::min<Clock::duration>(untilSettled, kPollInterval));
+        std::vector<std::string> arrived;
+#ifdef __linux__
+        pollfd descriptor = {inotify_, POLLIN, 0};
+        ::poll(&descriptor, 1, static_cast<int>(std::max<long long>(wait.count(), 1)));
+        for (;;)
+        {
+            const ssize_t length = ::read(inotify_, buffer, sizeof(buffer));
+            if (length <= 0)
+            {
+                break;
+            }
+            for (const char *p = buffer; p < buffer + length;)
+            {
+                const auto *event = reinterpret_cast<const inotify_event *>(p);
+                p += sizeof(inotify_event) + event->len;
+                if (event->mask & IN_Q_OVERFLOW)
+                {
+                    // Events were lost; whatever is new is found by listing
+                    const auto all = WatchTree(directory_);
+                    arrived.insert(arrived.end(), all.begin(), all.end());
+                    continue;
+                }
+                const auto watch = watches_.find(event->wd);
+                if (watch == watches_.end())
+                {
+                    continue;
+                }
+                if (event->mask & IN_IGNORED)
+                {
+                    watches_.erase(watch);
+                    continue;
+                }
+                if (event->len == 0)
+                {
+                    continue;
+                }
+                const std::string path = watch->second + "/" + event->name;
+                if (event->mask & IN_ISDIR)
+                {
+                    // New subfolders may already hold files
+                    const auto files = WatchTree(path);
+                    arrived.insert(arrived.end(), files.begin(), files.end());
+                }
+                else if (event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO))
+                {
+                    arrived.push_back(path);
+                }
+            }
+        }
+#else
+        // No change notification here; list the folder instead
+        std::this_thread::sleep_for(std::min<std::chrono::milliseconds>(
+            std::max(wait, std::chrono::milliseconds(1)), std::chrono::milliseconds(250)));
+        arrived = WatchTree(directory_);
+        std::erase_if(arrived, [this](const std::string &path) { return seen_.count(path) > 0; });
+        seen_.insert(arrived.begin(), arrived.end());
+#endif
+        if (!arrived.empty())
+        {
+            Ingest(std::move(arrived));
+        }
+    }
+}
+
+void DicomSpoolWatcher::Ingest(std::vector<std::string> paths)
+{
+    const auto arrival = Clock::now();
+    std::sort(paths.begin(), paths.end());
+    paths.erase(std::unique(paths.begin(), paths.end()), paths.end());
+#ifdef __linux__
+    std::erase_if(paths, [this](const std::string &path) { return seen_.count(path) > 0; });
+#endif
+
+    // A burst of slices is parsed like a directory scan, all at once
+    struct Parsed
+    {
+        std::optional<DicomInstance> instance;
+        DicomSeries fields;
+    };
+    std::vector<Parsed> parsed(paths.size());
+    vtkSMPTools::For(0, static_cast<vtkIdType>(paths.size()), [&](vtkIdType begin, vtkIdType end) {
+        for (vtkIdType i = begin; i < end; ++i)
+        {
+            parsed[i].instance = ParseDicomInstance(paths[i], &parsed[i].fields);
+        }
+    });
+    for (std::size_t i = 0; i < parsed.size(); ++i)
+    {
+        if (!parsed[i].instance)
+        {
+            // Possibly still being written; a later close or move retries it
+            continue;
+        }
+        seen_.insert(paths[i]);
+        const DicomSeries *series = catalog_.AddInstance(*parsed[i].instance, parsed[i].fields);
+        SeriesState &state = states_[series->uid];
+        if (state.files == 0)
+        {
+            spdlog::info("spool: series {} ({}) started", series->description, series->uid);
+        }
+        state.lastArrival = arrival;
+        state.files = series->instances.size();
+    }
+}
+
+DicomSpoolWatcher::Clock::duration DicomSpoolWatcher::SubmitCompleteSeries()
+{
+    const auto now = Clock::now();
+    Clock::duration untilSettled = Clock::duration::max();
+    for (const DicomSeries &series : catalog_.GetSeries())
+    {
+        SeriesState &state = states_[series.uid];
+        if (state.files == state.submitted)
+        {
+            continue;
+        }
+        // Counts in the headers can be missing or wrong; settling covers both
+        const std::size_t expected = std::size_t(std::max(series.imagesInAcquisition, 0)) *
+                                     std::size_t(std::max(series.temporalPositions, 1));
+        const bool full = expected > 0 && state.files >= expected;
+        const Clock::time_point settled = state.lastArrival + settle_;
+        if (!full && now < settled)
+        {
+            untilSettled = std::min(untilSettled, settled - now);
+            continue;
+        }
+
+        Job job;
+        job.uid = series.uid;
+        job.files = SplitIntoPhases(series).front();
+        job.seriesFiles = state.files;
+        job.lastArrival = state.lastArrival;
+        state.submitted = state.files;
+        spdlog::info("spool: series {} complete with {} files{}, {:.3f} s after its last file",
+                     series.description, state.files, full ? "" : " (settled)",
+                     Seconds(now - state.lastArrival));
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            jobs_.push_back(std::move(job));
+        }
+        jobAdded_.notify_one();
+    }
+    return untilSettled;
+}
+
+void DicomSpoolWatcher::WorkerLoop()
+{
+    for (;;)
+    {
+        Result result;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            jobAdded_.wait(lock, [this] { return stopping_ || !jobs_.empty(); });
+            if (stopping_)
+            {
+                return;
+            }
+            result.job = std::move(jobs_.front());
+            jobs_.pop_front();
+        }
+
+        try
+        {
+            const auto start = Clock::now();
+            vtkSmartPointer<vtkImageData> volume = ReadDicomVolume(result.job.files);
+            const auto read = Clock::now();
+            result.surface = preprocess_(volume);
+            result.volumeSeconds = Seconds(read - start);
+            result.surfaceSeconds = Seconds(Clock::now() - read);
+        }
+        catch (const std::exception &e)
+        {
+            spdlog::error("spool: series {}: {}", result.job.uid, e.what());
+            continue;
+        }
+        if (result.surface)
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            results_.push_back(std::move(result));
+        }
+    }
+}
+
+void DicomSpoolWatcher::OnTimer()
+{
+    std::deque<Result> results;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        results.swap(results_);
+    }
+    if (results.empty())
+    {
+        return;
+    }
+
+    // Only the newest surface is worth a render
+    const Result &latest = results.back();
+    for (std::size_t i = 0; i + 1 < results.size(); ++i)
+    {
+        spdlog::info("spool: series {} superseded before it was shown", results[i].job.uid);
+    }
+    mapper_->SetInputDataObject(latest.surface);
+    if (latest.job.uid != shownSeries_)
+    {
+        shownSeries_ = latest.job.uid;
+        renderer_->ResetCamera();
+    }
+    interactor_->Render();
+
+    const double latency = Seconds(Clock::now() - latest.job.lastArrival);
+    ++shown_;
+    totalLatency_ += latency;
+    maxLatency_ = std::max(maxLatency_, latency);
+    spdlog::info("spool: series {} ({} files) rendered {:.3f} s after its last file (volume "
+                 "{:.3f} s, surface {:.3f} s)",
+                 latest.job.uid, latest.job.seriesFiles, latency, latest.volumeSeconds,
+                 latest.surfaceSeconds);
+}
+
+void DicomSpoolWatcher::LogStats()
+{
+    spdlog::info("spool: {} series rendered, ingestion latency {:.3f} s mean, {:.3f} s max",
+                 shown_, shown_ > 0 ? totalLatency_ / shown_ : 0.0, maxLatency_);
+}
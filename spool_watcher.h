@@ -0,0 +1,136 @@
+#pragma once
+
+#include "dicom_catalog.h"
+
+#include <vtkActor.h>
+#include <vtkCompositePolyDataMapper.h>
+#include <vtkDataObject.h>
+#include <vtkImageData.h>
+#include <vtkSmartPointer.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+class vtkRenderer;
+class vtkRenderWindowInteractor;
+
+// Watches a spool folder that scanners push DICOM files into and shows each
+// series as soon as it is complete.
+//
+// A watcher thread waits for files to be closed after writing or moved in
+// (inotify on Linux; elsewhere the folder is rescanned every quarter second),
+// parses the headers of each burst of new files in parallel and adds them to
+// a catalog, so series are assembled slice by slice. A series is complete
+// once it has ImagesInAcquisition x NumberOfTemporalPositions files, or when
+// no file has joined it for the settle time. A worker thread then reads the
+// first phase and runs the preprocessing step on it, and an interactor timer
+// swaps the result in and renders it. Slices arriving after that make the
+// series complete again later, and it is processed again.
+//
+// Ingestion latency is measured from the last file of a series arriving to
+// the render of its surface having finished.
+class DicomSpoolWatcher
+{
+public:
+    using Preprocessor = std::function<vtkSmartPointer<vtkDataObject>(vtkImageData *)>;
+
+    // Files already in directory are cataloged as if they had just arrived.
+    // Throws std::runtime_error if directory cannot be watched.
+    DicomSpoolWatcher(const std::string &directory, Preprocessor preprocess,
+                      double settleSeconds = 2.0);
+    ~DicomSpoolWatcher();
+
+    DicomSpoolWatcher(const DicomSpoolWatcher &) = delete;
+    DicomSpoolWatcher &operator=(const DicomSpoolWatcher &) = delete;
+
+    // Adds the surface actor to renderer and starts showing completed series.
+    // The interactor must be initialized so that it can create a timer, and
+    // outlive the watcher, which removes its timer when destroyed.
+    void Attach(vtkRenderer *renderer, vtkRenderWindowInteractor *interactor);
+
+    // Logs series shown and their ingestion latency
+    void LogStats();
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    // Ingestion state of one series of the catalog
+    struct SeriesState
+    {
+        Clock::time_point lastArrival;
+        std::size_t files = 0;     // files at the last arrival
+        std::size_t submitted = 0; // files when last handed to the worker
+    };
+
+    struct Job
+    {
+        std::string uid;
+        std::vector<std::string> files; // the first phase
+        std::size_t seriesFiles = 0;
+        Clock::time_point lastArrival;
+    };
+
+    struct Result
+    {
+        Job job;
+        vtkSmartPointer<vtkDataObject> surface;
+        double volumeSeconds = 0.0;
+        double surfaceSeconds = 0.0;
+    };
+
+    void WatchLoop(std::vector<std::string> initial);
+    void WorkerLoop();
+    void OnTimer();
+
+    // Watches root and the directories under it (on Linux) and returns the
+    // files already in them
+    std::vector<std::string> WatchTree(const std::string &root);
+    // Parses new files and adds them to the catalog
+    void Ingest(std::vector<std::string> paths);
+    // Hands every complete series with new files to the worker; returns the
+    // time until the next one settles
+    Clock::duration SubmitCompleteSeries();
+
+    std::string directory_;
+    Preprocessor preprocess_;
+    Clock::duration settle_;
+
+    // Catalog and ingestion state, watcher thread only
+    DicomCatalog catalog_;
+    std::unordered_map<std::string, SeriesState> states_;
+    std::unordered_set<std::string> seen_; // files cataloged or rejected for good
+    int inotify_ = -1;
+    std::map<int, std::string> watches_; // watch descriptor to directory
+
+    std::mutex mutex_;
+    std::condition_variable jobAdded_;
+    std::deque<Job> jobs_;
+    std::deque<Result> results_;
+    std::atomic<bool> stopping_{false};
+    std::thread watcher_;
+    std::thread worker_;
+
+    vtkSmartPointer<vtkCompositePolyDataMapper> mapper_;
+    vtkSmartPointer<vtkActor> actor_;
+    vtkRenderer *renderer_ = nullptr;
+    vtkRenderWindowInteractor *interactor_ = nullptr;
+    unsigned long timerObserver_ = 0;
+    int timerId_ = -1;
+
+    // Latency statistics, timer thread only
+    std::string shownSeries_;
+    std::uint64_t shown_ = 0;
+    double totalLatency_ = 0.0;
+    double maxLatency_ = 0.0;
+};
@@ -0,0 +1,150 @@
+#include "startup.h"
+
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#ifdef __linux__
+#include <time.h>
+#include <unistd.h>
+#endif
+
+#ifdef SIMPLE_VTK_LEAN_STARTUP
+// Factory registration of each module, which VTK_MODULE_INIT calls from a
+// static initializer
+void vtkInteractionStyle_AutoInit_Construct();
+void vtkRenderingOpenGL2_AutoInit_Construct();
+#ifdef SIMPLE_VTK_HAVE_RENDERING_UI
+void vtkRenderingUI_AutoInit_Construct();
+#endif
+#endif
+
+namespace
+{
+
+using Clock = std::chrono::steady_clock;
+
+// Runs before the other static initializers of the executable; those of the
+// shared libraries have run by then
+#ifdef __GNUC__
+__attribute__((init_priority(101)))
+#endif
+const Clock::time_point kStaticInitStart = Clock::now();
+
+struct StartupPhases
+{
+    std::mutex mutex;
+    std::vector<std::pair<const char *, Clock::time_point>> marks;
+};
+
+StartupPhases &Phases()
+{
+    static StartupPhases phases;
+    return phases;
+}
+
+double Seconds(Clock::duration duration)
+{
+    return std::chrono::duration<double>(duration).count();
+}
+
+// Seconds since the process was created, or a negative number if unknown
+double SecondsSinceProcessStart()
+{
+#ifdef __linux__
+    // The 22nd field of /proc/self/stat is the start time in clock ticks
+    // after boot; the command name in the 2nd may contain spaces
+    std::FILE *stat = std::fopen("/proc/self/stat", "r");
+    if (!stat)
+    {
+        return -1.0;
+    }
+    char buffer[1024];
+    const std::size_t length = std::fread(buffer, 1, sizeof(buffer) - 1, stat);
+    std::fclose(stat);
+    buffer[length] = '\0';
+    const char *fields = nullptr;
+    for (std::size_t i = length; i > 0; --i)
+    {
+        if (buffer[i - 1] == ')')
+        {
+            fields = buffer + i;
+            break;
+        }
+    }
+    unsigned long long startTicks = 0;
+    if (!fields || std::sscanf(fields,
+                               " %*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %*u %*u %*d %*d "
+                               "%*d %*d %*d %*d %llu",
+                               &startTicks) != 1)
+    {
+        return -1.0;
+    }
+    timespec now;
+    clock_gettime(CLOCK_BOOTTIME, &now);
+    return double(now.tv_sec) + now.tv_nsec * 1e-9 - double(startTicks) / sysconf(_SC_CLK_TCK);
+#else
+    return -1.0;
+#endif
+}
+
+} // namespace
+
+void MarkStartupPhase(const char *phase)
+{
+    StartupPhases &phases = Phases();
+    std::lock_guard<std::mutex> lock(phases.mutex);
+    phases.marks.emplace_back(phase, Clock::now());
+}
+
+double SecondsSinceStartup()
+{
+    return Seconds(Clock::now() - kStaticInitStart);
+}
+
+void LogStartupProfile()
+{
+    const Clock::time_point now = Clock::now();
+    const double sinceProcessStart = SecondsSinceProcessStart();
+#ifdef SIMPLE_VTK_LEAN_STARTUP
+    spdlog::info("Startup profile (lean: factories registered on demand):");
+#else
+    spdlog::info("Startup profile (factories of all linked modules registered statically):");
+#endif
+    if (sinceProcessStart >= 0.0)
+    {
+        // Clock ticks are coarse, so this is only good to about 10 ms
+        spdlog::info("  {:32} {:8.1f} ms", "loading shared libraries",
+                     std::max(0.0, sinceProcessStart - Seconds(now - kStaticInitStart)) * 1e3);
+    }
+    StartupPhases &phases = Phases();
+    std::lock_guard<std::mutex> lock(phases.mutex);
+    Clock::time_point previous = kStaticInitStart;
+    for (const auto &[phase, time] : phases.marks)
+    {
+        spdlog::info("  {:32} {:8.1f} ms", phase, Seconds(time - previous) * 1e3);
+        previous = time;
+    }
+    spdlog::info("  {:32} {:8.1f} ms", "total since static initialization",
+                 Seconds(previous - kStaticInitStart) * 1e3);
+}
+
+void InitializeRenderingModules()
+{
+#ifdef SIMPLE_VTK_LEAN_STARTUP
+    static std::once_flag once;
+    std::call_once(once, [] {
+        vtkInteractionStyle_AutoInit_Construct();
+        vtkRenderingOpenGL2_AutoInit_Construct();
+#ifdef SIMPLE_VTK_HAVE_RENDERING_UI
+        vtkRenderingUI_AutoInit_Construct();
+#endif
+        MarkStartupPhase("rendering factories");
+    });
+#endif
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+// Startup of the process: where its time goes, and the VTK object factories
+// it needs.
+//
+// Milestones are recorded from the start of the executable's static
+// initialization, before any other initializer of the executable runs. With
+// the default build, vtk_module_autoinit registers the factory overrides of
+// every linked VTK module during that static initialization. Built with
+// SIMPLE_VTK_LEAN_STARTUP (the SIMPLE_VTK_LEAN_STARTUP CMake option), nothing
+// is registered then, and InitializeRenderingModules registers the modules
+// that rendering needs, only in runs that render.
+
+// Records that the named phase of startup has just ended. The name must
+// outlive the process, such as a string literal.
+void MarkStartupPhase(const char *phase);
+
+// Seconds from the start of static initialization to now
+double SecondsSinceStartup();
+
+// Logs the time from process creation to static initialization (loading and
+// initializing the shared libraries, where the system tells), then the
+// duration of every phase marked since.
+void LogStartupProfile();
+
+// Registers the object factories of the rendering modules (OpenGL, the
+// interactor and its styles) once. Does nothing unless built with
+// SIMPLE_VTK_LEAN_STARTUP, since they were registered at startup.
+void InitializeRenderingModules();
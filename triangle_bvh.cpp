@@ -0,0 +1,620 @@
+#include "triangle_bvh.h"
+
+#include "array_dispatch.h"
+
+#include <vtkCellArray.h>
+#include <vtkPoints.h>
+#include <vtkSMPTools.h>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <stdexcept>
+#include <utility>
+
+namespace
+{
+
+void Subtract(const double *a, const double *b, double *out)
+{
+    out[0] = a[0] - b[0];
+    out[1] = a[1] - b[1];
+    out[2] = a[2] - b[2];
+}
+
+double Dot(const double *a, const double *b)
+{
+    return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+}
+
+void Cross(const double *a, const double *b, double *out)
+{
+    out[0] = a[1] * b[2] - a[2] * b[1];
+    out[1] = a[2] * b[0] - a[0] * b[2];
+    out[2] = a[0] * b[1] - a[1] * b[0];
+}
+
+void Normalize(double *v)
+{
+    const double length = std::sqrt(Dot(v, v));
+    if (length > 0.0)
+    {
+        v[0] /= length;
+        v[1] /= length;
+        v[2] /= length;
+    }
+}
+
+// Angle at a between the edges to b and c
+double Angle(const double *a, const double *b, const double *c)
+{
+    double u[3], v[3], w[3];
+    Subtract(b, a, u);
+    Subtract(c, a, v);
+    Cross(u, v, w);
+    return std::atan2(std::sqrt(Dot(w, w)), Dot(u, v));
+}
+
+double BoxDistance2(const double *min, const double *max, const double *p)
+{
+    double distance2 = 0.0;
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        const double d = std::max({min[axis] - p[axis], 0.0, p[axis] - max[axis]});
+        distance2 += d * d;
+    }
+    return distance2;
+}
+
+// Distance along a ray at which it enters a box, clipped to [near, far], or
+// infinity if it misses the box there; inverse holds 1 / direction
+double RayBoxEntry(const double *min, const double *max, const double *origin,
+                   const double *inverse, double near, double far)
+{
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        double t0 = (min[axis] - origin[axis]) * inverse[axis];
+        double t1 = (max[axis] - origin[axis]) * inverse[axis];
+        if (t0 > t1)
+        {
+            std::swap(t0, t1);
+        }
+        near = std::max(near, t0);
+        far = std::min(far, t1);
+        if (near > far)
+        {
+            return std::numeric_limits<double>::infinity();
+        }
+    }
+    return near;
+}
+
+} // namespace
+
+TriangleBVH::TriangleBVH(vtkPolyData *mesh, int leafSize)
+{
+    Weld(mesh);
+    const std::int32_t count = static_cast<std::int32_t>(triangles_.size() / 3);
+    if (count == 0)
+    {
+        throw std::invalid_argument("TriangleBVH: mesh has no polygons");
+    }
+
+    std::vector<double> centroids(3 * std::size_t(count));
+    vtkSMPTools::For(0, count, [&](vtkIdType begin, vtkIdType end) {
+        for (vtkIdType t = begin; t < end; ++t)
+        {
+            for (int axis = 0; axis < 3; ++axis)
+            {
+                double sum = 0.0;
+                for (int corner = 0; corner < 3; ++corner)
+                {
+                    sum += points_[3 * std::size_t(triangles_[3 * t + corner]) + axis];
+                }
+                centroids[3 * t + axis] = sum / 3.0;
+            }
+        }
+    });
+
+    std::vector<std::int32_t> order(count);
+    std::iota(order.begin(), order.end(), 0);
+    nodes_.reserve(2 * std::size_t(count) / std::max(leafSize, 1) + 1);
+    Build(0, count, order, centroids, std::max(leafSize, 1));
+
+    // Store the triangles in leaf order so leaves address contiguous ranges
+    std::vector<std::int32_t> triangles(triangles_.size());
+    std::vector<vtkIdType> sourceTriangles(count);
+    for (std::int32_t i = 0; i < count; ++i)
+    {
+        std::copy_n(&triangles_[3 * std::size_t(order[i])], 3, &triangles[3 * std::size_t(i)]);
+        sourceTriangles[i] = sourceTriangles_[order[i]];
+    }
+    triangles_.swap(triangles);
+    sourceTriangles_.swap(sourceTriangles);
+
+    ComputePseudonormals();
+}
+
+void TriangleBVH::Weld(vtkPolyData *mesh)
+{
+    vtkPoints *points = mesh->GetPoints();
+    vtkCellArray *polys = mesh->GetPolys();
+    if (!points || !polys)
+    {
+        return;
+    }
+
+    // Sort the points by coordinates; equal runs become one point
+    const vtkIdType pointCount = points->GetNumberOfPoints();
+    std::vector<double> coordinates(3 * std::size_t(pointCount));
+    array_dispatch::DispatchReal(points->GetData(), [&](auto xyz) {
+        vtkSMPTools::For(0, pointCount, [&](vtkIdType begin, vtkIdType end) {
+            for (vtkIdType id = begin; id < end; ++id)
+            {
+                xyz.GetTuple(id, &coordinates[3 * id]);
+            }
+        });
+    });
+    std::vector<vtkIdType> sorted(pointCount);
+    std::iota(sorted.begin(), sorted.end(), vtkIdType(0));
+    vtkSMPTools::Sort(sorted.begin(), sorted.end(), [&](vtkIdType a, vtkIdType b) {
+        return std::lexicographical_compare(&coordinates[3 * a], &coordinates[3 * a + 3],
+                                            &coordinates[3 * b], &coordinates[3 * b + 3]);
+    });
+    std::vector<std::int32_t> welded(pointCount);
+    for (vtkIdType i = 0; i < pointCount; ++i)
+    {
+        const double *p = &coordinates[3 * sorted[i]];
+        if (i == 0 || !std::equal(p, p + 3, &coordinates[3 * sorted[i - 1]]))
+        {
+            points_.insert(points_.end(), p, p + 3);
+        }
+        welded[sorted[i]] = static_cast<std::int32_t>(points_.size() / 3 - 1);
+    }
+
+    // Polygons become triangle fans; triangles that welding collapsed are dropped
+    vtkIdType source = 0;
+    for (vtkIdType cell = 0; cell < polys->GetNumberOfCells(); ++cell)
+    {
+        vtkIdType npts = 0;
+        const vtkIdType *pts = nullptr;
+        polys->GetCellAtId(cell, npts, pts);
+        for (vtkIdType i = 1; i + 1 < npts; ++i, ++source)
+        {
+            const std::int32_t a = welded[pts[0]];
+            const std::int32_t b = welded[pts[i]];
+            const std::int32_t c = welded[pts[i + 1]];
+            if (a != b && b != c && c != a)
+            {
+                triangles_.insert(triangles_.end(), {a, b, c});
+                sourceTriangles_.push_back(source);
+            }
+        }
+    }
+}
+
+void TriangleBVH::ComputePseudonormals()
+{
+    const std::size_t count = triangles_.size() / 3;
+    faceNormals_.assign(3 * count, 0.0);
+    edgeNormals_.assign(9 * count, 0.0);
+    vertexNormals_.assign(points_.size(), 0.0);
+
+    vtkSMPTools::For(0, static_cast<vtkIdType>(count), [&](vtkIdType begin, vtkIdType end) {
+        for (vtkIdType t = begin; t < end; ++t)
+        {
+            const double *a = &points_[3 * std::size_t(triangles_[3 * t])];
+            const double *b = &points_[3 * std::size_t(triangles_[3 * t + 1])];
+            const double *c = &points_[3 * std::size_t(triangles_[3 * t + 2])];
+            double u[3], v[3];
+            Subtract(b, a, u);
+            Subtract(c, a, v);
+            Cross(u, v, &faceNormals_[3 * t]);
+            Normalize(&faceNormals_[3 * t]);
+        }
+    });
+
+    // Vertex normals weight the faces by their angle at the vertex
+    for (std::size_t t = 0; t < count; ++t)
+    {
+        for (int corner = 0; corner < 3; ++corner)
+        {
+            const std::int32_t id = triangles_[3 * t + corner];
+            const double angle =
+                Angle(&points_[3 * std::size_t(id)],
+                      &points_[3 * std::size_t(triangles_[3 * t + (corner + 1) % 3])],
+                      &points_[3 * std::size_t(triangles_[3 * t + (corner + 2) % 3])]);
+            for (int axis = 0; axis < 3; ++axis)
+            {
+                vertexNormals_[3 * std::size_t(id) + axis] += angle * faceNormals_[3 * t + axis];
+            }
+        }
+    }
+
+    // Edge normals sum the faces that share the edge; sorting brings them together
+    struct EdgeRecord
+    {
+        std::int32_t low;
+        std::int32_t high;
+        std::size_t slot; // 3 * triangle + edge
+    };
+    std::vector<EdgeRecord> edges(3 * count);
+    for (std::size_t t = 0; t < count; ++t)
+    {
+        for (int edge = 0; edge < 3; ++edge)
+        {
+            const std::int32_t a = triangles_[3 * t + edge];
+            const std::int32_t b = triangles_[3 * t + (edge + 1) % 3];
+            edges[3 * t + edge] = {std::min(a, b), std::max(a, b), 3 * t + edge};
+        }
+    }
+    vtkSMPTools::Sort(edges.begin(), edges.end(), [](const EdgeRecord &l, const EdgeRecord &r) {
+        return l.low != r.low ? l.low < r.low : l.high < r.high;
+    });
+    for (std::size_t first = 0; first < edges.size();)
+    {
+        std::size_t last = first;
+        double normal[3] = {0.0, 0.0, 0.0};
+        for (; last < edges.size() && edges[last].low == edges[first].low &&
+               edges[last].high == edges[first].high;
+             ++last)
+        {
+            const double *face = &faceNormals_[3 * (edges[last].slot / 3)];
+            normal[0] += face[0];
+            normal[1] += face[1];
+            normal[2] += face[2];
+        }
+        for (std::size_t e = first; e < last; ++e)
+        {
+            std::copy_n(normal, 3, &edgeNormals_[3 * edges[e].slot]);
+        }
+        first = last;
+    }
+}
+
+std::int32_t TriangleBVH::Build(std::int32_t first, std::int32_t count,
+                                std::vector<std::int32_t> &order,
+                                const std::vector<double> &centroids, int leafSize)
+{
+    const std::int32_t index = static_cast<std::int32_t>(nodes_.size());
+    nodes_.emplace_back();
+    Node node;
+    double centroidMin[3], centroidMax[3];
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        node.min[axis] = centroidMin[axis] = std::numeric_limits<double>::max();
+        node.max[axis] = centroidMax[axis] = std::numeric_limits<double>::lowest();
+    }
+    for (std::int32_t i = first; i < first + count; ++i)
+    {
+        const std::int32_t t = order[i];
+        for (int corner = 0; corner < 3; ++corner)
+        {
+            const double *p = &points_[3 * std::size_t(triangles_[3 * std::size_t(t) + corner])];
+            for (int axis = 0; axis < 3; ++axis)
+            {
+                node.min[axis] = std::min(node.min[axis], p[axis]);
+                node.max[axis] = std::max(node.max[axis], p[axis]);
+            }
+        }
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            centroidMin[axis] = std::min(centroidMin[axis], centroids[3 * std::size_t(t) + axis]);
+            centroidMax[axis] = std::max(centroidMax[axis], centroids[3 * std::size_t(t) + axis]);
+        }
+    }
+
+    if (count <= leafSize)
+    {
+        node.first = first;
+        node.count = count;
+        nodes_[index] = node;
+        return index;
+    }
+
+    // Median split along the longest axis of the centroids
+    int axis = 0;
+    for (int a = 1; a < 3; ++a)
+    {
+        if (centroidMax[a] - centroidMin[a] > centroidMax[axis] - centroidMin[axis])
+        {
+            axis = a;
+        }
+    }
+    const std::int32_t half = count / 2;
+    std::nth_element(order.begin() + first, order.begin() + first + half,
+                     order.begin() + first + count, [&](std::int32_t l, std::int32_t r) {
+                         return centroids[3 * std::size_t(l) + axis] <
+                                centroids[3 * std::size_t(r) + axis];
+                     });
+    Build(first, half, order, centroids, leafSize);
+    node.first = Build(first + half, count - half, order, centroids, leafSize);
+    node.count = 0;
+    nodes_[index] = node;
+    return index;
+}
+
+TriangleBVH::Feature TriangleBVH::ClosestPointOnTriangle(std::int32_t triangle, const double p[3],
+                                                         double point[3]) const
+{
+    // Voronoi regions of the triangle (Ericson, Real-Time Collision Detection, 5.1.5)
+    const double *a = &points_[3 * std::size_t(triangles_[3 * std::size_t(triangle)])];
+    const double *b = &points_[3 * std::size_t(triangles_[3 * std::size_t(triangle) + 1])];
+    const double *c = &points_[3 * std::size_t(triangles_[3 * std::size_t(triangle) + 2])];
+    double ab[3], ac[3], ap[3];
+    Subtract(b, a, ab);
+    Subtract(c, a, ac);
+    Subtract(p, a, ap);
+    auto set = [&](const double *q) { std::copy_n(q, 3, point); };
+    auto along = [&](const double *from, const double *edge, double t) {
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            point[axis] = from[axis] + t * edge[axis];
+        }
+    };
+
+    const double d1 = Dot(ab, ap);
+    const double d2 = Dot(ac, ap);
+    if (d1 <= 0.0 && d2 <= 0.0)
+    {
+        set(a);
+        return Vertex0;
+    }
+    double bp[3];
+    Subtract(p, b, bp);
+    const double d3 = Dot(ab, bp);
+    const double d4 = Dot(ac, bp);
+    if (d3 >= 0.0 && d4 <= d3)
+    {
+        set(b);
+        return Vertex1;
+    }
+    const double vc = d1 * d4 - d3 * d2;
+    if (vc <= 0.0 && d1 >= 0.0 && d3 <= 0.0)
+    {
+        along(a, ab, d1 / (d1 - d3));
+        return Edge01;
+    }
+    double cp[3];
+    Subtract(p, c, cp);
+    const double d5 = Dot(ab, cp);
+    const double d6 = Dot(ac, cp);
+    if (d6 >= 0.0 && d5 <= d6)
+    {
+        set(c);
+        return Vertex2;
+    }
+    const double vb = d5 * d2 - d1 * d6;
+    if (vb <= 0.0 && d2 >= 0.0 && d6 <= 0.0)
+    {
+        along(a, ac, d2 / (d2 - d6));
+        return Edge20;
+    }
+    const double va = d3 * d6 - d5 * d4;
+    if (va <= 0.0 && (d4 - d3) >= 0.0 && (d5 - d6) >= 0.0)
+    {
+        double bc[3];
+        Subtract(c, b, bc);
+        along(b, bc, (d4 - d3) / ((d4 - d3) + (d5 - d6)));
+        return Edge12;
+    }
+    const double denominator = 1.0 / (va + vb + vc);
+    const double v = vb * denominator;
+    const double w = vc * denominator;
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        point[axis] = a[axis] + ab[axis] * v + ac[axis] * w;
+    }
+    return Face;
+}
+
+bool TriangleBVH::FindClosest(const double p[3], double maxDistance, Hit &hit,
+                              Feature &feature) const
+{
+    double best2 = maxDistance * maxDistance;
+    bool found = false;
+    std::array<std::int32_t, 64> stack;
+    int top = 0;
+    stack[top++] = 0;
+    while (top > 0)
+    {
+        const Node &node = nodes_[stack[--top]];
+        if (BoxDistance2(node.min, node.max, p) > best2)
+        {
+            continue;
+        }
+        if (node.count > 0)
+        {
+            for (std::int32_t t = node.first; t < node.first + node.count; ++t)
+            {
+                double point[3], d[3];
+                const Feature f = ClosestPointOnTriangle(t, p, point);
+                Subtract(p, point, d);
+                const double distance2 = Dot(d, d);
+                if (distance2 <= best2)
+                {
+                    best2 = distance2;
+                    found = true;
+                    feature = f;
+                    hit.distance2 = distance2;
+                    std::copy_n(point, 3, hit.point);
+                    hit.triangle = t;
+                }
+            }
+            continue;
+        }
+
+        // Visit the nearer child first
+        const std::int32_t left = static_cast<std::int32_t>(&node - nodes_.data()) + 1;
+        const std::int32_t right = node.first;
+        const double leftDistance2 = BoxDistance2(nodes_[left].min, nodes_[left].max, p);
+        const double rightDistance2 = BoxDistance2(nodes_[right].min, nodes_[right].max, p);
+        if (leftDistance2 < rightDistance2)
+        {
+            stack[top++] = right;
+            stack[top++] = left;
+        }
+        else
+        {
+            stack[top++] = left;
+            stack[top++] = right;
+        }
+    }
+    return found;
+}
+
+bool TriangleBVH::FindClosestPoint(const double p[3], double maxDistance, Hit &hit) const
+{
+    Feature feature;
+    if (!FindClosest(p, maxDistance, hit, feature))
+    {
+        return false;
+    }
+    hit.triangle = sourceTriangles_[hit.triangle];
+    return true;
+}
+
+double TriangleBVH::SignedDistance(const double p[3], double maxDistance) const
+{
+    Hit hit;
+    Feature feature = Face;
+    if (!FindClosest(p, maxDistance, hit, feature))
+    {
+        return maxDistance;
+    }
+    const std::size_t t = static_cast<std::size_t>(hit.triangle);
+    const double *normal = nullptr;
+    switch (feature)
+    {
+    case Vertex0:
+    case Vertex1:
+    case Vertex2:
+        normal = &vertexNormals_[3 * std::size_t(triangles_[3 * t + (feature - Vertex0)])];
+        break;
+    case Edge01:
+    case Edge12:
+    case Edge20:
+        normal = &edgeNormals_[9 * t + 3 * (feature - Edge01)];
+        break;
+    case Face:
+        normal = &faceNormals_[3 * t];
+        break;
+    }
+    double d[3];
+    Subtract(p, hit.point, d);
+    const double distance = std::sqrt(hit.distance2);
+    return Dot(d, normal) < 0.0 ? -distance : distance;
+}
+
+bool TriangleBVH::IntersectRay(const double origin[3], const double direction[3],
+                               double minDistance, double maxDistance, Hit &hit) const
+{
+    const double inverse[3] = {1.0 / direction[0], 1.0 / direction[1], 1.0 / direction[2]};
+    double best = maxDistance;
+    bool found = false;
+    std::array<std::int32_t, 64> stack;
+    int top = 0;
+    stack[top++] = 0;
+    while (top > 0)
+    {
+        const Node &node = nodes_[stack[--top]];
+        if (RayBoxEntry(node.min, node.max, origin, inverse, minDistance, best) > best)
+        {
+            continue;
+        }
+        if (node.count > 0)
+        {
+            // Moeller-Trumbore
+            for (std::int32_t t = node.first; t < node.first + node.count; ++t)
+            {
+                const double *a = &points_[3 * std::size_t(triangles_[3 * std::size_t(t)])];
+                const double *b = &points_[3 * std::size_t(triangles_[3 * std::size_t(t) + 1])];
+                const double *c = &points_[3 * std::size_t(triangles_[3 * std::size_t(t) + 2])];
+                double ab[3], ac[3], q[3], s[3], r[3];
+                Subtract(b, a, ab);
+                Subtract(c, a, ac);
+                Cross(direction, ac, q);
+                const double determinant = Dot(ab, q);
+                if (determinant == 0.0)
+                {
+                    continue;
+                }
+                Subtract(origin, a, s);
+                const double u = Dot(s, q) / determinant;
+                Cross(s, ab, r);
+                const double v = Dot(direction, r) / determinant;
+                const double distance = Dot(ac, r) / determinant;
+                if (u < 0.0 || v < 0.0 || u + v > 1.0 || distance < minDistance ||
+                    distance > best)
+                {
+                    continue;
+                }
+                best = distance;
+                found = true;
+                hit.distance2 = distance * distance;
+                for (int axis = 0; axis < 3; ++axis)
+                {
+                    hit.point[axis] = origin[axis] + distance * direction[axis];
+                }
+                hit.triangle = sourceTriangles_[t];
+            }
+            continue;
+        }
+
+        // Visit first the child the ray enters first
+        const std::int32_t left = static_cast<std::int32_t>(&node - nodes_.data()) + 1;
+        const std::int32_t right = node.first;
+        const double leftEntry =
+            RayBoxEntry(nodes_[left].min, nodes_[left].max, origin, inverse, minDistance, best);
+        const double rightEntry =
+            RayBoxEntry(nodes_[right].min, nodes_[right].max, origin, inverse, minDistance, best);
+        if (leftEntry < rightEntry)
+        {
+            stack[top++] = right;
+            stack[top++] = left;
+        }
+        else
+        {
+            stack[top++] = left;
+            stack[top++] = right;
+        }
+    }
+    return found;
+}
+
+void TriangleBVH::GetTriangleBounds(vtkIdType triangle, double bounds[6]) const
+{
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        bounds[2 * axis] = std::numeric_limits<double>::max();
+        bounds[2 * axis + 1] = std::numeric_limits<double>::lowest();
+    }
+    for (int corner = 0; corner < 3; ++corner)
+    {
+        const double *p = &points_[3 * std::size_t(triangles_[3 * std::size_t(triangle) + corner])];
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            bounds[2 * axis] = std::min(bounds[2 * axis], p[axis]);
+            bounds[2 * axis + 1] = std::max(bounds[2 * axis + 1], p[axis]);
+        }
+    }
+}
+
+void TriangleBVH::GetBounds(double bounds[6]) const
+{
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        bounds[2 * axis] = nodes_[0].min[axis];
+        bounds[2 * axis + 1] = nodes_[0].max[axis];
+    }
+}
+
+std::size_t TriangleBVH::GetMemorySize() const
+{
+    return points_.capacity() * sizeof(double) + triangles_.capacity() * sizeof(std::int32_t) +
+           sourceTriangles_.capacity() * sizeof(vtkIdType) + nodes_.capacity() * sizeof(Node) +
+           (faceNormals_.capacity() + edgeNormals_.capacity() + vertexNormals_.capacity()) *
+               sizeof(double);
+}
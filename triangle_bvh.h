@@ -0,0 +1,89 @@
+#pragma once
+
+#include <vtkPolyData.h>
+#include <vtkType.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Bounding volume hierarchy over the triangles of a mesh (polygons become
+// triangle fans) for closest-point, signed-distance and ray queries.
+//
+// Points with identical coordinates are welded, so triangle soups such as STL
+// files get the same topology as indexed meshes. The sign of a distance comes
+// from angle-weighted pseudonormals (Baerentzen and Aanaes), which is exact
+// for closed, consistently oriented meshes.
+class TriangleBVH
+{
+public:
+    explicit TriangleBVH(vtkPolyData *mesh, int leafSize = 4);
+
+    struct Hit
+    {
+        double distance2 = 0.0;
+        double point[3] = {0.0, 0.0, 0.0};
+        vtkIdType triangle = -1;
+    };
+
+    // Closest point on the mesh no farther than maxDistance from p. Returns
+    // false if there is none.
+    bool FindClosestPoint(const double p[3], double maxDistance, Hit &hit) const;
+
+    // Distance to the mesh, negative inside. Returns maxDistance if the mesh
+    // is farther than that.
+    double SignedDistance(const double p[3], double maxDistance) const;
+
+    // Nearest crossing of the ray from origin along the unit direction at a
+    // distance in [minDistance, maxDistance], with hit.distance2 its squared
+    // distance. Returns false if there is none.
+    bool IntersectRay(const double origin[3], const double direction[3], double minDistance,
+                      double maxDistance, Hit &hit) const;
+
+    vtkIdType GetNumberOfTriangles() const { return static_cast<vtkIdType>(triangles_.size() / 3); }
+    void GetTriangleBounds(vtkIdType triangle, double bounds[6]) const;
+    void GetBounds(double bounds[6]) const;
+    std::size_t GetMemorySize() const;
+
+    // Welded points (xyz) and triangles (three point ids each, in BVH order)
+    const std::vector<double> &GetPoints() const { return points_; }
+    const std::vector<std::int32_t> &GetTriangles() const { return triangles_; }
+
+private:
+    // Internal nodes have count 0; their left child follows them and the
+    // right child is at index first. Leaves hold count triangles from first.
+    struct Node
+    {
+        double min[3];
+        double max[3];
+        std::int32_t first;
+        std::int32_t count;
+    };
+
+    // Feature of a triangle that holds the closest point
+    enum Feature
+    {
+        Vertex0,
+        Vertex1,
+        Vertex2,
+        Edge01,
+        Edge12,
+        Edge20,
+        Face,
+    };
+
+    void Weld(vtkPolyData *mesh);
+    void ComputePseudonormals();
+    std::int32_t Build(std::int32_t first, std::int32_t count, std::vector<std::int32_t> &order,
+                       const std::vector<double> &centroids, int leafSize);
+    Feature ClosestPointOnTriangle(std::int32_t triangle, const double p[3], double point[3]) const;
+    bool FindClosest(const double p[3], double maxDistance, Hit &hit, Feature &feature) const;
+
+    std::vector<double> points_;             // welded xyz
+    std::vector<std::int32_t> triangles_;    // three point ids each, in BVH order
+    std::vector<vtkIdType> sourceTriangles_; // triangle index before reordering
+    std::vector<Node> nodes_;
+    std::vector<double> faceNormals_;   // 3 per triangle
+    std::vector<double> edgeNormals_;   // 9 per triangle: edges 01, 12, 20
+    std::vector<double> vertexNormals_; // 3 per point
+};
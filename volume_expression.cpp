@@ -0,0 +1,536 @@
+#include "volume_expression.h"
+
+#include <vtkDataArray.h>
+#include <vtkPointData.h>
+#include <vtkSMPTools.h>
+
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+namespace
+{
+
+// Rounded and clamped to the range of T for integers, NaN becoming 0
+template <typename T>
+void WriteValues(const float *in, void *values, vtkIdType begin, int count)
+{
+    T *out = static_cast<T *>(values) + begin;
+    if constexpr (std::is_floating_point_v<T>)
+    {
+        for (int i = 0; i < count; ++i)
+        {
+            out[i] = static_cast<T>(in[i]);
+        }
+    }
+    else
+    {
+        constexpr T lowest = std::numeric_limits<T>::lowest();
+        constexpr T highest = std::numeric_limits<T>::max();
+        for (int i = 0; i < count; ++i)
+        {
+            const double value = std::nearbyint(double(in[i]));
+            out[i] = value <= double(lowest)    ? lowest
+                     : value >= double(highest) ? highest
+                     : value == value           ? static_cast<T>(value)
+                                                : T(0);
+        }
+    }
+}
+
+using Writer = void (*)(const float *in, void *values, vtkIdType begin, int count);
+
+template <typename Op>
+void RunUnary(const float *a, float *out, int count)
+{
+    for (int i = 0; i < count; ++i)
+    {
+        out[i] = Op::Apply(a[i]);
+    }
+}
+
+template <typename Op>
+void RunBinary(const float *a, const float *b, float *out, int count)
+{
+    for (int i = 0; i < count; ++i)
+    {
+        out[i] = Op::Apply(a[i], b[i]);
+    }
+}
+
+} // namespace
+
+VolumeOperand::VolumeOperand(vtkImageData *volume)
+    : volume_(volume)
+{
+    vtkDataArray *scalars = volume ? volume->GetPointData()->GetScalars() : nullptr;
+    if (!scalars)
+    {
+        throw std::invalid_argument("volume operand without scalars");
+    }
+    numValues_ = scalars->GetNumberOfValues();
+    read_ = array_dispatch::MakeFloatReader(scalars);
+}
+
+void VolumeOperand::Read(vtkIdType begin, int count, float *out) const
+{
+    read_(begin, count, out);
+}
+
+const float *VolumeBlocks::Add(const VolumeOperand &operand)
+{
+    operands_.push_back(&operand);
+    blocks_.push_back(std::make_unique<float[]>(kSize));
+    return blocks_.back().get();
+}
+
+void VolumeBlocks::Load(vtkIdType begin, int count)
+{
+    for (std::size_t i = 0; i < operands_.size(); ++i)
+    {
+        operands_[i]->Read(begin, count, blocks_[i].get());
+    }
+}
+
+vtkSmartPointer<vtkImageData> volume_expression::EvaluateBlocks(
+    const std::vector<const VolumeOperand *> &operands, int outputType,
+    const std::function<BlockFunction()> &makeBlockFunction)
+{
+    if (operands.empty())
+    {
+        throw std::invalid_argument("volume expression without a volume");
+    }
+    vtkImageData *first = operands[0]->GetVolume();
+    int extent[6];
+    first->GetExtent(extent);
+    const int components = first->GetNumberOfScalarComponents();
+    for (const VolumeOperand *operand : operands)
+    {
+        int other[6];
+        operand->GetVolume()->GetExtent(other);
+        if (!std::equal(extent, extent + 6, other) ||
+            operand->GetVolume()->GetNumberOfScalarComponents() != components ||
+            operand->GetNumberOfValues() != operands[0]->GetNumberOfValues())
+        {
+            throw std::invalid_argument("volume expression over volumes of different extents "
+                                        "or numbers of components");
+        }
+    }
+    Writer write = nullptr;
+    switch (outputType)
+    {
+        vtkTemplateMacro(write = &WriteValues<VTK_TT>);
+        default:
+            throw std::invalid_argument("volume expression of unsupported output type");
+    }
+
+    auto output = vtkSmartPointer<vtkImageData>::New();
+    output->CopyStructure(first);
+    output->AllocateScalars(outputType, components);
+    void *values = output->GetScalarPointer();
+    const vtkIdType numValues = operands[0]->GetNumberOfValues();
+    const vtkIdType numBlocks = (numValues + VolumeBlocks::kSize - 1) / VolumeBlocks::kSize;
+    vtkSMPTools::For(0, numBlocks, [&](vtkIdType blockBegin, vtkIdType blockEnd) {
+        const BlockFunction compute = makeBlockFunction();
+        float block[VolumeBlocks::kSize];
+        for (vtkIdType b = blockBegin; b < blockEnd; ++b)
+        {
+            const vtkIdType begin = b * VolumeBlocks::kSize;
+            const int count = static_cast<int>(std::min<vtkIdType>(VolumeBlocks::kSize,
+                                                                   numValues - begin));
+            if (outputType == VTK_FLOAT)
+            {
+                // Straight into the output
+                compute(begin, count, static_cast<float *>(values) + begin);
+                continue;
+            }
+            compute(begin, count, block);
+            write(block, values, begin, count);
+        }
+    });
+    return output;
+}
+
+class VolumeFormula::Parser
+{
+public:
+    explicit Parser(VolumeFormula &formula)
+        : formula_(formula), text_(formula.text_)
+    {
+    }
+
+    void Parse()
+    {
+        ParseComparison();
+        if (Peek() != '\0')
+        {
+            Fail("unexpected '" + std::string(1, Peek()) + "'");
+        }
+    }
+
+private:
+    // Next character after blanks, '\0' at the end
+    char Peek()
+    {
+        while (position_ < text_.size() &&
+               std::isspace(static_cast<unsigned char>(text_[position_])))
+        {
+            ++position_;
+        }
+        return position_ < text_.size() ? text_[position_] : '\0';
+    }
+
+    void Expect(char c)
+    {
+        if (Peek() != c)
+        {
+            Fail(std::string("expected '") + c + "'");
+        }
+        ++position_;
+    }
+
+    [[noreturn]] void Fail(const std::string &message) const
+    {
+        throw std::invalid_argument("formula: " + message + " at position " +
+                                    std::to_string(position_ + 1) + " of \"" + text_ + "\"");
+    }
+
+    void ParseComparison()
+    {
+        ParseSum();
+        const char c = Peek();
+        if (c == '<' || c == '>')
+        {
+            ++position_;
+            ParseSum();
+            formula_.Emit(c == '<' ? Code::Less : Code::Greater);
+        }
+    }
+
+    void ParseSum()
+    {
+        ParseProduct();
+        for (char c = Peek(); c == '+' || c == '-'; c = Peek())
+        {
+            ++position_;
+            ParseProduct();
+            formula_.Emit(c == '+' ? Code::Add : Code::Subtract);
+        }
+    }
+
+    void ParseProduct()
+    {
+        ParseUnary();
+        for (char c = Peek(); c == '*' || c == '/'; c = Peek())
+        {
+            ++position_;
+            ParseUnary();
+            formula_.Emit(c == '*' ? Code::Multiply : Code::Divide);
+        }
+    }
+
+    void ParseUnary()
+    {
+        const char c = Peek();
+        if (c == '-' || c == '+')
+        {
+            ++position_;
+            ParseUnary();
+            if (c == '-')
+            {
+                formula_.Emit(Code::Negate);
+            }
+            return;
+        }
+        ParsePrimary();
+    }
+
+    void ParsePrimary()
+    {
+        const char c = Peek();
+        if (c == '(')
+        {
+            ++position_;
+            ParseComparison();
+            Expect(')');
+            return;
+        }
+        if (std::isdigit(static_cast<unsigned char>(c)) || c == '.')
+        {
+            const char *start = text_.c_str() + position_;
+            char *end = nullptr;
+            const double value = std::strtod(start, &end);
+            if (end == start)
+            {
+                Fail("malformed number");
+            }
+            position_ += static_cast<std::size_t>(end - start);
+            formula_.program_.push_back({Code::Constant, 0, static_cast<float>(value)});
+            formula_.Push();
+            return;
+        }
+        if (!std::isalpha(static_cast<unsigned char>(c)) && c != '_')
+        {
+            Fail(c == '\0' ? "unexpected end" : "unexpected '" + std::string(1, c) + "'");
+        }
+        const std::size_t start = position_;
+        while (position_ < text_.size() &&
+               (std::isalnum(static_cast<unsigned char>(text_[position_])) ||
+                text_[position_] == '_'))
+        {
+            ++position_;
+        }
+        const std::string name = text_.substr(start, position_ - start);
+        if (Peek() == '(')
+        {
+            ParseCall(name, start);
+            return;
+        }
+        const auto &variables = formula_.variables_;
+        const auto it = std::find(variables.begin(), variables.end(), name);
+        if (it == variables.end())
+        {
+            position_ = start;
+            Fail("unknown variable " + name);
+        }
+        formula_.program_.push_back({Code::Variable, static_cast<int>(it - variables.begin())});
+        formula_.Push();
+    }
+
+    void ParseCall(const std::string &name, std::size_t start)
+    {
+        struct Function
+        {
+            const char *name;
+            int arguments;
+            Code code;
+        };
+        static const Function kFunctions[] = {
+            {"abs", 1, Code::Abs},   {"sqrt", 1, Code::Sqrt}, {"exp", 1, Code::Exp},
+            {"log", 1, Code::Log},   {"min", 2, Code::Min},   {"max", 2, Code::Max},
+            {"clamp", 3, Code::Min},
+        };
+        const Function *function = nullptr;
+        for (const Function &candidate : kFunctions)
+        {
+            if (name == candidate.name)
+            {
+                function = &candidate;
+            }
+        }
+        if (!function)
+        {
+            position_ = start;
+            Fail("unknown function " + name);
+        }
+        Expect('(');
+        for (int argument = 0; argument < function->arguments; ++argument)
+        {
+            if (argument > 0)
+            {
+                Expect(',');
+            }
+            ParseComparison();
+            // clamp(x, lower, upper) is min(max(x, lower), upper)
+            if (function->arguments == 3 && argument == 1)
+            {
+                formula_.Emit(Code::Max);
+            }
+        }
+        Expect(')');
+        formula_.Emit(function->code);
+    }
+
+    VolumeFormula &formula_;
+    const std::string &text_;
+    std::size_t position_ = 0;
+};
+
+template <typename Fn>
+void VolumeFormula::Dispatch(Code code, Fn &&fn)
+{
+    switch (code)
+    {
+    case Code::Negate:
+        fn(volume_ops::Negate{});
+        break;
+    case Code::Abs:
+        fn(volume_ops::Abs{});
+        break;
+    case Code::Sqrt:
+        fn(volume_ops::Sqrt{});
+        break;
+    case Code::Exp:
+        fn(volume_ops::Exp{});
+        break;
+    case Code::Log:
+        fn(volume_ops::Log{});
+        break;
+    case Code::Add:
+        fn(volume_ops::Add{});
+        break;
+    case Code::Subtract:
+        fn(volume_ops::Subtract{});
+        break;
+    case Code::Multiply:
+        fn(volume_ops::Multiply{});
+        break;
+    case Code::Divide:
+        fn(volume_ops::Divide{});
+        break;
+    case Code::Min:
+        fn(volume_ops::Min{});
+        break;
+    case Code::Max:
+        fn(volume_ops::Max{});
+        break;
+    case Code::Less:
+        fn(volume_ops::Less{});
+        break;
+    case Code::Greater:
+        fn(volume_ops::Greater{});
+        break;
+    default:
+        break;
+    }
+}
+
+VolumeFormula::VolumeFormula(const std::string &text, const std::vector<std::string> &variables)
+    : text_(text), variables_(variables)
+{
+    Parser(*this).Parse();
+}
+
+void VolumeFormula::Push()
+{
+    stackDepth_ = std::max(stackDepth_, ++depth_);
+}
+
+void VolumeFormula::Emit(Code code)
+{
+    const bool unary = code >= Code::Negate && code <= Code::Log;
+    const std::size_t arguments = unary ? 1 : 2;
+    const bool constant =
+        program_.size() >= arguments &&
+        std::all_of(program_.end() - arguments, program_.end(), [](const Instruction &instruction) {
+            return instruction.code == Code::Constant;
+        });
+    if (!unary)
+    {
+        --depth_;
+    }
+    if (!constant)
+    {
+        program_.push_back({code});
+        return;
+    }
+    const float a = program_[program_.size() - arguments].value;
+    const float b = program_.back().value;
+    float value = 0.0f;
+    Dispatch(code, [&](auto operation) {
+        using Op = decltype(operation);
+        if constexpr (requires { Op::Apply(a); })
+        {
+            value = Op::Apply(a);
+        }
+        else
+        {
+            value = Op::Apply(a, b);
+        }
+    });
+    program_.resize(program_.size() - arguments);
+    program_.push_back({Code::Constant, 0, value});
+}
+
+vtkSmartPointer<vtkImageData> VolumeFormula::Evaluate(const std::vector<vtkImageData *> &volumes,
+                                                      int outputType) const
+{
+    if (volumes.size() != variables_.size())
+    {
+        throw std::invalid_argument("formula: expected " + std::to_string(variables_.size()) +
+                                    " volumes, got " + std::to_string(volumes.size()));
+    }
+    std::vector<VolumeOperand> operands;
+    operands.reserve(volumes.size());
+    std::vector<const VolumeOperand *> layout;
+    for (vtkImageData *volume : volumes)
+    {
+        operands.emplace_back(volume);
+        layout.push_back(&operands.back());
+    }
+
+    // One stack of blocks per thread; variables are read in place
+    struct State
+    {
+        VolumeBlocks blocks;
+        std::vector<const float *> variables;
+        std::vector<float> storage;
+        std::vector<const float *> stack;
+    };
+    return volume_expression::EvaluateBlocks(
+        layout, outputType, [&]() -> volume_expression::BlockFunction {
+            auto state = std::make_shared<State>();
+            state->variables.resize(operands.size(), nullptr);
+            for (const Instruction &instruction : program_)
+            {
+                if (instruction.code == Code::Variable && !state->variables[instruction.variable])
+                {
+                    state->variables[instruction.variable] =
+                        state->blocks.Add(operands[instruction.variable]);
+                }
+            }
+            state->storage.resize(std::size_t(stackDepth_) * VolumeBlocks::kSize);
+            state->stack.resize(stackDepth_);
+            return [this, state](vtkIdType begin, int count, float *out) {
+                state->blocks.Load(begin, count);
+                const float **stack = state->stack.data();
+                int top = -1;
+                for (const Instruction &instruction : program_)
+                {
+                    float *slot = nullptr;
+                    switch (instruction.code)
+                    {
+                    case Code::Variable:
+                        stack[++top] = state->variables[instruction.variable];
+                        continue;
+                    case Code::Constant:
+                        slot = state->storage.data() + std::size_t(++top) * VolumeBlocks::kSize;
+                        std::fill_n(slot, count, instruction.value);
+                        stack[top] = slot;
+                        continue;
+                    default:
+                        break;
+                    }
+                    const bool unary = instruction.code <= Code::Log;
+                    if (!unary)
+                    {
+                        --top;
+                    }
+                    slot = state->storage.data() + std::size_t(top) * VolumeBlocks::kSize;
+                    const float *a = stack[top];
+                    const float *b = unary ? nullptr : stack[top + 1];
+                    switch (instruction.code)
+                    {
+                    case Code::Negate: RunUnary<volume_ops::Negate>(a, slot, count); break;
+                    case Code::Abs: RunUnary<volume_ops::Abs>(a, slot, count); break;
+                    case Code::Sqrt: RunUnary<volume_ops::Sqrt>(a, slot, count); break;
+                    case Code::Exp: RunUnary<volume_ops::Exp>(a, slot, count); break;
+                    case Code::Log: RunUnary<volume_ops::Log>(a, slot, count); break;
+                    case Code::Add: RunBinary<volume_ops::Add>(a, b, slot, count); break;
+                    case Code::Subtract: RunBinary<volume_ops::Subtract>(a, b, slot, count); break;
+                    case Code::Multiply: RunBinary<volume_ops::Multiply>(a, b, slot, count); break;
+                    case Code::Divide: RunBinary<volume_ops::Divide>(a, b, slot, count); break;
+                    case Code::Min: RunBinary<volume_ops::Min>(a, b, slot, count); break;
+                    case Code::Max: RunBinary<volume_ops::Max>(a, b, slot, count); break;
+                    case Code::Less: RunBinary<volume_ops::Less>(a, b, slot, count); break;
+                    case Code::Greater: RunBinary<volume_ops::Greater>(a, b, slot, count); break;
+                    default: break;
+                    }
+                    stack[top] = slot;
+                }
+                std::memcpy(out, stack[0], sizeof(float) * std::size_t(count));
+            };
+        });
+}
@@ -0,0 +1,433 @@
+#pragma once
+
+#include "array_dispatch.h"
+
+#include <vtkImageData.h>
+#include <vtkSmartPointer.h>
+#include <vtkType.h>
+
+#include <algorithm>
+#include <cmath>
+#include <concepts>
+#include <functional>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+// Lazy arithmetic on volumes.
+//
+// Arithmetic on VolumeOperand handles, such as (a - b) * mask + 100, builds an
+// expression whose type is the tree of operations; nothing is computed until
+// Evaluate, which runs the whole tree in one multithreaded pass over blocks
+// of a thousand values. Each operand converts its block to float with a loop
+// compiled for its scalar type and layout (see array_dispatch.h), the tree
+// runs as one loop the compiler can vectorize, and the result is converted to
+// the output type the same way. The only volume allocated is the result.
+//
+// VolumeFormula compiles the same operations from text at run time into a
+// short program, run block by block with the same kernels.
+//
+// Values are computed in float. Integer outputs are rounded and clamped to
+// the range of their type.
+
+class VolumeBlocks;
+
+// A volume in an expression. Operands of one expression must have the same
+// extent and number of components.
+class VolumeOperand
+{
+public:
+    // Throws std::invalid_argument if volume has no scalars
+    explicit VolumeOperand(vtkImageData *volume);
+
+    vtkImageData *GetVolume() const { return volume_; }
+    vtkIdType GetNumberOfValues() const { return numValues_; }
+
+    // Values begin to begin + count as float
+    void Read(vtkIdType begin, int count, float *out) const;
+
+    // Used by the expressions
+    void CollectOperands(std::vector<const VolumeOperand *> &operands) const
+    {
+        operands.push_back(this);
+    }
+    auto Bind(VolumeBlocks &blocks) const;
+
+private:
+    vtkSmartPointer<vtkImageData> volume_;
+    array_dispatch::FloatReader read_; // compiled for the scalar type and layout
+    vtkIdType numValues_ = 0;
+};
+
+// The elementwise operations, shared by expressions and formulas
+namespace volume_ops
+{
+struct Negate
+{
+    static float Apply(float a) { return -a; }
+};
+struct Abs
+{
+    static float Apply(float a) { return std::abs(a); }
+};
+struct Sqrt
+{
+    static float Apply(float a) { return std::sqrt(a); }
+};
+struct Exp
+{
+    static float Apply(float a) { return std::exp(a); }
+};
+struct Log
+{
+    static float Apply(float a) { return std::log(a); }
+};
+struct Add
+{
+    static float Apply(float a, float b) { return a + b; }
+};
+struct Subtract
+{
+    static float Apply(float a, float b) { return a - b; }
+};
+struct Multiply
+{
+    static float Apply(float a, float b) { return a * b; }
+};
+struct Divide
+{
+    static float Apply(float a, float b) { return a / b; }
+};
+struct Min
+{
+    static float Apply(float a, float b) { return std::min(a, b); }
+};
+struct Max
+{
+    static float Apply(float a, float b) { return std::max(a, b); }
+};
+struct Less
+{
+    static float Apply(float a, float b) { return a < b ? 1.0f : 0.0f; }
+};
+struct Greater
+{
+    static float Apply(float a, float b) { return a > b ? 1.0f : 0.0f; }
+};
+} // namespace volume_ops
+
+// The operand blocks of one thread: every operand's values in the block
+// being computed
+class VolumeBlocks
+{
+public:
+    static constexpr int kSize = 1024;
+
+    // Block of operand, filled by Load
+    const float *Add(const VolumeOperand &operand);
+
+    void Load(vtkIdType begin, int count);
+
+private:
+    std::vector<const VolumeOperand *> operands_;
+    std::vector<std::unique_ptr<float[]>> blocks_;
+};
+
+namespace volume_expression
+{
+
+// Block of values of an operand
+struct Block
+{
+    const float *values;
+
+    float operator[](int i) const { return values[i]; }
+};
+
+struct Constant
+{
+    float value;
+
+    float operator[](int) const { return value; }
+    void CollectOperands(std::vector<const VolumeOperand *> &) const {}
+    Constant Bind(VolumeBlocks &) const { return *this; }
+};
+
+template <typename Op, typename A>
+struct Unary
+{
+    A a;
+
+    float operator[](int i) const { return Op::Apply(a[i]); }
+    void CollectOperands(std::vector<const VolumeOperand *> &operands) const
+    {
+        a.CollectOperands(operands);
+    }
+    auto Bind(VolumeBlocks &blocks) const
+    {
+        using BoundA = decltype(a.Bind(blocks));
+        return Unary<Op, BoundA>{a.Bind(blocks)};
+    }
+};
+
+template <typename Op, typename A, typename B>
+struct Binary
+{
+    A a;
+    B b;
+
+    float operator[](int i) const { return Op::Apply(a[i], b[i]); }
+    void CollectOperands(std::vector<const VolumeOperand *> &operands) const
+    {
+        a.CollectOperands(operands);
+        b.CollectOperands(operands);
+    }
+    auto Bind(VolumeBlocks &blocks) const
+    {
+        using BoundA = decltype(a.Bind(blocks));
+        using BoundB = decltype(b.Bind(blocks));
+        return Binary<Op, BoundA, BoundB>{a.Bind(blocks), b.Bind(blocks)};
+    }
+};
+
+template <typename T>
+concept Expression = requires(const T &t, std::vector<const VolumeOperand *> &operands) {
+    t.CollectOperands(operands);
+};
+
+template <typename T>
+concept Argument = Expression<T> || std::is_arithmetic_v<T>;
+
+template <Argument T>
+auto AsExpression(const T &value)
+{
+    if constexpr (Expression<T>)
+    {
+        return value;
+    }
+    else
+    {
+        return Constant{static_cast<float>(value)};
+    }
+}
+
+template <typename Op, Argument A>
+auto MakeUnary(const A &a)
+{
+    using E = decltype(AsExpression(a));
+    return Unary<Op, E>{AsExpression(a)};
+}
+
+template <typename Op, Argument A, Argument B>
+auto MakeBinary(const A &a, const B &b)
+{
+    using EA = decltype(AsExpression(a));
+    using EB = decltype(AsExpression(b));
+    return Binary<Op, EA, EB>{AsExpression(a), AsExpression(b)};
+}
+
+template <typename A, typename B>
+concept Operands = Argument<A> && Argument<B> && (Expression<A> || Expression<B>);
+
+using BlockFunction = std::function<void(vtkIdType begin, int count, float *out)>;
+
+// Output with the structure of the first operand, filled in parallel by the
+// block functions makeFunction returns, one per thread and range. Throws
+// std::invalid_argument if there are no operands or their layouts differ.
+vtkSmartPointer<vtkImageData> EvaluateBlocks(const std::vector<const VolumeOperand *> &operands,
+                                             int outputType,
+                                             const std::function<BlockFunction()> &makeFunction);
+
+} // namespace volume_expression
+
+inline auto VolumeOperand::Bind(VolumeBlocks &blocks) const
+{
+    return volume_expression::Block{blocks.Add(*this)};
+}
+
+template <volume_expression::Argument A, volume_expression::Argument B>
+    requires volume_expression::Operands<A, B>
+auto operator+(const A &a, const B &b)
+{
+    return volume_expression::MakeBinary<volume_ops::Add>(a, b);
+}
+
+template <volume_expression::Argument A, volume_expression::Argument B>
+    requires volume_expression::Operands<A, B>
+auto operator-(const A &a, const B &b)
+{
+    return volume_expression::MakeBinary<volume_ops::Subtract>(a, b);
+}
+
+template <volume_expression::Argument A, volume_expression::Argument B>
+    requires volume_expression::Operands<A, B>
+auto operator*(const A &a, const B &b)
+{
+    return volume_expression::MakeBinary<volume_ops::Multiply>(a, b);
+}
+
+template <volume_expression::Argument A, volume_expression::Argument B>
+    requires volume_expression::Operands<A, B>
+auto operator/(const A &a, const B &b)
+{
+    return volume_expression::MakeBinary<volume_ops::Divide>(a, b);
+}
+
+template <volume_expression::Expression A>
+auto operator-(const A &a)
+{
+    return volume_expression::MakeUnary<volume_ops::Negate>(a);
+}
+
+template <volume_expression::Expression A>
+auto Abs(const A &a)
+{
+    return volume_expression::MakeUnary<volume_ops::Abs>(a);
+}
+
+template <volume_expression::Expression A>
+auto Sqrt(const A &a)
+{
+    return volume_expression::MakeUnary<volume_ops::Sqrt>(a);
+}
+
+template <volume_expression::Expression A>
+auto Exp(const A &a)
+{
+    return volume_expression::MakeUnary<volume_ops::Exp>(a);
+}
+
+template <volume_expression::Expression A>
+auto Log(const A &a)
+{
+    return volume_expression::MakeUnary<volume_ops::Log>(a);
+}
+
+template <volume_expression::Argument A, volume_expression::Argument B>
+    requires volume_expression::Operands<A, B>
+auto Min(const A &a, const B &b)
+{
+    return volume_expression::MakeBinary<volume_ops::Min>(a, b);
+}
+
+template <volume_expression::Argument A, volume_expression::Argument B>
+    requires volume_expression::Operands<A, B>
+auto Max(const A &a, const B &b)
+{
+    return volume_expression::MakeBinary<volume_ops::Max>(a, b);
+}
+
+// 1 where a < b, 0 elsewhere
+template <volume_expression::Argument A, volume_expression::Argument B>
+    requires volume_expression::Operands<A, B>
+auto Less(const A &a, const B &b)
+{
+    return volume_expression::MakeBinary<volume_ops::Less>(a, b);
+}
+
+// 1 where a > b, 0 elsewhere
+template <volume_expression::Argument A, volume_expression::Argument B>
+    requires volume_expression::Operands<A, B>
+auto Greater(const A &a, const B &b)
+{
+    return volume_expression::MakeBinary<volume_ops::Greater>(a, b);
+}
+
+template <volume_expression::Expression A, volume_expression::Argument L,
+          volume_expression::Argument H>
+auto Clamp(const A &a, const L &lower, const H &upper)
+{
+    return Min(Max(a, lower), upper);
+}
+
+// Computes expression into a new volume of outputType with the structure of
+// its first operand. Throws std::invalid_argument if the expression has no
+// operand or the layouts of its operands differ.
+template <volume_expression::Expression E>
+vtkSmartPointer<vtkImageData> Evaluate(const E &expression, int outputType = VTK_FLOAT)
+{
+    std::vector<const VolumeOperand *> operands;
+    expression.CollectOperands(operands);
+    return volume_expression::EvaluateBlocks(
+        operands, outputType, [&expression]() -> volume_expression::BlockFunction {
+            auto blocks = std::make_shared<VolumeBlocks>();
+            auto bound = expression.Bind(*blocks);
+            return [blocks, bound](vtkIdType begin, int count, float *out) {
+                blocks->Load(begin, count);
+                for (int i = 0; i < count; ++i)
+                {
+                    out[i] = bound[i];
+                }
+            };
+        });
+}
+
+// A formula over named volumes, such as "clamp(abs(a - b) * mask + 100, 0,
+// 4095)", compiled at run time.
+//
+// Formulas have + - * / with the usual precedence, unary minus, < and >
+// (1 where true, 0 elsewhere, below + and -), parentheses, numbers and the
+// functions abs, sqrt, exp, log, min, max and clamp. Constant subexpressions
+// are folded; the rest runs on a stack of blocks, one kernel per operation.
+class VolumeFormula
+{
+public:
+    // Throws std::invalid_argument, with the offending position, for syntax
+    // errors and names that are neither variables nor functions
+    VolumeFormula(const std::string &text, const std::vector<std::string> &variables);
+
+    const std::string &GetText() const { return text_; }
+
+    // Number of operations after folding, for logs
+    int GetNumberOfInstructions() const { return static_cast<int>(program_.size()); }
+
+    // Computes the formula with volumes[i] for variables[i] into a new volume
+    // of outputType. Throws std::invalid_argument for a wrong number of
+    // volumes, layouts that differ and formulas without variables.
+    vtkSmartPointer<vtkImageData> Evaluate(const std::vector<vtkImageData *> &volumes,
+                                           int outputType = VTK_FLOAT) const;
+
+private:
+    enum class Code
+    {
+        Variable,
+        Constant,
+        Negate,
+        Abs,
+        Sqrt,
+        Exp,
+        Log,
+        Add,
+        Subtract,
+        Multiply,
+        Divide,
+        Min,
+        Max,
+        Less,
+        Greater,
+    };
+    struct Instruction
+    {
+        Code code;
+        int variable = 0;
+        float value = 0.0f;
+    };
+    class Parser;
+
+    // Calls fn with the volume_ops type of an operation
+    template <typename Fn>
+    static void Dispatch(Code code, Fn &&fn);
+
+    // Counts a value pushed by a variable or constant
+    void Push();
+
+    // Appends an operation, folding it into a constant if its arguments are
+    void Emit(Code code);
+
+    std::string text_;
+    std::vector<std::string> variables_;
+    std::vector<Instruction> program_;
+    int depth_ = 0;      // values on the stack after the program so far
+    int stackDepth_ = 0; // most values on the stack at once
+};
@@ -0,0 +1,902 @@
+#include "volume_readers.h"
+#include "array_dispatch.h"
+#include "mapped_array.h"
+#include "mapped_file.h"
+#include "vtkhdf_io.h"
+
+#include <vtkDataArray.h>
+#include <vtkPointData.h>
+#include <vtkSMPTools.h>
+
+#include <zlib.h>
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cctype>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string_view>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+namespace
+{
+
+// zlib counts bytes in 32-bit integers
+constexpr std::size_t kMaxInflateStep = std::size_t(1) << 30;
+
+// Bytes per task when copying or byte-swapping payloads
+constexpr vtkIdType kCopyBlock = vtkIdType(1) << 24;
+
+std::string Lowercase(std::string text)
+{
+    std::transform(text.begin(), text.end(), text.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    return text;
+}
+
+std::string Trim(std::string_view text)
+{
+    const auto blank = [](char c) { return std::isspace(static_cast<unsigned char>(c)) != 0; };
+    while (!text.empty() && blank(text.front()))
+    {
+        text.remove_prefix(1);
+    }
+    while (!text.empty() && blank(text.back()))
+    {
+        text.remove_suffix(1);
+    }
+    return std::string(text);
+}
+
+int ElementSize(int vtkType)
+{
+    switch (vtkType)
+    {
+    case VTK_SIGNED_CHAR:
+    case VTK_UNSIGNED_CHAR:
+        return 1;
+    case VTK_SHORT:
+    case VTK_UNSIGNED_SHORT:
+        return 2;
+    case VTK_INT:
+    case VTK_UNSIGNED_INT:
+    case VTK_FLOAT:
+        return 4;
+    default:
+        return 8;
+    }
+}
+
+vtkSmartPointer<vtkDataArray> NewArray(int vtkType, int components, vtkIdType tuples)
+{
+    auto array = vtkSmartPointer<vtkDataArray>::Take(vtkDataArray::CreateDataArray(vtkType));
+    array->SetNumberOfComponents(components);
+    array->SetNumberOfTuples(tuples);
+    return array;
+}
+
+void ParallelCopy(char *out, const char *in, std::size_t bytes)
+{
+    const vtkIdType blocks = static_cast<vtkIdType>((bytes + kCopyBlock - 1) / kCopyBlock);
+    vtkSMPTools::For(0, blocks, [&](vtkIdType begin, vtkIdType end) {
+        const std::size_t first = std::size_t(begin) * kCopyBlock;
+        const std::size_t last = std::min(bytes, std::size_t(end * kCopyBlock));
+        std::memcpy(out + first, in + first, last - first);
+    });
+}
+
+void SwapBytes(char *data, std::size_t count, int elementSize)
+{
+    if (elementSize == 1)
+    {
+        return;
+    }
+    const vtkIdType perBlock = kCopyBlock / elementSize;
+    const vtkIdType blocks = static_cast<vtkIdType>((count + perBlock - 1) / perBlock);
+    vtkSMPTools::For(0, blocks, [&](vtkIdType begin, vtkIdType end) {
+        const std::size_t last = std::min(count, std::size_t(end * perBlock));
+        for (std::size_t i = std::size_t(begin * perBlock); i < last; ++i)
+        {
+            std::reverse(data + i * elementSize, data + (i + 1) * elementSize);
+        }
+    });
+}
+
+//------------------------------------------------------------------------------
+// Gzip
+
+// One gzip member of a BGZF stream and the bytes it decodes to
+struct GzipMember
+{
+    std::size_t offset;
+    std::size_t size;
+    std::size_t decodedOffset;
+    std::size_t decodedSize;
+};
+
+std::uint32_t LittleEndian32(const unsigned char *p)
+{
+    return std::uint32_t(p[0]) | std::uint32_t(p[1]) << 8 | std::uint32_t(p[2]) << 16 |
+           std::uint32_t(p[3]) << 24;
+}
+
+// The members of data if it is a BGZF stream, whose members record their
+// compressed size in a "BC" extra field, or nothing if it is not
+std::vector<GzipMember> BGZFMembers(const unsigned char *data, std::size_t size)
+{
+    constexpr std::size_t kMinMember = 18 + 8; // header with BC field + trailer
+    std::vector<GzipMember> members;
+    std::size_t offset = 0, decoded = 0;
+    while (offset < size)
+    {
+        const unsigned char *member = data + offset;
+        if (size - offset < kMinMember || member[0] != 0x1f || member[1] != 0x8b ||
+            member[2] != 8 || !(member[3] & 4))
+        {
+            return {};
+        }
+        const std::size_t extraEnd = 12 + (member[10] | member[11] << 8);
+        std::size_t memberSize = 0;
+        for (std::size_t x = 12; x + 4 <= extraEnd && offset + x + 4 <= size;)
+        {
+            const std::size_t fieldSize = member[x + 2] | member[x + 3] << 8;
+            if (member[x] == 'B' && member[x + 1] == 'C' && fieldSize == 2 &&
+                offset + x + 6 <= size)
+            {
+                memberSize = std::size_t(member[x + 4] | member[x + 5] << 8) + 1;
+            }
+            x += 4 + fieldSize;
+        }
+        if (memberSize < kMinMember || memberSize > size - offset)
+        {
+            return {};
+        }
+        const std::size_t decodedSize = LittleEndian32(member + memberSize - 4);
+        members.push_back({offset, memberSize, decoded, decodedSize});
+        offset += memberSize;
+        decoded += decodedSize;
+    }
+    return members;
+}
+
+// Inflates one gzip member of known decoded size into out; false if it is corrupt
+bool InflateMember(const unsigned char *data, std::size_t size, char *out, std::size_t outSize)
+{
+    z_stream stream = {};
+    if (inflateInit2(&stream, 16 + MAX_WBITS) != Z_OK)
+    {
+        return false;
+    }
+    stream.next_in = const_cast<Bytef *>(data);
+    stream.avail_in = static_cast<uInt>(size);
+    stream.next_out = reinterpret_cast<Bytef *>(out);
+    stream.avail_out = static_cast<uInt>(outSize);
+    const int status = inflate(&stream, Z_FINISH);
+    inflateEnd(&stream);
+    return status == Z_STREAM_END && stream.avail_out == 0;
+}
+
+// Decodes a gzip stream of one or more members on the calling thread,
+// dropping the first skip bytes and stopping once out is full
+void InflateSerial(const unsigned char *data, std::size_t size, std::size_t skip, char *out,
+                   std::size_t outSize, const std::string &name)
+{
+    z_stream stream = {};
+    if (inflateInit2(&stream, 16 + MAX_WBITS) != Z_OK)
+    {
+        throw std::runtime_error("cannot inflate " + name);
+    }
+    std::vector<char> scratch(std::min<std::size_t>(skip, std::size_t(1) << 20));
+    std::size_t consumed = 0, produced = 0;
+    const std::size_t wanted = skip + outSize;
+    int status = Z_OK;
+    while (produced < wanted)
+    {
+        if (stream.avail_in == 0)
+        {
+            const std::size_t step = std::min(size - consumed, kMaxInflateStep);
+            stream.next_in = const_cast<Bytef *>(data + consumed);
+            stream.avail_in = static_cast<uInt>(step);
+            consumed += step;
+        }
+        char *target = produced < skip ? scratch.data() : out + (produced - skip);
+        const std::size_t room =
+            std::min(produced < skip ? std::min(scratch.size(), skip - produced)
+                                     : wanted - produced,
+                     kMaxInflateStep);
+        stream.next_out = reinterpret_cast<Bytef *>(target);
+        stream.avail_out = static_cast<uInt>(room);
+        status = inflate(&stream, Z_NO_FLUSH);
+        produced += room - stream.avail_out;
+        const bool inputLeft = stream.avail_in > 0 || consumed < size;
+        if (status == Z_STREAM_END && inputLeft)
+        {
+            // Concatenated members decode as one stream
+            status = inflateReset(&stream);
+        }
+        else if (status == Z_STREAM_END || (status == Z_BUF_ERROR && !inputLeft) ||
+                 (status != Z_OK && status != Z_BUF_ERROR))
+        {
+            break;
+        }
+    }
+    inflateEnd(&stream);
+    if (produced < wanted)
+    {
+        throw std::runtime_error(status == Z_OK || status == Z_STREAM_END || status == Z_BUF_ERROR
+                                     ? name + ": truncated gzip payload"
+                                     : name + ": corrupt gzip payload");
+    }
+}
+
+// Decodes the bytes [skip, skip + outSize) of a gzip stream into out; the
+// members of BGZF streams are inflated in parallel
+void InflateGzip(const char *data, std::size_t size, std::size_t skip, char *out,
+                 std::size_t outSize, const std::string &name)
+{
+    const auto *bytes = reinterpret_cast<const unsigned char *>(data);
+    const std::vector<GzipMember> members = BGZFMembers(bytes, size);
+    if (members.size() < 2)
+    {
+        InflateSerial(bytes, size, skip, out, outSize, name);
+        return;
+    }
+    if (members.back().decodedOffset + members.back().decodedSize < skip + outSize)
+    {
+        throw std::runtime_error(name + ": truncated gzip payload");
+    }
+
+    std::atomic<bool> failed(false);
+    vtkSMPTools::For(0, static_cast<vtkIdType>(members.size()), [&](vtkIdType begin,
+                                                                     vtkIdType end) {
+        std::vector<char> decoded;
+        for (vtkIdType m = begin; m < end; ++m)
+        {
+            const GzipMember &member = members[m];
+            const std::size_t first = std::max(member.decodedOffset, skip);
+            const std::size_t last =
+                std::min(member.decodedOffset + member.decodedSize, skip + outSize);
+            if (first >= last)
+            {
+                continue;
+            }
+            // Members inside the range go straight to out
+            const bool whole = first == member.decodedOffset &&
+                               last == member.decodedOffset + member.decodedSize;
+            if (!whole)
+            {
+                decoded.resize(member.decodedSize);
+            }
+            char *target = whole ? out + (first - skip) : decoded.data();
+            if (!InflateMember(bytes + member.offset, member.size, target, member.decodedSize))
+            {
+                failed = true;
+                continue;
+            }
+            if (!whole)
+            {
+                std::memcpy(out + (first - skip), decoded.data() + (first - member.decodedOffset),
+                            last - first);
+            }
+        }
+    });
+    if (failed)
+    {
+        throw std::runtime_error(name + ": corrupt gzip payload");
+    }
+}
+
+//------------------------------------------------------------------------------
+// Common payload handling
+
+// Where and how the voxels of a volume are stored
+struct Payload
+{
+    std::shared_ptr<const MappedFile> file;
+    std::size_t offset = 0; // of the voxels, or of the gzip stream
+    bool gzip = false;
+    std::size_t skip = 0;   // decoded bytes before the voxels of a gzip stream
+    bool swap = false;      // stored in the other byte order
+    int vtkType = VTK_UNSIGNED_CHAR;
+    int components = 1;
+    vtkIdType tuples = 0;
+};
+
+// Scalars of a volume, mapped when the payload allows it
+vtkSmartPointer<vtkDataArray> LoadScalars(const Payload &payload)
+{
+    const int elementSize = ElementSize(payload.vtkType);
+    const std::size_t count = std::size_t(payload.tuples) * payload.components;
+    const std::size_t bytes = count * elementSize;
+    const std::string &name = payload.file->path();
+    if (payload.offset > payload.file->size() ||
+        (!payload.gzip && bytes > payload.file->size() - payload.offset))
+    {
+        throw std::runtime_error(name + ": file is shorter than its volume");
+    }
+
+    if (!payload.gzip && !payload.swap && payload.offset % elementSize == 0)
+    {
+        return MapArray(payload.file, payload.offset, payload.vtkType, payload.components,
+                        payload.tuples);
+    }
+    auto scalars = NewArray(payload.vtkType, payload.components, payload.tuples);
+    char *out = static_cast<char *>(scalars->GetVoidPointer(0));
+    const char *in = payload.file->data() + payload.offset;
+    if (payload.gzip)
+    {
+        InflateGzip(in, payload.file->size() - payload.offset, payload.skip, out, bytes, name);
+    }
+    else
+    {
+        ParallelCopy(out, in, bytes);
+    }
+    if (payload.swap)
+    {
+        SwapBytes(out, count, elementSize);
+    }
+    return scalars;
+}
+
+// Image with the given geometry, origin and axes in LPS
+vtkSmartPointer<vtkImageData> NewImage(const int dims[3], const double origin[3],
+                                       const double spacing[3], const double direction[9],
+                                       vtkDataArray *scalars)
+{
+    auto image = vtkSmartPointer<vtkImageData>::New();
+    image->SetDimensions(dims[0], dims[1], dims[2]);
+    image->SetOrigin(origin[0], origin[1], origin[2]);
+    image->SetSpacing(spacing[0], spacing[1], spacing[2]);
+    image->SetDirectionMatrix(direction);
+    scalars->SetName("scalars");
+    image->GetPointData()->SetScalars(scalars);
+    return image;
+}
+
+// Splits an index-to-physical matrix (columns are the axes scaled by the
+// spacing) into spacing and direction, converting RAS coordinates to LPS
+void SetAxes(double matrix[3][3], double origin[3], bool ras, double spacing[3],
+             double direction[9])
+{
+    if (ras)
+    {
+        for (int c = 0; c < 3; ++c)
+        {
+            matrix[0][c] = -matrix[0][c];
+            matrix[1][c] = -matrix[1][c];
+        }
+        origin[0] = -origin[0];
+        origin[1] = -origin[1];
+    }
+    for (int c = 0; c < 3; ++c)
+    {
+        spacing[c] = std::sqrt(matrix[0][c] * matrix[0][c] + matrix[1][c] * matrix[1][c] +
+                               matrix[2][c] * matrix[2][c]);
+        for (int r = 0; r < 3; ++r)
+        {
+            direction[r * 3 + c] = spacing[c] > 0.0 ? matrix[r][c] / spacing[c] : r == c;
+        }
+        if (spacing[c] <= 0.0)
+        {
+            spacing[c] = 1.0;
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+// NRRD
+
+int NrrdType(const std::string &name)
+{
+    static const std::pair<const char *, int> kNames[] = {
+        {"signed char", VTK_SIGNED_CHAR},      {"int8", VTK_SIGNED_CHAR},
+        {"int8_t", VTK_SIGNED_CHAR},           {"uchar", VTK_UNSIGNED_CHAR},
+        {"unsigned char", VTK_UNSIGNED_CHAR},  {"uint8", VTK_UNSIGNED_CHAR},
+        {"uint8_t", VTK_UNSIGNED_CHAR},        {"short", VTK_SHORT},
+        {"short int", VTK_SHORT},              {"signed short", VTK_SHORT},
+        {"signed short int", VTK_SHORT},       {"int16", VTK_SHORT},
+        {"int16_t", VTK_SHORT},                {"ushort", VTK_UNSIGNED_SHORT},
+        {"unsigned short", VTK_UNSIGNED_SHORT}, {"unsigned short int", VTK_UNSIGNED_SHORT},
+        {"uint16", VTK_UNSIGNED_SHORT},        {"uint16_t", VTK_UNSIGNED_SHORT},
+        {"int", VTK_INT},                      {"signed int", VTK_INT},
+        {"int32", VTK_INT},                    {"int32_t", VTK_INT},
+        {"uint", VTK_UNSIGNED_INT},            {"unsigned int", VTK_UNSIGNED_INT},
+        {"uint32", VTK_UNSIGNED_INT},          {"uint32_t", VTK_UNSIGNED_INT},
+        {"longlong", VTK_LONG_LONG},           {"long long", VTK_LONG_LONG},
+        {"long long int", VTK_LONG_LONG},      {"signed long long", VTK_LONG_LONG},
+        {"signed long long int", VTK_LONG_LONG}, {"int64", VTK_LONG_LONG},
+        {"int64_t", VTK_LONG_LONG},            {"ulonglong", VTK_UNSIGNED_LONG_LONG},
+        {"unsigned long long", VTK_UNSIGNED_LONG_LONG},
+        {"unsigned long long int", VTK_UNSIGNED_LONG_LONG},
+        {"uint64", VTK_UNSIGNED_LONG_LONG},    {"uint64_t", VTK_UNSIGNED_LONG_LONG},
+        {"float", VTK_FLOAT},                  {"double", VTK_DOUBLE},
+    };
+    for (const auto &[text, value] : kNames)
+    {
+        if (name == text)
+        {
+            return value;
+        }
+    }
+    throw std::runtime_error("unsupported NRRD type: " + name);
+}
+
+// Vectors "(x,y,z)" of a space directions or origin field; "none" entries are
+// returned empty
+std::vector<std::vector<double>> NrrdVectors(const std::string &text)
+{
+    std::vector<std::vector<double>> vectors;
+    std::istringstream stream(text);
+    std::string token;
+    while (stream >> token)
+    {
+        if (token == "none")
+        {
+            vectors.emplace_back();
+            continue;
+        }
+        // Vectors may contain blanks, up to the closing parenthesis
+        while (token.find(')') == std::string::npos && stream)
+        {
+            std::string more;
+            stream >> more;
+            token += more;
+        }
+        std::replace(token.begin(), token.end(), ',', ' ');
+        token.erase(std::remove_if(token.begin(), token.end(),
+                                   [](char c) { return c == '(' || c == ')'; }),
+                    token.end());
+        std::istringstream values(token);
+        std::vector<double> vector;
+        double value;
+        while (values >> value)
+        {
+            vector.push_back(value);
+        }
+        vectors.push_back(std::move(vector));
+    }
+    return vectors;
+}
+
+std::size_t SkipLines(const MappedFile &file, std::size_t offset, long long lines)
+{
+    for (; lines > 0 && offset < file.size(); --lines)
+    {
+        const void *nl = std::memchr(file.data() + offset, '\n', file.size() - offset);
+        offset = nl ? static_cast<const char *>(nl) - file.data() + 1 : file.size();
+    }
+    return offset;
+}
+
+//------------------------------------------------------------------------------
+// NIfTI
+
+constexpr std::size_t kNIfTIHeaderSize = 348;
+
+// Fields of a NIfTI-1 header, read in either byte order
+class NIfTIHeader
+{
+public:
+    NIfTIHeader(const char *data, const std::string &path)
+        : data_(data)
+    {
+        std::int32_t size;
+        std::memcpy(&size, data, 4);
+        swap_ = size != std::int32_t(kNIfTIHeaderSize);
+        if (Int32(0) != std::int32_t(kNIfTIHeaderSize))
+        {
+            throw std::runtime_error(path + ": not a NIfTI-1 file");
+        }
+    }
+
+    bool Swapped() const { return swap_; }
+
+    std::int16_t Int16(std::size_t offset) const { return Get<std::int16_t>(offset); }
+    std::int32_t Int32(std::size_t offset) const { return Get<std::int32_t>(offset); }
+    double Float(std::size_t offset) const { return Get<float>(offset); }
+
+private:
+    template <typename T>
+    T Get(std::size_t offset) const
+    {
+        char bytes[sizeof(T)];
+        std::memcpy(bytes, data_ + offset, sizeof(T));
+        if (swap_)
+        {
+            std::reverse(bytes, bytes + sizeof(T));
+        }
+        T value;
+        std::memcpy(&value, bytes, sizeof(T));
+        return value;
+    }
+
+    const char *data_;
+    bool swap_ = false;
+};
+
+// VTK type and components of a NIfTI datatype code
+std::pair<int, int> NIfTIType(int code)
+{
+    switch (code)
+    {
+    case 2:
+        return {VTK_UNSIGNED_CHAR, 1};
+    case 4:
+        return {VTK_SHORT, 1};
+    case 8:
+        return {VTK_INT, 1};
+    case 16:
+        return {VTK_FLOAT, 1};
+    case 64:
+        return {VTK_DOUBLE, 1};
+    case 128:
+        return {VTK_UNSIGNED_CHAR, 3};
+    case 256:
+        return {VTK_SIGNED_CHAR, 1};
+    case 512:
+        return {VTK_UNSIGNED_SHORT, 1};
+    case 768:
+        return {VTK_UNSIGNED_INT, 1};
+    case 1024:
+        return {VTK_LONG_LONG, 1};
+    case 1280:
+        return {VTK_UNSIGNED_LONG_LONG, 1};
+    case 2304:
+        return {VTK_UNSIGNED_CHAR, 4};
+    default:
+        throw std::runtime_error("unsupported NIfTI datatype " + std::to_string(code));
+    }
+}
+
+template <typename Values, typename Out>
+void ScaleRange(Values in, Out *out, vtkIdType begin, vtkIdType end, double slope,
+                double intercept)
+{
+    for (vtkIdType i = begin; i < end; ++i)
+    {
+        out[i] = static_cast<Out>(double(in.GetValue(i)) * slope + intercept);
+    }
+}
+
+// value * slope + intercept in float, or double for double input
+vtkSmartPointer<vtkDataArray> ScaleScalars(vtkDataArray *scalars, double slope, double intercept)
+{
+    const int outType = scalars->GetDataType() == VTK_DOUBLE ? VTK_DOUBLE : VTK_FLOAT;
+    auto scaled = NewArray(outType, scalars->GetNumberOfComponents(),
+                           scalars->GetNumberOfTuples());
+    void *out = scaled->GetVoidPointer(0);
+    array_dispatch::Dispatch(scalars, [&](auto in) {
+        vtkSMPTools::For(0, scalars->GetNumberOfValues(), [&](vtkIdType begin, vtkIdType end) {
+            if (outType == VTK_DOUBLE)
+            {
+                ScaleRange(in, static_cast<double *>(out), begin, end, slope, intercept);
+                return;
+            }
+            ScaleRange(in, static_cast<float *>(out), begin, end, slope, intercept);
+        });
+    });
+    return scaled;
+}
+
+} // namespace
+
+vtkSmartPointer<vtkImageData> ReadNRRD(const std::string &path)
+{
+    auto header = std::make_shared<const MappedFile>(path, true);
+    const std::string_view text(header->data(), header->size());
+    if (text.substr(0, 7) != "NRRD000")
+    {
+        throw std::runtime_error(path + ": not a NRRD file");
+    }
+
+    std::unordered_map<std::string, std::string> fields;
+    std::size_t offset = text.find('\n');
+    offset = offset == std::string_view::npos ? text.size() : offset + 1;
+    while (offset < text.size())
+    {
+        std::size_t end = text.find('\n', offset);
+        end = end == std::string_view::npos ? text.size() : end;
+        const std::string line = Trim(text.substr(offset, end - offset));
+        offset = std::min(end + 1, text.size());
+        if (line.empty())
+        {
+            break; // the data follows
+        }
+        const std::size_t colon = line.find(": ");
+        if (line[0] == '#' || colon == std::string::npos)
+        {
+            continue; // comments and key/value pairs
+        }
+        fields[Lowercase(line.substr(0, colon))] = Trim(line.substr(colon + 2));
+    }
+    const auto field = [&](const char *key) -> std::string {
+        const auto it = fields.find(key);
+        return it == fields.end() ? std::string() : it->second;
+    };
+    const auto required = [&](const char *key) {
+        const std::string value = field(key);
+        if (value.empty())
+        {
+            throw std::runtime_error(path + ": NRRD field \"" + key + "\" is missing");
+        }
+        return value;
+    };
+
+    Payload payload;
+    payload.vtkType = NrrdType(Lowercase(required("type")));
+    const int dimension = std::stoi(required("dimension"));
+    std::vector<long long> sizes;
+    {
+        std::istringstream stream(required("sizes"));
+        long long size;
+        while (stream >> size)
+        {
+            sizes.push_back(size);
+        }
+    }
+    const auto directions = NrrdVectors(field("space directions"));
+    // A leading axis of components has no space direction, or is the fourth
+    const bool componentAxis =
+        dimension == 4 || (!directions.empty() && directions[0].empty() && dimension > 2);
+    const int spatial = dimension - (componentAxis ? 1 : 0);
+    if (int(sizes.size()) != dimension || spatial < 2 || spatial > 3)
+    {
+        throw std::runtime_error(path + ": only 2D and 3D NRRD volumes are supported");
+    }
+    payload.components = componentAxis ? static_cast<int>(sizes[0]) : 1;
+    int dims[3] = {1, 1, 1};
+    for (int a = 0; a < spatial; ++a)
+    {
+        dims[a] = static_cast<int>(sizes[a + (componentAxis ? 1 : 0)]);
+    }
+    payload.tuples = vtkIdType(dims[0]) * dims[1] * dims[2];
+
+    const std::string encoding = Lowercase(required("encoding"));
+    if (encoding == "gzip" || encoding == "gz")
+    {
+        payload.gzip = true;
+    }
+    else if (encoding != "raw")
+    {
+        throw std::runtime_error(path + ": unsupported NRRD encoding " + encoding);
+    }
+    const bool bigEndian = Lowercase(field("endian")) == "big";
+    payload.swap = ElementSize(payload.vtkType) > 1 &&
+                   bigEndian != (std::endian::native == std::endian::big);
+
+    // Geometry: space directions and origin, or plain spacings
+    double matrix[3][3] = {{1, 0, 0}, {0, 1, 0}, {0, 0, 1}};
+    double origin[3] = {0, 0, 0};
+    const auto spatialDirections = directions.size() > std::size_t(spatial)
+                                       ? std::vector<std::vector<double>>(
+                                             directions.end() - spatial, directions.end())
+                                       : directions;
+    if (int(spatialDirections.size()) == spatial)
+    {
+        for (int a = 0; a < spatial; ++a)
+        {
+            for (int r = 0; r < 3 && r < int(spatialDirections[a].size()); ++r)
+            {
+                matrix[r][a] = spatialDirections[a][r];
+            }
+        }
+        const auto origins = NrrdVectors(field("space origin"));
+        for (int r = 0; !origins.empty() && r < 3 && r < int(origins[0].size()); ++r)
+        {
+            origin[r] = origins[0][r];
+        }
+    }
+    else if (!field("spacings").empty())
+    {
+        std::istringstream stream(field("spacings"));
+        std::vector<double> spacings;
+        std::string token;
+        while (stream >> token)
+        {
+            spacings.push_back(token == "nan" || token == "NaN" ? 1.0 : std::stod(token));
+        }
+        for (int a = 0; a < spatial && a + (componentAxis ? 1 : 0) < int(spacings.size()); ++a)
+        {
+            matrix[a][a] = spacings[a + (componentAxis ? 1 : 0)];
+        }
+    }
+    const std::string space = Lowercase(field("space"));
+    const bool ras = space == "right-anterior-superior" || space == "ras";
+
+    // The payload follows the header, or is in a file next to it
+    std::string dataFile = field("data file");
+    if (dataFile.empty())
+    {
+        dataFile = field("datafile");
+    }
+    if (dataFile.empty())
+    {
+        payload.file = header;
+        payload.offset = offset;
+    }
+    else
+    {
+        if (dataFile.find(' ') != std::string::npos || dataFile.find('%') != std::string::npos)
+        {
+            throw std::runtime_error(path + ": NRRD data split over several files");
+        }
+        std::filesystem::path dataPath(dataFile);
+        if (dataPath.is_relative())
+        {
+            dataPath = std::filesystem::path(path).parent_path() / dataPath;
+        }
+        payload.file = std::make_shared<const MappedFile>(dataPath.string(), true);
+        payload.offset = 0;
+    }
+    const std::string lineSkip = field("line skip");
+    payload.offset = SkipLines(*payload.file, payload.offset,
+                               lineSkip.empty() ? 0 : std::stoll(lineSkip));
+    const std::string byteSkipField = field("byte skip");
+    const long long byteSkip = byteSkipField.empty() ? 0 : std::stoll(byteSkipField);
+    const std::size_t bytes =
+        std::size_t(payload.tuples) * payload.components * ElementSize(payload.vtkType);
+    if (byteSkip == -1 && !payload.gzip && bytes <= payload.file->size())
+    {
+        // The voxels are the last bytes of the file
+        payload.offset = payload.file->size() - bytes;
+    }
+    else if (byteSkip < 0)
+    {
+        throw std::runtime_error(path + ": unsupported NRRD byte skip");
+    }
+    else if (payload.gzip)
+    {
+        payload.skip = static_cast<std::size_t>(byteSkip);
+    }
+    else
+    {
+        payload.offset += static_cast<std::size_t>(byteSkip);
+    }
+
+    double spacing[3], direction[9];
+    SetAxes(matrix, origin, ras, spacing, direction);
+    return NewImage(dims, origin, spacing, direction, LoadScalars(payload));
+}
+
+vtkSmartPointer<vtkImageData> ReadNIfTI(const std::string &path)
+{
+    auto file = std::make_shared<const MappedFile>(path, true);
+    const bool gzip = file->size() >= 2 && static_cast<unsigned char>(file->data()[0]) == 0x1f &&
+                      static_cast<unsigned char>(file->data()[1]) == 0x8b;
+    char headerBytes[kNIfTIHeaderSize];
+    if (gzip)
+    {
+        InflateGzip(file->data(), file->size(), 0, headerBytes, kNIfTIHeaderSize, path);
+    }
+    else if (file->size() >= kNIfTIHeaderSize)
+    {
+        std::memcpy(headerBytes, file->data(), kNIfTIHeaderSize);
+    }
+    else
+    {
+        throw std::runtime_error(path + ": not a NIfTI-1 file");
+    }
+    const NIfTIHeader header(headerBytes, path);
+    if (std::memcmp(headerBytes + 344, "n+1", 4) != 0)
+    {
+        throw std::runtime_error(path + ": only single-file NIfTI-1 (.nii) is supported");
+    }
+
+    const int rank = header.Int16(40);
+    int dims[3] = {1, 1, 1};
+    for (int a = 0; a < std::min(rank, 3); ++a)
+    {
+        dims[a] = header.Int16(42 + 2 * a);
+    }
+    for (int a = 4; a <= rank && a <= 7; ++a)
+    {
+        // Components are stored plane by plane and cannot be interleaved for
+        // free; later time points are simply not read
+        if (a > 4 && header.Int16(40 + 2 * a) > 1)
+        {
+            throw std::runtime_error(path + ": NIfTI vector volumes are not supported");
+        }
+    }
+    if (rank < 1 || dims[0] < 1 || dims[1] < 1 || dims[2] < 1)
+    {
+        throw std::runtime_error(path + ": invalid NIfTI dimensions");
+    }
+
+    Payload payload;
+    payload.file = file;
+    std::tie(payload.vtkType, payload.components) = NIfTIType(header.Int16(70));
+    payload.tuples = vtkIdType(dims[0]) * dims[1] * dims[2];
+    payload.swap = header.Swapped() && ElementSize(payload.vtkType) > 1;
+    const auto voxOffset = static_cast<std::size_t>(std::max(header.Float(108), 0.0));
+    payload.gzip = gzip;
+    if (gzip)
+    {
+        payload.skip = std::max(voxOffset, kNIfTIHeaderSize);
+    }
+    else
+    {
+        payload.offset = std::max(voxOffset, kNIfTIHeaderSize);
+    }
+
+    // Index to RAS: the sform if set, the qform otherwise, else the spacing
+    double pixdim[8];
+    for (int i = 0; i < 8; ++i)
+    {
+        pixdim[i] = header.Float(76 + 4 * i);
+    }
+    double matrix[3][3] = {{pixdim[1], 0, 0}, {0, pixdim[2], 0}, {0, 0, pixdim[3]}};
+    double origin[3] = {0, 0, 0};
+    if (header.Int16(254) > 0)
+    {
+        for (int r = 0; r < 3; ++r)
+        {
+            for (int c = 0; c < 3; ++c)
+            {
+                matrix[r][c] = header.Float(280 + 16 * r + 4 * c);
+            }
+            origin[r] = header.Float(280 + 16 * r + 12);
+        }
+    }
+    else if (header.Int16(252) > 0)
+    {
+        const double b = header.Float(256), c = header.Float(260), d = header.Float(264);
+        const double a = std::sqrt(std::max(0.0, 1.0 - (b * b + c * c + d * d)));
+        const double rotation[3][3] = {
+            {a * a + b * b - c * c - d * d, 2 * (b * c - a * d), 2 * (b * d + a * c)},
+            {2 * (b * c + a * d), a * a + c * c - b * b - d * d, 2 * (c * d - a * b)},
+            {2 * (b * d - a * c), 2 * (c * d + a * b), a * a + d * d - c * c - b * b}};
+        const double scale[3] = {pixdim[1], pixdim[2], pixdim[0] < 0.0 ? -pixdim[3] : pixdim[3]};
+        for (int r = 0; r < 3; ++r)
+        {
+            for (int col = 0; col < 3; ++col)
+            {
+                matrix[r][col] = rotation[r][col] * scale[col];
+            }
+            origin[r] = header.Float(268 + 4 * r);
+        }
+    }
+    double spacing[3], direction[9];
+    SetAxes(matrix, origin, true, spacing, direction);
+
+    vtkSmartPointer<vtkDataArray> scalars = LoadScalars(payload);
+    const double slope = header.Float(112), intercept = header.Float(116);
+    if (std::isfinite(slope) && slope != 0.0 && (slope != 1.0 || intercept != 0.0))
+    {
+        scalars = ScaleScalars(scalars, slope, intercept);
+    }
+    return NewImage(dims, origin, spacing, direction, scalars);
+}
+
+vtkSmartPointer<vtkImageData> ReadVolumeFile(const std::string &path, const int *extent)
+{
+    const std::string name = Lowercase(path);
+    const auto endsWith = [&](std::string_view suffix) {
+        return name.size() >= suffix.size() &&
+               name.compare(name.size() - suffix.size(), suffix.size(), suffix) == 0;
+    };
+    if (endsWith(".vtkhdf") || endsWith(".hdf"))
+    {
+        return ReadVTKHDFImage(path, extent);
+    }
+    if (extent)
+    {
+        throw std::invalid_argument("only VTKHDF volumes can be read partially: " + path);
+    }
+    if (endsWith(".nrrd") || endsWith(".nhdr"))
+    {
+        return ReadNRRD(path);
+    }
+    if (endsWith(".nii") || endsWith(".nii.gz"))
+    {
+        return ReadNIfTI(path);
+    }
+    throw std::runtime_error("unsupported volume format: " + path);
+}
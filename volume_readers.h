@@ -0,0 +1,36 @@
+#pragma once
+
+#include <vtkImageData.h>
+#include <vtkSmartPointer.h>
+
+#include <string>
+
+// Readers for the volume files research groups send us, which load the
+// payload without the copies the VTK readers make.
+//
+// Uncompressed payloads in host byte order are not copied at all: the file is
+// mapped copy-on-write and the mapping becomes the scalar array of the volume,
+// unmapped when the array is released. Gzip payloads are inflated straight
+// into the preallocated scalars, in parallel when the stream is made of BGZF
+// blocks (bgzip, or any gzip tool writing independent members with block
+// sizes) and on the calling thread otherwise. Payloads in the other byte
+// order or not aligned to their element size are copied in parallel.
+//
+// Volumes are returned in LPS coordinates, like the DICOM volumes. Unsupported
+// or malformed files throw std::runtime_error.
+
+// NRRD with an attached (.nrrd) or detached (.nhdr) header and raw or gzip
+// encoding; a detached header is also how a headerless raw file is described.
+// Two or three spatial axes, optionally preceded by an axis of components.
+vtkSmartPointer<vtkImageData> ReadNRRD(const std::string &path);
+
+// Single-file NIfTI-1 (.nii or .nii.gz). Only the first time point of 4D
+// files is read, and scaled intensities (scl_slope) are converted to float.
+vtkSmartPointer<vtkImageData> ReadNIfTI(const std::string &path);
+
+// Picks a reader from the file extension (case-insensitive): ReadNRRD,
+// ReadNIfTI or ReadVTKHDFImage for .vtkhdf/.hdf files. Only VTKHDF files can
+// be read partially, within extent (see ReadVTKHDFImage); the other readers
+// throw std::invalid_argument if extent is not null.
+vtkSmartPointer<vtkImageData> ReadVolumeFile(const std::string &path,
+                                             const int *extent = nullptr);
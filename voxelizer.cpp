@@ -0,0 +1,272 @@
+#include "voxelizer.h"
+
+#include "array_dispatch.h"
+
+#include <vtkCellArray.h>
+#include <vtkPoints.h>
+#include <vtkSMPTools.h>
+#include <vtkType.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+namespace
+{
+
+// Triangle in continuous grid index coordinates
+struct Triangle
+{
+    double p[3][3];
+};
+
+struct Crossing
+{
+    double x;
+    int sign;
+};
+
+// Edge function of p against the edge a-b in the (y, z) plane, computed with
+// the endpoints in a canonical order so that the two triangles sharing an
+// edge get exactly opposite values. onEdge tells whether a point on the edge
+// counts as inside; it is true for exactly one of the two directions.
+double EdgeFunction(const double *a, const double *b, double y, double z, bool &onEdge)
+{
+    const bool swapped = a[1] > b[1] || (a[1] == b[1] && a[2] > b[2]);
+    const double *first = swapped ? b : a;
+    const double *second = swapped ? a : b;
+    const double value =
+        (second[1] - first[1]) * (z - first[2]) - (second[2] - first[2]) * (y - first[1]);
+    const double dy = b[1] - a[1];
+    const double dz = b[2] - a[2];
+    onEdge = dz > 0.0 || (dz == 0.0 && dy < 0.0);
+    return swapped ? -value : value;
+}
+
+std::vector<Triangle> TrianglesInIndexSpace(vtkPolyData *mesh, const double origin[3],
+                                            const double spacing[3])
+{
+    vtkPoints *points = mesh->GetPoints();
+    vtkCellArray *polys = mesh->GetPolys();
+    std::vector<Triangle> triangles;
+    if (!points || !polys)
+    {
+        return triangles;
+    }
+    triangles.reserve(static_cast<std::size_t>(polys->GetNumberOfCells()));
+
+    array_dispatch::DispatchReal(points->GetData(), [&](auto xyz) {
+        auto toIndex = [&](vtkIdType id, double *out) {
+            for (int axis = 0; axis < 3; ++axis)
+            {
+                out[axis] = (xyz.Get(id, axis) - origin[axis]) / spacing[axis];
+            }
+        };
+
+        // Polygons become triangle fans
+        for (vtkIdType cell = 0; cell < polys->GetNumberOfCells(); ++cell)
+        {
+            vtkIdType npts = 0;
+            const vtkIdType *pts = nullptr;
+            polys->GetCellAtId(cell, npts, pts);
+            for (vtkIdType i = 1; i + 1 < npts; ++i)
+            {
+                Triangle triangle;
+                toIndex(pts[0], triangle.p[0]);
+                toIndex(pts[i], triangle.p[1]);
+                toIndex(pts[i + 1], triangle.p[2]);
+                triangles.push_back(triangle);
+            }
+        }
+    });
+    return triangles;
+}
+
+// Range of integer rows [first, last] within [low, high] covered by [min, max]
+bool RowRange(double min, double max, int low, int high, int &first, int &last)
+{
+    first = std::max(low, static_cast<int>(std::ceil(min)));
+    last = std::min(high, static_cast<int>(std::floor(max)));
+    return first <= last;
+}
+
+// Crossing of the x ray through (y, z) with triangle, if any. The sign is the
+// winding contribution of entering the surface there.
+bool Intersect(const Triangle &triangle, double y, double z, Crossing &crossing)
+{
+    const double *a = triangle.p[0];
+    const double *b = triangle.p[1];
+    const double *c = triangle.p[2];
+    const double area = (b[1] - a[1]) * (c[2] - a[2]) - (b[2] - a[2]) * (c[1] - a[1]);
+    if (area == 0.0)
+    {
+        return false; // parallel to the ray
+    }
+    // Make the projection counter-clockwise; a front face (normal along +x)
+    // is where the ray leaves the inside
+    const int sign = area > 0.0 ? -1 : 1;
+    if (area < 0.0)
+    {
+        std::swap(b, c);
+    }
+
+    bool onEdge[3];
+    const double ea = EdgeFunction(b, c, y, z, onEdge[0]);
+    const double eb = EdgeFunction(c, a, y, z, onEdge[1]);
+    const double ec = EdgeFunction(a, b, y, z, onEdge[2]);
+    if (ea < 0.0 || eb < 0.0 || ec < 0.0 || (ea == 0.0 && !onEdge[0]) ||
+        (eb == 0.0 && !onEdge[1]) || (ec == 0.0 && !onEdge[2]))
+    {
+        return false;
+    }
+    crossing.x = (ea * a[0] + eb * b[0] + ec * c[0]) / (ea + eb + ec);
+    crossing.sign = sign;
+    return true;
+}
+
+} // namespace
+
+vtkSmartPointer<vtkImageData> VoxelizeMesh(vtkPolyData *mesh, vtkImageData *grid, VoxelizeRule rule)
+{
+    int extent[6];
+    double origin[3];
+    double spacing[3];
+    grid->GetExtent(extent);
+    grid->GetOrigin(origin);
+    grid->GetSpacing(spacing);
+    if (extent[1] < extent[0] || extent[3] < extent[2] || extent[5] < extent[4])
+    {
+        throw std::invalid_argument("voxelizer: empty target grid");
+    }
+
+    auto volume = vtkSmartPointer<vtkImageData>::New();
+    volume->SetExtent(extent);
+    volume->SetOrigin(origin);
+    volume->SetSpacing(spacing);
+    volume->AllocateScalars(rule == VoxelizeRule::Parity ? VTK_UNSIGNED_CHAR : VTK_SIGNED_CHAR, 1);
+
+    const int nx = extent[1] - extent[0] + 1;
+    const int ny = extent[3] - extent[2] + 1;
+    const int nz = extent[5] - extent[4] + 1;
+    std::int8_t *voxels = static_cast<std::int8_t *>(volume->GetScalarPointer());
+    std::fill_n(voxels, std::size_t(nx) * ny * nz, std::int8_t(0));
+
+    const std::vector<Triangle> triangles = TrianglesInIndexSpace(mesh, origin, spacing);
+
+    // Triangles of every z slice, as offsets into one list
+    std::vector<vtkIdType> sliceOffsets(std::size_t(nz) + 1, 0);
+    auto zRange = [&](const Triangle &t, int &first, int &last) {
+        const double zMin = std::min({t.p[0][2], t.p[1][2], t.p[2][2]});
+        const double zMax = std::max({t.p[0][2], t.p[1][2], t.p[2][2]});
+        return RowRange(zMin, zMax, extent[4], extent[5], first, last);
+    };
+    for (const Triangle &triangle : triangles)
+    {
+        int first, last;
+        if (zRange(triangle, first, last))
+        {
+            for (int k = first; k <= last; ++k)
+            {
+                ++sliceOffsets[k - extent[4] + 1];
+            }
+        }
+    }
+    for (int k = 0; k < nz; ++k)
+    {
+        sliceOffsets[k + 1] += sliceOffsets[k];
+    }
+    std::vector<vtkIdType> sliceTriangles(static_cast<std::size_t>(sliceOffsets[nz]));
+    {
+        std::vector<vtkIdType> cursor(sliceOffsets.begin(), sliceOffsets.end() - 1);
+        for (std::size_t t = 0; t < triangles.size(); ++t)
+        {
+            int first, last;
+            if (zRange(triangles[t], first, last))
+            {
+                for (int k = first; k <= last; ++k)
+                {
+                    sliceTriangles[cursor[k - extent[4]]++] = static_cast<vtkIdType>(t);
+                }
+            }
+        }
+    }
+
+    vtkSMPTools::For(0, nz, [&](vtkIdType begin, vtkIdType end) {
+        std::vector<std::vector<Crossing>> rows(ny);
+        for (vtkIdType slice = begin; slice < end; ++slice)
+        {
+            const double z = double(extent[4] + slice);
+            for (vtkIdType s = sliceOffsets[slice]; s < sliceOffsets[slice + 1]; ++s)
+            {
+                const Triangle &triangle = triangles[sliceTriangles[s]];
+                const double yMin = std::min({triangle.p[0][1], triangle.p[1][1], triangle.p[2][1]});
+                const double yMax = std::max({triangle.p[0][1], triangle.p[1][1], triangle.p[2][1]});
+                int first, last;
+                if (!RowRange(yMin, yMax, extent[2], extent[3], first, last))
+                {
+                    continue;
+                }
+                for (int j = first; j <= last; ++j)
+                {
+                    Crossing crossing;
+                    if (Intersect(triangle, double(j), z, crossing))
+                    {
+                        rows[j - extent[2]].push_back(crossing);
+                    }
+                }
+            }
+
+            // Sweep every row from -x; a sample counts the crossings before it
+            std::int8_t *sliceVoxels = voxels + std::size_t(slice) * nx * ny;
+            for (int row = 0; row < ny; ++row)
+            {
+                std::vector<Crossing> &crossings = rows[row];
+                if (crossings.empty())
+                {
+                    continue;
+                }
+                std::sort(crossings.begin(), crossings.end(),
+                          [](const Crossing &l, const Crossing &r) { return l.x < r.x; });
+                std::int8_t *out = sliceVoxels + std::size_t(row) * nx;
+                std::size_t next = 0;
+                int count = 0;
+                int winding = 0;
+                for (int i = 0; i < nx; ++i)
+                {
+                    const double x = double(extent[0] + i);
+                    for (; next < crossings.size() && crossings[next].x < x; ++next)
+                    {
+                        ++count;
+                        winding += crossings[next].sign;
+                    }
+                    if (next == crossings.size() && winding == 0 && (count & 1) == 0)
+                    {
+                        break; // outside for the rest of the row
+                    }
+                    out[i] = rule == VoxelizeRule::Parity
+                                 ? std::int8_t(count & 1)
+                                 : std::int8_t(std::clamp(winding, -127, 127));
+                }
+                crossings.clear();
+            }
+        }
+    });
+    return volume;
+}
+
+vtkSmartPointer<vtkImageData> CreateVoxelGrid(const double bounds[6], const int dimensions[3])
+{
+    auto grid = vtkSmartPointer<vtkImageData>::New();
+    grid->SetDimensions(dimensions[0], dimensions[1], dimensions[2]);
+    grid->SetOrigin(bounds[0], bounds[2], bounds[4]);
+    double spacing[3];
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        const double length = bounds[2 * axis + 1] - bounds[2 * axis];
+        spacing[axis] = dimensions[axis] > 1 && length > 0.0 ? length / (dimensions[axis] - 1) : 1.0;
+    }
+    grid->SetSpacing(spacing);
+    return grid;
+}
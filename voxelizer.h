@@ -0,0 +1,25 @@
+#pragma once
+
+#include <vtkImageData.h>
+#include <vtkPolyData.h>
+#include <vtkSmartPointer.h>
+
+enum class VoxelizeRule
+{
+    // Odd number of surface crossings: 1 inside, 0 outside (unsigned char)
+    Parity,
+    // Signed sum of crossings by face orientation (signed char): 1 inside an
+    // outward-facing shell, -1 inside an inverted one, 2 where shells overlap
+    Winding,
+};
+
+// Rasterizes the polygons of mesh onto the points of grid, whose extent,
+// origin and spacing are used (a DICOM volume, say; its direction matrix is
+// ignored). Rays along x through every grid row are intersected with the
+// triangles they cross; z slices are rasterized in parallel. Shared edges and
+// vertices are counted once, so a closed mesh gives a watertight result.
+vtkSmartPointer<vtkImageData> VoxelizeMesh(vtkPolyData *mesh, vtkImageData *grid,
+                                           VoxelizeRule rule = VoxelizeRule::Parity);
+
+// Grid without scalars of the given dimensions spanning bounds
+vtkSmartPointer<vtkImageData> CreateVoxelGrid(const double bounds[6], const int dimensions[3]);
@@ -0,0 +1,933 @@
+#include "vtkhdf_io.h"
+
+#include <vtkCellArray.h>
+#include <vtkCellData.h>
+#include <vtkDataArray.h>
+#include <vtkIdTypeArray.h>
+#include <vtkMatrix3x3.h>
+#include <vtkPointData.h>
+#include <vtkPoints.h>
+#include <vtkSMPTools.h>
+#include <vtkTypeInt32Array.h>
+#include <vtkTypeInt64Array.h>
+
+#include <hdf5.h>
+#include <zlib.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+static_assert(sizeof(vtkIdType) == sizeof(long long), "cell arrays are read as 64-bit ids");
+
+namespace
+{
+
+// Chunk bytes held in memory at once while writing or reading a dataset
+constexpr std::size_t kBytesInFlight = std::size_t(256) << 20;
+
+// Datasets have up to three dimensions plus one for the components
+constexpr int kMaxRank = 4;
+
+// Closes an HDF5 identifier when it goes out of scope
+class H5Id
+{
+public:
+    H5Id(hid_t id, herr_t (*close)(hid_t), const std::string &what)
+        : id_(id)
+        , close_(close)
+    {
+        if (id_ < 0)
+        {
+            throw std::runtime_error("HDF5: cannot " + what);
+        }
+    }
+    ~H5Id() { close_(id_); }
+
+    H5Id(const H5Id &) = delete;
+    H5Id &operator=(const H5Id &) = delete;
+
+    operator hid_t() const { return id_; }
+
+private:
+    hid_t id_;
+    herr_t (*close_)(hid_t);
+};
+
+void Check(herr_t status, const std::string &what)
+{
+    if (status < 0)
+    {
+        throw std::runtime_error("HDF5: cannot " + what);
+    }
+}
+
+hid_t NativeType(int vtkType)
+{
+    switch (vtkType)
+    {
+    case VTK_FLOAT:
+        return H5T_NATIVE_FLOAT;
+    case VTK_DOUBLE:
+        return H5T_NATIVE_DOUBLE;
+    case VTK_CHAR:
+    case VTK_SIGNED_CHAR:
+        return H5T_NATIVE_SCHAR;
+    case VTK_UNSIGNED_CHAR:
+        return H5T_NATIVE_UCHAR;
+    case VTK_SHORT:
+        return H5T_NATIVE_SHORT;
+    case VTK_UNSIGNED_SHORT:
+        return H5T_NATIVE_USHORT;
+    case VTK_INT:
+        return H5T_NATIVE_INT;
+    case VTK_UNSIGNED_INT:
+        return H5T_NATIVE_UINT;
+    case VTK_LONG:
+        return H5T_NATIVE_LONG;
+    case VTK_UNSIGNED_LONG:
+        return H5T_NATIVE_ULONG;
+    case VTK_LONG_LONG:
+    case VTK_ID_TYPE:
+        return H5T_NATIVE_LLONG;
+    case VTK_UNSIGNED_LONG_LONG:
+        return H5T_NATIVE_ULLONG;
+    default:
+        throw std::runtime_error("VTKHDF: unsupported array type " + std::to_string(vtkType));
+    }
+}
+
+// VTK type that holds the values of an HDF5 dataset type without conversion
+int VTKTypeOf(hid_t type)
+{
+    const std::size_t size = H5Tget_size(type);
+    const H5T_class_t typeClass = H5Tget_class(type);
+    if (typeClass == H5T_FLOAT && (size == 4 || size == 8))
+    {
+        return size == 4 ? VTK_FLOAT : VTK_DOUBLE;
+    }
+    if (typeClass == H5T_INTEGER)
+    {
+        const bool isSigned = H5Tget_sign(type) != H5T_SGN_NONE;
+        switch (size)
+        {
+        case 1:
+            return isSigned ? VTK_SIGNED_CHAR : VTK_UNSIGNED_CHAR;
+        case 2:
+            return isSigned ? VTK_SHORT : VTK_UNSIGNED_SHORT;
+        case 4:
+            return isSigned ? VTK_INT : VTK_UNSIGNED_INT;
+        case 8:
+            return isSigned ? VTK_LONG_LONG : VTK_UNSIGNED_LONG_LONG;
+        }
+    }
+    throw std::runtime_error("VTKHDF: unsupported dataset type");
+}
+
+// Copies the intersection of a chunk and an array region, both boxes in
+// dataset coordinates with the last dimension varying fastest
+void CopyBox(int rank, std::size_t elementSize, const hsize_t *chunkFirst,
+             const hsize_t *chunkDims, char *chunk, const hsize_t *arrayFirst,
+             const hsize_t *arrayDims, char *array, bool intoChunk)
+{
+    hsize_t lo[kMaxRank], hi[kMaxRank], chunkStride[kMaxRank], arrayStride[kMaxRank];
+    for (int d = 0; d < rank; ++d)
+    {
+        lo[d] = std::max(chunkFirst[d], arrayFirst[d]);
+        hi[d] = std::min(chunkFirst[d] + chunkDims[d], arrayFirst[d] + arrayDims[d]);
+        if (lo[d] >= hi[d])
+        {
+            return;
+        }
+    }
+    chunkStride[rank - 1] = arrayStride[rank - 1] = 1;
+    for (int d = rank - 2; d >= 0; --d)
+    {
+        chunkStride[d] = chunkStride[d + 1] * chunkDims[d + 1];
+        arrayStride[d] = arrayStride[d + 1] * arrayDims[d + 1];
+    }
+
+    // Rows along the last dimension are contiguous on both sides
+    const std::size_t rowBytes = (hi[rank - 1] - lo[rank - 1]) * elementSize;
+    hsize_t index[kMaxRank];
+    std::copy(lo, lo + rank, index);
+    for (;;)
+    {
+        hsize_t chunkOffset = 0, arrayOffset = 0;
+        for (int d = 0; d < rank; ++d)
+        {
+            chunkOffset += (index[d] - chunkFirst[d]) * chunkStride[d];
+            arrayOffset += (index[d] - arrayFirst[d]) * arrayStride[d];
+        }
+        char *inChunk = chunk + chunkOffset * elementSize;
+        char *inArray = array + arrayOffset * elementSize;
+        std::memcpy(intoChunk ? inChunk : inArray, intoChunk ? inArray : inChunk, rowBytes);
+
+        int d = rank - 2;
+        for (; d >= 0; --d)
+        {
+            if (++index[d] < hi[d])
+            {
+                break;
+            }
+            index[d] = lo[d];
+        }
+        if (d < 0)
+        {
+            return;
+        }
+    }
+}
+
+// Chunks of a dataset in row-major order; ChunkFirst gives the first element
+// of a chunk
+struct ChunkGrid
+{
+    int rank = 0;
+    hsize_t chunk[kMaxRank] = {};
+    hsize_t first[kMaxRank] = {}; // first chunk index along each dimension
+    hsize_t count[kMaxRank] = {}; // chunks along each dimension
+    std::size_t total = 1;
+
+    void ChunkFirst(std::size_t index, hsize_t *out) const
+    {
+        for (int d = rank - 1; d >= 0; --d)
+        {
+            out[d] = (first[d] + index % count[d]) * chunk[d];
+            index /= count[d];
+        }
+    }
+};
+
+// Chunks covering the box [start, start + size) of a dataset
+ChunkGrid CoveringChunks(int rank, const hsize_t *chunk, const hsize_t *start, const hsize_t *size)
+{
+    ChunkGrid grid;
+    grid.rank = rank;
+    for (int d = 0; d < rank; ++d)
+    {
+        grid.chunk[d] = chunk[d];
+        grid.first[d] = start[d] / chunk[d];
+        grid.count[d] = (start[d] + size[d] - 1) / chunk[d] - grid.first[d] + 1;
+        grid.total *= grid.count[d];
+    }
+    return grid;
+}
+
+// Creates a chunked dataset and writes data (row-major, dims) into it, with
+// the chunks gathered and compressed in parallel
+void WriteDataset(hid_t group, const std::string &name, hid_t type, int rank,
+                  const hsize_t *dims, const hsize_t *chunkRequest, const void *data, int level)
+{
+    const std::size_t elementSize = H5Tget_size(type);
+    H5Id space(H5Screate_simple(rank, dims, nullptr), H5Sclose, "create the space of " + name);
+    hsize_t total = 1;
+    for (int d = 0; d < rank; ++d)
+    {
+        total *= dims[d];
+    }
+    if (total == 0)
+    {
+        H5Id dataset(H5Dcreate2(group, name.c_str(), type, space, H5P_DEFAULT, H5P_DEFAULT,
+                                H5P_DEFAULT),
+                     H5Dclose, "create " + name);
+        return;
+    }
+
+    hsize_t chunk[kMaxRank];
+    std::size_t chunkBytes = elementSize;
+    for (int d = 0; d < rank; ++d)
+    {
+        chunk[d] = std::clamp<hsize_t>(chunkRequest[d], 1, dims[d]);
+        chunkBytes *= chunk[d];
+    }
+    H5Id plist(H5Pcreate(H5P_DATASET_CREATE), H5Pclose, "create a property list");
+    Check(H5Pset_chunk(plist, rank, chunk), "chunk " + name);
+    if (level > 0)
+    {
+        // Tells readers how the chunks written below are encoded
+        Check(H5Pset_deflate(plist, static_cast<unsigned>(level)), "compress " + name);
+    }
+    H5Id dataset(H5Dcreate2(group, name.c_str(), type, space, H5P_DEFAULT, plist, H5P_DEFAULT),
+                 H5Dclose, "create " + name);
+
+    const hsize_t origin[kMaxRank] = {};
+    const ChunkGrid grid = CoveringChunks(rank, chunk, origin, dims);
+    const std::size_t batch = std::max<std::size_t>(1, kBytesInFlight / chunkBytes);
+    std::vector<std::vector<char>> encoded(std::min(batch, grid.total));
+    for (std::size_t first = 0; first < grid.total; first += batch)
+    {
+        const std::size_t count = std::min(batch, grid.total - first);
+        std::atomic<bool> failed(false);
+        vtkSMPTools::For(0, static_cast<vtkIdType>(count), [&](vtkIdType begin, vtkIdType end) {
+            std::vector<char> raw;
+            for (vtkIdType i = begin; i < end; ++i)
+            {
+                hsize_t chunkFirst[kMaxRank];
+                grid.ChunkFirst(first + i, chunkFirst);
+                // Edge chunks are stored whole, padded with zeros
+                raw.assign(chunkBytes, 0);
+                CopyBox(rank, elementSize, chunkFirst, chunk, raw.data(), origin, dims,
+                        static_cast<char *>(const_cast<void *>(data)), true);
+                std::vector<char> &out = encoded[i];
+                if (level == 0)
+                {
+                    out.swap(raw);
+                    continue;
+                }
+                uLongf size = compressBound(static_cast<uLong>(chunkBytes));
+                out.resize(size);
+                if (compress2(reinterpret_cast<Bytef *>(out.data()), &size,
+                              reinterpret_cast<const Bytef *>(raw.data()),
+                              static_cast<uLong>(chunkBytes), level) != Z_OK)
+                {
+                    failed = true;
+                }
+                out.resize(size);
+            }
+        });
+        if (failed)
+        {
+            throw std::runtime_error("VTKHDF: cannot compress " + name);
+        }
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            hsize_t chunkFirst[kMaxRank];
+            grid.ChunkFirst(first + i, chunkFirst);
+            Check(H5Dwrite_chunk(dataset, H5P_DEFAULT, 0, chunkFirst, encoded[i].size(),
+                                 encoded[i].data()),
+                  "write " + name);
+        }
+    }
+}
+
+// Reads the box [start, start + size) of a dataset into out as memType. The
+// chunks of deflate-compressed or unfiltered chunked datasets stored as
+// memType are fetched raw and decoded in parallel; anything else goes
+// through H5Dread.
+void ReadDataset(hid_t dataset, const std::string &name, hid_t memType, int rank,
+                 const hsize_t *start, const hsize_t *size, void *out)
+{
+    std::size_t total = 1;
+    for (int d = 0; d < rank; ++d)
+    {
+        total *= size[d];
+    }
+    if (total == 0)
+    {
+        return;
+    }
+    // Chunks past the end of the dataset would read as zeros
+    {
+        H5Id space(H5Dget_space(dataset), H5Sclose, "get the space of " + name);
+        hsize_t dims[kMaxRank];
+        bool inside = H5Sget_simple_extent_ndims(space) == rank &&
+                      H5Sget_simple_extent_dims(space, dims, nullptr) == rank;
+        for (int d = 0; inside && d < rank; ++d)
+        {
+            inside = start[d] <= dims[d] && size[d] <= dims[d] - start[d];
+        }
+        if (!inside)
+        {
+            throw std::runtime_error("VTKHDF: " + name + " is smaller than expected");
+        }
+    }
+
+    H5Id plist(H5Dget_create_plist(dataset), H5Pclose, "get the layout of " + name);
+    H5Id fileType(H5Dget_type(dataset), H5Tclose, "get the type of " + name);
+    const int filters = H5Pget_nfilters(plist);
+    bool deflate = false;
+    if (filters == 1)
+    {
+        unsigned flags = 0, filterConfig = 0;
+        std::size_t values = 0;
+        deflate = H5Pget_filter2(plist, 0, &flags, &values, nullptr, 0, nullptr, &filterConfig) ==
+                  H5Z_FILTER_DEFLATE;
+    }
+    const bool raw = H5Pget_layout(plist) == H5D_CHUNKED && H5Tequal(fileType, memType) > 0 &&
+                     (filters == 0 || deflate);
+    if (!raw)
+    {
+        H5Id fileSpace(H5Dget_space(dataset), H5Sclose, "get the space of " + name);
+        Check(H5Sselect_hyperslab(fileSpace, H5S_SELECT_SET, start, nullptr, size, nullptr),
+              "select in " + name);
+        H5Id memSpace(H5Screate_simple(rank, size, nullptr), H5Sclose, "create a space");
+        Check(H5Dread(dataset, memType, memSpace, fileSpace, H5P_DEFAULT, out), "read " + name);
+        return;
+    }
+
+    hsize_t chunk[kMaxRank];
+    if (H5Pget_chunk(plist, rank, chunk) != rank)
+    {
+        throw std::runtime_error("VTKHDF: unexpected chunk rank in " + name);
+    }
+    const std::size_t elementSize = H5Tget_size(memType);
+    std::size_t chunkBytes = elementSize;
+    for (int d = 0; d < rank; ++d)
+    {
+        chunkBytes *= chunk[d];
+    }
+    const ChunkGrid grid = CoveringChunks(rank, chunk, start, size);
+    const std::size_t batch = std::max<std::size_t>(1, kBytesInFlight / chunkBytes);
+    std::vector<std::vector<char>> stored(std::min(batch, grid.total));
+    std::vector<std::uint32_t> masks(stored.size());
+    for (std::size_t first = 0; first < grid.total; first += batch)
+    {
+        const std::size_t count = std::min(batch, grid.total - first);
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            hsize_t chunkFirst[kMaxRank];
+            grid.ChunkFirst(first + i, chunkFirst);
+            hsize_t bytes = 0;
+            // Chunks never written read as zeros
+            if (H5Dget_chunk_storage_size(dataset, chunkFirst, &bytes) < 0)
+            {
+                bytes = 0;
+            }
+            stored[i].resize(bytes);
+            masks[i] = 0;
+            if (bytes > 0)
+            {
+                Check(H5Dread_chunk(dataset, H5P_DEFAULT, chunkFirst, &masks[i], stored[i].data()),
+                      "read " + name);
+            }
+        }
+
+        std::atomic<bool> failed(false);
+        vtkSMPTools::For(0, static_cast<vtkIdType>(count), [&](vtkIdType begin, vtkIdType end) {
+            std::vector<char> decoded;
+            for (vtkIdType i = begin; i < end; ++i)
+            {
+                hsize_t chunkFirst[kMaxRank];
+                grid.ChunkFirst(first + i, chunkFirst);
+                const std::vector<char> &bytes = stored[i];
+                // Bit 0 of the mask is set if the deflate filter was skipped
+                const bool compressed = deflate && !(masks[i] & 1) && !bytes.empty();
+                const char *chunkData = bytes.data();
+                if (bytes.empty() || compressed)
+                {
+                    decoded.assign(chunkBytes, 0);
+                    chunkData = decoded.data();
+                }
+                if (compressed)
+                {
+                    uLongf decodedSize = static_cast<uLongf>(chunkBytes);
+                    if (uncompress(reinterpret_cast<Bytef *>(decoded.data()), &decodedSize,
+                                   reinterpret_cast<const Bytef *>(bytes.data()),
+                                   static_cast<uLong>(bytes.size())) != Z_OK ||
+                        decodedSize != chunkBytes)
+                    {
+                        failed = true;
+                        continue;
+                    }
+                }
+                else if (!bytes.empty() && bytes.size() != chunkBytes)
+                {
+                    failed = true;
+                    continue;
+                }
+                CopyBox(rank, elementSize, chunkFirst, chunk, const_cast<char *>(chunkData),
+                        start, size, static_cast<char *>(out), false);
+            }
+        });
+        if (failed)
+        {
+            throw std::runtime_error("VTKHDF: corrupt chunk in " + name);
+        }
+    }
+}
+
+// Reads a whole dataset of the given rank and dimensions
+void ReadWholeDataset(hid_t group, const std::string &name, hid_t memType, int rank,
+                      const hsize_t *dims, void *out)
+{
+    H5Id dataset(H5Dopen2(group, name.c_str(), H5P_DEFAULT), H5Dclose, "open " + name);
+    const hsize_t start[kMaxRank] = {};
+    ReadDataset(dataset, name, memType, rank, start, dims, out);
+}
+
+// Dimensions of a dataset; throws unless its rank is in [minRank, maxRank]
+int DatasetDims(hid_t dataset, const std::string &name, int minRank, int maxRank, hsize_t *dims)
+{
+    H5Id space(H5Dget_space(dataset), H5Sclose, "get the space of " + name);
+    const int rank = H5Sget_simple_extent_ndims(space);
+    if (rank < minRank || rank > maxRank)
+    {
+        throw std::runtime_error("VTKHDF: unexpected shape of " + name);
+    }
+    H5Sget_simple_extent_dims(space, dims, nullptr);
+    return rank;
+}
+
+void WriteAttribute(hid_t object, const char *name, hid_t type, hsize_t count,
+                    const void *values)
+{
+    H5Id space(H5Screate_simple(1, &count, nullptr), H5Sclose, "create an attribute space");
+    H5Id attribute(H5Acreate2(object, name, type, space, H5P_DEFAULT, H5P_DEFAULT), H5Aclose,
+                   std::string("create attribute ") + name);
+    Check(H5Awrite(attribute, type, values), std::string("write attribute ") + name);
+}
+
+void WriteStringAttribute(hid_t object, const char *name, const std::string &value)
+{
+    H5Id type(H5Tcopy(H5T_C_S1), H5Tclose, "create a string type");
+    Check(H5Tset_size(type, std::max<std::size_t>(value.size(), 1)), "size a string type");
+    Check(H5Tset_strpad(type, H5T_STR_NULLPAD), "pad a string type");
+    H5Id space(H5Screate(H5S_SCALAR), H5Sclose, "create an attribute space");
+    H5Id attribute(H5Acreate2(object, name, type, space, H5P_DEFAULT, H5P_DEFAULT), H5Aclose,
+                   std::string("create attribute ") + name);
+    Check(H5Awrite(attribute, type, value.c_str()), std::string("write attribute ") + name);
+}
+
+void ReadAttribute(hid_t object, const char *name, hid_t memType, void *values)
+{
+    H5Id attribute(H5Aopen(object, name, H5P_DEFAULT), H5Aclose,
+                   std::string("open attribute ") + name);
+    Check(H5Aread(attribute, memType, values), std::string("read attribute ") + name);
+}
+
+std::string ReadStringAttribute(hid_t object, const char *name)
+{
+    H5Id attribute(H5Aopen(object, name, H5P_DEFAULT), H5Aclose,
+                   std::string("open attribute ") + name);
+    H5Id type(H5Aget_type(attribute), H5Tclose, std::string("get the type of ") + name);
+    if (H5Tis_variable_str(type) > 0)
+    {
+        char *text = nullptr;
+        Check(H5Aread(attribute, type, &text), std::string("read attribute ") + name);
+        std::string value = text ? text : "";
+        H5free_memory(text);
+        return value;
+    }
+    std::string value(H5Tget_size(type), '\0');
+    Check(H5Aread(attribute, type, value.data()), std::string("read attribute ") + name);
+    return value.substr(0, value.find('\0'));
+}
+
+// Writes the arrays of attributes into a new group; every array has the
+// shape dims (rank dimensions) plus a dimension for its components if it
+// has more than one
+void WriteArrays(hid_t parent, const char *groupName, vtkDataSetAttributes *attributes,
+                 int rank, const hsize_t *dims, const hsize_t *chunk, int level)
+{
+    H5Id group(H5Gcreate2(parent, groupName, H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT), H5Gclose,
+               std::string("create group ") + groupName);
+    for (int i = 0; i < attributes->GetNumberOfArrays(); ++i)
+    {
+        // Skips string and other non-numeric arrays
+        vtkDataArray *array = attributes->GetArray(i);
+        if (!array)
+        {
+            continue;
+        }
+        const std::string name =
+            array->GetName() && *array->GetName() ? array->GetName() : "Array" + std::to_string(i);
+        hsize_t arrayDims[kMaxRank], arrayChunk[kMaxRank];
+        std::copy(dims, dims + rank, arrayDims);
+        std::copy(chunk, chunk + rank, arrayChunk);
+        int arrayRank = rank;
+        if (array->GetNumberOfComponents() > 1)
+        {
+            arrayDims[rank] = arrayChunk[rank] = array->GetNumberOfComponents();
+            ++arrayRank;
+        }
+        WriteDataset(group, name, NativeType(array->GetDataType()), arrayRank, arrayDims,
+                     arrayChunk, array->GetVoidPointer(0), level);
+        if (array == attributes->GetScalars())
+        {
+            WriteStringAttribute(group, "Scalars", name);
+        }
+        else if (array == attributes->GetNormals())
+        {
+            WriteStringAttribute(group, "Normals", name);
+        }
+    }
+}
+
+// Reads the box [start, start + size) of every array in a group written by
+// WriteArrays, restoring the active scalars and normals
+void ReadArrays(hid_t parent, const char *groupName, vtkDataSetAttributes *attributes, int rank,
+                const hsize_t *start, const hsize_t *size)
+{
+    if (H5Lexists(parent, groupName, H5P_DEFAULT) <= 0)
+    {
+        return;
+    }
+    H5Id group(H5Gopen2(parent, groupName, H5P_DEFAULT), H5Gclose,
+               std::string("open group ") + groupName);
+    H5G_info_t info;
+    Check(H5Gget_info(group, &info), std::string("list group ") + groupName);
+    vtkIdType tuples = 1;
+    for (int d = 0; d < rank; ++d)
+    {
+        tuples *= static_cast<vtkIdType>(size[d]);
+    }
+    for (hsize_t i = 0; i < info.nlinks; ++i)
+    {
+        const ssize_t length = H5Lget_name_by_idx(group, ".", H5_INDEX_NAME, H5_ITER_INC, i,
+                                                  nullptr, 0, H5P_DEFAULT);
+        std::string name(static_cast<std::size_t>(std::max<ssize_t>(length, 0)) + 1, '\0');
+        H5Lget_name_by_idx(group, ".", H5_INDEX_NAME, H5_ITER_INC, i, name.data(), name.size(),
+                           H5P_DEFAULT);
+        name.resize(name.size() - 1);
+
+        H5Id dataset(H5Dopen2(group, name.c_str(), H5P_DEFAULT), H5Dclose, "open " + name);
+        hsize_t dims[kMaxRank];
+        const int datasetRank = DatasetDims(dataset, name, rank, rank + 1, dims);
+        H5Id type(H5Dget_type(dataset), H5Tclose, "get the type of " + name);
+        const int vtkType = VTKTypeOf(type);
+        hsize_t arrayStart[kMaxRank], arraySize[kMaxRank];
+        std::copy(start, start + rank, arrayStart);
+        std::copy(size, size + rank, arraySize);
+        int components = 1;
+        if (datasetRank > rank)
+        {
+            arrayStart[rank] = 0;
+            arraySize[rank] = dims[rank];
+            components = static_cast<int>(dims[rank]);
+        }
+
+        auto array = vtkSmartPointer<vtkDataArray>::Take(vtkDataArray::CreateDataArray(vtkType));
+        array->SetName(name.c_str());
+        array->SetNumberOfComponents(components);
+        array->SetNumberOfTuples(tuples);
+        ReadDataset(dataset, name, NativeType(vtkType), datasetRank, arrayStart, arraySize,
+                    array->GetVoidPointer(0));
+        attributes->AddArray(array);
+    }
+    if (H5Aexists(group, "Scalars") > 0)
+    {
+        attributes->SetActiveScalars(ReadStringAttribute(group, "Scalars").c_str());
+    }
+    if (H5Aexists(group, "Normals") > 0)
+    {
+        attributes->SetActiveNormals(ReadStringAttribute(group, "Normals").c_str());
+    }
+}
+
+// Offsets or connectivity of a cell array as 64-bit ids
+const long long *Ids64(vtkDataArray *ids, std::vector<long long> &converted)
+{
+    if (auto *ids64 = vtkTypeInt64Array::FastDownCast(ids))
+    {
+        return ids64->GetPointer(0);
+    }
+    auto *ids32 = vtkTypeInt32Array::FastDownCast(ids);
+    converted.resize(static_cast<std::size_t>(ids->GetNumberOfValues()));
+    vtkSMPTools::For(0, ids->GetNumberOfValues(), [&](vtkIdType begin, vtkIdType end) {
+        for (vtkIdType i = begin; i < end; ++i)
+        {
+            converted[i] = ids32 ? ids32->GetValue(i) : static_cast<long long>(ids->GetTuple1(i));
+        }
+    });
+    return converted.data();
+}
+
+void WriteScalarDataset(hid_t group, const char *name, long long value)
+{
+    const hsize_t one = 1;
+    WriteDataset(group, name, H5T_NATIVE_LLONG, 1, &one, &one, &value, 0);
+}
+
+long long ReadScalarDataset(hid_t group, const std::string &name)
+{
+    H5Id dataset(H5Dopen2(group, name.c_str(), H5P_DEFAULT), H5Dclose, "open " + name);
+    hsize_t dims[1];
+    DatasetDims(dataset, name, 1, 1, dims);
+    if (dims[0] != 1)
+    {
+        throw std::runtime_error("VTKHDF: only single-piece files are supported");
+    }
+    long long value = 0;
+    const hsize_t start = 0;
+    ReadDataset(dataset, name, H5T_NATIVE_LLONG, 1, &start, dims, &value);
+    return value;
+}
+
+// Throws unless offsets start at 0, never decrease and end at the size of
+// connectivity, and every id is a point of the mesh
+void CheckCellArray(vtkIdTypeArray *offsets, vtkIdTypeArray *connectivity, vtkIdType numPoints,
+                    const std::string &name)
+{
+    const vtkIdType *first = offsets->GetPointer(0);
+    const vtkIdType cells = offsets->GetNumberOfValues() - 1;
+    const vtkIdType *ids = connectivity->GetPointer(0);
+    std::atomic<bool> failed(first[0] != 0 || first[cells] != connectivity->GetNumberOfValues());
+    vtkSMPTools::For(0, cells, [&](vtkIdType begin, vtkIdType end) {
+        for (vtkIdType i = begin; i < end && !failed; ++i)
+        {
+            if (first[i] > first[i + 1])
+            {
+                failed = true;
+            }
+        }
+    });
+    vtkSMPTools::For(0, connectivity->GetNumberOfValues(), [&](vtkIdType begin, vtkIdType end) {
+        for (vtkIdType i = begin; i < end && !failed; ++i)
+        {
+            if (ids[i] < 0 || ids[i] >= numPoints)
+            {
+                failed = true;
+            }
+        }
+    });
+    if (failed)
+    {
+        throw std::runtime_error("VTKHDF: corrupt cells in " + name);
+    }
+}
+
+constexpr const char *kTopologies[4] = {"Vertices", "Lines", "Polygons", "Strips"};
+
+vtkCellArray *Topology(vtkPolyData *mesh, int index)
+{
+    switch (index)
+    {
+    case 0:
+        return mesh->GetVerts();
+    case 1:
+        return mesh->GetLines();
+    case 2:
+        return mesh->GetPolys();
+    default:
+        return mesh->GetStrips();
+    }
+}
+
+} // namespace
+
+void WriteVTKHDF(vtkImageData *image, const std::string &path, const VTKHDFOptions &options)
+{
+    H5Id file(H5Fcreate(path.c_str(), H5F_ACC_TRUNC, H5P_DEFAULT, H5P_DEFAULT), H5Fclose,
+              "create " + path);
+    H5Id root(H5Gcreate2(file, "VTKHDF", H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT), H5Gclose,
+              "create group VTKHDF");
+    const int version[2] = {1, 0};
+    WriteAttribute(root, "Version", H5T_NATIVE_INT, 2, version);
+    WriteStringAttribute(root, "Type", "ImageData");
+    int extent[6];
+    image->GetExtent(extent);
+    WriteAttribute(root, "WholeExtent", H5T_NATIVE_INT, 6, extent);
+    WriteAttribute(root, "Origin", H5T_NATIVE_DOUBLE, 3, image->GetOrigin());
+    WriteAttribute(root, "Spacing", H5T_NATIVE_DOUBLE, 3, image->GetSpacing());
+    WriteAttribute(root, "Direction", H5T_NATIVE_DOUBLE, 9,
+                   image->GetDirectionMatrix()->GetData());
+
+    // Datasets are indexed z, y, x
+    const hsize_t dims[3] = {static_cast<hsize_t>(extent[5] - extent[4] + 1),
+                             static_cast<hsize_t>(extent[3] - extent[2] + 1),
+                             static_cast<hsize_t>(extent[1] - extent[0] + 1)};
+    const hsize_t chunk[3] = {static_cast<hsize_t>(std::max(options.chunkSize[2], 1)),
+                              static_cast<hsize_t>(std::max(options.chunkSize[1], 1)),
+                              static_cast<hsize_t>(std::max(options.chunkSize[0], 1))};
+    WriteArrays(root, "PointData", image->GetPointData(), 3, dims, chunk,
+                options.compressionLevel);
+}
+
+void WriteVTKHDF(vtkPolyData *mesh, const std::string &path, const VTKHDFOptions &options)
+{
+    H5Id file(H5Fcreate(path.c_str(), H5F_ACC_TRUNC, H5P_DEFAULT, H5P_DEFAULT), H5Fclose,
+              "create " + path);
+    H5Id root(H5Gcreate2(file, "VTKHDF", H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT), H5Gclose,
+              "create group VTKHDF");
+    const int version[2] = {2, 0};
+    WriteAttribute(root, "Version", H5T_NATIVE_INT, 2, version);
+    WriteStringAttribute(root, "Type", "PolyData");
+
+    const hsize_t rows = std::max<std::uint64_t>(options.meshChunkRows, 1);
+    const int level = options.compressionLevel;
+    const vtkIdType numPoints = mesh->GetNumberOfPoints();
+    WriteScalarDataset(root, "NumberOfPoints", numPoints);
+    {
+        const hsize_t dims[2] = {static_cast<hsize_t>(numPoints), 3};
+        const hsize_t chunk[2] = {rows, 3};
+        if (numPoints > 0)
+        {
+            vtkDataArray *points = mesh->GetPoints()->GetData();
+            WriteDataset(root, "Points", NativeType(points->GetDataType()), 2, dims, chunk,
+                         points->GetVoidPointer(0), level);
+        }
+        else
+        {
+            WriteDataset(root, "Points", H5T_NATIVE_FLOAT, 2, dims, chunk, nullptr, level);
+        }
+    }
+
+    for (int t = 0; t < 4; ++t)
+    {
+        H5Id group(H5Gcreate2(root, kTopologies[t], H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT),
+                   H5Gclose, std::string("create group ") + kTopologies[t]);
+        vtkCellArray *cells = Topology(mesh, t);
+        const vtkIdType numCells = cells ? cells->GetNumberOfCells() : 0;
+        const vtkIdType numIds = cells ? cells->GetNumberOfConnectivityIds() : 0;
+        WriteScalarDataset(group, "NumberOfCells", numCells);
+        WriteScalarDataset(group, "NumberOfConnectivityIds", numIds);
+
+        std::vector<long long> offsets64, connectivity64;
+        const long long noCells = 0;
+        const long long *offsets = cells ? Ids64(cells->GetOffsetsArray(), offsets64) : &noCells;
+        const long long *connectivity =
+            cells ? Ids64(cells->GetConnectivityArray(), connectivity64) : nullptr;
+        const hsize_t offsetsDims = static_cast<hsize_t>(numCells + 1);
+        const hsize_t idsDims = static_cast<hsize_t>(numIds);
+        WriteDataset(group, "Offsets", H5T_NATIVE_LLONG, 1, &offsetsDims, &rows, offsets, level);
+        WriteDataset(group, "Connectivity", H5T_NATIVE_LLONG, 1, &idsDims, &rows, connectivity,
+                     level);
+    }
+
+    const hsize_t pointDims = static_cast<hsize_t>(numPoints);
+    WriteArrays(root, "PointData", mesh->GetPointData(), 1, &pointDims, &rows, level);
+    const hsize_t cellDims = static_cast<hsize_t>(mesh->GetNumberOfCells());
+    WriteArrays(root, "CellData", mesh->GetCellData(), 1, &cellDims, &rows, level);
+}
+
+vtkSmartPointer<vtkImageData> ReadVTKHDFImage(const std::string &path, const int *extent)
+{
+    H5Id file(H5Fopen(path.c_str(), H5F_ACC_RDONLY, H5P_DEFAULT), H5Fclose, "open " + path);
+    H5Id root(H5Gopen2(file, "VTKHDF", H5P_DEFAULT), H5Gclose, "open group VTKHDF in " + path);
+    if (ReadStringAttribute(root, "Type") != "ImageData")
+    {
+        throw std::runtime_error("VTKHDF: " + path + " does not hold image data");
+    }
+    int whole[6];
+    double origin[3], spacing[3];
+    double direction[9] = {1, 0, 0, 0, 1, 0, 0, 0, 1};
+    ReadAttribute(root, "WholeExtent", H5T_NATIVE_INT, whole);
+    ReadAttribute(root, "Origin", H5T_NATIVE_DOUBLE, origin);
+    ReadAttribute(root, "Spacing", H5T_NATIVE_DOUBLE, spacing);
+    if (H5Aexists(root, "Direction") > 0)
+    {
+        ReadAttribute(root, "Direction", H5T_NATIVE_DOUBLE, direction);
+    }
+
+    int sub[6];
+    std::copy(whole, whole + 6, sub);
+    if (extent)
+    {
+        for (int k = 0; k < 3; ++k)
+        {
+            sub[2 * k] = std::max(extent[2 * k], whole[2 * k]);
+            sub[2 * k + 1] = std::min(extent[2 * k + 1], whole[2 * k + 1]);
+            if (sub[2 * k] > sub[2 * k + 1])
+            {
+                throw std::runtime_error("VTKHDF: extent outside the volume of " + path);
+            }
+        }
+    }
+    auto image = vtkSmartPointer<vtkImageData>::New();
+    image->SetExtent(sub);
+    image->SetOrigin(origin);
+    image->SetSpacing(spacing);
+    image->SetDirectionMatrix(direction);
+
+    const hsize_t start[3] = {static_cast<hsize_t>(sub[4] - whole[4]),
+                              static_cast<hsize_t>(sub[2] - whole[2]),
+                              static_cast<hsize_t>(sub[0] - whole[0])};
+    const hsize_t size[3] = {static_cast<hsize_t>(sub[5] - sub[4] + 1),
+                             static_cast<hsize_t>(sub[3] - sub[2] + 1),
+                             static_cast<hsize_t>(sub[1] - sub[0] + 1)};
+    ReadArrays(root, "PointData", image->GetPointData(), 3, start, size);
+    if (!image->GetPointData()->GetScalars() && image->GetPointData()->GetNumberOfArrays() > 0)
+    {
+        // Files from other writers may not name their scalars
+        image->GetPointData()->SetScalars(image->GetPointData()->GetArray(0));
+    }
+    return image;
+}
+
+vtkSmartPointer<vtkPolyData> ReadVTKHDFPolyData(const std::string &path)
+{
+    H5Id file(H5Fopen(path.c_str(), H5F_ACC_RDONLY, H5P_DEFAULT), H5Fclose, "open " + path);
+    H5Id root(H5Gopen2(file, "VTKHDF", H5P_DEFAULT), H5Gclose, "open group VTKHDF in " + path);
+    if (ReadStringAttribute(root, "Type") != "PolyData")
+    {
+        throw std::runtime_error("VTKHDF: " + path + " does not hold poly data");
+    }
+
+    auto mesh = vtkSmartPointer<vtkPolyData>::New();
+    const auto numPoints = static_cast<vtkIdType>(ReadScalarDataset(root, "NumberOfPoints"));
+    if (numPoints < 0)
+    {
+        throw std::runtime_error("VTKHDF: negative NumberOfPoints in " + path);
+    }
+    {
+        H5Id dataset(H5Dopen2(root, "Points", H5P_DEFAULT), H5Dclose, "open Points");
+        hsize_t dims[2];
+        DatasetDims(dataset, "Points", 2, 2, dims);
+        if (dims[0] != static_cast<hsize_t>(numPoints) || dims[1] != 3)
+        {
+            throw std::runtime_error("VTKHDF: unexpected shape of Points in " + path);
+        }
+        H5Id type(H5Dget_type(dataset), H5Tclose, "get the type of Points");
+        const int vtkType = VTKTypeOf(type) == VTK_DOUBLE ? VTK_DOUBLE : VTK_FLOAT;
+        auto points = vtkSmartPointer<vtkPoints>::New();
+        points->SetDataType(vtkType);
+        points->SetNumberOfPoints(numPoints);
+        const hsize_t start[2] = {0, 0};
+        ReadDataset(dataset, "Points", NativeType(vtkType), 2, start, dims,
+                    points->GetData()->GetVoidPointer(0));
+        mesh->SetPoints(points);
+    }
+
+    vtkIdType numCells = 0;
+    for (int t = 0; t < 4; ++t)
+    {
+        if (H5Lexists(root, kTopologies[t], H5P_DEFAULT) <= 0)
+        {
+            continue;
+        }
+        H5Id group(H5Gopen2(root, kTopologies[t], H5P_DEFAULT), H5Gclose,
+                   std::string("open group ") + kTopologies[t]);
+        const auto cells = static_cast<vtkIdType>(ReadScalarDataset(group, "NumberOfCells"));
+        const auto ids =
+            static_cast<vtkIdType>(ReadScalarDataset(group, "NumberOfConnectivityIds"));
+        if (cells < 0 || ids < 0)
+        {
+            throw std::runtime_error(std::string("VTKHDF: negative sizes of ") + kTopologies[t] +
+                                     " in " + path);
+        }
+        auto offsets = vtkSmartPointer<vtkIdTypeArray>::New();
+        offsets->SetNumberOfValues(cells + 1);
+        auto connectivity = vtkSmartPointer<vtkIdTypeArray>::New();
+        connectivity->SetNumberOfValues(ids);
+        const hsize_t offsetsDims = static_cast<hsize_t>(cells + 1);
+        const hsize_t idsDims = static_cast<hsize_t>(ids);
+        ReadWholeDataset(group, "Offsets", H5T_NATIVE_LLONG, 1, &offsetsDims,
+                         offsets->GetPointer(0));
+        ReadWholeDataset(group, "Connectivity", H5T_NATIVE_LLONG, 1, &idsDims,
+                         connectivity->GetPointer(0));
+        CheckCellArray(offsets, connectivity, numPoints,
+                       std::string(kTopologies[t]) + " of " + path);
+        if (cells == 0)
+        {
+            continue;
+        }
+        auto cellArray = vtkSmartPointer<vtkCellArray>::New();
+        cellArray->SetData(offsets, connectivity);
+        switch (t)
+        {
+        case 0:
+            mesh->SetVerts(cellArray);
+            break;
+        case 1:
+            mesh->SetLines(cellArray);
+            break;
+        case 2:
+            mesh->SetPolys(cellArray);
+            break;
+        default:
+            mesh->SetStrips(cellArray);
+        }
+        numCells += cells;
+    }
+
+    const hsize_t start = 0;
+    const hsize_t pointSize = static_cast<hsize_t>(numPoints);
+    ReadArrays(root, "PointData", mesh->GetPointData(), 1, &start, &pointSize);
+    const hsize_t cellSize = static_cast<hsize_t>(numCells);
+    ReadArrays(root, "CellData", mesh->GetCellData(), 1, &start, &cellSize);
+    return mesh;
+}
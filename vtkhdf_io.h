@@ -0,0 +1,41 @@
+#pragma once
+
+#include <vtkImageData.h>
+#include <vtkPolyData.h>
+#include <vtkSmartPointer.h>
+
+#include <cstdint>
+#include <string>
+
+// VTKHDF files (ImageData version 1.0 and PolyData version 2.0, one piece)
+// for volumes and meshes, readable by VTK's vtkHDFReader.
+//
+// Datasets are chunked. The writer compresses whole chunks with zlib on
+// vtkSMPTools and hands them to HDF5 as raw chunks; the reader fetches the
+// raw chunks it needs and decompresses them in parallel. HDF5 itself is only
+// called from the calling thread. Datasets written without chunking or with
+// other filters are read through HDF5 as they are. I/O errors and malformed
+// files throw std::runtime_error.
+
+struct VTKHDFOptions
+{
+    // Chunk edges of volume arrays in voxels along x, y and z
+    int chunkSize[3] = {64, 64, 64};
+    // Points, cells or point ids per chunk of mesh arrays
+    std::uint64_t meshChunkRows = std::uint64_t(1) << 18;
+    // zlib level, 0 to store chunks uncompressed
+    int compressionLevel = 1;
+};
+
+void WriteVTKHDF(vtkImageData *image, const std::string &path,
+                 const VTKHDFOptions &options = {});
+void WriteVTKHDF(vtkPolyData *mesh, const std::string &path,
+                 const VTKHDFOptions &options = {});
+
+// Reads the point data of a volume, or only the voxels within extent (six
+// indices in the file's whole extent, clamped to it) if it is not null; the
+// result keeps the file's origin, spacing and direction and has that extent.
+vtkSmartPointer<vtkImageData> ReadVTKHDFImage(const std::string &path,
+                                              const int *extent = nullptr);
+
+vtkSmartPointer<vtkPolyData> ReadVTKHDFPolyData(const std::string &path);